@@ -86,6 +86,7 @@
 
 #define UA_getnameinfo getnameinfo
 #define UA_send send
+#define UA_sendmsg sendmsg
 #define UA_recv recv
 #define UA_sendto sendto
 #define UA_recvfrom recvfrom
@@ -16,6 +16,17 @@
 
 #include <string.h> // memset
 
+#ifdef UA_ENABLE_EPOLL
+# include <sys/epoll.h>
+#endif
+
+#ifdef UA_ENABLE_IO_URING
+# include <linux/io_uring.h>
+# include <sys/mman.h>
+# include <sys/syscall.h>
+# include <unistd.h>
+#endif
+
 #ifndef MSG_NOSIGNAL
 #define MSG_NOSIGNAL 0
 #endif
@@ -29,25 +40,26 @@ connection_getsendbuffer(UA_Connection *connection,
                          size_t length, UA_ByteString *buf) {
     if(length > connection->config.sendBufferSize)
         return UA_STATUSCODE_BADCOMMUNICATIONERROR;
-    return UA_ByteString_allocBuffer(buf, length);
+    return UA_BufferPool_getBuffer(&connection->sendBufferPool,
+                                   connection->config.sendBufferSize, length, buf);
 }
 
 static void
 connection_releasesendbuffer(UA_Connection *connection,
                              UA_ByteString *buf) {
-    UA_ByteString_deleteMembers(buf);
+    UA_BufferPool_releaseBuffer(&connection->sendBufferPool, buf);
 }
 
 static void
 connection_releaserecvbuffer(UA_Connection *connection,
                              UA_ByteString *buf) {
-    UA_ByteString_deleteMembers(buf);
+    UA_BufferPool_releaseBuffer(&connection->recvBufferPool, buf);
 }
 
 static UA_StatusCode
 connection_write(UA_Connection *connection, UA_ByteString *buf) {
     if(connection->state == UA_CONNECTION_CLOSED) {
-        UA_ByteString_deleteMembers(buf);
+        connection_releasesendbuffer(connection, buf);
         return UA_STATUSCODE_BADCONNECTIONCLOSED;
     }
 
@@ -66,15 +78,15 @@ connection_write(UA_Connection *connection, UA_ByteString *buf) {
                      bytes_to_send, flags);
             if(n < 0 && UA_ERRNO != UA_INTERRUPTED && UA_ERRNO != UA_AGAIN) {
                 connection->close(connection);
-                UA_ByteString_deleteMembers(buf);
+                connection_releasesendbuffer(connection, buf);
                 return UA_STATUSCODE_BADCONNECTIONCLOSED;
             }
         } while(n < 0);
         nWritten += (size_t)n;
     } while(nWritten < buf->length);
 
-    /* Free the buffer */
-    UA_ByteString_deleteMembers(buf);
+    /* Return the buffer to the pool */
+    connection_releasesendbuffer(connection, buf);
     return UA_STATUSCODE_GOOD;
 }
 
@@ -111,11 +123,12 @@ connection_recv(UA_Connection *connection, UA_ByteString *response,
         }
     }
 
-    response->data = (UA_Byte*)UA_malloc(connection->config.recvBufferSize);
-    if(!response->data) {
-        response->length = 0;
-        return UA_STATUSCODE_BADOUTOFMEMORY; /* not enough memory retry */
-    }
+    UA_StatusCode retval =
+        UA_BufferPool_getBuffer(&connection->recvBufferPool,
+                                connection->config.recvBufferSize,
+                                connection->config.recvBufferSize, response);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval; /* not enough memory retry */
 
     size_t offset = connection->incompleteChunk.length;
     size_t remaining = connection->config.recvBufferSize - offset;
@@ -126,14 +139,14 @@ connection_recv(UA_Connection *connection, UA_ByteString *response,
 
     /* The remote side closed the connection */
     if(ret == 0) {
-        UA_ByteString_deleteMembers(response);
+        connection_releaserecvbuffer(connection, response);
         connection->close(connection);
         return UA_STATUSCODE_BADCONNECTIONCLOSED;
     }
 
     /* Error case */
     if(ret < 0) {
-        UA_ByteString_deleteMembers(response);
+        connection_releaserecvbuffer(connection, response);
         if(UA_ERRNO == UA_INTERRUPTED || (timeout > 0) ?
            false : (UA_ERRNO == UA_EAGAIN || UA_ERRNO == UA_WOULDBLOCK))
             return UA_STATUSCODE_GOOD; /* statuscode_good but no data -> retry */
@@ -160,9 +173,29 @@ connection_recv(UA_Connection *connection, UA_ByteString *response,
 #define NOHELLOTIMEOUT 120000 /* timeout in ms before close the connection
                                * if server does not receive Hello Message */
 
+#define SENDQUEUE_MAXIOV 64 /* Max number of chunks written in one call */
+
 typedef struct ConnectionEntry {
     UA_Connection connection;
     LIST_ENTRY(ConnectionEntry) pointers;
+
+    /* Chunks that are not yet written to the socket. sendOffset bytes of the
+     * chunk at sendQueueHead are already sent. */
+    UA_ByteString *sendQueue;
+    size_t sendQueueHead;
+    size_t sendQueueSize;
+    size_t sendQueueCapacity;
+    size_t sendOffset;
+    UA_Boolean writeBlocked; /* Wait until the socket is writable */
+
+    /* Connections with chunks to be written at the end of the iteration */
+    TAILQ_ENTRY(ConnectionEntry) flushPointers;
+    UA_Boolean flushScheduled;
+
+    /* Connections that have not yet received a HEL message, ordered by their
+     * opening date */
+    TAILQ_ENTRY(ConnectionEntry) openingPointers;
+    UA_Boolean opening;
 } ConnectionEntry;
 
 typedef struct {
@@ -171,24 +204,290 @@ typedef struct {
     UA_SOCKET serverSockets[FD_SETSIZE];
     UA_UInt16 serverSocketsSize;
     LIST_HEAD(, ConnectionEntry) connections;
+    TAILQ_HEAD(, ConnectionEntry) flushConnections;
+    UA_Boolean sendCoalescing;
+    TAILQ_HEAD(, ConnectionEntry) openingConnections;
+#ifdef UA_ENABLE_EPOLL
+    int epollfd; /* -1 for the select-based network layer */
+#endif
 } ServerNetworkLayerTCP;
 
+static void
+ServerNetworkLayerTCP_clearSendQueue(ConnectionEntry *e) {
+    for(size_t i = e->sendQueueHead; i < e->sendQueueSize; i++)
+        connection_releasesendbuffer(&e->connection, &e->sendQueue[i]);
+    e->sendQueueHead = 0;
+    e->sendQueueSize = 0;
+    e->sendOffset = 0;
+    e->connection.pendingSendBytes = 0;
+}
+
+#ifdef UA_ENABLE_EPOLL
+/* Watch for the socket to become writable while chunks are queued */
+static void
+ServerNetworkLayerEpoll_watchWritable(ConnectionEntry *e, UA_Boolean writable) {
+    ServerNetworkLayerTCP *layer = (ServerNetworkLayerTCP*)e->connection.handle;
+    if(layer->epollfd < 0)
+        return;
+    struct epoll_event event;
+    memset(&event, 0, sizeof(struct epoll_event));
+    event.events = EPOLLIN | EPOLLRDHUP;
+    if(writable)
+        event.events |= EPOLLOUT;
+    event.data.ptr = e;
+    epoll_ctl(layer->epollfd, EPOLL_CTL_MOD, e->connection.sockfd, &event);
+}
+#endif
+
 static void
 ServerNetworkLayerTCP_freeConnection(UA_Connection *connection) {
+    ConnectionEntry *e = (ConnectionEntry*)connection;
+    ServerNetworkLayerTCP_clearSendQueue(e);
+    UA_free(e->sendQueue);
     UA_Connection_deleteMembers(connection);
     UA_free(connection);
 }
 
+/* Write the queued chunks without blocking. If available, the chunks are
+ * gathered in a single sendmsg. blocked is set if the socket did not take all
+ * the offered data. */
+static UA_StatusCode
+ServerNetworkLayerTCP_write(ConnectionEntry *e, size_t *written,
+                            UA_Boolean *blocked) {
+#ifdef UA_sendmsg
+    struct iovec iov[SENDQUEUE_MAXIOV];
+    size_t iovSize = e->sendQueueSize - e->sendQueueHead;
+    if(iovSize > SENDQUEUE_MAXIOV)
+        iovSize = SENDQUEUE_MAXIOV;
+    size_t offered = 0;
+    for(size_t i = 0; i < iovSize; i++) {
+        iov[i].iov_base = e->sendQueue[e->sendQueueHead + i].data;
+        iov[i].iov_len = e->sendQueue[e->sendQueueHead + i].length;
+        offered += iov[i].iov_len;
+    }
+    iov[0].iov_base = (UA_Byte*)iov[0].iov_base + e->sendOffset;
+    iov[0].iov_len -= e->sendOffset;
+    offered -= e->sendOffset;
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(struct msghdr));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = iovSize;
+#else
+    const UA_ByteString *buf = &e->sendQueue[e->sendQueueHead];
+    size_t offered = buf->length - e->sendOffset;
+#endif
+
+    *written = 0;
+    *blocked = false;
+    while(true) {
+#ifdef UA_sendmsg
+        ssize_t n = UA_sendmsg(e->connection.sockfd, &msg, MSG_NOSIGNAL);
+#else
+        ssize_t n = UA_send(e->connection.sockfd,
+                            (const char*)&buf->data[e->sendOffset],
+                            offered, MSG_NOSIGNAL);
+#endif
+        if(n >= 0) {
+            *written = (size_t)n;
+            *blocked = (*written < offered);
+            return UA_STATUSCODE_GOOD;
+        }
+        if(UA_ERRNO == UA_INTERRUPTED)
+            continue;
+        if(UA_ERRNO == UA_AGAIN || UA_ERRNO == UA_WOULDBLOCK) {
+            *blocked = true; /* Try again when the socket is writable */
+            return UA_STATUSCODE_GOOD;
+        }
+        return UA_STATUSCODE_BADCONNECTIONCLOSED;
+    }
+}
+
+/* Send the queued chunks until the socket would block */
+static void
+ServerNetworkLayerTCP_flush(ConnectionEntry *e) {
+    while(e->sendQueueHead < e->sendQueueSize) {
+        size_t written = 0;
+        UA_Boolean blocked = false;
+        UA_StatusCode retval = ServerNetworkLayerTCP_write(e, &written, &blocked);
+        if(retval != UA_STATUSCODE_GOOD) {
+            /* The closed socket is picked up in the next listen */
+            ServerNetworkLayerTCP_clearSendQueue(e);
+            UA_shutdown((UA_SOCKET)e->connection.sockfd, 2);
+            e->connection.state = UA_CONNECTION_CLOSED;
+            return;
+        }
+
+        /* Release the completely sent chunks */
+        e->connection.pendingSendBytes -= written;
+        written += e->sendOffset;
+        while(e->sendQueueHead < e->sendQueueSize &&
+              written >= e->sendQueue[e->sendQueueHead].length) {
+            written -= e->sendQueue[e->sendQueueHead].length;
+            connection_releasesendbuffer(&e->connection, &e->sendQueue[e->sendQueueHead]);
+            e->sendQueueHead++;
+        }
+        e->sendOffset = written;
+
+        /* The socket would block */
+        if(blocked) {
+            if(!e->writeBlocked) {
+                e->writeBlocked = true;
+#ifdef UA_ENABLE_EPOLL
+                ServerNetworkLayerEpoll_watchWritable(e, true);
+#endif
+            }
+            return;
+        }
+    }
+
+    /* Everything is sent */
+    e->sendQueueHead = 0;
+    e->sendQueueSize = 0;
+    e->sendOffset = 0;
+    if(e->writeBlocked) {
+        e->writeBlocked = false;
+#ifdef UA_ENABLE_EPOLL
+        ServerNetworkLayerEpoll_watchWritable(e, false);
+#endif
+    }
+}
+
+/* Flush the connections that have sent chunks during the iteration */
+static void
+ServerNetworkLayerTCP_flushAll(ServerNetworkLayerTCP *layer) {
+    ConnectionEntry *e;
+    while((e = TAILQ_FIRST(&layer->flushConnections))) {
+        TAILQ_REMOVE(&layer->flushConnections, e, flushPointers);
+        e->flushScheduled = false;
+        if(!e->writeBlocked)
+            ServerNetworkLayerTCP_flush(e);
+    }
+}
+
+/* The chunk is queued. With coalescing, all chunks of the connection are
+ * written together at the end of the iteration. Otherwise they are written
+ * right away as far as possible without blocking. The remainder is sent in
+ * listen when the socket becomes writable. */
+static UA_StatusCode
+ServerNetworkLayerTCP_send(UA_Connection *connection, UA_ByteString *buf) {
+    if(connection->state == UA_CONNECTION_CLOSED) {
+        connection_releasesendbuffer(connection, buf);
+        return UA_STATUSCODE_BADCONNECTIONCLOSED;
+    }
+
+    /* Make room in the queue */
+    ConnectionEntry *e = (ConnectionEntry*)connection;
+    if(e->sendQueueSize == e->sendQueueCapacity) {
+        if(e->sendQueueHead > 0) {
+            memmove(e->sendQueue, &e->sendQueue[e->sendQueueHead],
+                    (e->sendQueueSize - e->sendQueueHead) * sizeof(UA_ByteString));
+            e->sendQueueSize -= e->sendQueueHead;
+            e->sendQueueHead = 0;
+        } else {
+            size_t newCapacity = (e->sendQueueCapacity == 0) ? 8 : e->sendQueueCapacity * 2;
+            UA_ByteString *newQueue = (UA_ByteString*)
+                UA_realloc(e->sendQueue, newCapacity * sizeof(UA_ByteString));
+            if(!newQueue) {
+                connection->close(connection);
+                connection_releasesendbuffer(connection, buf);
+                return UA_STATUSCODE_BADOUTOFMEMORY;
+            }
+            e->sendQueue = newQueue;
+            e->sendQueueCapacity = newCapacity;
+        }
+    }
+
+    /* Take ownership of the buffer */
+    e->sendQueue[e->sendQueueSize] = *buf;
+    e->sendQueueSize++;
+    connection->pendingSendBytes += buf->length;
+    *buf = UA_BYTESTRING_NULL;
+
+    /* Wait until the socket is writable */
+    if(e->writeBlocked)
+        return UA_STATUSCODE_GOOD;
+
+    ServerNetworkLayerTCP *layer = (ServerNetworkLayerTCP*)connection->handle;
+    if(!layer->sendCoalescing) {
+        ServerNetworkLayerTCP_flush(e);
+        if(connection->state == UA_CONNECTION_CLOSED)
+            return UA_STATUSCODE_BADCONNECTIONCLOSED;
+        return UA_STATUSCODE_GOOD;
+    }
+
+    if(!e->flushScheduled) {
+        TAILQ_INSERT_TAIL(&layer->flushConnections, e, flushPointers);
+        e->flushScheduled = true;
+    }
+    return UA_STATUSCODE_GOOD;
+}
+
 /* This performs only 'shutdown'. 'close' is called when the shutdown
- * socket is returned from select. */
+ * socket is returned from select. Queued chunks are sent if this is possible
+ * without blocking. */
 static void
 ServerNetworkLayerTCP_close(UA_Connection *connection) {
     if (connection->state == UA_CONNECTION_CLOSED)
         return;
+    ConnectionEntry *e = (ConnectionEntry*)connection;
+    ServerNetworkLayerTCP_flush(e);
+    ServerNetworkLayerTCP_clearSendQueue(e);
     UA_shutdown((UA_SOCKET)connection->sockfd, 2);
     connection->state = UA_CONNECTION_CLOSED;
 }
 
+/* Remove the connection from the network layer before it is handed back to
+ * the server */
+static void
+ServerNetworkLayerTCP_unlinkConnection(ServerNetworkLayerTCP *layer,
+                                       ConnectionEntry *e) {
+    LIST_REMOVE(e, pointers);
+    if(e->flushScheduled) {
+        TAILQ_REMOVE(&layer->flushConnections, e, flushPointers);
+        e->flushScheduled = false;
+    }
+    if(e->opening) {
+        TAILQ_REMOVE(&layer->openingConnections, e, openingPointers);
+        e->opening = false;
+    }
+}
+
+/* Close the socket and hand the connection back to the server */
+static void
+ServerNetworkLayerTCP_removeConnection(ServerNetworkLayerTCP *layer, UA_Server *server,
+                                       ConnectionEntry *e) {
+    ServerNetworkLayerTCP_unlinkConnection(layer, e);
+#ifdef UA_ENABLE_EPOLL
+    if(layer->epollfd >= 0)
+        epoll_ctl(layer->epollfd, EPOLL_CTL_DEL, e->connection.sockfd, NULL);
+#endif
+    UA_close(e->connection.sockfd);
+    UA_Server_removeConnection(server, &e->connection);
+}
+
+/* Only the head of the opening queue needs to be inspected. Connections that
+ * have completed the handshake in the meantime are dropped from the queue when
+ * they reach the head. */
+static void
+ServerNetworkLayerTCP_checkHelloTimeout(ServerNetworkLayerTCP *layer,
+                                        UA_Server *server) {
+    UA_DateTime now = UA_DateTime_nowMonotonic();
+    ConnectionEntry *e;
+    while((e = TAILQ_FIRST(&layer->openingConnections))) {
+        if(e->connection.state != UA_CONNECTION_OPENING) {
+            TAILQ_REMOVE(&layer->openingConnections, e, openingPointers);
+            e->opening = false;
+            continue;
+        }
+        if(now <= e->connection.openingDate + (NOHELLOTIMEOUT * UA_DATETIME_MSEC))
+            break;
+        UA_LOG_INFO(layer->logger, UA_LOGCATEGORY_NETWORK,
+                    "Connection %i | Closed by the server (no Hello Message)",
+                    (int)(e->connection.sockfd));
+        ServerNetworkLayerTCP_removeConnection(layer, server, e);
+    }
+}
+
 static UA_StatusCode
 ServerNetworkLayerTCP_add(UA_ServerNetworkLayer *nl, ServerNetworkLayerTCP *layer,
                           UA_Int32 newsockfd, struct sockaddr_storage *remote) {
@@ -235,12 +534,12 @@ ServerNetworkLayerTCP_add(UA_ServerNetworkLayer *nl, ServerNetworkLayerTCP *laye
         return UA_STATUSCODE_BADOUTOFMEMORY;
     }
 
+    memset(e, 0, sizeof(ConnectionEntry));
     UA_Connection *c = &e->connection;
-    memset(c, 0, sizeof(UA_Connection));
     c->sockfd = newsockfd;
     c->handle = layer;
     c->config = nl->localConnectionConfig;
-    c->send = connection_write;
+    c->send = ServerNetworkLayerTCP_send;
     c->close = ServerNetworkLayerTCP_close;
     c->free = ServerNetworkLayerTCP_freeConnection;
     c->getSendBuffer = connection_getsendbuffer;
@@ -251,6 +550,31 @@ ServerNetworkLayerTCP_add(UA_ServerNetworkLayer *nl, ServerNetworkLayerTCP *laye
 
     /* Add to the linked list */
     LIST_INSERT_HEAD(&layer->connections, e, pointers);
+
+#ifdef UA_ENABLE_EPOLL
+    /* Register the socket once. Events point directly to the entry. */
+    if(layer->epollfd >= 0) {
+        struct epoll_event event;
+        memset(&event, 0, sizeof(struct epoll_event));
+        event.events = EPOLLIN | EPOLLRDHUP;
+        event.data.ptr = e;
+        if(epoll_ctl(layer->epollfd, EPOLL_CTL_ADD, newsockfd, &event) != 0) {
+            UA_LOG_SOCKET_ERRNO_WRAP(
+                UA_LOG_WARNING(layer->logger, UA_LOGCATEGORY_NETWORK,
+                               "Connection %i | Could not register the socket "
+                               "with epoll: %s", (int)newsockfd, errno_str));
+            LIST_REMOVE(e, pointers);
+            UA_close(newsockfd);
+            UA_free(e);
+            return UA_STATUSCODE_BADINTERNALERROR;
+        }
+    }
+#endif
+
+    /* Track the HEL timeout. New connections are appended, so the queue is
+     * ordered by the opening date. */
+    e->opening = true;
+    TAILQ_INSERT_TAIL(&layer->openingConnections, e, openingPointers);
     return UA_STATUSCODE_GOOD;
 }
 
@@ -402,12 +726,23 @@ ServerNetworkLayerTCP_listen(UA_ServerNetworkLayer *nl, UA_Server *server,
     if (layer->serverSocketsSize == 0)
         return UA_STATUSCODE_GOOD;
 
-    /* Listen on open sockets (including the server) */
-    fd_set fdset, errset;
+    /* Send the chunks generated since the last listen (e.g. in timed
+     * callbacks) */
+    ServerNetworkLayerTCP_flushAll(layer);
+
+    /* Listen on open sockets (including the server). Wait for sockets with
+     * queued chunks to become writable. */
+    fd_set fdset, errset, writeset;
     UA_Int32 highestfd = setFDSet(layer, &fdset);
     setFDSet(layer, &errset);
+    FD_ZERO(&writeset);
+    ConnectionEntry *e, *e_tmp;
+    LIST_FOREACH(e, &layer->connections, pointers) {
+        if(e->writeBlocked)
+            UA_fd_set(e->connection.sockfd, &writeset);
+    }
     struct timeval tmptv = {0, timeout * 1000};
-    if (UA_select(highestfd+1, &fdset, NULL, &errset, &tmptv) < 0) {
+    if (UA_select(highestfd+1, &fdset, &writeset, &errset, &tmptv) < 0) {
         UA_LOG_SOCKET_ERRNO_WRAP(
             UA_LOG_WARNING(layer->logger, UA_LOGCATEGORY_NETWORK,
                            "Socket select failed with %s", errno_str));
@@ -434,20 +769,14 @@ ServerNetworkLayerTCP_listen(UA_ServerNetworkLayer *nl, UA_Server *server,
         ServerNetworkLayerTCP_add(nl, layer, (UA_Int32)newsockfd, &remote);
     }
 
+    /* Close connections without a HEL message */
+    ServerNetworkLayerTCP_checkHelloTimeout(layer, server);
+
     /* Read from established sockets */
-    ConnectionEntry *e, *e_tmp;
-    UA_DateTime now = UA_DateTime_nowMonotonic();
     LIST_FOREACH_SAFE(e, &layer->connections, pointers, e_tmp) {
-        if ((e->connection.state == UA_CONNECTION_OPENING) &&
-            (now > (e->connection.openingDate + (NOHELLOTIMEOUT * UA_DATETIME_MSEC)))){
-            UA_LOG_INFO(layer->logger, UA_LOGCATEGORY_NETWORK,
-                        "Connection %i | Closed by the server (no Hello Message)",
-                         (int)(e->connection.sockfd));
-            LIST_REMOVE(e, pointers);
-            UA_close(e->connection.sockfd);
-            UA_Server_removeConnection(server, &e->connection);
-            continue;
-        }
+        /* Send queued chunks */
+        if(UA_fd_isset(e->connection.sockfd, &writeset))
+            ServerNetworkLayerTCP_flush(e);
 
         if(!UA_fd_isset(e->connection.sockfd, &errset) &&
            !UA_fd_isset(e->connection.sockfd, &fdset))
@@ -469,11 +798,12 @@ ServerNetworkLayerTCP_listen(UA_ServerNetworkLayer *nl, UA_Server *server,
             UA_LOG_INFO(layer->logger, UA_LOGCATEGORY_NETWORK,
                         "Connection %i | Closed",
                         (int)(e->connection.sockfd));
-            LIST_REMOVE(e, pointers);
-            UA_close(e->connection.sockfd);
-            UA_Server_removeConnection(server, &e->connection);
+            ServerNetworkLayerTCP_removeConnection(layer, server, e);
         }
     }
+
+    /* Send the responses */
+    ServerNetworkLayerTCP_flushAll(layer);
     return UA_STATUSCODE_GOOD;
 }
 
@@ -512,11 +842,16 @@ ServerNetworkLayerTCP_deleteMembers(UA_ServerNetworkLayer *nl) {
      * running. So this is safe. */
     ConnectionEntry *e, *e_tmp;
     LIST_FOREACH_SAFE(e, &layer->connections, pointers, e_tmp) {
-        LIST_REMOVE(e, pointers);
+        ServerNetworkLayerTCP_unlinkConnection(layer, e);
         UA_close(e->connection.sockfd);
-        UA_free(e);
+        ServerNetworkLayerTCP_freeConnection(&e->connection);
     }
 
+#ifdef UA_ENABLE_EPOLL
+    if(layer->epollfd >= 0)
+        UA_close(layer->epollfd);
+#endif
+
     /* Free the layer */
     UA_free(layer);
 }
@@ -541,10 +876,1006 @@ UA_ServerNetworkLayerTCP(UA_ConnectionConfig config, UA_UInt16 port,
 
     layer->logger = logger;
     layer->port = port;
+    layer->sendCoalescing = true;
+    TAILQ_INIT(&layer->flushConnections);
+    TAILQ_INIT(&layer->openingConnections);
+#ifdef UA_ENABLE_EPOLL
+    layer->epollfd = -1;
+#endif
+
+    return nl;
+}
+
+void
+UA_ServerNetworkLayerTCP_setSendCoalescing(UA_ServerNetworkLayer *nl,
+                                           UA_Boolean enabled) {
+    ServerNetworkLayerTCP *layer = (ServerNetworkLayerTCP *)nl->handle;
+    if(layer)
+        layer->sendCoalescing = enabled;
+}
+
+#ifdef UA_ENABLE_EPOLL
+
+/*****************************/
+/* Server NetworkLayer epoll */
+/*****************************/
+
+/* Maximum number of events handled in one call to listen. Remaining events are
+ * picked up in the next iteration. */
+#define EPOLL_MAXEVENTS 64
+
+static UA_Boolean
+isServerSocketEvent(ServerNetworkLayerTCP *layer, void *ptr) {
+    return ((uintptr_t)ptr >= (uintptr_t)layer->serverSockets &&
+            (uintptr_t)ptr < (uintptr_t)&layer->serverSockets[layer->serverSocketsSize]);
+}
+
+static UA_StatusCode
+ServerNetworkLayerEpoll_start(UA_ServerNetworkLayer *nl, const UA_String *customHostname) {
+    ServerNetworkLayerTCP *layer = (ServerNetworkLayerTCP *)nl->handle;
+    layer->epollfd = epoll_create1(EPOLL_CLOEXEC);
+    if(layer->epollfd < 0) {
+        UA_LOG_SOCKET_ERRNO_WRAP(
+            UA_LOG_ERROR(layer->logger, UA_LOGCATEGORY_NETWORK,
+                         "Could not create the epoll instance: %s", errno_str));
+        return UA_STATUSCODE_BADINTERNALERROR;
+    }
+
+    UA_StatusCode retval = ServerNetworkLayerTCP_start(nl, customHostname);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+
+    /* Register the server sockets. The event points into the serverSockets
+     * array to distinguish them from the connections. */
+    for(UA_UInt16 i = 0; i < layer->serverSocketsSize; i++) {
+        struct epoll_event event;
+        memset(&event, 0, sizeof(struct epoll_event));
+        event.events = EPOLLIN;
+        event.data.ptr = &layer->serverSockets[i];
+        if(epoll_ctl(layer->epollfd, EPOLL_CTL_ADD,
+                     layer->serverSockets[i], &event) != 0) {
+            UA_LOG_SOCKET_ERRNO_WRAP(
+                UA_LOG_ERROR(layer->logger, UA_LOGCATEGORY_NETWORK,
+                             "Could not register the server socket "
+                             "with epoll: %s", errno_str));
+            return UA_STATUSCODE_BADINTERNALERROR;
+        }
+    }
+    return UA_STATUSCODE_GOOD;
+}
+
+static void
+ServerNetworkLayerEpoll_accept(UA_ServerNetworkLayer *nl, ServerNetworkLayerTCP *layer,
+                               UA_SOCKET serverSocket) {
+    /* The server socket is nonblocking. Accept the entire backlog at once. */
+    while(true) {
+        struct sockaddr_storage remote;
+        socklen_t remote_size = sizeof(remote);
+        UA_SOCKET newsockfd = UA_accept(serverSocket, (struct sockaddr*)&remote,
+                                        &remote_size);
+        if(newsockfd == UA_INVALID_SOCKET)
+            return;
+
+        UA_LOG_TRACE(layer->logger, UA_LOGCATEGORY_NETWORK,
+                     "Connection %i | New TCP connection on server socket %i",
+                     (int)newsockfd, (int)serverSocket);
+
+        ServerNetworkLayerTCP_add(nl, layer, (UA_Int32)newsockfd, &remote);
+    }
+}
+
+static UA_StatusCode
+ServerNetworkLayerEpoll_listen(UA_ServerNetworkLayer *nl, UA_Server *server,
+                               UA_UInt16 timeout) {
+    ServerNetworkLayerTCP *layer = (ServerNetworkLayerTCP *)nl->handle;
+    if(layer->serverSocketsSize == 0)
+        return UA_STATUSCODE_GOOD;
+
+    ServerNetworkLayerTCP_checkHelloTimeout(layer, server);
+
+    /* Send the chunks generated since the last listen (e.g. in timed
+     * callbacks) */
+    ServerNetworkLayerTCP_flushAll(layer);
+
+    struct epoll_event events[EPOLL_MAXEVENTS];
+    int n = epoll_wait(layer->epollfd, events, EPOLL_MAXEVENTS, (int)timeout);
+    if(n < 0) {
+        if(UA_ERRNO != UA_INTERRUPTED) {
+            UA_LOG_SOCKET_ERRNO_WRAP(
+                UA_LOG_WARNING(layer->logger, UA_LOGCATEGORY_NETWORK,
+                               "epoll_wait failed with %s", errno_str));
+        }
+        /* we will retry, so do not return bad */
+        return UA_STATUSCODE_GOOD;
+    }
+
+    for(int i = 0; i < n; i++) {
+        void *ptr = events[i].data.ptr;
+
+        /* Accept new connections via the server sockets */
+        if(isServerSocketEvent(layer, ptr)) {
+            ServerNetworkLayerEpoll_accept(nl, layer, *(UA_SOCKET*)ptr);
+            continue;
+        }
+
+        /* Send queued chunks */
+        ConnectionEntry *e = (ConnectionEntry*)ptr;
+        if(events[i].events & EPOLLOUT) {
+            ServerNetworkLayerTCP_flush(e);
+            if(!(events[i].events & ~(uint32_t)EPOLLOUT))
+                continue;
+        }
+
+        /* Read from established sockets */
+        UA_LOG_TRACE(layer->logger, UA_LOGCATEGORY_NETWORK,
+                     "Connection %i | Activity on the socket",
+                     (int)(e->connection.sockfd));
+
+        UA_ByteString buf = UA_BYTESTRING_NULL;
+        UA_StatusCode retval = connection_recv(&e->connection, &buf, 0);
+        if(retval == UA_STATUSCODE_GOOD) {
+            /* Process packets */
+            UA_Server_processBinaryMessage(server, &e->connection, &buf);
+            connection_releaserecvbuffer(&e->connection, &buf);
+        } else if(retval == UA_STATUSCODE_BADCONNECTIONCLOSED) {
+            /* The socket is shutdown but not closed */
+            UA_LOG_INFO(layer->logger, UA_LOGCATEGORY_NETWORK,
+                        "Connection %i | Closed",
+                        (int)(e->connection.sockfd));
+            ServerNetworkLayerTCP_removeConnection(layer, server, e);
+        }
+    }
+
+    /* Send the responses */
+    ServerNetworkLayerTCP_flushAll(layer);
+    return UA_STATUSCODE_GOOD;
+}
+
+static void
+ServerNetworkLayerEpoll_stop(UA_ServerNetworkLayer *nl, UA_Server *server) {
+    ServerNetworkLayerTCP *layer = (ServerNetworkLayerTCP *)nl->handle;
+    UA_LOG_INFO(layer->logger, UA_LOGCATEGORY_NETWORK,
+                "Shutting down the epoll network layer");
+
+    /* Close the server sockets */
+    for(UA_UInt16 i = 0; i < layer->serverSocketsSize; i++) {
+        UA_shutdown(layer->serverSockets[i], 2);
+        UA_close(layer->serverSockets[i]);
+    }
+    layer->serverSocketsSize = 0;
+
+    /* Close and remove the open connections. Pending events of the closed
+     * sockets are not needed to pick them up. */
+    ConnectionEntry *e, *e_tmp;
+    LIST_FOREACH_SAFE(e, &layer->connections, pointers, e_tmp) {
+        ServerNetworkLayerTCP_close(&e->connection);
+        ServerNetworkLayerTCP_removeConnection(layer, server, e);
+    }
+
+    UA_close(layer->epollfd);
+    layer->epollfd = -1;
+
+    UA_deinitialize_architecture_network();
+}
+
+UA_ServerNetworkLayer
+UA_ServerNetworkLayerTCPEpoll(UA_ConnectionConfig config, UA_UInt16 port,
+                              UA_Logger *logger) {
+    UA_ServerNetworkLayer nl = UA_ServerNetworkLayerTCP(config, port, logger);
+    nl.start = ServerNetworkLayerEpoll_start;
+    nl.listen = ServerNetworkLayerEpoll_listen;
+    nl.stop = ServerNetworkLayerEpoll_stop;
+    return nl;
+}
+
+#endif /* UA_ENABLE_EPOLL */
+
+#ifdef UA_ENABLE_IO_URING
+
+/********************************/
+/* Server NetworkLayer io_uring */
+/********************************/
+
+/* The io_uring network layer reuses the server sockets of the TCP network
+ * layer. Everything else is driven by completions:
+ *
+ * - A multishot accept is armed on every server socket.
+ * - A multishot receive is armed on every connection. The kernel selects the
+ *   receive buffers from a registered buffer ring. The buffers are handed back
+ *   to the ring right after processing.
+ * - Outgoing chunks are queued on the connection. In every iteration, the queue
+ *   of each connection is flushed with a single sendmsg SQE. At most one send
+ *   is in flight per connection to keep the order of the chunks.
+ *
+ * SQEs for the sends are prepared in listen and submitted together with the
+ * wait for completions. So the responses generated in one iteration of the
+ * server main loop are sent with a single syscall. */
+
+#define URING_ENTRIES 256      /* Size of the submission queue */
+#define URING_RECVBUFFERS 64   /* Number of receive buffers (power of two) */
+#define URING_BUFGROUP 0       /* Buffer group id of the receive buffers */
+#define URING_MAXIOV 64        /* Max number of chunks per sendmsg */
+#define URING_STOPTIMEOUT 5000 /* Max time to wait for in-flight operations
+                                * during shutdown (in ms) */
+
+/* The operation type is encoded in the lower bits of the user_data */
+#define URING_OP_ACCEPT 0x1
+#define URING_OP_RECV   0x2
+#define URING_OP_SEND   0x3
+#define URING_OP_MASK   0x3
+
+typedef struct UringConnectionEntry {
+    UA_Connection connection;
+    LIST_ENTRY(UringConnectionEntry) pointers;
+
+    /* Connections that have not yet received a HEL message, ordered by their
+     * opening date */
+    TAILQ_ENTRY(UringConnectionEntry) openingPointers;
+    UA_Boolean opening;
+
+    UA_Boolean recvArmed;    /* A multishot receive is active */
+    UA_Boolean recvDone;     /* The socket was closed. No receive is armed
+                              * anymore. */
+    UA_Boolean shutdownPending; /* Closed with unsent chunks */
+
+    /* Outgoing chunks. The first sendInflight chunks are currently processed
+     * by the kernel. sendOffset bytes of the first chunk are already sent. */
+    UA_ByteString *sendQueue;
+    size_t sendQueueSize;
+    size_t sendQueueCapacity;
+    size_t sendOffset;
+    size_t sendInflight;
+    TAILQ_ENTRY(UringConnectionEntry) sendPointers;
+    UA_Boolean sendScheduled;
+    struct msghdr msg;
+    struct iovec iov[URING_MAXIOV];
+} UringConnectionEntry;
 
+typedef struct {
+    ServerNetworkLayerTCP tcp; /* Server sockets and configuration */
+    UA_ConnectionConfig localConfig;
+    UA_Server *server;
+
+    LIST_HEAD(, UringConnectionEntry) connections;
+    TAILQ_HEAD(, UringConnectionEntry) openingConnections;
+    TAILQ_HEAD(, UringConnectionEntry) sendConnections;
+
+    /* The ring */
+    int ringfd;
+    void *sqRing;
+    size_t sqRingSize;
+    void *cqRing;
+    size_t cqRingSize;
+    struct io_uring_sqe *sqes;
+    size_t sqesSize;
+    unsigned *sqHead;
+    unsigned *sqTail;
+    unsigned *sqMask;
+    unsigned sqEntries;
+    unsigned sqeTail;      /* Local tail, published on submit */
+    unsigned sqeSubmitted;
+    unsigned *cqHead;
+    unsigned *cqTail;
+    unsigned *cqMask;
+    struct io_uring_cqe *cqes;
+
+    /* Registered receive buffers */
+    struct io_uring_buf_ring *bufRing;
+    size_t bufRingSize;
+    UA_Byte *bufMem;
+    size_t bufSize;
+    UA_UInt16 bufTail;
+} ServerNetworkLayerUring;
+
+static int
+uring_enter(int fd, unsigned toSubmit, unsigned minComplete,
+            unsigned flags, void *arg, size_t argSize) {
+    return (int)syscall(__NR_io_uring_enter, fd, toSubmit, minComplete,
+                        flags, arg, argSize);
+}
+
+static UA_StatusCode
+uring_submit(ServerNetworkLayerUring *layer) {
+    unsigned toSubmit = layer->sqeTail - layer->sqeSubmitted;
+    if(toSubmit == 0)
+        return UA_STATUSCODE_GOOD;
+    __atomic_store_n(layer->sqTail, layer->sqeTail, __ATOMIC_RELEASE);
+    int res = uring_enter(layer->ringfd, toSubmit, 0, 0, NULL, 0);
+    if(res < 0) {
+        UA_LOG_SOCKET_ERRNO_WRAP(
+            UA_LOG_WARNING(layer->tcp.logger, UA_LOGCATEGORY_NETWORK,
+                           "io_uring submission failed with %s", errno_str));
+        return UA_STATUSCODE_BADINTERNALERROR;
+    }
+    layer->sqeSubmitted += (unsigned)res;
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Returns NULL if the submission queue is full even after submitting the
+ * pending entries */
+static struct io_uring_sqe *
+uring_getSqe(ServerNetworkLayerUring *layer) {
+    unsigned head = __atomic_load_n(layer->sqHead, __ATOMIC_ACQUIRE);
+    if(layer->sqeTail - head >= layer->sqEntries) {
+        uring_submit(layer);
+        head = __atomic_load_n(layer->sqHead, __ATOMIC_ACQUIRE);
+        if(layer->sqeTail - head >= layer->sqEntries)
+            return NULL;
+    }
+    struct io_uring_sqe *sqe = &layer->sqes[layer->sqeTail & *layer->sqMask];
+    memset(sqe, 0, sizeof(struct io_uring_sqe));
+    layer->sqeTail++;
+    return sqe;
+}
+
+static void
+uring_recycleBuffer(ServerNetworkLayerUring *layer, UA_UInt16 bid) {
+    UA_UInt16 mask = URING_RECVBUFFERS - 1;
+    struct io_uring_buf *buf = &layer->bufRing->bufs[layer->bufTail & mask];
+    buf->addr = (__u64)(uintptr_t)&layer->bufMem[bid * layer->bufSize];
+    buf->len = (__u32)layer->bufSize;
+    buf->bid = bid;
+    layer->bufTail++;
+    __atomic_store_n(&layer->bufRing->tail, layer->bufTail, __ATOMIC_RELEASE);
+}
+
+static void
+ServerNetworkLayerUring_deleteRing(ServerNetworkLayerUring *layer) {
+    if(layer->bufMem) {
+        UA_free(layer->bufMem);
+        layer->bufMem = NULL;
+    }
+    if(layer->bufRing) {
+        munmap(layer->bufRing, layer->bufRingSize);
+        layer->bufRing = NULL;
+    }
+    if(layer->sqes) {
+        munmap(layer->sqes, layer->sqesSize);
+        layer->sqes = NULL;
+    }
+    if(layer->cqRing && layer->cqRing != layer->sqRing)
+        munmap(layer->cqRing, layer->cqRingSize);
+    layer->cqRing = NULL;
+    if(layer->sqRing) {
+        munmap(layer->sqRing, layer->sqRingSize);
+        layer->sqRing = NULL;
+    }
+    if(layer->ringfd >= 0) {
+        UA_close(layer->ringfd);
+        layer->ringfd = -1;
+    }
+}
+
+static UA_StatusCode
+ServerNetworkLayerUring_setupRing(ServerNetworkLayerUring *layer, size_t bufSize) {
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(struct io_uring_params));
+    layer->ringfd = (int)syscall(__NR_io_uring_setup, URING_ENTRIES, &p);
+    if(layer->ringfd < 0)
+        return UA_STATUSCODE_BADINTERNALERROR;
+    if(!(p.features & IORING_FEAT_EXT_ARG))
+        return UA_STATUSCODE_BADNOTSUPPORTED;
+
+    /* Map the rings */
+    layer->sqRingSize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    layer->cqRingSize = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if(p.features & IORING_FEAT_SINGLE_MMAP) {
+        if(layer->cqRingSize > layer->sqRingSize)
+            layer->sqRingSize = layer->cqRingSize;
+        layer->cqRingSize = layer->sqRingSize;
+    }
+    layer->sqRing = mmap(NULL, layer->sqRingSize, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE, layer->ringfd, IORING_OFF_SQ_RING);
+    if(layer->sqRing == MAP_FAILED) {
+        layer->sqRing = NULL;
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    }
+    if(p.features & IORING_FEAT_SINGLE_MMAP) {
+        layer->cqRing = layer->sqRing;
+    } else {
+        layer->cqRing = mmap(NULL, layer->cqRingSize, PROT_READ | PROT_WRITE,
+                             MAP_SHARED | MAP_POPULATE, layer->ringfd, IORING_OFF_CQ_RING);
+        if(layer->cqRing == MAP_FAILED) {
+            layer->cqRing = NULL;
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+        }
+    }
+    layer->sqesSize = p.sq_entries * sizeof(struct io_uring_sqe);
+    layer->sqes = (struct io_uring_sqe*)
+        mmap(NULL, layer->sqesSize, PROT_READ | PROT_WRITE,
+             MAP_SHARED | MAP_POPULATE, layer->ringfd, IORING_OFF_SQES);
+    if(layer->sqes == MAP_FAILED) {
+        layer->sqes = NULL;
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    }
+
+    UA_Byte *sq = (UA_Byte*)layer->sqRing;
+    layer->sqHead = (unsigned*)(sq + p.sq_off.head);
+    layer->sqTail = (unsigned*)(sq + p.sq_off.tail);
+    layer->sqMask = (unsigned*)(sq + p.sq_off.ring_mask);
+    layer->sqEntries = p.sq_entries;
+    layer->sqeTail = *layer->sqTail;
+    layer->sqeSubmitted = layer->sqeTail;
+    /* The SQEs are always used in ring order */
+    unsigned *sqArray = (unsigned*)(sq + p.sq_off.array);
+    for(unsigned i = 0; i < p.sq_entries; i++)
+        sqArray[i] = i;
+
+    UA_Byte *cq = (UA_Byte*)layer->cqRing;
+    layer->cqHead = (unsigned*)(cq + p.cq_off.head);
+    layer->cqTail = (unsigned*)(cq + p.cq_off.tail);
+    layer->cqMask = (unsigned*)(cq + p.cq_off.ring_mask);
+    layer->cqes = (struct io_uring_cqe*)(cq + p.cq_off.cqes);
+
+    /* Register the receive buffers */
+    layer->bufSize = bufSize;
+    layer->bufMem = (UA_Byte*)UA_malloc(URING_RECVBUFFERS * bufSize);
+    if(!layer->bufMem)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    layer->bufRingSize = URING_RECVBUFFERS * sizeof(struct io_uring_buf);
+    layer->bufRing = (struct io_uring_buf_ring*)
+        mmap(NULL, layer->bufRingSize, PROT_READ | PROT_WRITE,
+             MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+    if(layer->bufRing == MAP_FAILED) {
+        layer->bufRing = NULL;
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    }
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(struct io_uring_buf_reg));
+    reg.ring_addr = (__u64)(uintptr_t)layer->bufRing;
+    reg.ring_entries = URING_RECVBUFFERS;
+    reg.bgid = URING_BUFGROUP;
+    if(syscall(__NR_io_uring_register, layer->ringfd,
+               IORING_REGISTER_PBUF_RING, &reg, 1) != 0)
+        return UA_STATUSCODE_BADNOTSUPPORTED;
+    layer->bufTail = 0;
+    for(UA_UInt16 i = 0; i < URING_RECVBUFFERS; i++)
+        uring_recycleBuffer(layer, i);
+    return UA_STATUSCODE_GOOD;
+}
+
+static void
+ServerNetworkLayerUring_armAccept(ServerNetworkLayerUring *layer, UA_SOCKET *serverSocket) {
+    struct io_uring_sqe *sqe = uring_getSqe(layer);
+    if(!sqe) {
+        UA_LOG_WARNING(layer->tcp.logger, UA_LOGCATEGORY_NETWORK,
+                       "Could not accept on server socket %i. The io_uring "
+                       "submission queue is full", (int)*serverSocket);
+        return;
+    }
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = *serverSocket;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+    sqe->user_data = (__u64)(uintptr_t)serverSocket | URING_OP_ACCEPT;
+}
+
+static UA_StatusCode
+ServerNetworkLayerUring_armRecv(ServerNetworkLayerUring *layer, UringConnectionEntry *e) {
+    struct io_uring_sqe *sqe = uring_getSqe(layer);
+    if(!sqe)
+        return UA_STATUSCODE_BADRESOURCEUNAVAILABLE;
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = e->connection.sockfd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = URING_BUFGROUP;
+    sqe->user_data = (__u64)(uintptr_t)e | URING_OP_RECV;
+    e->recvArmed = true;
+    return UA_STATUSCODE_GOOD;
+}
+
+static void
+ServerNetworkLayerUring_clearSendQueue(UringConnectionEntry *e) {
+    for(size_t i = e->sendInflight; i < e->sendQueueSize; i++) {
+        e->connection.pendingSendBytes -= e->sendQueue[i].length;
+        connection_releasesendbuffer(&e->connection, &e->sendQueue[i]);
+    }
+    e->sendQueueSize = e->sendInflight;
+    if(e->sendQueueSize == 0) {
+        e->sendOffset = 0;
+        e->connection.pendingSendBytes = 0;
+    }
+}
+
+static void
+ServerNetworkLayerUring_freeConnection(UA_Connection *connection) {
+    UringConnectionEntry *e = (UringConnectionEntry*)connection;
+    for(size_t i = 0; i < e->sendQueueSize; i++)
+        connection_releasesendbuffer(connection, &e->sendQueue[i]);
+    UA_free(e->sendQueue);
+    UA_Connection_deleteMembers(connection);
+    UA_free(connection);
+}
+
+/* Chunks that are already queued are sent before the socket is shut down */
+static void
+ServerNetworkLayerUring_close(UA_Connection *connection) {
+    if(connection->state == UA_CONNECTION_CLOSED)
+        return;
+    connection->state = UA_CONNECTION_CLOSED;
+    UringConnectionEntry *e = (UringConnectionEntry*)connection;
+    if(e->sendQueueSize > 0) {
+        e->shutdownPending = true;
+        return;
+    }
+    UA_shutdown((UA_SOCKET)connection->sockfd, 2);
+}
+
+/* The connection is removed once no operation is in flight anymore */
+static void
+ServerNetworkLayerUring_checkRemove(ServerNetworkLayerUring *layer, UringConnectionEntry *e) {
+    if(!e->recvDone || e->sendInflight > 0)
+        return;
+    UA_LOG_INFO(layer->tcp.logger, UA_LOGCATEGORY_NETWORK,
+                "Connection %i | Closed", (int)(e->connection.sockfd));
+    LIST_REMOVE(e, pointers);
+    if(e->opening)
+        TAILQ_REMOVE(&layer->openingConnections, e, openingPointers);
+    if(e->sendScheduled)
+        TAILQ_REMOVE(&layer->sendConnections, e, sendPointers);
+    e->connection.state = UA_CONNECTION_CLOSED;
+    UA_close(e->connection.sockfd);
+    UA_Server_removeConnection(layer->server, &e->connection);
+}
+
+static void
+ServerNetworkLayerUring_prepareSends(ServerNetworkLayerUring *layer) {
+    UringConnectionEntry *e;
+    while((e = TAILQ_FIRST(&layer->sendConnections))) {
+        UA_assert(e->sendInflight == 0);
+        if(e->sendQueueSize == 0) {
+            /* The queue was dropped in the meantime */
+            TAILQ_REMOVE(&layer->sendConnections, e, sendPointers);
+            e->sendScheduled = false;
+            continue;
+        }
+        struct io_uring_sqe *sqe = uring_getSqe(layer);
+        if(!sqe)
+            return; /* Try again in the next iteration */
+        TAILQ_REMOVE(&layer->sendConnections, e, sendPointers);
+        e->sendScheduled = false;
+
+        /* Gather all queued chunks in one sendmsg */
+        size_t count = e->sendQueueSize;
+        if(count > URING_MAXIOV)
+            count = URING_MAXIOV;
+        for(size_t i = 0; i < count; i++) {
+            e->iov[i].iov_base = e->sendQueue[i].data;
+            e->iov[i].iov_len = e->sendQueue[i].length;
+        }
+        e->iov[0].iov_base = &e->sendQueue[0].data[e->sendOffset];
+        e->iov[0].iov_len -= e->sendOffset;
+        memset(&e->msg, 0, sizeof(struct msghdr));
+        e->msg.msg_iov = e->iov;
+        e->msg.msg_iovlen = count;
+        e->sendInflight = count;
+
+        sqe->opcode = IORING_OP_SENDMSG;
+        sqe->fd = e->connection.sockfd;
+        sqe->addr = (__u64)(uintptr_t)&e->msg;
+        sqe->len = 1;
+        sqe->msg_flags = MSG_NOSIGNAL;
+        sqe->user_data = (__u64)(uintptr_t)e | URING_OP_SEND;
+    }
+}
+
+static UA_StatusCode
+ServerNetworkLayerUring_send(UA_Connection *connection, UA_ByteString *buf) {
+    if(connection->state == UA_CONNECTION_CLOSED) {
+        connection_releasesendbuffer(connection, buf);
+        return UA_STATUSCODE_BADCONNECTIONCLOSED;
+    }
+
+    UringConnectionEntry *e = (UringConnectionEntry*)connection;
+    if(e->sendQueueSize == e->sendQueueCapacity) {
+        size_t newCapacity = (e->sendQueueCapacity == 0) ? 8 : e->sendQueueCapacity * 2;
+        UA_ByteString *newQueue = (UA_ByteString*)
+            UA_realloc(e->sendQueue, newCapacity * sizeof(UA_ByteString));
+        if(!newQueue) {
+            connection_releasesendbuffer(connection, buf);
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+        }
+        e->sendQueue = newQueue;
+        e->sendQueueCapacity = newCapacity;
+    }
+
+    /* Take ownership of the buffer. It is freed when the send completes. */
+    e->sendQueue[e->sendQueueSize] = *buf;
+    e->sendQueueSize++;
+    connection->pendingSendBytes += buf->length;
+    *buf = UA_BYTESTRING_NULL;
+
+    /* Schedule the connection to be flushed in this iteration */
+    ServerNetworkLayerUring *layer = (ServerNetworkLayerUring*)connection->handle;
+    if(!e->sendScheduled && e->sendInflight == 0) {
+        TAILQ_INSERT_TAIL(&layer->sendConnections, e, sendPointers);
+        e->sendScheduled = true;
+    }
+
+    /* Without coalescing, submit the send right away */
+    if(!layer->tcp.sendCoalescing) {
+        ServerNetworkLayerUring_prepareSends(layer);
+        uring_submit(layer);
+    }
+    return UA_STATUSCODE_GOOD;
+}
+
+static void
+ServerNetworkLayerUring_add(ServerNetworkLayerUring *layer, UA_SOCKET newsockfd) {
+    /* Do not merge packets on the socket (disable Nagle's algorithm) */
+    int dummy = 1;
+    if(UA_setsockopt(newsockfd, IPPROTO_TCP, TCP_NODELAY,
+                     (const char *)&dummy, sizeof(dummy)) < 0) {
+        UA_LOG_SOCKET_ERRNO_WRAP(
+            UA_LOG_ERROR(layer->tcp.logger, UA_LOGCATEGORY_NETWORK,
+                         "Cannot set socket option TCP_NODELAY. Error: %s",
+                         errno_str));
+        UA_close(newsockfd);
+        return;
+    }
+
+    UA_LOG_INFO(layer->tcp.logger, UA_LOGCATEGORY_NETWORK,
+                "Connection %i | New connection over TCP (io_uring)",
+                (int)newsockfd);
+
+    UringConnectionEntry *e = (UringConnectionEntry*)
+        UA_calloc(1, sizeof(UringConnectionEntry));
+    if(!e) {
+        UA_close(newsockfd);
+        return;
+    }
+
+    UA_Connection *c = &e->connection;
+    c->sockfd = newsockfd;
+    c->handle = layer;
+    c->config = layer->localConfig;
+    c->send = ServerNetworkLayerUring_send;
+    c->close = ServerNetworkLayerUring_close;
+    c->free = ServerNetworkLayerUring_freeConnection;
+    c->getSendBuffer = connection_getsendbuffer;
+    c->releaseSendBuffer = connection_releasesendbuffer;
+    c->releaseRecvBuffer = connection_releaserecvbuffer;
+    c->state = UA_CONNECTION_OPENING;
+    c->openingDate = UA_DateTime_nowMonotonic();
+
+    if(ServerNetworkLayerUring_armRecv(layer, e) != UA_STATUSCODE_GOOD) {
+        UA_LOG_WARNING(layer->tcp.logger, UA_LOGCATEGORY_NETWORK,
+                       "Connection %i | The io_uring submission queue is full",
+                       (int)newsockfd);
+        UA_close(newsockfd);
+        UA_free(e);
+        return;
+    }
+
+    LIST_INSERT_HEAD(&layer->connections, e, pointers);
+    e->opening = true;
+    TAILQ_INSERT_TAIL(&layer->openingConnections, e, openingPointers);
+}
+
+static void
+ServerNetworkLayerUring_processAccept(ServerNetworkLayerUring *layer,
+                                      UA_SOCKET *serverSocket,
+                                      struct io_uring_cqe *cqe) {
+    if(cqe->res >= 0) {
+        UA_LOG_TRACE(layer->tcp.logger, UA_LOGCATEGORY_NETWORK,
+                     "Connection %i | New TCP connection on server socket %i",
+                     (int)cqe->res, (int)*serverSocket);
+        ServerNetworkLayerUring_add(layer, (UA_SOCKET)cqe->res);
+    }
+
+    /* Re-arm the accept unless the network layer is stopped */
+    if(!(cqe->flags & IORING_CQE_F_MORE) && layer->tcp.serverSocketsSize > 0)
+        ServerNetworkLayerUring_armAccept(layer, serverSocket);
+}
+
+static void
+ServerNetworkLayerUring_processRecv(ServerNetworkLayerUring *layer,
+                                    UringConnectionEntry *e,
+                                    struct io_uring_cqe *cqe) {
+    if(!(cqe->flags & IORING_CQE_F_MORE))
+        e->recvArmed = false;
+
+    if(cqe->res > 0) {
+        UA_UInt16 bid = (UA_UInt16)(cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+        UA_ByteString packet;
+        packet.data = &layer->bufMem[bid * layer->bufSize];
+        packet.length = (size_t)cqe->res;
+        if(e->connection.state != UA_CONNECTION_CLOSED)
+            UA_Server_processBinaryMessage(layer->server, &e->connection, &packet);
+        uring_recycleBuffer(layer, bid);
+    } else if(cqe->res != -ENOBUFS &&
+              (cqe->res != -ECANCELED || e->connection.state == UA_CONNECTION_CLOSED)) {
+        /* The socket was closed. (The kernel also cancels the operations
+         * when the thread that submitted them exits. The receive is then
+         * re-armed below.) */
+        e->recvDone = true;
+        if(e->connection.state != UA_CONNECTION_CLOSED) {
+            e->connection.state = UA_CONNECTION_CLOSED;
+            UA_shutdown((UA_SOCKET)e->connection.sockfd, 2);
+        }
+        ServerNetworkLayerUring_clearSendQueue(e);
+        ServerNetworkLayerUring_checkRemove(layer, e);
+        return;
+    }
+
+    /* The multishot receive ends when no buffers are left */
+    if(!e->recvArmed && ServerNetworkLayerUring_armRecv(layer, e) != UA_STATUSCODE_GOOD) {
+        UA_LOG_WARNING(layer->tcp.logger, UA_LOGCATEGORY_NETWORK,
+                       "Connection %i | Could not re-arm the receive",
+                       (int)e->connection.sockfd);
+        ServerNetworkLayerUring_close(&e->connection);
+        e->recvDone = true;
+        ServerNetworkLayerUring_clearSendQueue(e);
+        ServerNetworkLayerUring_checkRemove(layer, e);
+    }
+}
+
+static void
+ServerNetworkLayerUring_processSend(ServerNetworkLayerUring *layer,
+                                    UringConnectionEntry *e,
+                                    struct io_uring_cqe *cqe) {
+    size_t inflight = e->sendInflight;
+    e->sendInflight = 0;
+
+    /* The send was cancelled because the submitting thread exited. Nothing
+     * was sent. Try again in the next iteration. */
+    if(cqe->res == -ECANCELED) {
+        TAILQ_INSERT_TAIL(&layer->sendConnections, e, sendPointers);
+        e->sendScheduled = true;
+        return;
+    }
+
+    if(cqe->res < 0) {
+        /* Sending failed. Drop all chunks and close the connection. */
+        for(size_t i = 0; i < inflight; i++)
+            connection_releasesendbuffer(&e->connection, &e->sendQueue[i]);
+        memmove(e->sendQueue, &e->sendQueue[inflight],
+                (e->sendQueueSize - inflight) * sizeof(UA_ByteString));
+        e->sendQueueSize -= inflight;
+        ServerNetworkLayerUring_clearSendQueue(e);
+        e->shutdownPending = false;
+        e->connection.state = UA_CONNECTION_CLOSED;
+        UA_shutdown((UA_SOCKET)e->connection.sockfd, 2);
+        ServerNetworkLayerUring_checkRemove(layer, e);
+        return;
+    }
+
+    /* Remove the completely sent chunks */
+    e->connection.pendingSendBytes -= (size_t)cqe->res;
+    size_t sent = (size_t)cqe->res + e->sendOffset;
+    size_t done = 0;
+    while(done < inflight && sent >= e->sendQueue[done].length) {
+        sent -= e->sendQueue[done].length;
+        connection_releasesendbuffer(&e->connection, &e->sendQueue[done]);
+        done++;
+    }
+    e->sendOffset = sent; /* Partial send of the next chunk */
+    memmove(e->sendQueue, &e->sendQueue[done],
+            (e->sendQueueSize - done) * sizeof(UA_ByteString));
+    e->sendQueueSize -= done;
+
+    if(e->sendQueueSize > 0) {
+        /* Send the remaining chunks in the next iteration */
+        TAILQ_INSERT_TAIL(&layer->sendConnections, e, sendPointers);
+        e->sendScheduled = true;
+    } else if(e->shutdownPending) {
+        /* Everything is sent. Complete the close. */
+        e->shutdownPending = false;
+        UA_shutdown((UA_SOCKET)e->connection.sockfd, 2);
+    }
+    ServerNetworkLayerUring_checkRemove(layer, e);
+}
+
+static void
+ServerNetworkLayerUring_processCompletions(ServerNetworkLayerUring *layer) {
+    unsigned head = *layer->cqHead;
+    unsigned tail = __atomic_load_n(layer->cqTail, __ATOMIC_ACQUIRE);
+    while(head != tail) {
+        /* Copy the cqe and advance the head to free the slot right away.
+         * Processing can generate new submissions. */
+        struct io_uring_cqe cqe = layer->cqes[head & *layer->cqMask];
+        head++;
+        __atomic_store_n(layer->cqHead, head, __ATOMIC_RELEASE);
+
+        void *ptr = (void*)(uintptr_t)(cqe.user_data & ~(__u64)URING_OP_MASK);
+        switch(cqe.user_data & URING_OP_MASK) {
+        case URING_OP_ACCEPT:
+            ServerNetworkLayerUring_processAccept(layer, (UA_SOCKET*)ptr, &cqe);
+            break;
+        case URING_OP_RECV:
+            ServerNetworkLayerUring_processRecv(layer, (UringConnectionEntry*)ptr, &cqe);
+            break;
+        case URING_OP_SEND:
+            ServerNetworkLayerUring_processSend(layer, (UringConnectionEntry*)ptr, &cqe);
+            break;
+        default:
+            break;
+        }
+
+        if(head == tail)
+            tail = __atomic_load_n(layer->cqTail, __ATOMIC_ACQUIRE);
+    }
+}
+
+/* Submit the prepared SQEs and wait up to timeout ms for completions */
+static void
+ServerNetworkLayerUring_submitAndWait(ServerNetworkLayerUring *layer, UA_UInt16 timeout) {
+    ServerNetworkLayerUring_prepareSends(layer);
+    unsigned toSubmit = layer->sqeTail - layer->sqeSubmitted;
+    __atomic_store_n(layer->sqTail, layer->sqeTail, __ATOMIC_RELEASE);
+
+    struct __kernel_timespec ts;
+    ts.tv_sec = timeout / 1000;
+    ts.tv_nsec = (long long)(timeout % 1000) * 1000000;
+    struct io_uring_getevents_arg arg;
+    memset(&arg, 0, sizeof(struct io_uring_getevents_arg));
+    arg.ts = (__u64)(uintptr_t)&ts;
+
+    unsigned minComplete = (timeout > 0) ? 1 : 0;
+    int res = uring_enter(layer->ringfd, toSubmit, minComplete,
+                          IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG,
+                          &arg, sizeof(struct io_uring_getevents_arg));
+    if(res >= 0) {
+        layer->sqeSubmitted += (unsigned)res;
+    } else if(UA_ERRNO != ETIME && UA_ERRNO != UA_INTERRUPTED) {
+        UA_LOG_SOCKET_ERRNO_WRAP(
+            UA_LOG_WARNING(layer->tcp.logger, UA_LOGCATEGORY_NETWORK,
+                           "io_uring_enter failed with %s", errno_str));
+    }
+    ServerNetworkLayerUring_processCompletions(layer);
+}
+
+static void
+ServerNetworkLayerUring_checkHelloTimeout(ServerNetworkLayerUring *layer) {
+    UA_DateTime now = UA_DateTime_nowMonotonic();
+    UringConnectionEntry *e;
+    while((e = TAILQ_FIRST(&layer->openingConnections))) {
+        if(e->connection.state == UA_CONNECTION_OPENING &&
+           now <= e->connection.openingDate + (NOHELLOTIMEOUT * UA_DATETIME_MSEC))
+            break;
+        TAILQ_REMOVE(&layer->openingConnections, e, openingPointers);
+        e->opening = false;
+        if(e->connection.state != UA_CONNECTION_OPENING)
+            continue;
+        UA_LOG_INFO(layer->tcp.logger, UA_LOGCATEGORY_NETWORK,
+                    "Connection %i | Closed by the server (no Hello Message)",
+                    (int)(e->connection.sockfd));
+        ServerNetworkLayerUring_close(&e->connection);
+    }
+}
+
+static UA_StatusCode
+ServerNetworkLayerUring_start(UA_ServerNetworkLayer *nl, const UA_String *customHostname) {
+    ServerNetworkLayerUring *layer = (ServerNetworkLayerUring *)nl->handle;
+    UA_StatusCode retval =
+        ServerNetworkLayerUring_setupRing(layer, nl->localConnectionConfig.recvBufferSize);
+    if(retval != UA_STATUSCODE_GOOD) {
+        UA_LOG_ERROR(layer->tcp.logger, UA_LOGCATEGORY_NETWORK,
+                     "Could not set up io_uring (requires Linux 6.0 or later)");
+        ServerNetworkLayerUring_deleteRing(layer);
+        return retval;
+    }
+
+    retval = ServerNetworkLayerTCP_start(nl, customHostname);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+
+    for(UA_UInt16 i = 0; i < layer->tcp.serverSocketsSize; i++)
+        ServerNetworkLayerUring_armAccept(layer, &layer->tcp.serverSockets[i]);
+    return uring_submit(layer);
+}
+
+static UA_StatusCode
+ServerNetworkLayerUring_listen(UA_ServerNetworkLayer *nl, UA_Server *server,
+                               UA_UInt16 timeout) {
+    ServerNetworkLayerUring *layer = (ServerNetworkLayerUring *)nl->handle;
+    if(layer->ringfd < 0)
+        return UA_STATUSCODE_GOOD;
+    layer->server = server;
+
+    ServerNetworkLayerUring_checkHelloTimeout(layer);
+
+    /* Submit the chunks that were generated since the last iteration (e.g.
+     * from timed callbacks) and wait for completions */
+    ServerNetworkLayerUring_submitAndWait(layer, timeout);
+
+    /* Submit the responses to the processed messages right away */
+    ServerNetworkLayerUring_submitAndWait(layer, 0);
+    return UA_STATUSCODE_GOOD;
+}
+
+static void
+ServerNetworkLayerUring_stop(UA_ServerNetworkLayer *nl, UA_Server *server) {
+    ServerNetworkLayerUring *layer = (ServerNetworkLayerUring *)nl->handle;
+    UA_LOG_INFO(layer->tcp.logger, UA_LOGCATEGORY_NETWORK,
+                "Shutting down the io_uring network layer");
+    layer->server = server;
+
+    /* Close the server sockets. This also ends the multishot accepts. */
+    UA_UInt16 serverSocketsSize = layer->tcp.serverSocketsSize;
+    layer->tcp.serverSocketsSize = 0;
+    for(UA_UInt16 i = 0; i < serverSocketsSize; i++) {
+        UA_shutdown(layer->tcp.serverSockets[i], 2);
+        UA_close(layer->tcp.serverSockets[i]);
+    }
+
+    if(layer->ringfd >= 0) {
+        /* Shut down the open connections. Unsent chunks are dropped. */
+        UringConnectionEntry *e;
+        LIST_FOREACH(e, &layer->connections, pointers) {
+            ServerNetworkLayerUring_clearSendQueue(e);
+            e->shutdownPending = false;
+            e->connection.state = UA_CONNECTION_CLOSED;
+            UA_shutdown((UA_SOCKET)e->connection.sockfd, 2);
+        }
+
+        /* Wait until the in-flight operations have completed and all
+         * connections are removed */
+        UA_DateTime maxDate = UA_DateTime_nowMonotonic() +
+            (URING_STOPTIMEOUT * UA_DATETIME_MSEC);
+        while(!LIST_EMPTY(&layer->connections) &&
+              UA_DateTime_nowMonotonic() < maxDate)
+            ServerNetworkLayerUring_submitAndWait(layer, 10);
+    }
+
+    UA_deinitialize_architecture_network();
+}
+
+static void
+ServerNetworkLayerUring_deleteMembers(UA_ServerNetworkLayer *nl) {
+    ServerNetworkLayerUring *layer = (ServerNetworkLayerUring *)nl->handle;
+    UA_String_deleteMembers(&nl->discoveryUrl);
+
+    /* Closing the ring cancels the operations that are still in flight */
+    ServerNetworkLayerUring_deleteRing(layer);
+
+    /* Hard-close and remove remaining connections */
+    UringConnectionEntry *e, *e_tmp;
+    LIST_FOREACH_SAFE(e, &layer->connections, pointers, e_tmp) {
+        LIST_REMOVE(e, pointers);
+        UA_close(e->connection.sockfd);
+        ServerNetworkLayerUring_freeConnection(&e->connection);
+    }
+
+    UA_free(layer);
+}
+
+UA_ServerNetworkLayer
+UA_ServerNetworkLayerTCPUring(UA_ConnectionConfig config, UA_UInt16 port,
+                              UA_Logger *logger) {
+    UA_ServerNetworkLayer nl;
+    memset(&nl, 0, sizeof(UA_ServerNetworkLayer));
+    nl.deleteMembers = ServerNetworkLayerUring_deleteMembers;
+    nl.localConnectionConfig = config;
+    nl.start = ServerNetworkLayerUring_start;
+    nl.listen = ServerNetworkLayerUring_listen;
+    nl.stop = ServerNetworkLayerUring_stop;
+    nl.handle = NULL;
+
+    ServerNetworkLayerUring *layer = (ServerNetworkLayerUring*)
+        UA_calloc(1, sizeof(ServerNetworkLayerUring));
+    if(!layer)
+        return nl;
+    nl.handle = layer;
+
+    layer->tcp.logger = logger;
+    layer->tcp.port = port;
+    layer->tcp.sendCoalescing = true;
+    TAILQ_INIT(&layer->tcp.flushConnections);
+    TAILQ_INIT(&layer->tcp.openingConnections);
+#ifdef UA_ENABLE_EPOLL
+    layer->tcp.epollfd = -1;
+#endif
+    layer->localConfig = config;
+    layer->ringfd = -1;
+    TAILQ_INIT(&layer->openingConnections);
+    TAILQ_INIT(&layer->sendConnections);
     return nl;
 }
 
+#endif /* UA_ENABLE_IO_URING */
+
 typedef struct TCPClientConnection {
     struct addrinfo hints, *server;
     UA_DateTime connStart;
@@ -566,6 +1897,10 @@ ClientNetworkLayerTCP_close(UA_Connection *connection) {
         UA_close(connection->sockfd);
     }
     connection->state = UA_CONNECTION_CLOSED;
+
+    /* The idle buffers are no longer needed */
+    UA_BufferPool_clear(&connection->sendBufferPool);
+    UA_BufferPool_clear(&connection->recvBufferPool);
 }
 
 static void
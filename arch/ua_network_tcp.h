@@ -16,6 +16,35 @@ _UA_BEGIN_DECLS
 UA_ServerNetworkLayer UA_EXPORT
 UA_ServerNetworkLayerTCP(UA_ConnectionConfig conf, UA_UInt16 port, UA_Logger *logger);
 
+/* By default, the chunks sent to a connection are collected and written with a
+ * single (vectored) send at the end of the listen iteration. This coalesces
+ * the chunks of large messages and several small responses. When disabled,
+ * every chunk is written right away. This can reduce the latency of single
+ * responses. Applies to all TCP server network layers defined here. */
+void UA_EXPORT
+UA_ServerNetworkLayerTCP_setSendCoalescing(UA_ServerNetworkLayer *nl,
+                                           UA_Boolean enabled);
+
+#ifdef UA_ENABLE_EPOLL
+/* Linux-only variant of the TCP network layer. Sockets are registered with
+ * epoll once when the connection is opened. Only sockets with pending events
+ * are visited in listen. The number of connections is not limited by
+ * FD_SETSIZE. */
+UA_ServerNetworkLayer UA_EXPORT
+UA_ServerNetworkLayerTCPEpoll(UA_ConnectionConfig conf, UA_UInt16 port,
+                              UA_Logger *logger);
+#endif
+
+#ifdef UA_ENABLE_IO_URING
+/* Linux-only variant of the TCP network layer based on io_uring. Messages are
+ * received into a ring of registered buffers. The chunks sent by the server
+ * are queued on the connection and submitted in a batch when listen is called
+ * in the server main loop. */
+UA_ServerNetworkLayer UA_EXPORT
+UA_ServerNetworkLayerTCPUring(UA_ConnectionConfig conf, UA_UInt16 port,
+                              UA_Logger *logger);
+#endif
+
 UA_Connection UA_EXPORT
 UA_ClientConnectionTCP(UA_ConnectionConfig conf, const UA_String endpointUrl,
                        UA_UInt32 timeout, UA_Logger *logger);
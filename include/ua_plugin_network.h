@@ -58,6 +58,51 @@ typedef enum {
 
 } UA_ConnectionState;
 
+/**
+ * Buffer Pool
+ * ~~~~~~~~~~~
+ * Every chunk is encoded into a buffer of the (negotiated) send buffer size
+ * and received into a buffer of the receive buffer size. To avoid a
+ * malloc/free pair per chunk, network layers can take the buffers from a pool
+ * on the connection. Released buffers are kept in the pool and handed out
+ * again. The size of the pooled buffers follows the connection config. When
+ * the config changes (e.g. after the HEL/ACK handshake), the idle buffers are
+ * freed and the new size is used from then on.
+ *
+ * Buffers from the pool must only be returned with
+ * ``UA_BufferPool_releaseBuffer`` (and not ``UA_ByteString_deleteMembers``). */
+
+#define UA_BUFFERPOOL_MAXIDLE 4
+
+typedef struct {
+    size_t bufferSize;         /* Size of the pooled buffers */
+    size_t maxIdle;            /* Max number of idle buffers kept in the pool
+                                * (0 = UA_BUFFERPOOL_MAXIDLE) */
+    void *idle;                /* Singly-linked list of the idle buffers */
+    size_t idleSize;
+
+    /* Statistics */
+    size_t inUse;              /* Buffers currently handed out */
+    size_t inUseHighWaterMark; /* Max number of buffers handed out at once */
+    size_t idleHighWaterMark;  /* Max number of idle buffers in the pool */
+    size_t allocations;        /* Buffers that were allocated from the heap */
+    size_t reuses;             /* Buffers that were taken from the pool */
+} UA_BufferPool;
+
+/* Get a buffer with at least bufferSize bytes. The length of the returned
+ * ByteString is set to length (<= bufferSize). */
+UA_StatusCode UA_EXPORT
+UA_BufferPool_getBuffer(UA_BufferPool *pool, size_t bufferSize,
+                        size_t length, UA_ByteString *buf);
+
+/* Return the buffer to the pool or free it if the pool is full */
+void UA_EXPORT
+UA_BufferPool_releaseBuffer(UA_BufferPool *pool, UA_ByteString *buf);
+
+/* Free the idle buffers. The statistics are kept. */
+void UA_EXPORT
+UA_BufferPool_clear(UA_BufferPool *pool);
+
 struct UA_Connection {
     UA_ConnectionState state;
     UA_ConnectionConfig config;
@@ -71,6 +116,11 @@ struct UA_Connection {
     UA_ByteString incompleteChunk;   /* A half-received chunk (TCP is a
                                       * streaming protocol) is stored here */
     UA_UInt64 connectCallbackID;     /* Callback Id, for the connect-loop */
+    UA_BufferPool sendBufferPool;    /* Pooled buffers for sending and */
+    UA_BufferPool recvBufferPool;    /* receiving (see above) */
+    size_t pendingSendBytes;         /* Bytes handed to send that are not yet
+                                      * written to the socket. Used by the
+                                      * server to detect congestion. */
     /* Get a buffer for sending */
     UA_StatusCode (*getSendBuffer)(UA_Connection *connection, size_t length,
                                    UA_ByteString *buf);
@@ -112,7 +162,8 @@ struct UA_Connection {
     void (*free)(UA_Connection *connection);
 };
 
-/* Cleans up half-received messages, and so on. Called from connection->free. */
+/* Cleans up half-received messages, pooled buffers, and so on. Called from
+ * connection->free. */
 void UA_EXPORT
 UA_Connection_deleteMembers(UA_Connection *connection);
 
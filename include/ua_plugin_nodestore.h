@@ -64,14 +64,31 @@ struct UA_MonitoredItem;
  *
  * Internally, open62541 uses ``UA_Node`` in places where the exact node type is
  * not known or not important. The ``nodeClass`` attribute is used to ensure the
- * correctness of casting from ``UA_Node`` to a specific node type. */
+ * correctness of casting from ``UA_Node`` to a specific node type.
+ *
+ * **Interned strings.** The NodeId (for string and bytestring identifiers),
+ * BrowseName, DisplayName, Description and the InverseName of ReferenceTypes
+ * point into strings that are shared by all nodes of the process with the same
+ * content. This includes the nodes returned by ``getNodeCopy``. These members
+ * must never be modified in-place or freed with ``UA_*_deleteMembers``. To edit
+ * one of them, remove the old value with the matching ``UA_*_deleteInterned``
+ * method below and then set a new value. The new value can be a normal heap
+ * allocated copy or a copy made with ``UA_*_copyInterned``. ``UA_Node_copy``
+ * and ``UA_Node_deleteMembers`` handle the interned members correctly. */
+
+/* List of reference targets with the same reference type and direction. Nodes
+ * with many targets (e.g. large folders) additionally get a hash index over the
+ * NodeIds of the targets. The index is internal and maintained by
+ * UA_Node_addReference and UA_Node_deleteReference. So the targets must only
+ * be added and removed with these methods. */
+struct UA_ReferenceTargetIndex;
 
-/* List of reference targets with the same reference type and direction */
 typedef struct {
     UA_NodeId referenceTypeId;
     UA_Boolean isInverse;
     size_t targetIdsSize;
     UA_ExpandedNodeId *targetIds;
+    struct UA_ReferenceTargetIndex *targetIndex; /* NULL if not indexed */
 } UA_NodeReferenceKind;
 
 #define UA_NODE_BASEATTRIBUTES                  \
@@ -440,16 +457,16 @@ typedef struct {
 
 typedef void (*UA_NodestoreVisitor)(void *visitorContext, const UA_Node *node);
 
+/* Takes ownership of a node that was removed from the nodestore or replaced.
+ * Other threads may still read the node. It is deleted with ``deleteNode``
+ * once that is no longer possible. */
+typedef void (*UA_NodestoreRetireCallback)(void *retireContext, UA_Node *node);
+
 typedef struct {
     /* Nodestore context and lifecycle */
     void *context;
     void (*deleteNodestore)(void *nodestoreContext);
 
-    /* For non-multithreaded access, some nodestores allow that nodes are edited
-     * without a copy/replace. This is not possible when the node is only an
-     * intermediate representation and stored e.g. in a database backend. */
-    UA_Boolean inPlaceEditAllowed;
-
     /* The following definitions are used to create empty nodes of the different
      * node types. The memory is managed by the nodestore. Therefore, the node
      * has to be removed via a special deleteNode function. (If the new node is
@@ -465,6 +482,15 @@ typedef struct {
 
     void (*releaseNode)(void *nodestoreContext, const UA_Node *node);
 
+    /* Set by the server before the nodestore is used. Removed and replaced
+     * nodes are then handed to the retire callback instead of being deleted
+     * right away. So the nodestore does not need to track the readers of a
+     * node in get/release. Without a retire callback, the nodestore must not
+     * delete a removed or replaced node while it is held. Nodestores that
+     * always track their readers can leave this function NULL. */
+    void (*setRetireCallback)(void *nodestoreContext, void *retireContext,
+                              UA_NodestoreRetireCallback callback);
+
     /* Returns an editable copy of a node (needs to be deleted with the
      * deleteNode function or inserted / replaced into the nodestore). */
     UA_StatusCode (*getNodeCopy)(void *nodestoreContext, const UA_NodeId *nodeId,
@@ -524,10 +550,41 @@ UA_Node_deleteReference(UA_Node *node, const UA_DeleteReferencesItem *item);
 void UA_EXPORT
 UA_Node_deleteReferences(UA_Node *node);
 
+/* Heap memory used by the target index of the reference kind */
+size_t UA_EXPORT
+UA_NodeReferenceKind_targetIndexBytes(const UA_NodeReferenceKind *refs);
+
 /* Remove all malloc'ed members of the node */
 void UA_EXPORT
 UA_Node_deleteMembers(UA_Node *node);
 
+/* Copy and delete the interned string members of a node. The delete methods
+ * also accept strings that were not interned. NodeIds are interned only for
+ * string and bytestring identifiers. */
+UA_StatusCode UA_EXPORT
+UA_String_copyInterned(const UA_String *src, UA_String *dst);
+
+void UA_EXPORT
+UA_String_deleteInterned(UA_String *s);
+
+UA_StatusCode UA_EXPORT
+UA_QualifiedName_copyInterned(const UA_QualifiedName *src, UA_QualifiedName *dst);
+
+void UA_EXPORT
+UA_QualifiedName_deleteInterned(UA_QualifiedName *qn);
+
+UA_StatusCode UA_EXPORT
+UA_LocalizedText_copyInterned(const UA_LocalizedText *src, UA_LocalizedText *dst);
+
+void UA_EXPORT
+UA_LocalizedText_deleteInterned(UA_LocalizedText *lt);
+
+UA_StatusCode UA_EXPORT
+UA_NodeId_copyInterned(const UA_NodeId *src, UA_NodeId *dst);
+
+void UA_EXPORT
+UA_NodeId_deleteInterned(UA_NodeId *id);
+
 _UA_END_DECLS
 
 #endif /* UA_SERVER_NODES_H_ */
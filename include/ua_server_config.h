@@ -93,6 +93,9 @@ struct UA_ServerConfig {
     size_t networkLayersSize;
     UA_ServerNetworkLayer *networkLayers;
     UA_String customHostname;
+    size_t maxPendingSendBytes; /* Publish responses are delayed while more
+                                 * bytes are queued for sending on the
+                                 * connection (0 -> unlimited) */
 
 #ifdef UA_ENABLE_PUBSUB
     /*PubSub network layer */
@@ -165,6 +168,18 @@ struct UA_ServerConfig {
     UA_DurationRange samplingIntervalLimits; /* in ms (must not be less than 5) */
     UA_UInt32Range queueSizeLimits; /* Negotiated with the client */
 
+    /* MonitoredItems requesting a sampling interval of zero for the value of
+     * a variable without DataSource or onRead callback are not sampled
+     * periodically. Instead, every write to the value is reported directly
+     * (report-by-exception). The revised sampling interval is zero. */
+    UA_Boolean reportByException;
+
+    /* MonitoredItems that sample the same attribute with the same settings
+     * share the binary encoding of the sampled value in their notifications.
+     * The encoding is spliced into the PublishResponse and kept for
+     * retransmission without being copied into a DataValue again. */
+    UA_Boolean shareNotificationEncoding;
+
     /* Limits for PublishRequests */
     UA_UInt32 maxPublishReqPerSession;
 
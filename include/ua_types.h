@@ -271,6 +271,11 @@ UA_ByteString_equal(const UA_ByteString *string1,
 UA_StatusCode UA_EXPORT
 UA_ByteString_allocBuffer(UA_ByteString *bs, size_t length);
 
+/* Returns a non-cryptographic hash for the bytes. The hash can be chained by
+ * using the result as the initial value for the next bytes. */
+UA_UInt32 UA_EXPORT
+UA_ByteString_hash(UA_UInt32 initialHashValue, const UA_Byte *data, size_t size);
+
 UA_EXPORT extern const UA_ByteString UA_BYTESTRING_NULL;
 
 static UA_INLINE UA_ByteString
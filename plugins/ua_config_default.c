@@ -17,6 +17,7 @@
 #include "ua_accesscontrol_default.h"
 #include "ua_pki_certificate.h"
 #include "ua_nodestore_default.h"
+#include "ua_nodestore_hashmap.h"
 #include "ua_securitypolicies.h"
 #include "ua_plugin_securitypolicy.h"
 
@@ -153,6 +154,7 @@ createDefaultConfig(void) {
     /* conf->networkLayersSize = 0; */
     /* conf->networkLayers = NULL; */
     /* conf->customHostname = UA_STRING_NULL; */
+    conf->maxPendingSendBytes = 1 << 20; /* 1MB */
 
     /* Endpoints */
     /* conf->endpoints = {0, NULL}; */
@@ -195,6 +197,8 @@ createDefaultConfig(void) {
     /* Limits for MonitoredItems */
     conf->samplingIntervalLimits = UA_DURATIONRANGE(50.0, 24.0 * 3600.0 * 1000.0);
     conf->queueSizeLimits = UA_UINT32RANGE(1, 100);
+    conf->reportByException = false;
+    conf->shareNotificationEncoding = false;
 
 #ifdef UA_ENABLE_DISCOVERY
     conf->discoveryCleanupTimeout = 60 * 60;
@@ -227,6 +231,15 @@ createDefaultConfig(void) {
     return conf;
 }
 
+static UA_StatusCode
+addDefaultNodestore(UA_Nodestore *ns) {
+#ifdef UA_ENABLE_NODESTORE_HASHMAP
+    return UA_Nodestore_hashMap_new(ns);
+#else
+    return UA_Nodestore_default_new(ns);
+#endif
+}
+
 static UA_StatusCode
 addDefaultNetworkLayers(UA_ServerConfig *conf, UA_UInt16 portNumber, UA_UInt32 sendBufferSize, UA_UInt32 recvBufferSize) {
     /* Add a network layer */
@@ -241,8 +254,16 @@ addDefaultNetworkLayers(UA_ServerConfig *conf, UA_UInt16 portNumber, UA_UInt32 s
     if (recvBufferSize > 0)
         config.recvBufferSize = recvBufferSize;
 
+#if defined(UA_ENABLE_IO_URING)
+    conf->networkLayers[0] =
+        UA_ServerNetworkLayerTCPUring(config, portNumber, &conf->logger);
+#elif defined(UA_ENABLE_EPOLL)
+    conf->networkLayers[0] =
+        UA_ServerNetworkLayerTCPEpoll(config, portNumber, &conf->logger);
+#else
     conf->networkLayers[0] =
         UA_ServerNetworkLayerTCP(config, portNumber, &conf->logger);
+#endif
     if (!conf->networkLayers[0].handle)
         return UA_STATUSCODE_BADOUTOFMEMORY;
     conf->networkLayersSize = 1;
@@ -260,7 +281,7 @@ UA_ServerConfig_new_customBuffer(UA_UInt16 portNumber,
         return NULL;
     }
 
-    UA_StatusCode retval = UA_Nodestore_default_new(&conf->nodestore);
+    UA_StatusCode retval = addDefaultNodestore(&conf->nodestore);
     if(retval != UA_STATUSCODE_GOOD) {
         UA_ServerConfig_delete(conf);
         return NULL;
@@ -330,7 +351,7 @@ UA_ServerConfig_new_basic128rsa15(UA_UInt16 portNumber,
         return NULL;
     }
 
-    retval = UA_Nodestore_default_new(&conf->nodestore);
+    retval = addDefaultNodestore(&conf->nodestore);
     if(retval != UA_STATUSCODE_GOOD) {
         UA_ServerConfig_delete(conf);
         return NULL;
@@ -431,7 +452,7 @@ UA_ServerConfig_new_basic256sha256(UA_UInt16 portNumber,
         return NULL;
     }
 
-    retval = UA_Nodestore_default_new(&conf->nodestore);
+    retval = addDefaultNodestore(&conf->nodestore);
     if(retval != UA_STATUSCODE_GOOD) {
         UA_ServerConfig_delete(conf);
         return NULL;
@@ -531,7 +552,7 @@ UA_ServerConfig_new_allSecurityPolicies(UA_UInt16 portNumber,
         return NULL;
     }
 
-    retval = UA_Nodestore_default_new(&conf->nodestore);
+    retval = addDefaultNodestore(&conf->nodestore);
     if(retval != UA_STATUSCODE_GOOD) {
         UA_ServerConfig_delete(conf);
         return NULL;
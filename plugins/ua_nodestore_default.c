@@ -8,16 +8,40 @@
 
 #include "ua_nodestore_default.h"
 #include "ziptree.h"
+#include "open62541_queue.h"
 
+/* Lookups take a shared lock on the tree. Modifications of the tree take the
+ * lock exclusively. Nodes are immutable once they are inserted. So they can be
+ * read without a lock after the lookup. Removed and replaced nodes are handed
+ * to the retire callback and deleted when no reader is left. Without a retire
+ * callback, the readers of a node are counted under the exclusive lock. */
 #ifdef UA_ENABLE_MULTITHREADING
 #include <pthread.h>
-#define BEGIN_CRITSECT(NODEMAP) pthread_mutex_lock(&(NODEMAP)->mutex)
-#define END_CRITSECT(NODEMAP) pthread_mutex_unlock(&(NODEMAP)->mutex)
+#define BEGIN_READSECT(NODEMAP) pthread_rwlock_rdlock(&(NODEMAP)->lock)
+#define BEGIN_CRITSECT(NODEMAP) pthread_rwlock_wrlock(&(NODEMAP)->lock)
+#define END_CRITSECT(NODEMAP) pthread_rwlock_unlock(&(NODEMAP)->lock)
 #else
+#define BEGIN_READSECT(NODEMAP)
 #define BEGIN_CRITSECT(NODEMAP)
 #define END_CRITSECT(NODEMAP)
 #endif
 
+/* Numeric NodeIds in namespace zero are small and compact. The nodes are kept in
+ * an array that is indexed directly by the identifier. The other nodes are kept
+ * in a tree ordered by the NodeId hash. */
+#define DENSE_NAMESPACE 0
+#define DENSE_MAXSIZE 65536
+
+/* The nodes are allocated from slabs. Every NodeClass has its own slabs, so
+ * that the slots of a slab have the same size and nodes of the same NodeClass
+ * are close in memory. Deleted nodes go to the free list of their slab and the
+ * slot is reused. A slab is freed when all its slots are free. Except for the
+ * last slab with free slots of the NodeClass. So that adding and deleting a
+ * single node does not allocate and free a slab every time. */
+#define SLAB_BYTES 16384
+#define SLAB_ALIGN 8
+#define SLAB_ROUNDUP(SIZE) (((SIZE) + SLAB_ALIGN - 1) & ~(size_t)(SLAB_ALIGN - 1))
+
 /* container_of */
 #define container_of(ptr, type, member) \
     (type *)((uintptr_t)ptr - offsetof(type,member))
@@ -28,7 +52,8 @@ typedef struct NodeEntry NodeEntry;
 struct NodeEntry {
     ZIP_ENTRY(NodeEntry) zipfields;
     UA_UInt32 nodeIdHash;
-    UA_UInt16 refCount; /* How many consumers have a reference to the node? */
+    UA_UInt16 refCount; /* How many consumers have a reference to the node?
+                         * Counted only without a retire callback. */
     UA_Boolean deleted; /* Node was marked as deleted and can be deleted when refCount == 0 */
     NodeEntry *orig;    /* If a copy is made to replace a node, track that we
                          * replace only the node from which the copy was made.
@@ -109,65 +134,195 @@ cmpNodeId(const void *a, const void *b) {
 ZIP_HEAD(NodeTree, NodeEntry);
 typedef struct NodeTree NodeTree;
 
+typedef struct NodeSlab {
+    LIST_ENTRY(NodeSlab) freeEntry; /* In the list if the slab has free slots */
+    void *freeSlots;                /* Linked via the first pointer in the slot */
+    size_t freeSlotsSize;
+    /* The slots follow at offset SLAB_ROUNDUP(sizeof(NodeSlab)) */
+} NodeSlab;
+
+typedef struct {
+    NodeSlab **slabs;    /* Sorted by address to find the slab of a slot */
+    size_t slabsSize;
+    LIST_HEAD(, NodeSlab) freeSlabs;
+    size_t slotSize;
+    size_t slotsPerSlab;
+} NodeSlabs;
+
+static const struct {
+    UA_NodeClass nodeClass;
+    size_t nodeSize;
+} nodeClasses[UA_NODESTORE_NODECLASSES] = {
+    {UA_NODECLASS_OBJECT, sizeof(UA_ObjectNode)},
+    {UA_NODECLASS_VARIABLE, sizeof(UA_VariableNode)},
+    {UA_NODECLASS_METHOD, sizeof(UA_MethodNode)},
+    {UA_NODECLASS_OBJECTTYPE, sizeof(UA_ObjectTypeNode)},
+    {UA_NODECLASS_VARIABLETYPE, sizeof(UA_VariableTypeNode)},
+    {UA_NODECLASS_REFERENCETYPE, sizeof(UA_ReferenceTypeNode)},
+    {UA_NODECLASS_DATATYPE, sizeof(UA_DataTypeNode)},
+    {UA_NODECLASS_VIEW, sizeof(UA_ViewNode)}
+};
+
 typedef struct {
     NodeTree root;
+    NodeEntry **dense;  /* Indexed by the numeric identifier */
+    UA_UInt32 denseSize;
 #ifdef UA_ENABLE_MULTITHREADING
-    pthread_mutex_t mutex; /* Protect access */
+    pthread_rwlock_t lock; /* Protect access to the tree */
+    pthread_mutex_t slabLock; /* Protect the slabs */
 #endif
+    NodeSlabs slabs[UA_NODESTORE_NODECLASSES]; /* Same order as nodeClasses */
+    void *retireContext;
+    UA_NodestoreRetireCallback retireCallback;
 } NodeMap;
 
 ZIP_PROTTYPE(NodeTree, NodeEntry, NodeEntry)
 ZIP_IMPL(NodeTree, NodeEntry, zipfields, NodeEntry, zipfields, cmpNodeId)
 
+static NodeSlabs *
+getSlabs(NodeMap *ns, UA_NodeClass nodeClass) {
+    for(size_t i = 0; i < UA_NODESTORE_NODECLASSES; i++) {
+        if(nodeClasses[i].nodeClass == nodeClass)
+            return &ns->slabs[i];
+    }
+    return NULL;
+}
+
+/* Position of the last slab at or below the address. Returns the number of
+ * slabs if the address is below all slabs. Call only with the slab lock. */
+static size_t
+findSlab(const NodeSlabs *slabs, uintptr_t addr) {
+    size_t lo = 0, hi = slabs->slabsSize;
+    while(lo < hi) {
+        size_t mid = lo + ((hi - lo) / 2);
+        if((uintptr_t)slabs->slabs[mid] <= addr)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return (lo > 0) ? lo - 1 : slabs->slabsSize;
+}
+
+/* Call only with the slab lock */
+static UA_StatusCode
+addSlab(NodeSlabs *slabs) {
+    NodeSlab **newSlabs = (NodeSlab**)
+        UA_realloc(slabs->slabs, sizeof(NodeSlab*) * (slabs->slabsSize + 1));
+    if(!newSlabs)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    slabs->slabs = newSlabs;
+
+    size_t offset = SLAB_ROUNDUP(sizeof(NodeSlab));
+    NodeSlab *slab = (NodeSlab*)
+        UA_malloc(offset + slabs->slotsPerSlab * slabs->slotSize);
+    if(!slab)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+
+    /* Insert sorted by address */
+    size_t pos = findSlab(slabs, (uintptr_t)slab);
+    pos = (pos == slabs->slabsSize) ? 0 : pos + 1;
+    memmove(&slabs->slabs[pos + 1], &slabs->slabs[pos],
+            sizeof(NodeSlab*) * (slabs->slabsSize - pos));
+    slabs->slabs[pos] = slab;
+    slabs->slabsSize++;
+
+    /* Add the slots to the free list in ascending order */
+    slab->freeSlots = NULL;
+    slab->freeSlotsSize = slabs->slotsPerSlab;
+    uintptr_t slot = (uintptr_t)slab + offset + slabs->slotsPerSlab * slabs->slotSize;
+    for(size_t i = 0; i < slabs->slotsPerSlab; i++) {
+        slot -= slabs->slotSize;
+        *(void**)slot = slab->freeSlots;
+        slab->freeSlots = (void*)slot;
+    }
+    LIST_INSERT_HEAD(&slabs->freeSlabs, slab, freeEntry);
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Call only with the slab lock */
+static void
+removeSlab(NodeSlabs *slabs, size_t pos) {
+    NodeSlab *slab = slabs->slabs[pos];
+    LIST_REMOVE(slab, freeEntry);
+    memmove(&slabs->slabs[pos], &slabs->slabs[pos + 1],
+            sizeof(NodeSlab*) * (slabs->slabsSize - pos - 1));
+    slabs->slabsSize--;
+    UA_free(slab);
+}
+
 static NodeEntry *
-newEntry(UA_NodeClass nodeClass) {
-    size_t size = sizeof(NodeEntry) - sizeof(UA_NodeId);
-    switch(nodeClass) {
-    case UA_NODECLASS_OBJECT:
-        size += sizeof(UA_ObjectNode);
-        break;
-    case UA_NODECLASS_VARIABLE:
-        size += sizeof(UA_VariableNode);
-        break;
-    case UA_NODECLASS_METHOD:
-        size += sizeof(UA_MethodNode);
-        break;
-    case UA_NODECLASS_OBJECTTYPE:
-        size += sizeof(UA_ObjectTypeNode);
-        break;
-    case UA_NODECLASS_VARIABLETYPE:
-        size += sizeof(UA_VariableTypeNode);
-        break;
-    case UA_NODECLASS_REFERENCETYPE:
-        size += sizeof(UA_ReferenceTypeNode);
-        break;
-    case UA_NODECLASS_DATATYPE:
-        size += sizeof(UA_DataTypeNode);
-        break;
-    case UA_NODECLASS_VIEW:
-        size += sizeof(UA_ViewNode);
-        break;
-    default:
+newEntry(NodeMap *ns, UA_NodeClass nodeClass) {
+    NodeSlabs *slabs = getSlabs(ns, nodeClass);
+    if(!slabs)
         return NULL;
-    }
-    NodeEntry *entry = (NodeEntry*)UA_calloc(1, size);
-    if(!entry)
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_lock(&ns->slabLock);
+#endif
+    if(LIST_EMPTY(&slabs->freeSlabs) && addSlab(slabs) != UA_STATUSCODE_GOOD) {
+#ifdef UA_ENABLE_MULTITHREADING
+        pthread_mutex_unlock(&ns->slabLock);
+#endif
         return NULL;
+    }
+    NodeSlab *slab = LIST_FIRST(&slabs->freeSlabs);
+    NodeEntry *entry = (NodeEntry*)slab->freeSlots;
+    slab->freeSlots = *(void**)entry;
+    slab->freeSlotsSize--;
+    if(slab->freeSlotsSize == 0)
+        LIST_REMOVE(slab, freeEntry);
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_unlock(&ns->slabLock);
+#endif
+    memset(entry, 0, slabs->slotSize);
     UA_Node *node = (UA_Node*)&entry->nodeId;
     node->nodeClass = nodeClass;
     return entry;
 }
 
 static void
-deleteEntry(NodeEntry *entry) {
-    UA_Node_deleteMembers((UA_Node*)&entry->nodeId);
-    UA_free(entry);
+deleteEntry(NodeMap *ns, NodeEntry *entry) {
+    UA_Node *node = (UA_Node*)&entry->nodeId;
+    NodeSlabs *slabs = getSlabs(ns, node->nodeClass);
+    UA_Node_deleteMembers(node);
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_lock(&ns->slabLock);
+#endif
+    size_t pos = findSlab(slabs, (uintptr_t)entry);
+    UA_assert(pos < slabs->slabsSize);
+    NodeSlab *slab = slabs->slabs[pos];
+    *(void**)entry = slab->freeSlots;
+    slab->freeSlots = entry;
+    if(slab->freeSlotsSize == 0)
+        LIST_INSERT_HEAD(&slabs->freeSlabs, slab, freeEntry);
+    slab->freeSlotsSize++;
+
+    /* Free the slab if it is unused and not the last slab with free slots */
+    if(slab->freeSlotsSize == slabs->slotsPerSlab &&
+       (LIST_FIRST(&slabs->freeSlabs) != slab || LIST_NEXT(slab, freeEntry)))
+        removeSlab(slabs, pos);
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_unlock(&ns->slabLock);
+#endif
 }
 
+/* Call only inside a critical section */
 static void
-cleanupEntry(NodeEntry *entry) {
+cleanupEntry(NodeMap *ns, NodeEntry *entry) {
     if(entry->deleted && entry->refCount == 0)
-        deleteEntry(entry);
+        deleteEntry(ns, entry);
+}
+
+/* Call after the entry was taken out of the tree */
+static void
+retireEntry(NodeMap *ns, NodeEntry *entry) {
+    if(ns->retireCallback) {
+        ns->retireCallback(ns->retireContext, (UA_Node*)&entry->nodeId);
+        return;
+    }
+    BEGIN_CRITSECT(ns);
+    entry->deleted = true;
+    cleanupEntry(ns, entry);
+    END_CRITSECT(ns);
 }
 
 /***********************/
@@ -177,7 +332,7 @@ cleanupEntry(NodeEntry *entry) {
 /* Not yet inserted into the NodeMap */
 static UA_Node *
 NodeMap_newNode(void *context, UA_NodeClass nodeClass) {
-    NodeEntry *entry = newEntry(nodeClass);
+    NodeEntry *entry = newEntry((NodeMap*)context, nodeClass);
     if(!entry)
         return NULL;
     return (UA_Node*)&entry->nodeId;
@@ -186,38 +341,99 @@ NodeMap_newNode(void *context, UA_NodeClass nodeClass) {
 /* Not yet inserted into the NodeMap */
 static void
 NodeMap_deleteNode(void *context, UA_Node *node) {
-    deleteEntry(container_of(node, NodeEntry, nodeId));
+    deleteEntry((NodeMap*)context, container_of(node, NodeEntry, nodeId));
 }
 
-static const UA_Node *
-NodeMap_getNode(void *context, const UA_NodeId *nodeid) {
-    NodeMap *ns = (NodeMap*)context;
-    BEGIN_CRITSECT(ns);
+static UA_Boolean
+isDense(const UA_NodeId *nodeid) {
+    return (nodeid->namespaceIndex == DENSE_NAMESPACE &&
+            nodeid->identifierType == UA_NODEIDTYPE_NUMERIC &&
+            nodeid->identifier.numeric < DENSE_MAXSIZE);
+}
+
+/* Call only inside a critical section */
+static NodeEntry *
+findEntry(NodeMap *ns, const UA_NodeId *nodeid) {
+    if(isDense(nodeid)) {
+        if(nodeid->identifier.numeric >= ns->denseSize)
+            return NULL;
+        return ns->dense[nodeid->identifier.numeric];
+    }
     NodeEntry dummy;
     dummy.nodeIdHash = UA_NodeId_hash(nodeid);
     dummy.nodeId = *nodeid;
-    NodeEntry *entry = ZIP_FIND(NodeTree, &ns->root, &dummy);
-    if(!entry) {
+    return ZIP_FIND(NodeTree, &ns->root, &dummy);
+}
+
+/* Call only inside a critical section. The NodeId must not exist yet. */
+static UA_StatusCode
+addEntry(NodeMap *ns, NodeEntry *entry) {
+    if(!isDense(&entry->nodeId)) {
+        entry->nodeIdHash = UA_NodeId_hash(&entry->nodeId);
+        ZIP_INSERT(NodeTree, &ns->root, entry, ZIP_FFS32(UA_UInt32_random()));
+        return UA_STATUSCODE_GOOD;
+    }
+
+    /* Grow the array to the next power of two */
+    UA_UInt32 id = entry->nodeId.identifier.numeric;
+    if(id >= ns->denseSize) {
+        UA_UInt32 newSize = (ns->denseSize > 0) ? ns->denseSize : 256;
+        while(newSize <= id)
+            newSize *= 2;
+        NodeEntry **dense = (NodeEntry**)
+            UA_realloc(ns->dense, sizeof(NodeEntry*) * newSize);
+        if(!dense)
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+        memset(&dense[ns->denseSize], 0,
+               sizeof(NodeEntry*) * (newSize - ns->denseSize));
+        ns->dense = dense;
+        ns->denseSize = newSize;
+    }
+    ns->dense[id] = entry;
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Call only inside a critical section */
+static void
+takeEntry(NodeMap *ns, NodeEntry *entry) {
+    if(isDense(&entry->nodeId))
+        ns->dense[entry->nodeId.identifier.numeric] = NULL;
+    else
+        ZIP_REMOVE(NodeTree, &ns->root, entry);
+}
+
+static const UA_Node *
+NodeMap_getNode(void *context, const UA_NodeId *nodeid) {
+    NodeMap *ns = (NodeMap*)context;
+    if(!ns->retireCallback) {
+        BEGIN_CRITSECT(ns);
+        NodeEntry *entry = findEntry(ns, nodeid);
+        if(entry)
+            ++entry->refCount;
         END_CRITSECT(ns);
-        return NULL;
+        return entry ? (const UA_Node*)&entry->nodeId : NULL;
     }
-    ++entry->refCount;
+
+    BEGIN_READSECT(ns);
+    NodeEntry *entry = findEntry(ns, nodeid);
     END_CRITSECT(ns);
+    if(!entry)
+        return NULL;
     return (const UA_Node*)&entry->nodeId;
 }
 
+/* Removed nodes are retired. So there is no need to track the readers if the
+ * retire callback is set. */
 static void
 NodeMap_releaseNode(void *context, const UA_Node *node) {
-    if(!node)
-        return;
-#ifdef UA_ENABLE_MULTITHREADING
     NodeMap *ns = (NodeMap*)context;
-#endif
+    if(!node || ns->retireCallback)
+        return;
     BEGIN_CRITSECT(ns);
     NodeEntry *entry = container_of(node, NodeEntry, nodeId);
     UA_assert(entry->refCount > 0);
     --entry->refCount;
-    cleanupEntry(entry);
+    cleanupEntry(ns, entry);
     END_CRITSECT(ns);
 }
 
@@ -230,7 +446,7 @@ NodeMap_getNodeCopy(void *context, const UA_NodeId *nodeid,
         return UA_STATUSCODE_BADNODEIDUNKNOWN;
 
     /* Create the new entry */
-    NodeEntry *ne = newEntry(node->nodeClass);
+    NodeEntry *ne = newEntry((NodeMap*)context, node->nodeClass);
     if(!ne) {
         NodeMap_releaseNode(context, node);
         return UA_STATUSCODE_BADOUTOFMEMORY;
@@ -241,7 +457,7 @@ NodeMap_getNodeCopy(void *context, const UA_NodeId *nodeid,
     UA_StatusCode retval = UA_Node_copy(node, nnode);
     NodeMap_releaseNode(context, node);
     if(retval != UA_STATUSCODE_GOOD) {
-        deleteEntry(ne);
+        deleteEntry((NodeMap*)context, ne);
         return retval;
     }
 
@@ -254,18 +470,14 @@ static UA_StatusCode
 NodeMap_removeNode(void *context, const UA_NodeId *nodeid) {
     NodeMap *ns = (NodeMap*)context;
     BEGIN_CRITSECT(ns);
-    NodeEntry dummy;
-    dummy.nodeIdHash = UA_NodeId_hash(nodeid);
-    dummy.nodeId = *nodeid;
-    NodeEntry *entry = ZIP_FIND(NodeTree, &ns->root, &dummy);
+    NodeEntry *entry = findEntry(ns, nodeid);
     if(!entry) {
         END_CRITSECT(ns);
         return UA_STATUSCODE_BADNODEIDUNKNOWN;
     }
-    ZIP_REMOVE(NodeTree, &ns->root, entry);
-    entry->deleted = true;
-    cleanupEntry(entry);
+    takeEntry(ns, entry);
     END_CRITSECT(ns);
+    retireEntry(ns, entry);
     return UA_STATUSCODE_GOOD;
 }
 
@@ -277,68 +489,75 @@ NodeMap_insertNode(void *context, UA_Node *node,
     BEGIN_CRITSECT(ns);
 
     /* Ensure that the NodeId is unique */
-    NodeEntry dummy;
-    dummy.nodeId = node->nodeId;
     if(node->nodeId.identifierType == UA_NODEIDTYPE_NUMERIC &&
        node->nodeId.identifier.numeric == 0) {
         do { /* Create a random nodeid until we find an unoccupied id */
             node->nodeId.identifier.numeric = UA_UInt32_random();
-            dummy.nodeId.identifier.numeric = node->nodeId.identifier.numeric;
-            dummy.nodeIdHash = UA_NodeId_hash(&node->nodeId);
-        } while(ZIP_FIND(NodeTree, &ns->root, &dummy));
+        } while(node->nodeId.identifier.numeric == 0 ||
+                findEntry(ns, &node->nodeId));
     } else {
-        dummy.nodeIdHash = UA_NodeId_hash(&node->nodeId);
-        if(ZIP_FIND(NodeTree, &ns->root, &dummy)) { /* The nodeid exists */
-            deleteEntry(entry);
+        if(findEntry(ns, &node->nodeId)) { /* The nodeid exists */
+            deleteEntry(ns, entry);
             END_CRITSECT(ns);
             return UA_STATUSCODE_BADNODEIDEXISTS;
         }
     }
 
+    /* Insert the node */
+    UA_StatusCode retval = addEntry(ns, entry);
+    if(retval != UA_STATUSCODE_GOOD) {
+        deleteEntry(ns, entry);
+        END_CRITSECT(ns);
+        return retval;
+    }
+
     /* Copy the NodeId */
     if(addedNodeId) {
-        UA_StatusCode retval = UA_NodeId_copy(&node->nodeId, addedNodeId);
+        retval = UA_NodeId_copy(&node->nodeId, addedNodeId);
         if(retval != UA_STATUSCODE_GOOD) {
-            deleteEntry(entry);
+            takeEntry(ns, entry);
+            deleteEntry(ns, entry);
             END_CRITSECT(ns);
             return retval;
         }
     }
-
-    /* Insert the node */
-    entry->nodeIdHash = dummy.nodeIdHash;
-    ZIP_INSERT(NodeTree, &ns->root, entry, ZIP_FFS32(UA_UInt32_random()));
     END_CRITSECT(ns);
     return UA_STATUSCODE_GOOD;
 }
 
 static UA_StatusCode
 NodeMap_replaceNode(void *context, UA_Node *node) {
+    NodeMap *ns = (NodeMap*)context;
+    NodeEntry *entry = container_of(node, NodeEntry, nodeId);
+    BEGIN_CRITSECT(ns);
+
     /* Find the node */
-    const UA_Node *oldNode = NodeMap_getNode(context, &node->nodeId);
-    if(!oldNode)
+    NodeEntry *oldEntry = findEntry(ns, &node->nodeId);
+    if(!oldEntry) {
+        END_CRITSECT(ns);
+        deleteEntry(ns, entry);
         return UA_STATUSCODE_BADNODEIDUNKNOWN;
+    }
 
     /* Test if the copy is current */
-    NodeEntry *entry = container_of(node, NodeEntry, nodeId);
-    NodeEntry *oldEntry = container_of(oldNode, NodeEntry, nodeId);
     if(oldEntry != entry->orig) {
         /* The node was already updated since the copy was made */
-        deleteEntry(entry);
-        NodeMap_releaseNode(context, oldNode);
+        END_CRITSECT(ns);
+        deleteEntry(ns, entry);
         return UA_STATUSCODE_BADINTERNALERROR;
     }
 
     /* Replace */
-    NodeMap *ns = (NodeMap*)context;
-    BEGIN_CRITSECT(ns);
-    ZIP_REMOVE(NodeTree, &ns->root, oldEntry);
-    entry->nodeIdHash = oldEntry->nodeIdHash;
-    ZIP_INSERT(NodeTree, &ns->root, entry, ZIP_RANK(entry, zipfields));
-    oldEntry->deleted = true;
+    if(isDense(&node->nodeId)) {
+        ns->dense[node->nodeId.identifier.numeric] = entry;
+    } else {
+        ZIP_REMOVE(NodeTree, &ns->root, oldEntry);
+        entry->nodeIdHash = oldEntry->nodeIdHash;
+        ZIP_INSERT(NodeTree, &ns->root, entry, ZIP_RANK(entry, zipfields));
+    }
     END_CRITSECT(ns);
 
-    NodeMap_releaseNode(context, oldNode);
+    retireEntry(ns, oldEntry);
     return UA_STATUSCODE_GOOD;
 }
 
@@ -360,23 +579,47 @@ NodeMap_iterate(void *context, void *visitorContext,
     d.visitor = visitor;
     d.visitorContext = visitorContext;
     NodeMap *ns = (NodeMap*)context;
-    BEGIN_CRITSECT(ns);
+    BEGIN_READSECT(ns);
+    for(UA_UInt32 i = 0; i < ns->denseSize; i++) {
+        if(ns->dense[i])
+            visitor(visitorContext, (UA_Node*)&ns->dense[i]->nodeId);
+    }
     ZIP_ITER(NodeTree, &ns->root, nodeVisitor, &d);
     END_CRITSECT(ns);
 }
 
+static void
+NodeMap_setRetireCallback(void *context, void *retireContext,
+                          UA_NodestoreRetireCallback callback) {
+    NodeMap *ns = (NodeMap*)context;
+    ns->retireContext = retireContext;
+    ns->retireCallback = callback;
+}
+
+/* The slots are freed with the slabs */
 static void
 deleteNodeVisitor(NodeEntry *entry, void *data) {
-    deleteEntry(entry);
+    UA_Node_deleteMembers((UA_Node*)&entry->nodeId);
 }
 
 static void
 NodeMap_delete(void *context) {
     NodeMap *ns = (NodeMap*)context;
 #ifdef UA_ENABLE_MULTITHREADING
-    pthread_mutex_destroy(&ns->mutex);
+    pthread_rwlock_destroy(&ns->lock);
+    pthread_mutex_destroy(&ns->slabLock);
 #endif
+    for(UA_UInt32 i = 0; i < ns->denseSize; i++) {
+        if(ns->dense[i])
+            deleteNodeVisitor(ns->dense[i], NULL);
+    }
+    UA_free(ns->dense);
     ZIP_ITER(NodeTree, &ns->root, deleteNodeVisitor, NULL);
+    for(size_t i = 0; i < UA_NODESTORE_NODECLASSES; i++) {
+        for(size_t j = 0; j < ns->slabs[i].slabsSize; j++)
+            UA_free(ns->slabs[i].slabs[j]);
+        UA_free(ns->slabs[i].slabs);
+    }
     UA_free(ns);
 }
 
@@ -387,19 +630,34 @@ UA_Nodestore_default_new(UA_Nodestore *ns) {
     if(!nodemap)
         return UA_STATUSCODE_BADOUTOFMEMORY;
 #ifdef UA_ENABLE_MULTITHREADING
-    pthread_mutex_init(&nodemap->mutex, NULL);
+    pthread_rwlock_init(&nodemap->lock, NULL);
+    pthread_mutex_init(&nodemap->slabLock, NULL);
 #endif
+    nodemap->retireContext = NULL;
+    nodemap->retireCallback = NULL;
 
     ZIP_INIT(&nodemap->root);
+    nodemap->dense = NULL;
+    nodemap->denseSize = 0;
+
+    for(size_t i = 0; i < UA_NODESTORE_NODECLASSES; i++) {
+        NodeSlabs *slabs = &nodemap->slabs[i];
+        slabs->slabs = NULL;
+        slabs->slabsSize = 0;
+        LIST_INIT(&slabs->freeSlabs);
+        slabs->slotSize = SLAB_ROUNDUP(sizeof(NodeEntry) - sizeof(UA_NodeId) +
+                                       nodeClasses[i].nodeSize);
+        slabs->slotsPerSlab = SLAB_BYTES / slabs->slotSize;
+    }
 
     /* Populate the nodestore */
     ns->context = nodemap;
     ns->deleteNodestore = NodeMap_delete;
-    ns->inPlaceEditAllowed = true;
     ns->newNode = NodeMap_newNode;
     ns->deleteNode = NodeMap_deleteNode;
     ns->getNode = NodeMap_getNode;
     ns->releaseNode = NodeMap_releaseNode;
+    ns->setRetireCallback = NodeMap_setRetireCallback;
     ns->getNodeCopy = NodeMap_getNodeCopy;
     ns->insertNode = NodeMap_insertNode;
     ns->replaceNode = NodeMap_replaceNode;
@@ -407,3 +665,119 @@ UA_Nodestore_default_new(UA_Nodestore *ns) {
     ns->iterate = NodeMap_iterate;
     return UA_STATUSCODE_GOOD;
 }
+
+/**************/
+/* Statistics */
+/**************/
+
+static size_t
+nodeIdBytes(const UA_NodeId *id) {
+    if(id->identifierType == UA_NODEIDTYPE_STRING ||
+       id->identifierType == UA_NODEIDTYPE_BYTESTRING)
+        return id->identifier.string.length;
+    return 0;
+}
+
+/* Nested structures in the value are not followed */
+static size_t
+variantBytes(const UA_Variant *v) {
+    size_t bytes = v->arrayDimensionsSize * sizeof(UA_UInt32);
+    if(!v->type || v->storageType != UA_VARIANT_DATA ||
+       v->data <= UA_EMPTY_ARRAY_SENTINEL)
+        return bytes;
+    size_t length = UA_Variant_isScalar(v) ? 1 : v->arrayLength;
+    bytes += length * v->type->memSize;
+    if(v->type->typeKind == UA_DATATYPEKIND_STRING ||
+       v->type->typeKind == UA_DATATYPEKIND_BYTESTRING ||
+       v->type->typeKind == UA_DATATYPEKIND_XMLELEMENT) {
+        const UA_String *strings = (const UA_String*)v->data;
+        for(size_t i = 0; i < length; i++)
+            bytes += strings[i].length;
+    }
+    return bytes;
+}
+
+/* Heap memory of the strings, arrays and references owned by the node */
+static size_t
+memberBytes(const UA_Node *node) {
+    size_t bytes = nodeIdBytes(&node->nodeId) + node->browseName.name.length +
+        node->displayName.locale.length + node->displayName.text.length +
+        node->description.locale.length + node->description.text.length;
+
+    bytes += node->referencesSize * sizeof(UA_NodeReferenceKind);
+    for(size_t i = 0; i < node->referencesSize; i++) {
+        const UA_NodeReferenceKind *rk = &node->references[i];
+        bytes += nodeIdBytes(&rk->referenceTypeId);
+        bytes += rk->targetIdsSize * sizeof(UA_ExpandedNodeId);
+        bytes += UA_NodeReferenceKind_targetIndexBytes(rk);
+        for(size_t j = 0; j < rk->targetIdsSize; j++)
+            bytes += nodeIdBytes(&rk->targetIds[j].nodeId) +
+                rk->targetIds[j].namespaceUri.length;
+    }
+
+    switch(node->nodeClass) {
+    case UA_NODECLASS_VARIABLE:
+    case UA_NODECLASS_VARIABLETYPE: {
+        const UA_VariableNode *vn = (const UA_VariableNode*)node;
+        bytes += nodeIdBytes(&vn->dataType);
+        bytes += vn->arrayDimensionsSize * sizeof(UA_UInt32);
+        if(vn->valueSource == UA_VALUESOURCE_DATA)
+            bytes += variantBytes(&vn->value.data.value.value);
+        break;
+    }
+    case UA_NODECLASS_REFERENCETYPE: {
+        const UA_ReferenceTypeNode *rn = (const UA_ReferenceTypeNode*)node;
+        bytes += rn->inverseName.locale.length + rn->inverseName.text.length;
+        break;
+    }
+    default:
+        break;
+    }
+    return bytes;
+}
+
+static void
+statisticsVisitor(NodeEntry *entry, void *data) {
+    UA_NodestoreStatistics *stats = (UA_NodestoreStatistics*)data;
+    const UA_Node *node = (const UA_Node*)&entry->nodeId;
+    for(size_t i = 0; i < UA_NODESTORE_NODECLASSES; i++) {
+        if(stats->classes[i].nodeClass != node->nodeClass)
+            continue;
+        stats->classes[i].nodes++;
+        stats->classes[i].memberBytes += memberBytes(node);
+        break;
+    }
+}
+
+UA_StatusCode
+UA_Nodestore_default_getStatistics(const UA_Nodestore *ns,
+                                   UA_NodestoreStatistics *stats) {
+    if(ns->getNode != NodeMap_getNode)
+        return UA_STATUSCODE_BADNOTSUPPORTED;
+    NodeMap *nodemap = (NodeMap*)ns->context;
+    memset(stats, 0, sizeof(UA_NodestoreStatistics));
+
+    BEGIN_READSECT(nodemap);
+    for(size_t i = 0; i < UA_NODESTORE_NODECLASSES; i++)
+        stats->classes[i].nodeClass = nodeClasses[i].nodeClass;
+    for(UA_UInt32 i = 0; i < nodemap->denseSize; i++) {
+        if(nodemap->dense[i])
+            statisticsVisitor(nodemap->dense[i], stats);
+    }
+    ZIP_ITER(NodeTree, &nodemap->root, statisticsVisitor, stats);
+    END_CRITSECT(nodemap);
+
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_lock(&nodemap->slabLock);
+#endif
+    for(size_t i = 0; i < UA_NODESTORE_NODECLASSES; i++) {
+        const NodeSlabs *slabs = &nodemap->slabs[i];
+        stats->classes[i].slotSize = slabs->slotSize;
+        stats->classes[i].slabBytes = slabs->slabsSize *
+            (SLAB_ROUNDUP(sizeof(NodeSlab)) + slabs->slotsPerSlab * slabs->slotSize);
+    }
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_unlock(&nodemap->slabLock);
+#endif
+    return UA_STATUSCODE_GOOD;
+}
@@ -17,6 +17,32 @@ _UA_BEGIN_DECLS
 UA_StatusCode UA_EXPORT
 UA_Nodestore_default_new(UA_Nodestore *ns);
 
+/* The nodes are allocated from slabs with one slab list per NodeClass. The
+ * statistics show the memory use for the nodes of every NodeClass. The average
+ * bytes per node are (slabBytes + memberBytes) / nodes. */
+#define UA_NODESTORE_NODECLASSES 8
+
+typedef struct {
+    UA_NodeClass nodeClass;
+    size_t nodes;       /* Nodes in the nodestore */
+    size_t slotSize;    /* Bytes per node in the slabs */
+    size_t slabBytes;   /* Allocated slabs. Includes the free slots and the
+                         * node copies that are not (yet) in the nodestore. */
+    size_t memberBytes; /* Heap memory of the strings, arrays and references
+                         * owned by the nodes. Approximated for values with
+                         * nested structures. */
+} UA_NodestoreClassStatistics;
+
+typedef struct {
+    UA_NodestoreClassStatistics classes[UA_NODESTORE_NODECLASSES];
+} UA_NodestoreStatistics;
+
+/* Returns UA_STATUSCODE_BADNOTSUPPORTED if the nodestore was not created with
+ * UA_Nodestore_default_new */
+UA_StatusCode UA_EXPORT
+UA_Nodestore_default_getStatistics(const UA_Nodestore *ns,
+                                   UA_NodestoreStatistics *stats);
+
 _UA_END_DECLS
 
 #endif /* UA_NODESTORE_DEFAULT_H_ */
@@ -0,0 +1,524 @@
+/* This work is licensed under a Creative Commons CCZero 1.0 Universal License.
+ * See http://creativecommons.org/publicdomain/zero/1.0/ for more information.
+ *
+ *    Copyright 2014-2018 (c) Fraunhofer IOSB (Author: Julius Pfrommer)
+ */
+
+#include "ua_nodestore_hashmap.h"
+
+/* The nodes are stored in an open-addressing hash map with linear probing. The
+ * hashes of the NodeIds are cached in a separate array. So probing scans
+ * consecutive integers and the nodes are only dereferenced when the hash
+ * matches. The hash values 0 and 1 mark empty and removed slots. The map grows
+ * when more than 3/4 of the slots are in use (including the removed slots).
+ *
+ * The map is optimized for read-mostly access. Lookups take no lock. Writers
+ * are serialized by a mutex and publish their changes with atomic stores:
+ *
+ * - A new node is written to its slot before the hash. So a reader that finds
+ *   the hash also sees the node.
+ * - A replaced node is swapped in the slot. The reader sees either the old or
+ *   the new version of the node, both immutable.
+ * - Removal only changes the hash of the slot. Slots never become empty again
+ *   while probing can continue behind them.
+ * - Rehashing builds a new table and swaps the table pointer.
+ *
+ * Removed and replaced nodes as well as the old tables are handed to the retire
+ * callback and deleted when no reader is left. The lookups do not track their
+ * readers. So without a retire callback, the removed and replaced nodes and the
+ * old tables are kept until the nodestore is deleted. */
+#ifdef UA_ENABLE_MULTITHREADING
+#include <pthread.h>
+#define BEGIN_CRITSECT(NODEMAP) pthread_mutex_lock(&(NODEMAP)->writeMutex)
+#define END_CRITSECT(NODEMAP) pthread_mutex_unlock(&(NODEMAP)->writeMutex)
+#define LOAD_ACQUIRE(PTR) __atomic_load_n(PTR, __ATOMIC_ACQUIRE)
+#define STORE_RELEASE(PTR, VAL) __atomic_store_n(PTR, VAL, __ATOMIC_RELEASE)
+#else
+#define BEGIN_CRITSECT(NODEMAP)
+#define END_CRITSECT(NODEMAP)
+#define LOAD_ACQUIRE(PTR) (*(PTR))
+#define STORE_RELEASE(PTR, VAL) (*(PTR) = (VAL))
+#endif
+
+/* container_of */
+#define container_of(ptr, type, member) \
+    (type *)((uintptr_t)ptr - offsetof(type,member))
+
+#define NODEMAP_EMPTY 0
+#define NODEMAP_TOMBSTONE 1
+#define NODEMAP_NOTFOUND UA_UINT32_MAX
+#define NODEMAP_MINBITS 6 /* 64 slots */
+
+struct NodeEntry;
+typedef struct NodeEntry NodeEntry;
+
+struct NodeEntry {
+    NodeEntry *orig;  /* If a copy is made to replace a node, track that we
+                       * replace only the node from which the copy was made.
+                       * Important for concurrent operations. Links the list
+                       * of retired entries after the entry was removed. */
+    UA_NodeId nodeId; /* This is actually a UA_Node that also starts with a NodeId */
+};
+
+typedef struct NodeTable {
+    /* A replaced table is handed to the retire callback as this placeholder.
+     * The placeholder has no NodeClass. Then deleteNode deletes the table. */
+    UA_Node placeholder;
+    struct NodeTable *retiredNext; /* Without a retire callback */
+    UA_UInt32 sizeBits;  /* The table has 2^sizeBits slots */
+    UA_UInt32 *hashes;   /* Cached hash for every slot */
+    NodeEntry **entries;
+} NodeTable;
+
+typedef struct {
+    NodeTable *table;    /* Swapped atomically */
+    UA_UInt32 count;     /* Number of nodes */
+    UA_UInt32 used;      /* Number of nodes and tombstones */
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_t writeMutex; /* Serialize the writers */
+#endif
+    void *retireContext;
+    UA_NodestoreRetireCallback retireCallback;
+    NodeEntry *retiredEntries; /* Kept without a retire callback */
+    NodeTable *retiredTables;
+} NodeMap;
+
+static UA_UInt32
+hashNodeId(const UA_NodeId *nodeId) {
+    UA_UInt32 h = UA_NodeId_hash(nodeId);
+    return (h > NODEMAP_TOMBSTONE) ? h : h + 2;
+}
+
+/* Consecutive numeric NodeIds have close hash values. Mix the hash (Fibonacci
+ * hashing) so that they don't form clusters. */
+static UA_UInt32
+startSlot(const NodeTable *t, UA_UInt32 h) {
+    return (UA_UInt32)(h * UINT32_C(2654435761)) >> (32 - t->sizeBits);
+}
+
+/* Can be called without the lock. The load factor ensures that there is always
+ * an empty slot where the probing ends. */
+static NodeEntry *
+findEntry(const NodeTable *t, const UA_NodeId *nodeId, UA_UInt32 h) {
+    UA_UInt32 mask = ((UA_UInt32)1 << t->sizeBits) - 1;
+    UA_UInt32 i = startSlot(t, h);
+    for(;;) {
+        UA_UInt32 sh = LOAD_ACQUIRE(&t->hashes[i]);
+        if(sh == h) {
+            NodeEntry *entry = LOAD_ACQUIRE(&t->entries[i]);
+            if(UA_NodeId_equal(&entry->nodeId, nodeId))
+                return entry;
+        }
+        if(sh == NODEMAP_EMPTY)
+            return NULL;
+        i = (i + 1) & mask;
+    }
+}
+
+/* Call only inside a critical section */
+static UA_UInt32
+findSlot(const NodeTable *t, const UA_NodeId *nodeId, UA_UInt32 h) {
+    UA_UInt32 mask = ((UA_UInt32)1 << t->sizeBits) - 1;
+    UA_UInt32 i = startSlot(t, h);
+    for(;;) {
+        UA_UInt32 sh = t->hashes[i];
+        if(sh == h && UA_NodeId_equal(&t->entries[i]->nodeId, nodeId))
+            return i;
+        if(sh == NODEMAP_EMPTY)
+            return NODEMAP_NOTFOUND;
+        i = (i + 1) & mask;
+    }
+}
+
+/* Returns the first empty or removed slot along the probing sequence */
+static UA_UInt32
+freeSlot(const NodeTable *t, UA_UInt32 h) {
+    UA_UInt32 mask = ((UA_UInt32)1 << t->sizeBits) - 1;
+    UA_UInt32 i = startSlot(t, h);
+    while(t->hashes[i] > NODEMAP_TOMBSTONE)
+        i = (i + 1) & mask;
+    return i;
+}
+
+static NodeTable *
+newTable(UA_UInt32 sizeBits) {
+    size_t size = (size_t)1 << sizeBits;
+    NodeTable *t = (NodeTable*)
+        UA_malloc(sizeof(NodeTable) + size * (sizeof(NodeEntry*) + sizeof(UA_UInt32)));
+    if(!t)
+        return NULL;
+    memset(&t->placeholder, 0, sizeof(UA_Node));
+    t->sizeBits = sizeBits;
+    t->entries = (NodeEntry**)&t[1];
+    t->hashes = (UA_UInt32*)&t->entries[size];
+    memset(t->hashes, 0, size * sizeof(UA_UInt32));
+    return t;
+}
+
+/* Rehash into a new table with 2^sizeBits slots. This also removes the
+ * tombstones. The old table is retired. */
+static UA_StatusCode
+resize(NodeMap *ns, UA_UInt32 sizeBits) {
+    NodeTable *t = newTable(sizeBits);
+    if(!t)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+
+    NodeTable *old = ns->table;
+    size_t oldSize = (size_t)1 << old->sizeBits;
+    for(size_t j = 0; j < oldSize; j++) {
+        if(old->hashes[j] <= NODEMAP_TOMBSTONE)
+            continue;
+        UA_UInt32 i = freeSlot(t, old->hashes[j]);
+        t->hashes[i] = old->hashes[j];
+        t->entries[i] = old->entries[j];
+    }
+    ns->used = ns->count;
+
+    /* Publish the new table */
+    STORE_RELEASE(&ns->table, t);
+    if(ns->retireCallback) {
+        ns->retireCallback(ns->retireContext, &old->placeholder);
+    } else {
+        old->retiredNext = ns->retiredTables;
+        ns->retiredTables = old;
+    }
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Make room for one more node. If the map is full of tombstones, it is rehashed
+ * to a size with a load factor of at most 1/2. */
+static UA_StatusCode
+expand(NodeMap *ns) {
+    size_t size = (size_t)1 << ns->table->sizeBits;
+    if(((size_t)ns->used + 1) * 4 <= size * 3)
+        return UA_STATUSCODE_GOOD;
+    UA_UInt32 sizeBits = NODEMAP_MINBITS;
+    while(((size_t)1 << sizeBits) < ((size_t)ns->count + 1) * 2)
+        sizeBits++;
+    if(sizeBits > 31)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    return resize(ns, sizeBits);
+}
+
+static NodeEntry *
+newEntry(UA_NodeClass nodeClass) {
+    size_t size = sizeof(NodeEntry) - sizeof(UA_NodeId);
+    switch(nodeClass) {
+    case UA_NODECLASS_OBJECT:
+        size += sizeof(UA_ObjectNode);
+        break;
+    case UA_NODECLASS_VARIABLE:
+        size += sizeof(UA_VariableNode);
+        break;
+    case UA_NODECLASS_METHOD:
+        size += sizeof(UA_MethodNode);
+        break;
+    case UA_NODECLASS_OBJECTTYPE:
+        size += sizeof(UA_ObjectTypeNode);
+        break;
+    case UA_NODECLASS_VARIABLETYPE:
+        size += sizeof(UA_VariableTypeNode);
+        break;
+    case UA_NODECLASS_REFERENCETYPE:
+        size += sizeof(UA_ReferenceTypeNode);
+        break;
+    case UA_NODECLASS_DATATYPE:
+        size += sizeof(UA_DataTypeNode);
+        break;
+    case UA_NODECLASS_VIEW:
+        size += sizeof(UA_ViewNode);
+        break;
+    default:
+        return NULL;
+    }
+    NodeEntry *entry = (NodeEntry*)UA_calloc(1, size);
+    if(!entry)
+        return NULL;
+    UA_Node *node = (UA_Node*)&entry->nodeId;
+    node->nodeClass = nodeClass;
+    return entry;
+}
+
+static void
+deleteEntry(NodeEntry *entry) {
+    UA_Node_deleteMembers((UA_Node*)&entry->nodeId);
+    UA_free(entry);
+}
+
+/* Call after the entry was taken out of the map */
+static void
+retireEntry(NodeMap *ns, NodeEntry *entry) {
+    if(ns->retireCallback) {
+        ns->retireCallback(ns->retireContext, (UA_Node*)&entry->nodeId);
+        return;
+    }
+    BEGIN_CRITSECT(ns);
+    entry->orig = ns->retiredEntries;
+    ns->retiredEntries = entry;
+    END_CRITSECT(ns);
+}
+
+/***********************/
+/* Interface functions */
+/***********************/
+
+/* Not yet inserted into the NodeMap */
+static UA_Node *
+NodeMap_newNode(void *context, UA_NodeClass nodeClass) {
+    NodeEntry *entry = newEntry(nodeClass);
+    if(!entry)
+        return NULL;
+    return (UA_Node*)&entry->nodeId;
+}
+
+/* Not yet inserted into the NodeMap or retired */
+static void
+NodeMap_deleteNode(void *context, UA_Node *node) {
+    if(node->nodeClass == UA_NODECLASS_UNSPECIFIED) {
+        UA_free(container_of(node, NodeTable, placeholder));
+        return;
+    }
+    deleteEntry(container_of(node, NodeEntry, nodeId));
+}
+
+static const UA_Node *
+NodeMap_getNode(void *context, const UA_NodeId *nodeid) {
+    NodeMap *ns = (NodeMap*)context;
+    NodeEntry *entry = findEntry(LOAD_ACQUIRE(&ns->table), nodeid,
+                                 hashNodeId(nodeid));
+    if(!entry)
+        return NULL;
+    return (const UA_Node*)&entry->nodeId;
+}
+
+/* Removed nodes are retired. So there is no need to track the readers. */
+static void
+NodeMap_releaseNode(void *context, const UA_Node *node) {
+}
+
+static UA_StatusCode
+NodeMap_getNodeCopy(void *context, const UA_NodeId *nodeid,
+                    UA_Node **outNode) {
+    /* Find the node */
+    const UA_Node *node = NodeMap_getNode(context, nodeid);
+    if(!node)
+        return UA_STATUSCODE_BADNODEIDUNKNOWN;
+
+    /* Create the new entry */
+    NodeEntry *ne = newEntry(node->nodeClass);
+    if(!ne) {
+        NodeMap_releaseNode(context, node);
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    }
+
+    /* Copy the node content */
+    UA_Node *nnode = (UA_Node*)&ne->nodeId;
+    UA_StatusCode retval = UA_Node_copy(node, nnode);
+    NodeMap_releaseNode(context, node);
+    if(retval != UA_STATUSCODE_GOOD) {
+        deleteEntry(ne);
+        return retval;
+    }
+
+    ne->orig = container_of(node, NodeEntry, nodeId);
+    *outNode = nnode;
+    return UA_STATUSCODE_GOOD;
+}
+
+static UA_StatusCode
+NodeMap_removeNode(void *context, const UA_NodeId *nodeid) {
+    NodeMap *ns = (NodeMap*)context;
+    UA_UInt32 h = hashNodeId(nodeid);
+    BEGIN_CRITSECT(ns);
+    NodeTable *t = ns->table;
+    UA_UInt32 i = findSlot(t, nodeid, h);
+    if(i == NODEMAP_NOTFOUND) {
+        END_CRITSECT(ns);
+        return UA_STATUSCODE_BADNODEIDUNKNOWN;
+    }
+    NodeEntry *entry = t->entries[i];
+
+    /* A tombstone is only required if the probing continues after the slot */
+    UA_UInt32 mask = ((UA_UInt32)1 << t->sizeBits) - 1;
+    if(t->hashes[(i + 1) & mask] == NODEMAP_EMPTY) {
+        STORE_RELEASE(&t->hashes[i], NODEMAP_EMPTY);
+        ns->used--;
+    } else {
+        STORE_RELEASE(&t->hashes[i], NODEMAP_TOMBSTONE);
+    }
+    ns->count--;
+    END_CRITSECT(ns);
+    retireEntry(ns, entry);
+    return UA_STATUSCODE_GOOD;
+}
+
+static UA_StatusCode
+NodeMap_insertNode(void *context, UA_Node *node,
+                   UA_NodeId *addedNodeId) {
+    NodeEntry *entry = container_of(node, NodeEntry, nodeId);
+    NodeMap *ns = (NodeMap*)context;
+    BEGIN_CRITSECT(ns);
+
+    UA_StatusCode retval = expand(ns);
+    if(retval != UA_STATUSCODE_GOOD) {
+        deleteEntry(entry);
+        END_CRITSECT(ns);
+        return retval;
+    }
+
+    /* Ensure that the NodeId is unique */
+    NodeTable *t = ns->table;
+    UA_UInt32 h;
+    if(node->nodeId.identifierType == UA_NODEIDTYPE_NUMERIC &&
+       node->nodeId.identifier.numeric == 0) {
+        do { /* Create a random nodeid until we find an unoccupied id */
+            node->nodeId.identifier.numeric = UA_UInt32_random();
+            h = hashNodeId(&node->nodeId);
+        } while(findSlot(t, &node->nodeId, h) != NODEMAP_NOTFOUND);
+    } else {
+        h = hashNodeId(&node->nodeId);
+        if(findSlot(t, &node->nodeId, h) != NODEMAP_NOTFOUND) { /* The nodeid exists */
+            deleteEntry(entry);
+            END_CRITSECT(ns);
+            return UA_STATUSCODE_BADNODEIDEXISTS;
+        }
+    }
+
+    /* Copy the NodeId */
+    if(addedNodeId) {
+        retval = UA_NodeId_copy(&node->nodeId, addedNodeId);
+        if(retval != UA_STATUSCODE_GOOD) {
+            deleteEntry(entry);
+            END_CRITSECT(ns);
+            return retval;
+        }
+    }
+
+    /* Insert the node. The entry is visible before the hash. */
+    UA_UInt32 i = freeSlot(t, h);
+    if(t->hashes[i] == NODEMAP_EMPTY)
+        ns->used++;
+    STORE_RELEASE(&t->entries[i], entry);
+    STORE_RELEASE(&t->hashes[i], h);
+    ns->count++;
+    END_CRITSECT(ns);
+    return UA_STATUSCODE_GOOD;
+}
+
+static UA_StatusCode
+NodeMap_replaceNode(void *context, UA_Node *node) {
+    NodeMap *ns = (NodeMap*)context;
+    NodeEntry *entry = container_of(node, NodeEntry, nodeId);
+    UA_UInt32 h = hashNodeId(&node->nodeId);
+    BEGIN_CRITSECT(ns);
+
+    /* Find the node */
+    NodeTable *t = ns->table;
+    UA_UInt32 i = findSlot(t, &node->nodeId, h);
+    if(i == NODEMAP_NOTFOUND) {
+        END_CRITSECT(ns);
+        deleteEntry(entry);
+        return UA_STATUSCODE_BADNODEIDUNKNOWN;
+    }
+
+    /* Test if the copy is current */
+    NodeEntry *oldEntry = t->entries[i];
+    if(oldEntry != entry->orig) {
+        /* The node was already updated since the copy was made */
+        END_CRITSECT(ns);
+        deleteEntry(entry);
+        return UA_STATUSCODE_BADINTERNALERROR;
+    }
+
+    /* Publish the new version */
+    STORE_RELEASE(&t->entries[i], entry);
+    END_CRITSECT(ns);
+
+    retireEntry(ns, oldEntry);
+    return UA_STATUSCODE_GOOD;
+}
+
+static void
+NodeMap_iterate(void *context, void *visitorContext,
+                UA_NodestoreVisitor visitor) {
+    NodeMap *ns = (NodeMap*)context;
+    const NodeTable *t = LOAD_ACQUIRE(&ns->table);
+    size_t size = (size_t)1 << t->sizeBits;
+    for(size_t i = 0; i < size; i++) {
+        if(LOAD_ACQUIRE(&t->hashes[i]) > NODEMAP_TOMBSTONE) {
+            NodeEntry *entry = LOAD_ACQUIRE(&t->entries[i]);
+            visitor(visitorContext, (UA_Node*)&entry->nodeId);
+        }
+    }
+}
+
+static void
+NodeMap_setRetireCallback(void *context, void *retireContext,
+                          UA_NodestoreRetireCallback callback) {
+    NodeMap *ns = (NodeMap*)context;
+    ns->retireContext = retireContext;
+    ns->retireCallback = callback;
+}
+
+static void
+NodeMap_delete(void *context) {
+    NodeMap *ns = (NodeMap*)context;
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_destroy(&ns->writeMutex);
+#endif
+    NodeTable *t = ns->table;
+    size_t size = (size_t)1 << t->sizeBits;
+    for(size_t i = 0; i < size; i++) {
+        if(t->hashes[i] > NODEMAP_TOMBSTONE)
+            deleteEntry(t->entries[i]);
+    }
+    UA_free(t);
+    while(ns->retiredEntries) {
+        NodeEntry *entry = ns->retiredEntries;
+        ns->retiredEntries = entry->orig;
+        deleteEntry(entry);
+    }
+    while(ns->retiredTables) {
+        t = ns->retiredTables;
+        ns->retiredTables = t->retiredNext;
+        UA_free(t);
+    }
+    UA_free(ns);
+}
+
+UA_StatusCode
+UA_Nodestore_hashMap_new(UA_Nodestore *ns) {
+    /* Allocate and initialize the nodemap */
+    NodeMap *nodemap = (NodeMap*)UA_malloc(sizeof(NodeMap));
+    if(!nodemap)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    nodemap->table = newTable(NODEMAP_MINBITS);
+    if(!nodemap->table) {
+        UA_free(nodemap);
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    }
+    nodemap->count = 0;
+    nodemap->used = 0;
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_init(&nodemap->writeMutex, NULL);
+#endif
+    nodemap->retireContext = NULL;
+    nodemap->retireCallback = NULL;
+    nodemap->retiredEntries = NULL;
+    nodemap->retiredTables = NULL;
+
+    /* Populate the nodestore */
+    ns->context = nodemap;
+    ns->deleteNodestore = NodeMap_delete;
+    ns->newNode = NodeMap_newNode;
+    ns->deleteNode = NodeMap_deleteNode;
+    ns->getNode = NodeMap_getNode;
+    ns->releaseNode = NodeMap_releaseNode;
+    ns->setRetireCallback = NodeMap_setRetireCallback;
+    ns->getNodeCopy = NodeMap_getNodeCopy;
+    ns->insertNode = NodeMap_insertNode;
+    ns->replaceNode = NodeMap_replaceNode;
+    ns->removeNode = NodeMap_removeNode;
+    ns->iterate = NodeMap_iterate;
+    return UA_STATUSCODE_GOOD;
+}
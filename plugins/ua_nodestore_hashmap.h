@@ -0,0 +1,24 @@
+/* This work is licensed under a Creative Commons CCZero 1.0 Universal License.
+ * See http://creativecommons.org/publicdomain/zero/1.0/ for more information.
+ *
+ *    Copyright 2014-2018 (c) Fraunhofer IOSB (Author: Julius Pfrommer)
+ */
+
+#ifndef UA_NODESTORE_HASHMAP_H_
+#define UA_NODESTORE_HASHMAP_H_
+
+#include "ua_plugin_nodestore.h"
+
+_UA_BEGIN_DECLS
+
+/* Initializes a nodestore based on an open-addressing hash map. Lookups take
+ * constant time on average, but the nodes are not iterated in any particular
+ * order. With multithreading, lookups take no lock and scale with the number
+ * of reader threads. Writers are serialized. So the nodestore is best suited
+ * for read-mostly address spaces. Sets the context and function pointers. */
+UA_StatusCode UA_EXPORT
+UA_Nodestore_hashMap_new(UA_Nodestore *ns);
+
+_UA_END_DECLS
+
+#endif /* UA_NODESTORE_HASHMAP_H_ */
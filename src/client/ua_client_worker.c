@@ -142,10 +142,12 @@ UA_StatusCode UA_Client_run_iterate(UA_Client *client, UA_UInt16 timeout) {
 #endif
         asyncServiceTimeoutCheck(client);
 
-#ifndef UA_ENABLE_MULTITHREADING
         /* Process delayed callbacks when all callbacks and network events are
          * done */
+#ifndef UA_ENABLE_MULTITHREADING
         UA_WorkQueue_manuallyProcessDelayed(&client->workQueue);
+#else
+        UA_WorkQueue_quiescent(&client->workQueue);
 #endif
     return retval;
 }
@@ -17,12 +17,174 @@
 /* There is no UA_Node_new() method here. Creating nodes is part of the
  * NodeStore layer */
 
+/********************/
+/* Interned Strings */
+/********************/
+
+/* The strings of the node attributes repeat across many nodes (e.g. the same
+ * BrowseNames and locales in every instance of a type). They are interned:
+ * every distinct string is allocated once with a reference count and the nodes
+ * point to the shared and immutable content. The table is global, as nodes are
+ * copied and deleted in the nodestore without access to the server. Strings
+ * that were not interned (e.g. set up by a custom nodestore) are recognized by
+ * their pointer and freed regularly. */
+
+typedef struct {
+    UA_HashIndexEntry indexEntry;
+    UA_UInt32 refCount;
+    size_t length;
+    UA_Byte data[];
+} UA_InternedString;
+
+static UA_HashIndex internedStrings; /* Zero-initialized is an empty index */
+
+/* The table is shared by all servers of the process. Without multithreading,
+ * separate servers can still run in separate threads of the application. So
+ * the table is always locked. Single-threaded builds don't link pthreads and
+ * use a spinlock. The critical sections are short. */
+#if defined(UA_ENABLE_MULTITHREADING)
+static pthread_mutex_t internedStringsLock = PTHREAD_MUTEX_INITIALIZER;
+#define BEGIN_INTERNSECT pthread_mutex_lock(&internedStringsLock)
+#define END_INTERNSECT pthread_mutex_unlock(&internedStringsLock)
+#elif defined(_MSC_VER)
+static volatile long internedStringsLock = 0;
+#define BEGIN_INTERNSECT \
+    while(_InterlockedExchange(&internedStringsLock, 1) != 0) {}
+#define END_INTERNSECT _InterlockedExchange(&internedStringsLock, 0)
+#elif defined(__GNUC__)
+static volatile int internedStringsLock = 0;
+#define BEGIN_INTERNSECT \
+    while(__sync_lock_test_and_set(&internedStringsLock, 1) != 0) {}
+#define END_INTERNSECT __sync_lock_release(&internedStringsLock)
+#else
+/* No atomic operations known for the compiler. Only one server can be used
+ * at a time. */
+#define BEGIN_INTERNSECT
+#define END_INTERNSECT
+#endif
+
+/* Call only inside the critical section */
+static UA_InternedString *
+findInterned(const UA_String *s, UA_UInt32 hash) {
+    UA_HashIndexEntry *e = UA_HashIndex_first(&internedStrings, hash);
+    for(; e; e = UA_HashIndex_next(e, hash)) {
+        UA_InternedString *is = container_of(e, UA_InternedString, indexEntry);
+        if(is->length == s->length && memcmp(is->data, s->data, s->length) == 0)
+            return is;
+    }
+    return NULL;
+}
+
+UA_StatusCode
+UA_String_copyInterned(const UA_String *src, UA_String *dst) {
+    if(src->length == 0)
+        return UA_String_copy(src, dst);
+
+    UA_UInt32 hash = UA_ByteString_hash(0, src->data, src->length);
+    BEGIN_INTERNSECT;
+    UA_InternedString *is = findInterned(src, hash);
+    if(!is) {
+        is = (UA_InternedString*)UA_malloc(sizeof(UA_InternedString) + src->length);
+        if(!is) {
+            END_INTERNSECT;
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+        }
+        is->refCount = 0;
+        is->length = src->length;
+        memcpy(is->data, src->data, src->length);
+        if(UA_HashIndex_insert(&internedStrings, &is->indexEntry, hash) != UA_STATUSCODE_GOOD) {
+            END_INTERNSECT;
+            UA_free(is);
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+        }
+    }
+    is->refCount++;
+    END_INTERNSECT;
+
+    dst->length = is->length;
+    dst->data = is->data;
+    return UA_STATUSCODE_GOOD;
+}
+
+void
+UA_String_deleteInterned(UA_String *s) {
+    if(s->length == 0) {
+        UA_String_deleteMembers(s);
+        return;
+    }
+
+    UA_UInt32 hash = UA_ByteString_hash(0, s->data, s->length);
+    BEGIN_INTERNSECT;
+    UA_InternedString *is = findInterned(s, hash);
+    if(!is || is->data != s->data) {
+        END_INTERNSECT;
+        UA_String_deleteMembers(s); /* Not interned */
+        return;
+    }
+    is->refCount--;
+    if(is->refCount == 0) {
+        UA_HashIndex_remove(&internedStrings, &is->indexEntry);
+        UA_free(is);
+        if(internedStrings.entriesSize == 0)
+            UA_HashIndex_deleteMembers(&internedStrings);
+    }
+    END_INTERNSECT;
+    UA_String_init(s);
+}
+
+UA_StatusCode
+UA_QualifiedName_copyInterned(const UA_QualifiedName *src, UA_QualifiedName *dst) {
+    dst->namespaceIndex = src->namespaceIndex;
+    return UA_String_copyInterned(&src->name, &dst->name);
+}
+
+void
+UA_QualifiedName_deleteInterned(UA_QualifiedName *qn) {
+    UA_String_deleteInterned(&qn->name);
+    qn->namespaceIndex = 0;
+}
+
+UA_StatusCode
+UA_LocalizedText_copyInterned(const UA_LocalizedText *src, UA_LocalizedText *dst) {
+    UA_StatusCode retval = UA_String_copyInterned(&src->locale, &dst->locale);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+    retval = UA_String_copyInterned(&src->text, &dst->text);
+    if(retval != UA_STATUSCODE_GOOD)
+        UA_String_deleteInterned(&dst->locale);
+    return retval;
+}
+
+void
+UA_LocalizedText_deleteInterned(UA_LocalizedText *lt) {
+    UA_String_deleteInterned(&lt->locale);
+    UA_String_deleteInterned(&lt->text);
+}
+
+UA_StatusCode
+UA_NodeId_copyInterned(const UA_NodeId *src, UA_NodeId *dst) {
+    if(src->identifierType != UA_NODEIDTYPE_STRING &&
+       src->identifierType != UA_NODEIDTYPE_BYTESTRING)
+        return UA_NodeId_copy(src, dst);
+    dst->namespaceIndex = src->namespaceIndex;
+    dst->identifierType = src->identifierType;
+    return UA_String_copyInterned(&src->identifier.string, &dst->identifier.string);
+}
+
+void
+UA_NodeId_deleteInterned(UA_NodeId *id) {
+    if(id->identifierType == UA_NODEIDTYPE_STRING ||
+       id->identifierType == UA_NODEIDTYPE_BYTESTRING)
+        UA_String_deleteInterned(&id->identifier.string);
+    UA_NodeId_deleteMembers(id);
+}
+
 void UA_Node_deleteMembers(UA_Node *node) {
     /* Delete standard content */
-    UA_NodeId_deleteMembers(&node->nodeId);
-    UA_QualifiedName_deleteMembers(&node->browseName);
-    UA_LocalizedText_deleteMembers(&node->displayName);
-    UA_LocalizedText_deleteMembers(&node->description);
+    UA_NodeId_deleteInterned(&node->nodeId);
+    UA_QualifiedName_deleteInterned(&node->browseName);
+    UA_LocalizedText_deleteInterned(&node->displayName);
+    UA_LocalizedText_deleteInterned(&node->description);
 
     /* Delete references */
     UA_Node_deleteReferences(node);
@@ -49,7 +211,7 @@ void UA_Node_deleteMembers(UA_Node *node) {
     }
     case UA_NODECLASS_REFERENCETYPE: {
         UA_ReferenceTypeNode *p = (UA_ReferenceTypeNode*)node;
-        UA_LocalizedText_deleteMembers(&p->inverseName);
+        UA_LocalizedText_deleteInterned(&p->inverseName);
         break;
     }
     case UA_NODECLASS_DATATYPE:
@@ -123,8 +285,8 @@ UA_ObjectTypeNode_copy(const UA_ObjectTypeNode *src, UA_ObjectTypeNode *dst) {
 static UA_StatusCode
 UA_ReferenceTypeNode_copy(const UA_ReferenceTypeNode *src,
                           UA_ReferenceTypeNode *dst) {
-    UA_StatusCode retval = UA_LocalizedText_copy(&src->inverseName,
-                                                 &dst->inverseName);
+    UA_StatusCode retval = UA_LocalizedText_copyInterned(&src->inverseName,
+                                                         &dst->inverseName);
     dst->isAbstract = src->isAbstract;
     dst->symmetric = src->symmetric;
     return retval;
@@ -149,10 +311,10 @@ UA_Node_copy(const UA_Node *src, UA_Node *dst) {
         return UA_STATUSCODE_BADINTERNALERROR;
 
     /* Copy standard content */
-    UA_StatusCode retval = UA_NodeId_copy(&src->nodeId, &dst->nodeId);
-    retval |= UA_QualifiedName_copy(&src->browseName, &dst->browseName);
-    retval |= UA_LocalizedText_copy(&src->displayName, &dst->displayName);
-    retval |= UA_LocalizedText_copy(&src->description, &dst->description);
+    UA_StatusCode retval = UA_NodeId_copyInterned(&src->nodeId, &dst->nodeId);
+    retval |= UA_QualifiedName_copyInterned(&src->browseName, &dst->browseName);
+    retval |= UA_LocalizedText_copyInterned(&src->displayName, &dst->displayName);
+    retval |= UA_LocalizedText_copyInterned(&src->description, &dst->description);
     dst->writeMask = src->writeMask;
     dst->context = src->context;
     dst->constructed = src->constructed;
@@ -185,6 +347,16 @@ UA_Node_copy(const UA_Node *src, UA_Node *dst) {
             if(retval != UA_STATUSCODE_GOOD)
                 break;
             drefs->targetIdsSize = srefs->targetIdsSize;
+            if(!srefs->targetIndex)
+                continue;
+            /* The positions of the targets are the same in the copy */
+            size_t indexBytes = UA_NodeReferenceKind_targetIndexBytes(srefs);
+            drefs->targetIndex = (struct UA_ReferenceTargetIndex*)UA_malloc(indexBytes);
+            if(!drefs->targetIndex) {
+                retval = UA_STATUSCODE_BADOUTOFMEMORY;
+                break;
+            }
+            memcpy(drefs->targetIndex, srefs->targetIndex, indexBytes);
         }
         if(retval != UA_STATUSCODE_GOOD) {
             UA_Node_deleteMembers(dst);
@@ -282,9 +454,9 @@ static UA_StatusCode
 copyStandardAttributes(UA_Node *node, const UA_NodeAttributes *attr) {
     /* retval  = UA_NodeId_copy(&item->requestedNewNodeId.nodeId, &node->nodeId); */
     /* retval |= UA_QualifiedName_copy(&item->browseName, &node->browseName); */
-    UA_StatusCode retval = UA_LocalizedText_copy(&attr->displayName,
-                                                 &node->displayName);
-    retval |= UA_LocalizedText_copy(&attr->description, &node->description);
+    UA_StatusCode retval = UA_LocalizedText_copyInterned(&attr->displayName,
+                                                         &node->displayName);
+    retval |= UA_LocalizedText_copyInterned(&attr->description, &node->description);
     node->writeMask = attr->writeMask;
     return retval;
 }
@@ -382,7 +554,7 @@ copyReferenceTypeNodeAttributes(UA_ReferenceTypeNode *rtnode,
                                 const UA_ReferenceTypeAttributes *attr) {
     rtnode->isAbstract = attr->isAbstract;
     rtnode->symmetric = attr->symmetric;
-    return UA_LocalizedText_copy(&attr->inverseName, &rtnode->inverseName);
+    return UA_LocalizedText_copyInterned(&attr->inverseName, &rtnode->inverseName);
 }
 
 static UA_StatusCode
@@ -481,8 +653,135 @@ UA_Node_setAttributes(UA_Node *node, const void *attributes,
 /* Manage References */
 /*********************/
 
+/* Reference kinds with at least this many targets get a hash index. The index
+ * is removed again when less than half of the threshold remains. */
+#define UA_TARGETINDEX_THRESHOLD 32
+
+/* Hash index over the NodeIds of the targets with linear probing. The index
+ * has at least twice as many slots as targets. */
+struct UA_ReferenceTargetIndex {
+    size_t targetIdsSize; /* Number of indexed targets */
+    size_t size;          /* Number of slots (a power of two) */
+    size_t slots[];       /* Position in targetIds + 1. Zero for empty slots. */
+};
+
+size_t
+UA_NodeReferenceKind_targetIndexBytes(const UA_NodeReferenceKind *refs) {
+    if(!refs->targetIndex)
+        return 0;
+    return sizeof(struct UA_ReferenceTargetIndex) +
+        refs->targetIndex->size * sizeof(size_t);
+}
+
+static void
+deleteTargetIndex(UA_NodeReferenceKind *refs) {
+    UA_free(refs->targetIndex);
+    refs->targetIndex = NULL;
+}
+
+static void
+indexTarget(UA_NodeReferenceKind *refs, size_t pos) {
+    struct UA_ReferenceTargetIndex *index = refs->targetIndex;
+    size_t mask = index->size - 1;
+    size_t slot = UA_NodeId_hash(&refs->targetIds[pos].nodeId) & mask;
+    while(index->slots[slot] != 0)
+        slot = (slot + 1) & mask;
+    index->slots[slot] = pos + 1;
+    index->targetIdsSize++;
+}
+
+static UA_StatusCode
+rebuildTargetIndex(UA_NodeReferenceKind *refs, size_t indexSize) {
+    struct UA_ReferenceTargetIndex *index = (struct UA_ReferenceTargetIndex*)
+        UA_calloc(1, sizeof(struct UA_ReferenceTargetIndex) + indexSize * sizeof(size_t));
+    if(!index)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    index->size = indexSize;
+    UA_free(refs->targetIndex);
+    refs->targetIndex = index;
+    for(size_t i = 0; i < refs->targetIdsSize; i++)
+        indexTarget(refs, i);
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Create the index if the reference kind has enough targets. Without the
+ * index, lookups remain correct. So errors are ignored. */
+static void
+createTargetIndex(UA_NodeReferenceKind *refs) {
+    if(refs->targetIdsSize < UA_TARGETINDEX_THRESHOLD)
+        return;
+    size_t indexSize = UA_TARGETINDEX_THRESHOLD * 4;
+    while(indexSize < refs->targetIdsSize * 2)
+        indexSize *= 2;
+    rebuildTargetIndex(refs, indexSize);
+}
+
+/* The index is stale if the targets were modified without going through
+ * UA_Node_addReference and UA_Node_deleteReference. Then the index is built
+ * anew. */
+static struct UA_ReferenceTargetIndex *
+getTargetIndex(UA_NodeReferenceKind *refs) {
+    if(!refs->targetIndex)
+        return NULL;
+    UA_assert(refs->targetIndex->targetIdsSize == refs->targetIdsSize);
+    if(refs->targetIndex->targetIdsSize != refs->targetIdsSize) {
+        deleteTargetIndex(refs);
+        createTargetIndex(refs);
+    }
+    return refs->targetIndex;
+}
+
+/* Returns the index slot of a target with the NodeId (and the same namespace
+ * uri and server index if fullMatch is set) or NULL */
+static size_t *
+findTargetSlot(const UA_NodeReferenceKind *refs, const UA_ExpandedNodeId *target,
+               UA_Boolean fullMatch) {
+    struct UA_ReferenceTargetIndex *index = refs->targetIndex;
+    size_t mask = index->size - 1;
+    size_t slot = UA_NodeId_hash(&target->nodeId) & mask;
+    for(; index->slots[slot] != 0; slot = (slot + 1) & mask) {
+        const UA_ExpandedNodeId *t = &refs->targetIds[index->slots[slot] - 1];
+        if(fullMatch ? UA_ExpandedNodeId_equal(t, target) :
+           UA_NodeId_equal(&t->nodeId, &target->nodeId))
+            return &index->slots[slot];
+    }
+    return NULL;
+}
+
+/* Removes the slot and moves the following entries of the probing sequence
+ * back. So lookups never stop at a gap before the entry they look for. */
+static void
+unindexSlot(UA_NodeReferenceKind *refs, size_t *slotPtr) {
+    struct UA_ReferenceTargetIndex *index = refs->targetIndex;
+    size_t mask = index->size - 1;
+    size_t gap = (size_t)(slotPtr - index->slots);
+    size_t slot = gap;
+    while(true) {
+        slot = (slot + 1) & mask;
+        size_t pos = index->slots[slot];
+        if(pos == 0)
+            break;
+        size_t home = UA_NodeId_hash(&refs->targetIds[pos - 1].nodeId) & mask;
+        /* Move the entry into the gap if its home slot is not in (gap, slot] */
+        if(((slot - home) & mask) >= ((slot - gap) & mask)) {
+            index->slots[gap] = pos;
+            gap = slot;
+        }
+    }
+    index->slots[gap] = 0;
+    index->targetIdsSize--;
+}
+
 static UA_StatusCode
 addReferenceTarget(UA_NodeReferenceKind *refs, const UA_ExpandedNodeId *target) {
+    /* Grow the index before the target is added */
+    struct UA_ReferenceTargetIndex *index = refs->targetIndex;
+    if(index && (refs->targetIdsSize + 1) * 2 > index->size) {
+        UA_StatusCode retval = rebuildTargetIndex(refs, index->size * 2);
+        if(retval != UA_STATUSCODE_GOOD)
+            return retval;
+    }
+
     UA_ExpandedNodeId *targets =
         (UA_ExpandedNodeId*) UA_realloc(refs->targetIds,
                                         sizeof(UA_ExpandedNodeId) * (refs->targetIdsSize+1));
@@ -493,14 +792,50 @@ addReferenceTarget(UA_NodeReferenceKind *refs, const UA_ExpandedNodeId *target)
     UA_StatusCode retval =
         UA_ExpandedNodeId_copy(target, &refs->targetIds[refs->targetIdsSize]);
 
-    if(retval == UA_STATUSCODE_GOOD) {
-        refs->targetIdsSize++;
-    } else if(refs->targetIdsSize == 0) {
-        /* We had zero references before (realloc was a malloc) */
-        UA_free(refs->targetIds);
-        refs->targetIds = NULL;
+    if(retval != UA_STATUSCODE_GOOD) {
+        if(refs->targetIdsSize == 0) {
+            /* We had zero references before (realloc was a malloc) */
+            UA_free(refs->targetIds);
+            refs->targetIds = NULL;
+        }
+        return retval;
     }
-    return retval;
+    refs->targetIdsSize++;
+
+    /* Index the new target */
+    if(refs->targetIndex)
+        indexTarget(refs, refs->targetIdsSize - 1);
+    else
+        createTargetIndex(refs);
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Removes the target at the position. The last target is moved into the
+ * gap. */
+static void
+removeReferenceTarget(UA_NodeReferenceKind *refs, size_t pos, size_t *slot) {
+    UA_ExpandedNodeId *target = &refs->targetIds[pos];
+    size_t last = refs->targetIdsSize - 1;
+    struct UA_ReferenceTargetIndex *index = refs->targetIndex;
+    if(slot)
+        unindexSlot(refs, slot);
+    if(index && pos != last) {
+        /* Point the slot of the last target to the new position */
+        size_t mask = index->size - 1;
+        size_t s = UA_NodeId_hash(&refs->targetIds[last].nodeId) & mask;
+        while(index->slots[s] != last + 1)
+            s = (s + 1) & mask;
+        index->slots[s] = pos + 1;
+    }
+
+    UA_ExpandedNodeId_deleteMembers(target);
+    refs->targetIdsSize--;
+    if(pos != refs->targetIdsSize) // avoid valgrind error: Source and
+                                   // destination overlap in memcpy
+        *target = refs->targetIds[refs->targetIdsSize];
+
+    if(index && refs->targetIdsSize < UA_TARGETINDEX_THRESHOLD / 2)
+        deleteTargetIndex(refs);
 }
 
 static UA_StatusCode
@@ -542,10 +877,15 @@ UA_Node_addReference(UA_Node *node, const UA_AddReferencesItem *item) {
         }
     }
     if(existingRefs != NULL) {
-        for(size_t i = 0; i < existingRefs->targetIdsSize; i++) {
-            if(UA_ExpandedNodeId_equal(&existingRefs->targetIds[i],
-                                       &item->targetNodeId)) {
+        if(getTargetIndex(existingRefs)) {
+            if(findTargetSlot(existingRefs, &item->targetNodeId, true))
                 return UA_STATUSCODE_BADDUPLICATEREFERENCENOTALLOWED;
+        } else {
+            for(size_t i = 0; i < existingRefs->targetIdsSize; i++) {
+                if(UA_ExpandedNodeId_equal(&existingRefs->targetIds[i],
+                                           &item->targetNodeId)) {
+                    return UA_STATUSCODE_BADDUPLICATEREFERENCENOTALLOWED;
+                }
             }
         }
         return addReferenceTarget(existingRefs, &item->targetNodeId);
@@ -562,41 +902,46 @@ UA_Node_deleteReference(UA_Node *node, const UA_DeleteReferencesItem *item) {
         if(!UA_NodeId_equal(&item->referenceTypeId, &refs->referenceTypeId))
             continue;
 
-        for(size_t j = refs->targetIdsSize; j > 0; --j) {
-            UA_ExpandedNodeId *target = &refs->targetIds[j-1];
-            if(!UA_NodeId_equal(&item->targetNodeId.nodeId, &target->nodeId))
+        /* Find the target */
+        size_t *slot = NULL;
+        size_t j = refs->targetIdsSize;
+        if(getTargetIndex(refs)) {
+            slot = findTargetSlot(refs, &item->targetNodeId, false);
+            if(!slot)
                 continue;
-
-            /* Ok, delete the reference */
-            UA_ExpandedNodeId_deleteMembers(target);
-            refs->targetIdsSize--;
-
-            /* One matching target remaining */
-            if(refs->targetIdsSize > 0) {
-                if(j-1 != refs->targetIdsSize) // avoid valgrind error: Source
-                                               // and destination overlap in
-                                               // memcpy
-                    *target = refs->targetIds[refs->targetIdsSize];
-                return UA_STATUSCODE_GOOD;
+            j = *slot;
+        } else {
+            for(; j > 0; --j) {
+                if(UA_NodeId_equal(&item->targetNodeId.nodeId, &refs->targetIds[j-1].nodeId))
+                    break;
             }
+            if(j == 0)
+                continue;
+        }
 
-            /* No target for the ReferenceType remaining. Remove entry. */
-            UA_free(refs->targetIds);
-            UA_NodeId_deleteMembers(&refs->referenceTypeId);
-            node->referencesSize--;
-            if(node->referencesSize > 0) {
-                if(i-1 != node->referencesSize) // avoid valgrind error: Source
-                                                // and destination overlap in
-                                                // memcpy
-                    node->references[i-1] = node->references[node->referencesSize];
-                return UA_STATUSCODE_GOOD;
-            }
+        /* Ok, delete the reference */
+        removeReferenceTarget(refs, j-1, slot);
 
-            /* No remaining references of any ReferenceType */
-            UA_free(node->references);
-            node->references = NULL;
+        /* One matching target remaining */
+        if(refs->targetIdsSize > 0)
+            return UA_STATUSCODE_GOOD;
+
+        /* No target for the ReferenceType remaining. Remove entry. */
+        UA_free(refs->targetIds);
+        UA_NodeId_deleteMembers(&refs->referenceTypeId);
+        node->referencesSize--;
+        if(node->referencesSize > 0) {
+            if(i-1 != node->referencesSize) // avoid valgrind error: Source
+                                            // and destination overlap in
+                                            // memcpy
+                node->references[i-1] = node->references[node->referencesSize];
             return UA_STATUSCODE_GOOD;
         }
+
+        /* No remaining references of any ReferenceType */
+        UA_free(node->references);
+        node->references = NULL;
+        return UA_STATUSCODE_GOOD;
     }
     return UA_STATUSCODE_UNCERTAINREFERENCENOTDELETED;
 }
@@ -624,6 +969,7 @@ UA_Node_deleteReferencesSubset(UA_Node *node, size_t referencesSkipSize,
 
         /* Remove references */
         UA_Array_delete(refs->targetIds, refs->targetIdsSize, &UA_TYPES[UA_TYPES_EXPANDEDNODEID]);
+        deleteTargetIndex(refs);
         UA_NodeId_deleteMembers(&refs->referenceTypeId);
         node->referencesSize--;
 
@@ -17,10 +17,40 @@
 
 #define STARTCHANNELID 1
 #define STARTTOKENID 1
+#define EXPIRY_DUE (-UA_INT64_MAX) /* Inspect in the next cleanup */
+
+/* Channels can expire at the same time. They are given an absolute order by
+ * the memory address to break ties. */
+static enum ZIP_CMP
+cmpExpiry(const UA_DateTime *a, const UA_DateTime *b) {
+    if(*a < *b)
+        return ZIP_CMP_LESS;
+    if(*a > *b)
+        return ZIP_CMP_MORE;
+    if(a == b)
+        return ZIP_CMP_EQ;
+    if(a < b)
+        return ZIP_CMP_LESS;
+    return ZIP_CMP_MORE;
+}
+
+ZIP_PROTTYPE(UA_ChannelExpiryTree, channel_entry, UA_DateTime)
+ZIP_IMPL(UA_ChannelExpiryTree, channel_entry, expiryEntry, UA_DateTime, expiry, cmpExpiry)
+
+static UA_DateTime
+channelExpiry(const UA_SecureChannel *channel) {
+    if(channel->state == UA_SECURECHANNELSTATE_CLOSED || !channel->connection ||
+       channel->nextSecurityToken.tokenId > 0)
+        return EXPIRY_DUE;
+    return channel->securityToken.createdAt +
+        (UA_DateTime)(channel->securityToken.revisedLifetime * UA_DATETIME_MSEC);
+}
 
 UA_StatusCode
 UA_SecureChannelManager_init(UA_SecureChannelManager *cm, UA_Server *server) {
     TAILQ_INIT(&cm->channels);
+    UA_HashIndex_init(&cm->channelsById);
+    ZIP_INIT(&cm->expiryTree);
     // TODO: use an ID that is likely to be unique after a restart
     cm->lastChannelId = STARTCHANNELID;
     cm->lastTokenId = STARTTOKENID;
@@ -35,13 +65,27 @@ UA_SecureChannelManager_deleteMembers(UA_SecureChannelManager *cm) {
     TAILQ_FOREACH_SAFE(entry, &cm->channels, pointers, temp) {
         TAILQ_REMOVE(&cm->channels, entry, pointers);
         UA_SecureChannel_close(&entry->channel);
+#ifdef UA_ENABLE_MULTITHREADING
+        UA_Server_sendPendingResponses(cm->server, entry);
+        pthread_mutex_destroy(&entry->pendingResponsesMutex);
+#endif
         UA_SecureChannel_deleteMembers(&entry->channel);
         UA_free(entry);
     }
+    UA_HashIndex_deleteMembers(&cm->channelsById);
 }
 
 static void
-removeSecureChannelCallback(void *_, channel_entry *entry) {
+removeSecureChannelCallback(UA_Server *server, channel_entry *entry) {
+#ifdef UA_ENABLE_MULTITHREADING
+    /* The workers that processed the last requests on the channel are done.
+     * Drop their responses. */
+    UA_Server_sendPendingResponses(server, entry);
+    UA_assert(SIMPLEQ_EMPTY(&entry->pendingResponses));
+    pthread_mutex_destroy(&entry->pendingResponsesMutex);
+#else
+    (void)server;
+#endif
     UA_SecureChannel_deleteMembers(&entry->channel);
 }
 
@@ -52,12 +96,15 @@ removeSecureChannel(UA_SecureChannelManager *cm, channel_entry *entry) {
 
     /* Detach the channel and make the capacity available */
     TAILQ_REMOVE(&cm->channels, entry, pointers);
+    UA_HashIndex_remove(&cm->channelsById, &entry->idEntry);
+    ZIP_REMOVE(UA_ChannelExpiryTree, &cm->expiryTree, entry);
+    entry->removed = true;
     UA_atomic_subUInt32(&cm->currentChannelCount, 1);
 
     /* Add a delayed callback to remove the channel when the currently
      * scheduled jobs have completed */
     entry->cleanupCallback.callback = (UA_ApplicationCallback)removeSecureChannelCallback;
-    entry->cleanupCallback.application = NULL;
+    entry->cleanupCallback.application = cm->server;
     entry->cleanupCallback.data = entry;
     UA_WorkQueue_enqueueDelayed(&cm->server->workQueue, &entry->cleanupCallback);
 }
@@ -66,8 +113,11 @@ removeSecureChannel(UA_SecureChannelManager *cm, channel_entry *entry) {
 void
 UA_SecureChannelManager_cleanupTimedOut(UA_SecureChannelManager *cm,
                                         UA_DateTime nowMonotonic) {
-    channel_entry *entry, *temp;
-    TAILQ_FOREACH_SAFE(entry, &cm->channels, pointers, temp) {
+    channel_entry *entry;
+    while((entry = ZIP_MIN(UA_ChannelExpiryTree, &cm->expiryTree))) {
+        if(entry->expiry >= nowMonotonic)
+            break;
+
         /* The channel was closed internally */
         if(entry->channel.state == UA_SECURECHANNELSTATE_CLOSED ||
            !entry->channel.connection) {
@@ -90,6 +140,14 @@ UA_SecureChannelManager_cleanupTimedOut(UA_SecureChannelManager *cm,
         if(entry->channel.nextSecurityToken.tokenId > 0) {
             UA_SecureChannel_revolveTokens(&entry->channel);
         }
+
+        /* Reinsert with the expiry of the current token */
+        ZIP_REMOVE(UA_ChannelExpiryTree, &cm->expiryTree, entry);
+        entry->expiry = channelExpiry(&entry->channel);
+        if(entry->expiry < nowMonotonic)
+            entry->expiry = nowMonotonic; /* Inspect again in the next cleanup */
+        ZIP_INSERT(UA_ChannelExpiryTree, &cm->expiryTree, entry,
+                   ZIP_RANK(entry, expiryEntry));
     }
 }
 
@@ -142,7 +200,14 @@ UA_SecureChannelManager_create(UA_SecureChannelManager *const cm, UA_Connection
         return retval;
     }
 
+#ifdef UA_ENABLE_MULTITHREADING
+    SIMPLEQ_INIT(&entry->pendingResponses);
+    pthread_mutex_init(&entry->pendingResponsesMutex, NULL);
+#endif
+
     /* Channel state is fresh (0) */
+    entry->idEntry.next = NULL;
+    entry->idEntry.hash = 0;
     entry->channel.securityToken.channelId = 0;
     entry->channel.securityToken.tokenId = cm->lastTokenId++;
     entry->channel.securityToken.createdAt = UA_DateTime_now();
@@ -151,6 +216,10 @@ UA_SecureChannelManager_create(UA_SecureChannelManager *const cm, UA_Connection
     TAILQ_INSERT_TAIL(&cm->channels, entry, pointers);
     UA_atomic_addUInt32(&cm->currentChannelCount, 1);
     UA_Connection_attachSecureChannel(connection, &entry->channel);
+    entry->removed = false;
+    entry->expiry = channelExpiry(&entry->channel);
+    ZIP_INSERT(UA_ChannelExpiryTree, &cm->expiryTree, entry,
+               ZIP_FFS32(UA_UInt32_random()));
     return UA_STATUSCODE_GOOD;
 }
 
@@ -174,6 +243,14 @@ UA_SecureChannelManager_open(UA_SecureChannelManager *cm, UA_SecureChannel *chan
     channel->securityToken.channelId = cm->lastChannelId++;
     channel->securityToken.createdAt = UA_DateTime_now();
 
+    /* Index by the channelId */
+    channel_entry *entry = container_of(channel, channel_entry, channel);
+    UA_StatusCode retval =
+        UA_HashIndex_insert(&cm->channelsById, &entry->idEntry,
+                            UA_HashIndex_hashUInt32(channel->securityToken.channelId));
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+
     /* Set the lifetime. Lifetime 0 -> set the maximum possible */
     channel->securityToken.revisedLifetime =
         (request->requestedLifetime > cm->server->config.maxSecurityTokenLifetime) ?
@@ -182,7 +259,7 @@ UA_SecureChannelManager_open(UA_SecureChannelManager *cm, UA_SecureChannel *chan
         channel->securityToken.revisedLifetime = cm->server->config.maxSecurityTokenLifetime;
 
     /* Set the nonces and generate the keys */
-    UA_StatusCode retval = UA_ByteString_copy(&request->clientNonce, &channel->remoteNonce);
+    retval = UA_ByteString_copy(&request->clientNonce, &channel->remoteNonce);
     if(retval != UA_STATUSCODE_GOOD)
         return retval;
 
@@ -208,6 +285,7 @@ UA_SecureChannelManager_open(UA_SecureChannelManager *cm, UA_SecureChannel *chan
 
     /* The channel is open */
     channel->state = UA_SECURECHANNELSTATE_OPEN;
+    UA_SecureChannelManager_updateExpiry(cm, channel);
 
     return UA_STATUSCODE_GOOD;
 }
@@ -256,29 +334,53 @@ UA_SecureChannelManager_renew(UA_SecureChannelManager *cm, UA_SecureChannel *cha
 
     /* Reset the internal creation date to the monotonic clock */
     channel->nextSecurityToken.createdAt = UA_DateTime_nowMonotonic();
+
+    /* Revolve the tokens in the next cleanup */
+    UA_SecureChannelManager_updateExpiry(cm, channel);
     return UA_STATUSCODE_GOOD;
 }
 
-UA_SecureChannel *
-UA_SecureChannelManager_get(UA_SecureChannelManager *cm, UA_UInt32 channelId) {
-    channel_entry *entry;
-    TAILQ_FOREACH(entry, &cm->channels, pointers) {
+static channel_entry *
+findChannel(UA_SecureChannelManager *cm, UA_UInt32 channelId) {
+    UA_UInt32 hash = UA_HashIndex_hashUInt32(channelId);
+    UA_HashIndexEntry *e = UA_HashIndex_first(&cm->channelsById, hash);
+    for(; e; e = UA_HashIndex_next(e, hash)) {
+        channel_entry *entry = container_of(e, channel_entry, idEntry);
         if(entry->channel.securityToken.channelId == channelId)
-            return &entry->channel;
+            return entry;
     }
     return NULL;
 }
 
+UA_SecureChannel *
+UA_SecureChannelManager_get(UA_SecureChannelManager *cm, UA_UInt32 channelId) {
+    channel_entry *entry = findChannel(cm, channelId);
+    if(!entry)
+        return NULL;
+    return &entry->channel;
+}
+
 UA_StatusCode
 UA_SecureChannelManager_close(UA_SecureChannelManager *cm, UA_UInt32 channelId) {
-    channel_entry *entry;
-    TAILQ_FOREACH(entry, &cm->channels, pointers) {
-        if(entry->channel.securityToken.channelId == channelId)
-            break;
-    }
+    channel_entry *entry = findChannel(cm, channelId);
     if(!entry)
         return UA_STATUSCODE_BADINTERNALERROR;
 
     removeSecureChannel(cm, entry);
     return UA_STATUSCODE_GOOD;
 }
+
+void
+UA_SecureChannelManager_updateExpiry(UA_SecureChannelManager *cm,
+                                     UA_SecureChannel *channel) {
+    channel_entry *entry = container_of(channel, channel_entry, channel);
+    if(entry->removed)
+        return;
+    UA_DateTime expiry = channelExpiry(channel);
+    if(expiry == entry->expiry)
+        return;
+    ZIP_REMOVE(UA_ChannelExpiryTree, &cm->expiryTree, entry);
+    entry->expiry = expiry;
+    ZIP_INSERT(UA_ChannelExpiryTree, &cm->expiryTree, entry,
+               ZIP_RANK(entry, expiryEntry));
+}
@@ -16,17 +16,42 @@
 #include "ua_workqueue.h"
 #include "ua_securechannel.h"
 #include "open62541_queue.h"
+#include "ziptree.h"
 
 _UA_BEGIN_DECLS
 
+#ifdef UA_ENABLE_MULTITHREADING
+/* Service requests that are processed by the worker threads. Defined in
+ * ua_server_binary.c. */
+struct UA_ServiceJob;
+#endif
+
 typedef struct channel_entry {
     UA_DelayedCallback cleanupCallback;
     TAILQ_ENTRY(channel_entry) pointers;
+    UA_HashIndexEntry idEntry; /* Hash of the channelId. Indexed once the
+                                * channel is opened. */
+    ZIP_ENTRY(channel_entry) expiryEntry; /* Ordered by the expiry */
+    UA_DateTime expiry; /* Monotonic time when the channel is next inspected
+                         * by the cleanup */
+    UA_Boolean removed;
     UA_SecureChannel channel;
+#ifdef UA_ENABLE_MULTITHREADING
+    /* Responses are sent in the order of the requests. Responses that are
+     * ready while the previous requests are still processed by the workers
+     * wait in the queue. Only the main thread sends on the channel. The
+     * workers take the mutex to mark their job as done. */
+    SIMPLEQ_HEAD(, UA_ServiceJob) pendingResponses;
+    pthread_mutex_t pendingResponsesMutex;
+#endif
 } channel_entry;
 
+ZIP_HEAD(UA_ChannelExpiryTree, channel_entry);
+
 typedef struct {
     TAILQ_HEAD(, channel_entry) channels; // doubly-linked list of channels
+    UA_HashIndex channelsById;
+    struct UA_ChannelExpiryTree expiryTree;
     UA_UInt32 currentChannelCount;
     UA_UInt32 lastChannelId;
     UA_UInt32 lastTokenId;
@@ -41,7 +66,8 @@ void
 UA_SecureChannelManager_deleteMembers(UA_SecureChannelManager *cm);
 
 /* Remove timed out securechannels with a delayed callback. So all currently
- * scheduled jobs with a pointer to a securechannel can finish first. */
+ * scheduled jobs with a pointer to a securechannel can finish first. Only the
+ * channels whose expiry has passed are visited. */
 void
 UA_SecureChannelManager_cleanupTimedOut(UA_SecureChannelManager *cm,
                                         UA_DateTime nowMonotonic);
@@ -67,6 +93,13 @@ UA_SecureChannelManager_get(UA_SecureChannelManager *cm, UA_UInt32 channelId);
 UA_StatusCode
 UA_SecureChannelManager_close(UA_SecureChannelManager *cm, UA_UInt32 channelId);
 
+/* Recompute the expiry after the channel was used. Channels that were closed,
+ * lost their connection or have a new token to revolve are due immediately.
+ * Does nothing if the channel was already removed. */
+void
+UA_SecureChannelManager_updateExpiry(UA_SecureChannelManager *cm,
+                                     UA_SecureChannel *channel);
+
 _UA_END_DECLS
 
 #endif /* UA_CHANNEL_MANAGER_H_ */
@@ -93,9 +93,7 @@ UA_Server_getNamespaceByName(UA_Server *server, const UA_String namespaceUri,
 UA_StatusCode
 UA_Server_forEachChildNodeCall(UA_Server *server, UA_NodeId parentNodeId,
                                UA_NodeIteratorCallback callback, void *handle) {
-    const UA_Node *parent =
-        server->config.nodestore.getNode(server->config.nodestore.context,
-                                         &parentNodeId);
+    const UA_Node *parent = UA_Nodestore_get(server, &parentNodeId);
     if(!parent)
         return UA_STATUSCODE_BADNODEIDINVALID;
 
@@ -108,7 +106,7 @@ UA_Server_forEachChildNodeCall(UA_Server *server, UA_NodeId parentNodeId,
      * */
     UA_Node *parentCopy = UA_Node_copy_alloc(parent);
     if(!parentCopy) {
-        server->config.nodestore.releaseNode(server->config.nodestore.context, parent);
+        UA_Nodestore_release(server, parent);
         return UA_STATUSCODE_BADUNEXPECTEDERROR;
     }
 
@@ -127,10 +125,133 @@ cleanup:
     UA_Node_deleteMembers(parentCopy);
     UA_free(parentCopy);
 
-    server->config.nodestore.releaseNode(server->config.nodestore.context, parent);
+    UA_Nodestore_release(server, parent);
     return retval;
 }
 
+/*****************/
+/* Retired Nodes */
+/*****************/
+
+static UA_Boolean
+workersRunning(UA_Server *server) {
+#ifdef UA_ENABLE_MULTITHREADING
+    return (server->workQueue.workersSize > 0);
+#else
+    return false;
+#endif
+}
+
+/* The workers hold nodes only during the execution of a callback. They are
+ * protected by the epochs of the work queue. The other threads (i.e. the main
+ * thread) count the nodes they hold. Also while the workers run. So that a node
+ * taken before and released after UA_Server_run_startup or
+ * UA_Server_run_shutdown is counted correctly. */
+static UA_Boolean
+countNodesInUse(UA_Server *server) {
+#ifdef UA_ENABLE_MULTITHREADING
+    return !UA_WorkQueue_isWorker(&server->workQueue);
+#else
+    return true;
+#endif
+}
+
+const UA_Node *
+UA_Nodestore_get(UA_Server *server, const UA_NodeId *nodeId) {
+    const UA_Node *node =
+        server->config.nodestore.getNode(server->config.nodestore.context, nodeId);
+    if(node && countNodesInUse(server))
+        server->nodesInUse++;
+    return node;
+}
+
+/* Removed and replaced nodes can still be read by a parallel worker. They are
+ * deleted with a delayed callback. Without running workers, only the current
+ * thread can hold nodes. Then the retired nodes are deleted as soon as no node
+ * is held. So they don't pile up during the setup (e.g. loading nodesets)
+ * where the delayed callbacks are not processed. */
+static void
+queueRetiredNode(UA_Server *server, UA_Node *node) {
+    UA_DelayedCallback *dc = (UA_DelayedCallback*)UA_malloc(sizeof(UA_DelayedCallback));
+    if(!dc) {
+        UA_Nodestore_delete(server, node); /* Delete immediately if the memory
+                                            * could not be allocated */
+        return;
+    }
+    dc->callback = NULL;
+    dc->application = server;
+    dc->data = node;
+    SIMPLEQ_INSERT_TAIL(&server->retiredNodes, dc, next);
+}
+
+/* The delayed callbacks are also executed after the workers have stopped (in
+ * UA_WorkQueue_cleanup). Then the node is kept while the main thread still
+ * holds nodes. */
+static void
+deleteRetiredNode(UA_Server *server, UA_Node *node) {
+    if(server->nodesInUse > 0 && !workersRunning(server))
+        queueRetiredNode(server, node);
+    else
+        UA_Nodestore_delete(server, node);
+}
+
+static void
+deleteRetiredNodes(UA_Server *server) {
+    UA_DelayedCallback *dc;
+    while((dc = SIMPLEQ_FIRST(&server->retiredNodes))) {
+        SIMPLEQ_REMOVE_HEAD(&server->retiredNodes, next);
+        UA_Nodestore_delete(server, (UA_Node*)dc->data);
+        UA_free(dc);
+    }
+}
+
+void
+UA_Nodestore_release(UA_Server *server, const UA_Node *node) {
+    server->config.nodestore.releaseNode(server->config.nodestore.context, node);
+    if(!node || !countNodesInUse(server))
+        return;
+    UA_assert(server->nodesInUse > 0);
+    server->nodesInUse--;
+    if(server->nodesInUse == 0 && !workersRunning(server))
+        deleteRetiredNodes(server);
+}
+
+static void
+retireNode(UA_Server *server, UA_Node *node) {
+    if(!workersRunning(server)) {
+        if(server->nodesInUse == 0)
+            UA_Nodestore_delete(server, node);
+        else
+            queueRetiredNode(server, node);
+        return;
+    }
+
+    UA_DelayedCallback *dc = (UA_DelayedCallback*)UA_malloc(sizeof(UA_DelayedCallback));
+    if(!dc) {
+        UA_Nodestore_delete(server, node); /* Delete immediately if the memory
+                                            * could not be allocated */
+        return;
+    }
+    dc->callback = (UA_ApplicationCallback)deleteRetiredNode;
+    dc->application = server;
+    dc->data = node;
+    UA_WorkQueue_enqueueDelayed(&server->workQueue, dc);
+}
+
+#ifdef UA_ENABLE_MULTITHREADING
+/* Nodes retired before the workers started are handed to the work queue.
+ * Otherwise they would wait until the workers are stopped again. */
+static void
+flushRetiredNodes(UA_Server *server) {
+    UA_DelayedCallback *dc;
+    while((dc = SIMPLEQ_FIRST(&server->retiredNodes))) {
+        SIMPLEQ_REMOVE_HEAD(&server->retiredNodes, next);
+        dc->callback = (UA_ApplicationCallback)deleteRetiredNode;
+        UA_WorkQueue_enqueueDelayed(&server->workQueue, dc);
+    }
+}
+#endif
+
 /********************/
 /* Server Lifecycle */
 /********************/
@@ -161,16 +282,22 @@ void UA_Server_delete(UA_Server *server) {
     /* Clean up the Admin Session */
     UA_Session_deleteMembersCleanup(&server->adminSession, server);
 
+    /* Delete the subtype closure */
+    UA_SubtypeClosure_delete(server->subtypes);
+
     /* Clean up the work queue */
     UA_WorkQueue_cleanup(&server->workQueue);
+    deleteRetiredNodes(server);
 
     /* Delete the timed work */
     UA_Timer_deleteMembers(&server->timer);
+    UA_Timer_deleteMembers(&server->internalTimer);
 
     /* Delete the server itself */
     UA_free(server);
 }
 
+
 /* Recurring cleanup. Removing unused and timed-out channels and sessions */
 static void
 UA_Server_cleanup(UA_Server *server, void *_) {
@@ -211,8 +338,18 @@ UA_Server_new(const UA_ServerConfig *config) {
 
     /* Initialize the handling of repeated callbacks */
     UA_Timer_init(&server->timer);
+    UA_Timer_init(&server->internalTimer);
 
     UA_WorkQueue_init(&server->workQueue);
+    SIMPLEQ_INIT(&server->retiredNodes);
+
+    /* The subtype closure is built on demand */
+    server->subtypes = UA_SubtypeClosure_new();
+
+    /* Retire removed and replaced nodes to the work queue */
+    if(server->config.nodestore.setRetireCallback)
+        server->config.nodestore.setRetireCallback(server->config.nodestore.context, server,
+                                                   (UA_NodestoreRetireCallback)retireNode);
 
     /* Initialize the adminSession */
     UA_Session_init(&server->adminSession);
@@ -230,9 +367,11 @@ UA_Server_new(const UA_ServerConfig *config) {
     UA_SecureChannelManager_init(&server->secureChannelManager, server);
     UA_SessionManager_init(&server->sessionManager, server);
 
-    /* Add a regular callback for cleanup and maintenance. With a 10s interval. */
-    UA_Server_addRepeatedCallback(server, (UA_ServerCallback)UA_Server_cleanup, NULL,
-                                  10000.0, NULL);
+    /* Add a regular callback for cleanup and maintenance. With a 10s interval.
+     * The expiry trees are also updated when messages arrive. So the cleanup
+     * runs on the internal timer in the main thread. */
+    UA_Server_addRepeatedCallbackInternal(server, (UA_ServerCallback)UA_Server_cleanup,
+                                          NULL, 10000.0, NULL);
 
     /* Initialized discovery */
 #ifdef UA_ENABLE_DISCOVERY
@@ -291,6 +430,27 @@ UA_Server_removeCallback(UA_Server *server, UA_UInt64 callbackId) {
     UA_Timer_removeCallback(&server->timer, callbackId);
 }
 
+UA_StatusCode
+UA_Server_addRepeatedCallbackInternal(UA_Server *server, UA_ServerCallback callback,
+                                      void *data, UA_Double interval_ms,
+                                      UA_UInt64 *callbackId) {
+    return UA_Timer_addRepeatedCallback(&server->internalTimer,
+                                        (UA_ApplicationCallback)callback,
+                                        server, data, interval_ms, callbackId);
+}
+
+UA_StatusCode
+UA_Server_changeRepeatedCallbackIntervalInternal(UA_Server *server, UA_UInt64 callbackId,
+                                                 UA_Double interval_ms) {
+    return UA_Timer_changeRepeatedCallbackInterval(&server->internalTimer, callbackId,
+                                                   interval_ms);
+}
+
+void
+UA_Server_removeRepeatedCallbackInternal(UA_Server *server, UA_UInt64 callbackId) {
+    UA_Timer_removeCallback(&server->internalTimer, callbackId);
+}
+
 UA_StatusCode UA_EXPORT
 UA_Server_updateCertificate(UA_Server *server,
                             const UA_ByteString *oldCertificate,
@@ -403,6 +563,7 @@ UA_Server_run_startup(UA_Server *server) {
     UA_LOG_INFO(&server->config.logger, UA_LOGCATEGORY_SERVER,
                 "Spinning up %u worker thread(s)", server->config.nThreads);
     UA_WorkQueue_start(&server->workQueue, server->config.nThreads);
+    flushRetiredNodes(server);
 #endif
 
     /* Start the multicast discovery server */
@@ -425,12 +586,34 @@ serverExecuteRepeatedCallback(UA_Server *server, UA_ApplicationCallback cb,
 #endif
 }
 
+static void
+serverExecuteInternalCallback(UA_Server *server, UA_ApplicationCallback cb,
+                              void *callbackApplication, void *data) {
+    cb(callbackApplication, data);
+}
+
+#ifdef UA_ENABLE_MULTITHREADING
+/* Send the responses that were finished by the workers */
+static void
+sendFinishedResponses(UA_Server *server) {
+    if(server->pendingResponsesSize == 0)
+        return;
+    channel_entry *entry;
+    TAILQ_FOREACH(entry, &server->secureChannelManager.channels, pointers)
+        UA_Server_sendPendingResponses(server, entry);
+}
+#endif
+
 UA_UInt16
 UA_Server_run_iterate(UA_Server *server, UA_Boolean waitInternal) {
     /* Process repeated work */
     UA_DateTime now = UA_DateTime_nowMonotonic();
     UA_DateTime nextRepeated = UA_Timer_process(&server->timer, now,
                      (UA_TimerExecutionCallback)serverExecuteRepeatedCallback, server);
+    UA_DateTime nextInternal = UA_Timer_process(&server->internalTimer, now,
+                     (UA_TimerExecutionCallback)serverExecuteInternalCallback, server);
+    if(nextInternal < nextRepeated)
+        nextRepeated = nextInternal;
     UA_DateTime latest = now + (UA_MAXTIMEOUT * UA_DATETIME_MSEC);
     if(nextRepeated > latest)
         nextRepeated = latest;
@@ -442,6 +625,14 @@ UA_Server_run_iterate(UA_Server *server, UA_Boolean waitInternal) {
     if(waitInternal)
         timeout = (UA_UInt16)(((nextRepeated - now) + (UA_DATETIME_MSEC - 1)) / UA_DATETIME_MSEC);
 
+#ifdef UA_ENABLE_MULTITHREADING
+    /* Don't block in the network layer while the workers process requests.
+     * Their responses are sent from here. */
+    sendFinishedResponses(server);
+    if(server->pendingResponsesSize > 0)
+        timeout = 0;
+#endif
+
     /* Listen on the networklayer */
     for(size_t i = 0; i < server->config.networkLayersSize; ++i) {
         UA_ServerNetworkLayer *nl = &server->config.networkLayers[i];
@@ -465,12 +656,21 @@ UA_Server_run_iterate(UA_Server *server, UA_Boolean waitInternal) {
 
 #ifndef UA_ENABLE_MULTITHREADING
     UA_WorkQueue_manuallyProcessDelayed(&server->workQueue);
+#else
+    sendFinishedResponses(server);
+
+    /* The main thread holds no pointers to retired memory between iterations */
+    UA_WorkQueue_quiescent(&server->workQueue);
 #endif
 
     now = UA_DateTime_nowMonotonic();
     timeout = 0;
     if(nextRepeated > now)
         timeout = (UA_UInt16)((nextRepeated - now) / UA_DATETIME_MSEC);
+#ifdef UA_ENABLE_MULTITHREADING
+    if(server->pendingResponsesSize > 0)
+        timeout = 0;
+#endif
     return timeout;
 }
 
@@ -40,10 +40,173 @@ void UA_debug_dumpCompleteChunk(UA_Server *const server, UA_Connection *const co
 /* Helper Functions */
 /********************/
 
+#ifdef UA_ENABLE_MULTITHREADING
+
+/* A request processed in a worker thread or a response that waits for the
+ * responses to earlier requests on the same SecureChannel. Pending jobs are
+ * kept in the channel_entry in the order of the requests. */
+struct UA_ServiceJob {
+    SIMPLEQ_ENTRY(UA_ServiceJob) next;
+    channel_entry *entry;
+    UA_Session *session;
+    UA_Service service;
+    UA_UInt32 requestId;
+    const UA_DataType *requestType;
+    const UA_DataType *responseType;
+    void *request; /* NULL if the response was queued after processing */
+    void *response;
+    UA_Boolean done; /* The response can be sent */
+};
+typedef struct UA_ServiceJob UA_ServiceJob;
+
+static void
+deleteServiceJob(UA_ServiceJob *job) {
+    if(job->request)
+        UA_delete(job->request, job->requestType);
+    if(job->response)
+        UA_delete(job->response, job->responseType);
+    UA_free(job);
+}
+
+/* Move the response into a new job at the end of the queue. Call only from the
+ * main thread with the pendingResponses mutex held. */
+static UA_StatusCode
+queueResponse(UA_Server *server, channel_entry *entry, UA_UInt32 requestId,
+              void *response, const UA_DataType *responseType) {
+    UA_ServiceJob *job = (UA_ServiceJob*)UA_calloc(1, sizeof(UA_ServiceJob));
+    if(!job)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    job->response = UA_malloc(responseType->memSize);
+    if(!job->response) {
+        UA_free(job);
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    }
+    memcpy(job->response, response, responseType->memSize);
+    UA_init(response, responseType);
+    job->entry = entry;
+    job->requestId = requestId;
+    job->responseType = responseType;
+    job->done = true;
+    SIMPLEQ_INSERT_TAIL(&entry->pendingResponses, job, next);
+    server->pendingResponsesSize++;
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Send the finished responses from the head of the queue */
+void
+UA_Server_sendPendingResponses(UA_Server *server, channel_entry *entry) {
+    pthread_mutex_lock(&entry->pendingResponsesMutex);
+    UA_ServiceJob *job;
+    while((job = SIMPLEQ_FIRST(&entry->pendingResponses)) && job->done) {
+        SIMPLEQ_REMOVE_HEAD(&entry->pendingResponses, next);
+        server->pendingResponsesSize--;
+        /* Drop the response if the channel was closed in the meantime */
+        if(entry->channel.state != UA_SECURECHANNELSTATE_CLOSED) {
+            UA_StatusCode retval =
+                UA_SecureChannel_sendSymmetricMessage(&entry->channel, job->requestId,
+                                                      UA_MESSAGETYPE_MSG, job->response,
+                                                      job->responseType);
+            if(retval != UA_STATUSCODE_GOOD)
+                UA_LOG_INFO_CHANNEL(&server->config.logger, &entry->channel,
+                                    "Could not send the message over the SecureChannel "
+                                    "with StatusCode %s", UA_StatusCode_name(retval));
+        }
+        deleteServiceJob(job);
+    }
+    pthread_mutex_unlock(&entry->pendingResponsesMutex);
+}
+
+/* Executed in a worker thread. The response is sent by the main thread. */
+static void
+processServiceJob(UA_Server *server, UA_ServiceJob *job) {
+    job->service(server, job->session, job->request, job->response);
+    ((UA_ResponseHeader*)job->response)->timestamp = UA_DateTime_now();
+    pthread_mutex_lock(&job->entry->pendingResponsesMutex);
+    job->done = true;
+    pthread_mutex_unlock(&job->entry->pendingResponsesMutex);
+}
+
+/* Services that only read from the information model. They are processed in
+ * parallel by the worker threads. */
+static UA_Boolean
+isParallelService(const UA_DataType *requestType) {
+    return (requestType == &UA_TYPES[UA_TYPES_READREQUEST] ||
+            requestType == &UA_TYPES[UA_TYPES_BROWSEREQUEST] ||
+            requestType == &UA_TYPES[UA_TYPES_BROWSENEXTREQUEST] ||
+            requestType == &UA_TYPES[UA_TYPES_TRANSLATEBROWSEPATHSTONODEIDSREQUEST]);
+}
+
+/* Move the decoded request and the prepared response into a job for the
+ * workers. The position in the queue of the channel is reserved right away. */
+static UA_StatusCode
+dispatchService(UA_Server *server, UA_SecureChannel *channel, UA_Session *session,
+                UA_UInt32 requestId, UA_Service service,
+                void *request, const UA_DataType *requestType,
+                void *response, const UA_DataType *responseType) {
+    /* Read is processed in-situ otherwise. The worker cannot encode into the
+     * message before the earlier responses are sent. */
+    if(requestType == &UA_TYPES[UA_TYPES_READREQUEST])
+        service = (UA_Service)Service_ReadBuffered;
+
+    UA_ServiceJob *job = (UA_ServiceJob*)UA_calloc(1, sizeof(UA_ServiceJob));
+    if(!job)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    job->request = UA_malloc(requestType->memSize);
+    job->response = UA_malloc(responseType->memSize);
+    if(!job->request || !job->response) {
+        UA_free(job->request);
+        UA_free(job->response);
+        UA_free(job);
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    }
+    memcpy(job->request, request, requestType->memSize);
+    memcpy(job->response, response, responseType->memSize);
+    job->entry = container_of(channel, channel_entry, channel);
+    job->session = session;
+    job->service = service;
+    job->requestId = requestId;
+    job->requestType = requestType;
+    job->responseType = responseType;
+
+    pthread_mutex_lock(&job->entry->pendingResponsesMutex);
+    SIMPLEQ_INSERT_TAIL(&job->entry->pendingResponses, job, next);
+    pthread_mutex_unlock(&job->entry->pendingResponsesMutex);
+    server->pendingResponsesSize++;
+
+    UA_WorkQueue_enqueue(&server->workQueue,
+                         (UA_ApplicationCallback)processServiceJob, server, job);
+    return UA_STATUSCODE_GOOD;
+}
+
+#endif
+
+/* Send the response. With multithreading, the response is queued if the
+ * responses to earlier requests are not yet sent. */
+static UA_StatusCode
+sendResponse(UA_Server *server, UA_SecureChannel *channel, UA_UInt32 requestId,
+             void *response, const UA_DataType *responseType) {
+#ifndef UA_ENABLE_MULTITHREADING
+    (void)server;
+    return UA_SecureChannel_sendSymmetricMessage(channel, requestId, UA_MESSAGETYPE_MSG,
+                                                 response, responseType);
+#else
+    channel_entry *entry = container_of(channel, channel_entry, channel);
+    UA_StatusCode retval;
+    pthread_mutex_lock(&entry->pendingResponsesMutex);
+    if(SIMPLEQ_EMPTY(&entry->pendingResponses))
+        retval = UA_SecureChannel_sendSymmetricMessage(channel, requestId, UA_MESSAGETYPE_MSG,
+                                                       response, responseType);
+    else
+        retval = queueResponse(server, entry, requestId, response, responseType);
+    pthread_mutex_unlock(&entry->pendingResponsesMutex);
+    return retval;
+#endif
+}
+
  /* This is not an ERR message, the connection is not closed afterwards */
 static UA_StatusCode
-sendServiceFault(UA_SecureChannel *channel, const UA_ByteString *msg,
-                 size_t offset, const UA_DataType *responseType,
+sendServiceFault(UA_Server *server, UA_SecureChannel *channel,
+                 const UA_ByteString *msg, size_t offset, const UA_DataType *responseType,
                  UA_UInt32 requestId, UA_StatusCode error) {
     UA_RequestHeader requestHeader;
     UA_StatusCode retval = UA_RequestHeader_decodeBinary(msg, &offset, &requestHeader);
@@ -57,8 +220,7 @@ sendServiceFault(UA_SecureChannel *channel, const UA_ByteString *msg,
     responseHeader->serviceResult = error;
 
     // Send error message. Message type is MSG and not ERR, since we are on a securechannel!
-    retval = UA_SecureChannel_sendSymmetricMessage(channel, requestId, UA_MESSAGETYPE_MSG,
-                                                   response, responseType);
+    retval = sendResponse(server, channel, requestId, response, responseType);
 
     UA_RequestHeader_deleteMembers(&requestHeader);
     UA_LOG_DEBUG(channel->securityPolicy->logger, UA_LOGCATEGORY_SERVER,
@@ -436,8 +598,9 @@ processMSG(UA_Server *server, UA_SecureChannel *channel,
                                 "Unknown request with type identifier %i",
                                 requestTypeId.identifier.numeric);
         }
-        return sendServiceFault(channel, msg, requestPos, &UA_TYPES[UA_TYPES_SERVICEFAULT],
-                                requestId, UA_STATUSCODE_BADSERVICEUNSUPPORTED);
+        return sendServiceFault(server, channel, msg, requestPos,
+                                &UA_TYPES[UA_TYPES_SERVICEFAULT], requestId,
+                                UA_STATUSCODE_BADSERVICEUNSUPPORTED);
     }
     UA_assert(responseType);
 
@@ -448,7 +611,8 @@ processMSG(UA_Server *server, UA_SecureChannel *channel,
     if(retval != UA_STATUSCODE_GOOD) {
         UA_LOG_DEBUG_CHANNEL(&server->config.logger, channel,
                              "Could not decode the request");
-        return sendServiceFault(channel, msg, requestPos, responseType, requestId, retval);
+        return sendServiceFault(server, channel, msg, requestPos, responseType,
+                                requestId, retval);
     }
 
     /* Prepare the respone */
@@ -490,7 +654,7 @@ processMSG(UA_Server *server, UA_SecureChannel *channel,
                                  "Trying to activate a session that is " \
                                  "not known in the server");
             UA_deleteMembers(request, requestType);
-            return sendServiceFault(channel, msg, requestPos, responseType,
+            return sendServiceFault(server, channel, msg, requestPos, responseType,
                                     requestId, UA_STATUSCODE_BADSESSIONIDINVALID);
         }
         Service_ActivateSession(server, channel, session,
@@ -507,7 +671,7 @@ processMSG(UA_Server *server, UA_SecureChannel *channel,
                                    "Service request %i without a valid session",
                                    requestType->binaryEncodingId);
             UA_deleteMembers(request, requestType);
-            return sendServiceFault(channel, msg, requestPos, responseType,
+            return sendServiceFault(server, channel, msg, requestPos, responseType,
                                     requestId, UA_STATUSCODE_BADSESSIONIDINVALID);
         }
 
@@ -525,7 +689,7 @@ processMSG(UA_Server *server, UA_SecureChannel *channel,
         UA_SessionManager_removeSession(&server->sessionManager,
                                         &session->header.authenticationToken);
         UA_deleteMembers(request, requestType);
-        return sendServiceFault(channel, msg, requestPos, responseType,
+        return sendServiceFault(server, channel, msg, requestPos, responseType,
                                 requestId, UA_STATUSCODE_BADSESSIONNOTACTIVATED);
     }
 
@@ -535,12 +699,15 @@ processMSG(UA_Server *server, UA_SecureChannel *channel,
                                "Client tries to use a Session that is not "
                                "bound to this SecureChannel");
         UA_deleteMembers(request, requestType);
-        return sendServiceFault(channel, msg, requestPos, responseType,
+        return sendServiceFault(server, channel, msg, requestPos, responseType,
                                 requestId, UA_STATUSCODE_BADSECURECHANNELIDINVALID);
     }
 
     /* Update the session lifetime */
-    UA_Session_updateLifetime(session);
+    if(session == &anonymousSession)
+        UA_Session_updateLifetime(session);
+    else
+        UA_SessionManager_updateLifetime(&server->sessionManager, session);
 
 #ifdef UA_ENABLE_SUBSCRIPTIONS
     /* The publish request is not answered immediately */
@@ -558,6 +725,17 @@ processMSG(UA_Server *server, UA_SecureChannel *channel,
     ((UA_ResponseHeader*)response)->requestHandle = requestHeader->requestHandle;
     ((UA_ResponseHeader*)response)->timestamp = UA_DateTime_now();
 
+#ifdef UA_ENABLE_MULTITHREADING
+    /* Process read-only services in the worker threads. The request and the
+     * response are moved into the job. Processed in the current thread if the
+     * job could not be created. */
+    if(server->workQueue.workersSize > 0 && isParallelService(requestType) &&
+       session != &anonymousSession &&
+       dispatchService(server, channel, session, requestId, service,
+                       request, requestType, response, responseType) == UA_STATUSCODE_GOOD)
+        return UA_STATUSCODE_GOOD;
+#endif
+
     /* Process normal services before initializing the message context.
      * Some services may initialize new message contexts and to support network
      * layers only providing one send buffer, only one message context can be
@@ -565,6 +743,22 @@ processMSG(UA_Server *server, UA_SecureChannel *channel,
     if(serviceType == UA_SERVICETYPE_NORMAL)
         service(server, session, request, response);
 
+#ifdef UA_ENABLE_MULTITHREADING
+    /* Responses to earlier requests are not yet sent. Queue the response. */
+    channel_entry *entry = container_of(channel, channel_entry, channel);
+    pthread_mutex_lock(&entry->pendingResponsesMutex);
+    if(!SIMPLEQ_EMPTY(&entry->pendingResponses)) {
+        if(serviceType == UA_SERVICETYPE_INSITU)
+            Service_ReadBuffered(server, session, (const UA_ReadRequest*)request,
+                                 (UA_ReadResponse*)response);
+        retval = queueResponse(server, entry, requestId, response, responseType);
+        pthread_mutex_unlock(&entry->pendingResponsesMutex);
+        UA_deleteMembers(request, requestType);
+        UA_deleteMembers(response, responseType);
+        return retval;
+    }
+#endif
+
     /* Start the message */
     UA_NodeId typeId = UA_NODEID_NUMERIC(0, responseType->binaryEncodingId);
     UA_MessageContext mc;
@@ -604,6 +798,9 @@ processMSG(UA_Server *server, UA_SecureChannel *channel,
     retval = UA_MessageContext_finish(&mc);
 
  cleanup:
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_unlock(&entry->pendingResponsesMutex);
+#endif
     if(retval != UA_STATUSCODE_GOOD)
         UA_LOG_INFO_CHANNEL(&server->config.logger, channel,
                             "Could not send the message over the SecureChannel "
@@ -734,12 +931,13 @@ processCompleteChunkWithoutChannel(UA_Server *server, UA_Connection *connection,
         if(retval != UA_STATUSCODE_GOOD)
             break;
 
-        retval = UA_SecureChannel_decryptAddChunk(connection->channel, message, false);
-        if(retval != UA_STATUSCODE_GOOD)
-            break;
-
-        UA_SecureChannel_processCompleteMessages(connection->channel, server,
-                                                 processSecureChannelMessage);
+        /* The channel is detached from the connection if it is closed */
+        UA_SecureChannel *channel = connection->channel;
+        retval = UA_SecureChannel_decryptAddChunk(channel, message, false);
+        if(retval == UA_STATUSCODE_GOOD)
+            UA_SecureChannel_processCompleteMessages(channel, server,
+                                                     processSecureChannelMessage);
+        UA_SecureChannelManager_updateExpiry(&server->secureChannelManager, channel);
         break;
     }
     default:
@@ -761,7 +959,12 @@ processCompleteChunk(void *const application, UA_Connection *connection,
 #endif
     if(!connection->channel)
         return processCompleteChunkWithoutChannel(server, connection, chunk);
-    return UA_SecureChannel_decryptAddChunk(connection->channel, chunk, false);
+
+    /* Decrypting can revolve the tokens or close the channel */
+    UA_SecureChannel *channel = connection->channel;
+    UA_StatusCode retval = UA_SecureChannel_decryptAddChunk(channel, chunk, false);
+    UA_SecureChannelManager_updateExpiry(&server->secureChannelManager, channel);
+    return retval;
 }
 
 void
@@ -794,6 +997,7 @@ UA_Server_processBinaryMessage(UA_Server *server, UA_Connection *connection,
 
     /* Process complete messages */
     UA_SecureChannel_processCompleteMessages(channel, server, processSecureChannelMessage);
+    UA_SecureChannelManager_updateExpiry(&server->secureChannelManager, channel);
 
     /* Is the channel still open? */
     if(channel->state == UA_SECURECHANNELSTATE_CLOSED)
@@ -812,7 +1016,11 @@ deleteConnection(UA_Server *server, UA_Connection *connection) {
 
 void
 UA_Server_removeConnection(UA_Server *server, UA_Connection *connection) {
+    /* The channel is removed in the next cleanup */
+    UA_SecureChannel *channel = connection->channel;
     UA_Connection_detachSecureChannel(connection);
+    if(channel)
+        UA_SecureChannelManager_updateExpiry(&server->secureChannelManager, channel);
 #ifndef UA_ENABLE_MULTITHREADING
     connection->free(connection);
 #else
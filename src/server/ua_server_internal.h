@@ -47,6 +47,11 @@ typedef struct {
 
 #endif
 
+/* Transitive closure of the HasSubtype references in the type hierarchies of
+ * namespace zero. See ua_server_subtypes.c. */
+struct UA_SubtypeClosure;
+typedef struct UA_SubtypeClosure UA_SubtypeClosure;
+
 struct UA_Server {
     /* Config */
     UA_ServerConfig config;
@@ -66,13 +71,32 @@ struct UA_Server {
     /* Callbacks with a repetition interval */
     UA_Timer timer;
 
+    /* Callbacks of the server itself (e.g. the publish cycle of the
+     * Subscriptions). They modify state that is shared with the processing of
+     * the network messages. With multithreading, they are executed in the main
+     * thread and not dispatched to the workers. */
+    UA_Timer internalTimer;
+
     /* WorkQueue and worker threads */
     UA_WorkQueue workQueue;
 
+    /* Nodes taken from the nodestore and not yet released outside of the
+     * worker threads. Without running workers, the nodes retired in the
+     * meantime are deleted when the last node is released. */
+    size_t nodesInUse;
+    SIMPLEQ_HEAD(, UA_DelayedCallback) retiredNodes;
+#ifdef UA_ENABLE_MULTITHREADING
+    size_t pendingResponsesSize; /* Responses queued on all SecureChannels.
+                                  * Accessed only by the main thread. */
+#endif
+
     /* For bootstrapping, omit some consistency checks, creating a reference to
      * the parent and member instantiation */
     UA_Boolean bootstrapNS0;
 
+    /* Subtype checks */
+    UA_SubtypeClosure *subtypes;
+
     /* Discovery */
 #ifdef UA_ENABLE_DISCOVERY
     UA_DiscoveryManager discoveryManager;
@@ -83,6 +107,12 @@ struct UA_Server {
     /* To be cast to UA_LocalMonitoredItem to get the callback and context */
     LIST_HEAD(LocalMonitoredItems, UA_MonitoredItem) localMonitoredItems;
     UA_UInt32 lastLocalMonitoredItemId;
+
+    /* MonitoredItems sampled with the same interval. Created on demand and
+     * removed when the last MonitoredItem leaves. */
+    LIST_HEAD(SamplingGroups, UA_SamplingGroup) samplingGroups;
+    UA_SamplingGroup *reportByExceptionGroup; /* Sampling interval zero. Also
+                                               * in the list. */
 #endif
 
     /* Publish/Subscribe */
@@ -91,15 +121,41 @@ struct UA_Server {
 #endif
 };
 
+/**********************/
+/* Internal Callbacks */
+/**********************/
+
+/* Repeated callbacks on the internalTimer. The ids are distinct from the
+ * callbacks added with the public API. */
+UA_StatusCode
+UA_Server_addRepeatedCallbackInternal(UA_Server *server, UA_ServerCallback callback,
+                                      void *data, UA_Double interval_ms,
+                                      UA_UInt64 *callbackId);
+
+UA_StatusCode
+UA_Server_changeRepeatedCallbackIntervalInternal(UA_Server *server, UA_UInt64 callbackId,
+                                                 UA_Double interval_ms);
+
+void UA_Server_removeRepeatedCallbackInternal(UA_Server *server, UA_UInt64 callbackId);
+
+#ifdef UA_ENABLE_MULTITHREADING
+/* The workers do not send. The finished responses are sent from the main
+ * thread in the order of the requests on the SecureChannel. The responses for
+ * a closed channel are dropped. */
+void UA_Server_sendPendingResponses(UA_Server *server, channel_entry *entry);
+#endif
+
 /*****************/
 /* Node Handling */
 /*****************/
 
-#define UA_Nodestore_get(SERVER, NODEID)                                \
-    (SERVER)->config.nodestore.getNode((SERVER)->config.nodestore.context, NODEID)
+/* Get and release count the nodes held outside of the worker threads. Without
+ * running workers, retired nodes are deleted as soon as no node is held. */
+const UA_Node *
+UA_Nodestore_get(UA_Server *server, const UA_NodeId *nodeId);
 
-#define UA_Nodestore_release(SERVER, NODEID)                            \
-    (SERVER)->config.nodestore.releaseNode((SERVER)->config.nodestore.context, NODEID)
+void
+UA_Nodestore_release(UA_Server *server, const UA_Node *node);
 
 #define UA_Nodestore_new(SERVER, NODECLASS)                               \
     (SERVER)->config.nodestore.newNode((SERVER)->config.nodestore.context, NODECLASS)
@@ -151,6 +207,27 @@ isNodeInTree(UA_Nodestore *ns, const UA_NodeId *leafNode,
              const UA_NodeId *nodeToFind, const UA_NodeId *referenceTypeIds,
              size_t referenceTypeIdsSize);
 
+/* Returns whether the type equals the superType or is a transitive subtype.
+ * Same as isNodeInTree for the HasSubtype references, but answered from the
+ * subtype closure in constant time if the type is contained. */
+UA_Boolean
+isSubtypeOf(UA_Server *server, const UA_NodeId *type, const UA_NodeId *superType);
+
+/* Returns NULL if out of memory. Then the subtype checks fall back to
+ * isNodeInTree. */
+UA_SubtypeClosure * UA_SubtypeClosure_new(void);
+void UA_SubtypeClosure_delete(UA_SubtypeClosure *sc);
+
+/* Call after a HasSubtype reference was added. Extends the closure if the
+ * subtype is a new leaf type below a contained supertype. Otherwise the
+ * closure is invalidated. */
+void
+UA_SubtypeClosure_addSubtype(UA_Server *server, const UA_NodeId *subtype,
+                             const UA_NodeId *superType);
+
+/* Call after a HasSubtype reference or a type node was removed */
+void UA_SubtypeClosure_invalidate(UA_SubtypeClosure *sc);
+
 /* Returns an array with the hierarchy of type nodes. The returned array starts
  * at the leaf and continues "upwards" or "downwards" in the hierarchy based on the
  * ``hasSubType`` references. Since multiple-inheritance is possible in general,
@@ -215,6 +292,12 @@ UA_StatusCode
 readValueAttribute(UA_Server *server, UA_Session *session,
                    const UA_VariableNode *vn, UA_DataValue *v);
 
+/* Check whether the session may read the attribute. Only the value attribute
+ * of VariableNodes is restricted via the (User)AccessLevel. */
+UA_StatusCode
+checkReadAccess(UA_Server *server, UA_Session *session,
+                const UA_Node *node, UA_UInt32 attributeId);
+
 /* Test whether the value matches a variable definition given by
  * - datatype
  * - valueranke
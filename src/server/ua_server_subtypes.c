@@ -0,0 +1,373 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ *    Copyright 2018 (c) Fraunhofer IOSB (Author: Julius Pfrommer)
+ */
+
+#include "ua_server_internal.h"
+
+/* Subtype checks may run in parallel worker threads (e.g. during Browse).
+ * Rebuilding and extending the closure takes the lock exclusively. The
+ * HasSubtype references are edited before the closure is updated. So a rebuild
+ * that runs in parallel to the edit is always followed by the update. */
+#ifdef UA_ENABLE_MULTITHREADING
+#define BEGIN_READSECT(SC) pthread_rwlock_rdlock(&(SC)->lock)
+#define BEGIN_CRITSECT(SC) pthread_rwlock_wrlock(&(SC)->lock)
+#define END_CRITSECT(SC) pthread_rwlock_unlock(&(SC)->lock)
+#else
+#define BEGIN_READSECT(SC)
+#define BEGIN_CRITSECT(SC)
+#define END_CRITSECT(SC)
+#endif
+
+#define SUBTYPES_MINCAPACITY 64
+
+/* Transitive closure of the HasSubtype references in the type hierarchies of
+ * namespace zero (ReferenceTypes, DataTypes, ObjectTypes and VariableTypes).
+ * Every contained type has a bitset with its supertypes, including itself. The
+ * supertypes of a contained type are always contained as well. The closure is
+ * built on demand and extended when a new leaf type is added. Other changes of
+ * the HasSubtype references invalidate it. */
+typedef struct {
+    UA_HashIndexEntry indexEntry;
+    UA_NodeId typeId;
+    size_t bit;
+} UA_SubtypeEntry;
+
+struct UA_SubtypeClosure {
+    UA_Boolean valid;
+    UA_HashIndex types;         /* UA_SubtypeEntry by the hash of the typeId */
+    UA_SubtypeEntry **entries;  /* Ordered by the bit position */
+    size_t entriesSize;
+    size_t capacity;            /* Bits per row and maximum number of entries */
+    UA_UInt32 *supertypes;      /* One row of capacity bits per entry */
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_rwlock_t lock;
+#endif
+};
+
+/* The roots of the type hierarchies that are contained in the closure */
+static const UA_UInt32 typeRoots[4] = {
+    UA_NS0ID_REFERENCES, UA_NS0ID_BASEDATATYPE,
+    UA_NS0ID_BASEOBJECTTYPE, UA_NS0ID_BASEVARIABLETYPE
+};
+
+UA_SubtypeClosure *
+UA_SubtypeClosure_new(void) {
+    UA_SubtypeClosure *sc = (UA_SubtypeClosure*)UA_calloc(1, sizeof(UA_SubtypeClosure));
+    if(!sc)
+        return NULL;
+    UA_HashIndex_init(&sc->types);
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_rwlock_init(&sc->lock, NULL);
+#endif
+    return sc;
+}
+
+static void
+clearClosure(UA_SubtypeClosure *sc) {
+    for(size_t i = 0; i < sc->entriesSize; i++) {
+        UA_NodeId_deleteMembers(&sc->entries[i]->typeId);
+        UA_free(sc->entries[i]);
+    }
+    UA_free(sc->entries);
+    UA_free(sc->supertypes);
+    UA_HashIndex_deleteMembers(&sc->types);
+    sc->entries = NULL;
+    sc->entriesSize = 0;
+    sc->capacity = 0;
+    sc->supertypes = NULL;
+    sc->valid = false;
+}
+
+void
+UA_SubtypeClosure_delete(UA_SubtypeClosure *sc) {
+    if(!sc)
+        return;
+    clearClosure(sc);
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_rwlock_destroy(&sc->lock);
+#endif
+    UA_free(sc);
+}
+
+static UA_SubtypeEntry *
+findEntry(const UA_SubtypeClosure *sc, const UA_NodeId *typeId) {
+    UA_UInt32 hash = UA_NodeId_hash(typeId);
+    UA_HashIndexEntry *e = UA_HashIndex_first(&sc->types, hash);
+    for(; e; e = UA_HashIndex_next(e, hash)) {
+        UA_SubtypeEntry *entry = container_of(e, UA_SubtypeEntry, indexEntry);
+        if(UA_NodeId_equal(&entry->typeId, typeId))
+            return entry;
+    }
+    return NULL;
+}
+
+static UA_UInt32 *
+getRow(const UA_SubtypeClosure *sc, size_t bit) {
+    return &sc->supertypes[bit * (sc->capacity / 32)];
+}
+
+static UA_Boolean
+testBit(const UA_UInt32 *row, size_t bit) {
+    return ((row[bit / 32] >> (bit % 32)) & 1) != 0;
+}
+
+/* Double the capacity and copy the rows */
+static UA_StatusCode
+growClosure(UA_SubtypeClosure *sc) {
+    size_t capacity = (sc->capacity > 0) ? sc->capacity * 2 : SUBTYPES_MINCAPACITY;
+    size_t words = capacity / 32;
+    size_t oldWords = sc->capacity / 32;
+
+    UA_SubtypeEntry **entries = (UA_SubtypeEntry**)
+        UA_realloc(sc->entries, capacity * sizeof(UA_SubtypeEntry*));
+    if(!entries)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    sc->entries = entries;
+
+    UA_UInt32 *supertypes = (UA_UInt32*)
+        UA_calloc(capacity * words, sizeof(UA_UInt32));
+    if(!supertypes)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    for(size_t i = 0; i < sc->entriesSize; i++)
+        memcpy(&supertypes[i * words], &sc->supertypes[i * oldWords],
+               oldWords * sizeof(UA_UInt32));
+    UA_free(sc->supertypes);
+    sc->supertypes = supertypes;
+    sc->capacity = capacity;
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Returns the new entry. Its row contains only its own bit. */
+static UA_SubtypeEntry *
+addEntry(UA_SubtypeClosure *sc, const UA_NodeId *typeId) {
+    if(sc->entriesSize == sc->capacity &&
+       growClosure(sc) != UA_STATUSCODE_GOOD)
+        return NULL;
+
+    UA_SubtypeEntry *entry = (UA_SubtypeEntry*)UA_malloc(sizeof(UA_SubtypeEntry));
+    if(!entry)
+        return NULL;
+    if(UA_NodeId_copy(typeId, &entry->typeId) != UA_STATUSCODE_GOOD) {
+        UA_free(entry);
+        return NULL;
+    }
+    if(UA_HashIndex_insert(&sc->types, &entry->indexEntry,
+                           UA_NodeId_hash(typeId)) != UA_STATUSCODE_GOOD) {
+        UA_NodeId_deleteMembers(&entry->typeId);
+        UA_free(entry);
+        return NULL;
+    }
+
+    entry->bit = sc->entriesSize;
+    sc->entries[sc->entriesSize] = entry;
+    sc->entriesSize++;
+    UA_UInt32 *row = getRow(sc, entry->bit);
+    row[entry->bit / 32] |= (UA_UInt32)1 << (entry->bit % 32);
+    return entry;
+}
+
+/* Discover the types from the roots along the HasSubtype references in both
+ * directions. So all supertypes of a contained type are contained as well. Then
+ * merge the rows of the supertypes into the rows of their subtypes until
+ * nothing changes. */
+static UA_StatusCode
+rebuildClosure(UA_Server *server, UA_SubtypeClosure *sc) {
+    clearClosure(sc);
+
+    for(size_t i = 0; i < 4; i++) {
+        UA_NodeId root = UA_NODEID_NUMERIC(0, typeRoots[i]);
+        const UA_Node *node = UA_Nodestore_get(server, &root);
+        if(!node)
+            continue;
+        UA_Nodestore_release(server, node);
+        if(!addEntry(sc, &root))
+            goto error;
+    }
+
+    /* The entries are the worklist. New entries are appended. */
+    for(size_t i = 0; i < sc->entriesSize; i++) {
+        const UA_Node *node = UA_Nodestore_get(server, &sc->entries[i]->typeId);
+        if(!node)
+            continue;
+        for(size_t j = 0; j < node->referencesSize; j++) {
+            UA_NodeReferenceKind *rk = &node->references[j];
+            if(!UA_NodeId_equal(&rk->referenceTypeId, &subtypeId))
+                continue;
+            for(size_t k = 0; k < rk->targetIdsSize; k++) {
+                const UA_NodeId *target = &rk->targetIds[k].nodeId;
+                if(findEntry(sc, target))
+                    continue;
+                if(!addEntry(sc, target)) {
+                    UA_Nodestore_release(server, node);
+                    goto error;
+                }
+            }
+        }
+        UA_Nodestore_release(server, node);
+    }
+
+    size_t words = sc->capacity / 32;
+    UA_Boolean changed;
+    do {
+        changed = false;
+        for(size_t i = 0; i < sc->entriesSize; i++) {
+            const UA_Node *node = UA_Nodestore_get(server, &sc->entries[i]->typeId);
+            if(!node)
+                continue;
+            UA_UInt32 *row = getRow(sc, i);
+            for(size_t j = 0; j < node->referencesSize; j++) {
+                UA_NodeReferenceKind *rk = &node->references[j];
+                if(!rk->isInverse || !UA_NodeId_equal(&rk->referenceTypeId, &subtypeId))
+                    continue;
+                for(size_t k = 0; k < rk->targetIdsSize; k++) {
+                    /* Can be missing if the node was edited since */
+                    UA_SubtypeEntry *super = findEntry(sc, &rk->targetIds[k].nodeId);
+                    if(!super)
+                        continue;
+                    const UA_UInt32 *superRow = getRow(sc, super->bit);
+                    for(size_t w = 0; w < words; w++) {
+                        UA_UInt32 merged = row[w] | superRow[w];
+                        if(merged != row[w]) {
+                            row[w] = merged;
+                            changed = true;
+                        }
+                    }
+                }
+            }
+            UA_Nodestore_release(server, node);
+        }
+    } while(changed);
+
+    sc->valid = true;
+    return UA_STATUSCODE_GOOD;
+
+ error:
+    clearClosure(sc);
+    return UA_STATUSCODE_BADOUTOFMEMORY;
+}
+
+UA_Boolean
+isSubtypeOf(UA_Server *server, const UA_NodeId *type, const UA_NodeId *superType) {
+    if(UA_NodeId_equal(type, superType))
+        return true;
+
+    UA_SubtypeClosure *sc = server->subtypes;
+    if(!sc)
+        return isNodeInTree(&server->config.nodestore, type, superType, &subtypeId, 1);
+
+    BEGIN_READSECT(sc);
+    if(!sc->valid && !server->bootstrapNS0) {
+        END_CRITSECT(sc);
+        BEGIN_CRITSECT(sc);
+        if(!sc->valid)
+            rebuildClosure(server, sc);
+        END_CRITSECT(sc);
+        BEGIN_READSECT(sc);
+    }
+
+    /* The supertypes of a contained type are contained as well */
+    if(sc->valid) {
+        const UA_SubtypeEntry *entry = findEntry(sc, type);
+        if(entry) {
+            const UA_SubtypeEntry *superEntry = findEntry(sc, superType);
+            UA_Boolean result = (superEntry != NULL &&
+                                 testBit(getRow(sc, entry->bit), superEntry->bit));
+            END_CRITSECT(sc);
+            return result;
+        }
+    }
+    END_CRITSECT(sc);
+
+    /* Not contained in the closure */
+    return isNodeInTree(&server->config.nodestore, type, superType, &subtypeId, 1);
+}
+
+/* The type has no subtypes and no other supertype */
+static UA_Boolean
+isNewLeafType(UA_Server *server, const UA_NodeId *typeId,
+              const UA_NodeId *superType) {
+    const UA_Node *node = UA_Nodestore_get(server, typeId);
+    if(!node)
+        return false;
+    UA_Boolean leaf = true;
+    for(size_t i = 0; i < node->referencesSize && leaf; i++) {
+        UA_NodeReferenceKind *rk = &node->references[i];
+        if(!UA_NodeId_equal(&rk->referenceTypeId, &subtypeId))
+            continue;
+        for(size_t j = 0; j < rk->targetIdsSize; j++) {
+            if(!rk->isInverse ||
+               !UA_NodeId_equal(&rk->targetIds[j].nodeId, superType)) {
+                leaf = false;
+                break;
+            }
+        }
+    }
+    UA_Nodestore_release(server, node);
+    return leaf;
+}
+
+void
+UA_SubtypeClosure_addSubtype(UA_Server *server, const UA_NodeId *subtype,
+                             const UA_NodeId *superType) {
+    UA_SubtypeClosure *sc = server->subtypes;
+    if(!sc)
+        return;
+    BEGIN_CRITSECT(sc);
+    if(!sc->valid)
+        goto done;
+
+    /* Not below a contained type. Nothing changes for the contained types. */
+    UA_SubtypeEntry *superEntry = findEntry(sc, superType);
+    if(!superEntry) {
+        if(findEntry(sc, subtype))
+            clearClosure(sc); /* A contained type gets a new supertype */
+        goto done;
+    }
+
+    /* Already contained (e.g. after a parallel rebuild) */
+    UA_SubtypeEntry *entry = findEntry(sc, subtype);
+    size_t words = sc->capacity / 32;
+    if(entry) {
+        const UA_UInt32 *row = getRow(sc, entry->bit);
+        const UA_UInt32 *superRow = getRow(sc, superEntry->bit);
+        for(size_t w = 0; w < words; w++) {
+            if((row[w] | superRow[w]) != row[w]) {
+                clearClosure(sc);
+                break;
+            }
+        }
+        goto done;
+    }
+
+    /* Only new leaf types are added incrementally */
+    if(!isNewLeafType(server, subtype, superType)) {
+        clearClosure(sc);
+        goto done;
+    }
+
+    entry = addEntry(sc, subtype);
+    if(!entry) {
+        clearClosure(sc);
+        goto done;
+    }
+    words = sc->capacity / 32; /* Adding can grow the rows */
+    UA_UInt32 *row = getRow(sc, entry->bit);
+    const UA_UInt32 *superRow = getRow(sc, superEntry->bit);
+    for(size_t w = 0; w < words; w++)
+        row[w] |= superRow[w];
+
+ done:
+    END_CRITSECT(sc);
+}
+
+void
+UA_SubtypeClosure_invalidate(UA_SubtypeClosure *sc) {
+    if(!sc)
+        return;
+    BEGIN_CRITSECT(sc);
+    clearClosure(sc);
+    END_CRITSECT(sc);
+}
@@ -307,6 +307,14 @@ void Service_UnregisterNodes(UA_Server *server, UA_Session *session,
 UA_StatusCode Service_Read(UA_Server *server, UA_Session *session, UA_MessageContext *mc,
                            const UA_ReadRequest *request, UA_ResponseHeader *responseHeader);
 
+#ifdef UA_ENABLE_MULTITHREADING
+/* Read into a response structure instead of encoding the results directly into
+ * the message. Used when the request is processed in a worker thread and the
+ * response is sent later on. */
+void Service_ReadBuffered(UA_Server *server, UA_Session *session,
+                          const UA_ReadRequest *request, UA_ReadResponse *response);
+#endif
+
 /**
  * Write Service
  * ^^^^^^^^^^^^^
@@ -191,6 +191,26 @@ static const UA_String jsonEncoding = {sizeof("Default JSON")-1, (UA_Byte*)"Defa
         break;                                                  \
     }
 
+UA_StatusCode
+checkReadAccess(UA_Server *server, UA_Session *session,
+                const UA_Node *node, UA_UInt32 attributeId) {
+    /* VariableTypes don't have the AccessLevel concept. Always allow reading
+     * the value. */
+    if(attributeId != UA_ATTRIBUTEID_VALUE ||
+       node->nodeClass != UA_NODECLASS_VARIABLE)
+        return UA_STATUSCODE_GOOD;
+
+    /* The access to a value variable is granted via the AccessLevel and
+     * UserAccessLevel attributes */
+    UA_Byte accessLevel = getAccessLevel(server, session, (const UA_VariableNode*)node);
+    if(!(accessLevel & (UA_ACCESSLEVELMASK_READ)))
+        return UA_STATUSCODE_BADNOTREADABLE;
+    accessLevel = getUserAccessLevel(server, session, (const UA_VariableNode*)node);
+    if(!(accessLevel & (UA_ACCESSLEVELMASK_READ)))
+        return UA_STATUSCODE_BADUSERACCESSDENIED;
+    return UA_STATUSCODE_GOOD;
+}
+
 /* Returns a datavalue that may point into the node via the
  * UA_VARIANT_DATA_NODELETE tag. Don't access the returned DataValue once the
  * node has been released! */
@@ -276,22 +296,9 @@ ReadWithNode(const UA_Node *node, UA_Server *server, UA_Session *session,
         break;
     case UA_ATTRIBUTEID_VALUE: {
         CHECK_NODECLASS(UA_NODECLASS_VARIABLE | UA_NODECLASS_VARIABLETYPE);
-        /* VariableTypes don't have the AccessLevel concept. Always allow reading the value. */
-        if(node->nodeClass == UA_NODECLASS_VARIABLE) {
-            /* The access to a value variable is granted via the AccessLevel
-             * and UserAccessLevel attributes */
-            UA_Byte accessLevel = getAccessLevel(server, session, (const UA_VariableNode*)node);
-            if(!(accessLevel & (UA_ACCESSLEVELMASK_READ))) {
-                retval = UA_STATUSCODE_BADNOTREADABLE;
-                break;
-            }
-            accessLevel = getUserAccessLevel(server, session,
-                                             (const UA_VariableNode*)node);
-            if(!(accessLevel & (UA_ACCESSLEVELMASK_READ))) {
-                retval = UA_STATUSCODE_BADUSERACCESSDENIED;
-                break;
-            }
-        }
+        retval = checkReadAccess(server, session, node, UA_ATTRIBUTEID_VALUE);
+        if(retval != UA_STATUSCODE_GOOD)
+            break;
         retval = readValueAttributeComplete(server, session, (const UA_VariableNode*)node,
                                             timestampsToReturn, &id->indexRange, v);
         break;
@@ -406,11 +413,9 @@ Operation_Read(UA_Server *server, UA_Session *session, UA_MessageContext *mc,
     return retval;
 }
 
-UA_StatusCode Service_Read(UA_Server *server, UA_Session *session, UA_MessageContext *mc,
-                           const UA_ReadRequest *request, UA_ResponseHeader *responseHeader) {
-    UA_LOG_DEBUG_SESSION(&server->config.logger, session,
-                         "Processing ReadRequest");
-
+static void
+checkReadRequest(UA_Server *server, const UA_ReadRequest *request,
+                 UA_ResponseHeader *responseHeader) {
     /* Check if the timestampstoreturn is valid */
     if(request->timestampsToReturn > UA_TIMESTAMPSTORETURN_NEITHER)
         responseHeader->serviceResult = UA_STATUSCODE_BADTIMESTAMPSTORETURNINVALID;
@@ -426,6 +431,13 @@ UA_StatusCode Service_Read(UA_Server *server, UA_Session *session, UA_MessageCon
     if(server->config.maxNodesPerRead != 0 &&
        request->nodesToReadSize > server->config.maxNodesPerRead)
         responseHeader->serviceResult = UA_STATUSCODE_BADTOOMANYOPERATIONS;
+}
+
+UA_StatusCode Service_Read(UA_Server *server, UA_Session *session, UA_MessageContext *mc,
+                           const UA_ReadRequest *request, UA_ResponseHeader *responseHeader) {
+    UA_LOG_DEBUG_SESSION(&server->config.logger, session,
+                         "Processing ReadRequest");
+    checkReadRequest(server, request, responseHeader);
 
     /* Encode the response header */
     UA_StatusCode retval =
@@ -455,6 +467,34 @@ UA_StatusCode Service_Read(UA_Server *server, UA_Session *session, UA_MessageCon
     return UA_MessageContext_encode(mc, &arraySize, &UA_TYPES[UA_TYPES_INT32]);
 }
 
+#ifdef UA_ENABLE_MULTITHREADING
+
+static void
+Operation_ReadBuffered(UA_Server *server, UA_Session *session,
+                       UA_TimestampsToReturn *timestampsToReturn,
+                       const UA_ReadValueId *id, UA_DataValue *result) {
+    *result = UA_Server_readWithSession(server, session, id, *timestampsToReturn);
+}
+
+void Service_ReadBuffered(UA_Server *server, UA_Session *session,
+                          const UA_ReadRequest *request, UA_ReadResponse *response) {
+    UA_LOG_DEBUG_SESSION(&server->config.logger, session,
+                         "Processing ReadRequest");
+    checkReadRequest(server, request, &response->responseHeader);
+    if(response->responseHeader.serviceResult != UA_STATUSCODE_GOOD)
+        return;
+
+    UA_TimestampsToReturn timestampsToReturn = request->timestampsToReturn;
+    response->responseHeader.serviceResult =
+        UA_Server_processServiceOperations(server, session,
+                                           (UA_ServiceOperation)Operation_ReadBuffered,
+                                           &timestampsToReturn,
+                                           &request->nodesToReadSize, &UA_TYPES[UA_TYPES_READVALUEID],
+                                           &response->resultsSize, &UA_TYPES[UA_TYPES_DATAVALUE]);
+}
+
+#endif
+
 UA_DataValue
 UA_Server_readWithSession(UA_Server *server, UA_Session *session,
                           const UA_ReadValueId *item,
@@ -598,12 +638,12 @@ compatibleDataType(UA_Server *server, const UA_NodeId *dataType,
         return true;
 
     /* Is the value-type a subtype of the required type? */
-    if(isNodeInTree(&server->config.nodestore, dataType, constraintDataType, &subtypeId, 1))
+    if(isSubtypeOf(server, dataType, constraintDataType))
         return true;
 
     /* Enum allows Int32 (only) */
     if(UA_NodeId_equal(dataType, &UA_TYPES[UA_TYPES_INT32].typeId) &&
-       isNodeInTree(&server->config.nodestore, constraintDataType, &enumNodeId, &subtypeId, 1))
+       isSubtypeOf(server, constraintDataType, &enumNodeId))
         return true;
 
     /* More checks for the data type of real values (variants) */
@@ -615,8 +655,7 @@ compatibleDataType(UA_Server *server, const UA_NodeId *dataType,
         if(dataType->namespaceIndex == 0 &&
            dataType->identifierType == UA_NODEIDTYPE_NUMERIC &&
            dataType->identifier.numeric <= 25 &&
-           isNodeInTree(&server->config.nodestore, constraintDataType,
-                        dataType, &subtypeId, 1))
+           isSubtypeOf(server, constraintDataType, dataType))
             return true;
     }
 
@@ -1226,20 +1265,20 @@ copyAttributeIntoNode(UA_Server *server, UA_Session *session,
     case UA_ATTRIBUTEID_BROWSENAME:
         CHECK_USERWRITEMASK(UA_WRITEMASK_BROWSENAME);
         CHECK_DATATYPE_SCALAR(QUALIFIEDNAME);
-        UA_QualifiedName_deleteMembers(&node->browseName);
-        UA_QualifiedName_copy((const UA_QualifiedName *)value, &node->browseName);
+        UA_QualifiedName_deleteInterned(&node->browseName);
+        retval = UA_QualifiedName_copyInterned((const UA_QualifiedName *)value, &node->browseName);
         break;
     case UA_ATTRIBUTEID_DISPLAYNAME:
         CHECK_USERWRITEMASK(UA_WRITEMASK_DISPLAYNAME);
         CHECK_DATATYPE_SCALAR(LOCALIZEDTEXT);
-        UA_LocalizedText_deleteMembers(&node->displayName);
-        UA_LocalizedText_copy((const UA_LocalizedText *)value, &node->displayName);
+        UA_LocalizedText_deleteInterned(&node->displayName);
+        retval = UA_LocalizedText_copyInterned((const UA_LocalizedText *)value, &node->displayName);
         break;
     case UA_ATTRIBUTEID_DESCRIPTION:
         CHECK_USERWRITEMASK(UA_WRITEMASK_DESCRIPTION);
         CHECK_DATATYPE_SCALAR(LOCALIZEDTEXT);
-        UA_LocalizedText_deleteMembers(&node->description);
-        UA_LocalizedText_copy((const UA_LocalizedText *)value, &node->description);
+        UA_LocalizedText_deleteInterned(&node->description);
+        retval = UA_LocalizedText_copyInterned((const UA_LocalizedText *)value, &node->description);
         break;
     case UA_ATTRIBUTEID_WRITEMASK:
         CHECK_USERWRITEMASK(UA_WRITEMASK_WRITEMASK);
@@ -1261,9 +1300,9 @@ copyAttributeIntoNode(UA_Server *server, UA_Session *session,
         CHECK_NODECLASS_WRITE(UA_NODECLASS_REFERENCETYPE);
         CHECK_USERWRITEMASK(UA_WRITEMASK_INVERSENAME);
         CHECK_DATATYPE_SCALAR(LOCALIZEDTEXT);
-        UA_LocalizedText_deleteMembers(&((UA_ReferenceTypeNode*)node)->inverseName);
-        UA_LocalizedText_copy((const UA_LocalizedText *)value,
-                              &((UA_ReferenceTypeNode*)node)->inverseName);
+        UA_LocalizedText_deleteInterned(&((UA_ReferenceTypeNode*)node)->inverseName);
+        retval = UA_LocalizedText_copyInterned((const UA_LocalizedText *)value,
+                                               &((UA_ReferenceTypeNode*)node)->inverseName);
         break;
     case UA_ATTRIBUTEID_CONTAINSNOLOOPS:
         CHECK_NODECLASS_WRITE(UA_NODECLASS_VIEW);
@@ -1366,11 +1405,25 @@ copyAttributeIntoNode(UA_Server *server, UA_Session *session,
     return retval;
 }
 
+static UA_StatusCode
+writeWithSession(UA_Server *server, UA_Session *session, const UA_WriteValue *wv) {
+    UA_StatusCode retval =
+        UA_Server_editNode(server, session, &wv->nodeId,
+                           (UA_EditNodeCallback)copyAttributeIntoNode,
+                           /* casting away const qualifier because callback uses const anyway */
+                           (UA_WriteValue *)(uintptr_t)wv);
+#ifdef UA_ENABLE_SUBSCRIPTIONS
+    /* Report the new value to the MonitoredItems without sampling interval */
+    if(retval == UA_STATUSCODE_GOOD && wv->attributeId == UA_ATTRIBUTEID_VALUE)
+        UA_MonitoredItem_reportWrite(server, &wv->nodeId);
+#endif
+    return retval;
+}
+
 static void
 Operation_Write(UA_Server *server, UA_Session *session, void *context,
                 UA_WriteValue *wv, UA_StatusCode *result) {
-    *result = UA_Server_editNode(server, session, &wv->nodeId,
-                        (UA_EditNodeCallback)copyAttributeIntoNode, wv);
+    *result = writeWithSession(server, session, wv);
 }
 
 void
@@ -1395,18 +1448,12 @@ Service_Write(UA_Server *server, UA_Session *session,
 UA_StatusCode
 UA_Server_writeWithSession(UA_Server *server, UA_Session *session,
                            const UA_WriteValue *value) {
-    return UA_Server_editNode(server, session, &value->nodeId,
-                              (UA_EditNodeCallback)copyAttributeIntoNode,
-                              /* casting away const qualifier because callback uses const anyway */
-                              (UA_WriteValue *)(uintptr_t)value);
+    return writeWithSession(server, session, value);
 }
 
 UA_StatusCode
 UA_Server_write(UA_Server *server, const UA_WriteValue *value) {
-    return UA_Server_editNode(server, &server->adminSession, &value->nodeId,
-                              (UA_EditNodeCallback)copyAttributeIntoNode,
-                              /* casting away const qualifier because callback uses const anyway */
-                              (UA_WriteValue *)(uintptr_t)value);
+    return writeWithSession(server, &server->adminSession, value);
 }
 
 /* Convenience function to be wrapped into inline functions */
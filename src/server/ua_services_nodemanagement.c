@@ -157,8 +157,7 @@ checkParentReference(UA_Server *server, UA_Session *session, UA_NodeClass nodeCl
     }
 
     /* Test if the referencetype is hierarchical */
-    if(!isNodeInTree(&server->config.nodestore, referenceTypeId,
-                     &hierarchicalReferences, &subtypeId, 1)) {
+    if(!isSubtypeOf(server, referenceTypeId, &hierarchicalReferences)) {
         UA_LOG_INFO_SESSION(&server->config.logger, session,
                             "AddNodes: Reference type to the parent is not hierarchical");
         return UA_STATUSCODE_BADREFERENCETYPEIDINVALID;
@@ -409,7 +408,7 @@ copyAllChildren(UA_Server *server, UA_Session *session,
 
 static UA_StatusCode
 recursiveTypeCheckAddChildren(UA_Server *server, UA_Session *session,
-                              const UA_Node *node, const UA_Node *type);
+                              const UA_Node **node, const UA_Node *type);
 
 static void
 Operation_addReference(UA_Server *server, UA_Session *session, void *context,
@@ -465,7 +464,7 @@ copyChild(UA_Server *server, UA_Session *session, const UA_NodeId *destinationNo
         node->constructed = false;
 
         /* Reset the NodeId (random numeric id will be assigned in the nodestore) */
-        UA_NodeId_deleteMembers(&node->nodeId);
+        UA_NodeId_deleteInterned(&node->nodeId);
         node->nodeId.namespaceIndex = destinationNodeId->namespaceIndex;
 
         /* Remove references, they are re-created from scratch in addnode_finish */
@@ -810,11 +809,12 @@ AddNode_raw(UA_Server *server, UA_Session *session, void *nodeContext,
 
     /* Fill the node attributes */
     node->context = nodeContext;
-    UA_StatusCode retval = UA_NodeId_copy(&item->requestedNewNodeId.nodeId, &node->nodeId);
+    UA_StatusCode retval = UA_NodeId_copyInterned(&item->requestedNewNodeId.nodeId,
+                                                  &node->nodeId);
     if(retval != UA_STATUSCODE_GOOD)
         goto create_error;
 
-    retval = UA_QualifiedName_copy(&item->browseName, &node->browseName);
+    retval = UA_QualifiedName_copyInterned(&item->browseName, &node->browseName);
     if(retval != UA_STATUSCODE_GOOD)
         goto create_error;
 
@@ -868,9 +868,12 @@ Operation_addNode_begin(UA_Server *server, UA_Session *session, void *nodeContex
     return retval;
 }
 
+/* The node pointer is updated if the attributes from the type lead to a new
+ * version of the node */
 static UA_StatusCode
 recursiveTypeCheckAddChildren(UA_Server *server, UA_Session *session,
-                              const UA_Node *node, const UA_Node *type) {
+                              const UA_Node **nodeptr, const UA_Node *type) {
+    const UA_Node *node = *nodeptr;
     UA_assert(node != NULL);
     UA_assert(type != NULL);
     UA_StatusCode retval = UA_STATUSCODE_GOOD;
@@ -881,6 +884,7 @@ recursiveTypeCheckAddChildren(UA_Server *server, UA_Session *session,
        node->nodeClass == UA_NODECLASS_VARIABLETYPE) {
         retval = useVariableTypeAttributes(server, session, (const UA_VariableNode**)&node,
                                            (const UA_VariableTypeNode*)type);
+        *nodeptr = node;
         if(retval != UA_STATUSCODE_GOOD) {
             UA_LOG_NODEID_WRAP(&node->nodeId, UA_LOG_INFO_SESSION(&server->config.logger, session,
                                "AddNodes: Using attributes for %.*s from the variable type "
@@ -1060,7 +1064,7 @@ AddNode_finish(UA_Server *server, UA_Session *session, const UA_NodeId *nodeId)
             goto cleanup;
         }
 
-        retval = recursiveTypeCheckAddChildren(server, session, node, type);
+        retval = recursiveTypeCheckAddChildren(server, session, &node, type);
         if(retval != UA_STATUSCODE_GOOD)
             goto cleanup;
     }
@@ -1349,6 +1353,14 @@ deleteNodeOperation(UA_Server *server, UA_Session *session, void *context,
 
     recursiveDeconstructNode(server, session, node);
     recursiveDeleteNode(server, session, node, item->deleteTargetReferences);
+
+    /* The type can remain in the subtype closure if the references to its
+     * supertype were not removed */
+    if(node->nodeClass == UA_NODECLASS_REFERENCETYPE ||
+       node->nodeClass == UA_NODECLASS_DATATYPE ||
+       node->nodeClass == UA_NODECLASS_OBJECTTYPE ||
+       node->nodeClass == UA_NODECLASS_VARIABLETYPE)
+        UA_SubtypeClosure_invalidate(server->subtypes);
     UA_Nodestore_release(server, node);
 }
 
@@ -1455,12 +1467,27 @@ Operation_addReference(UA_Server *server, UA_Session *session, void *context,
         /* ignore returned status code */
         UA_Server_editNode(server, session, &item->sourceNodeId,
                            (UA_EditNodeCallback)deleteOneWayReference, &deleteItem);
+        if(UA_NodeId_equal(&item->referenceTypeId, &subtypeId))
+            UA_SubtypeClosure_invalidate(server->subtypes);
     }
 
     /* Calculate common duplicate reference not allowed result and set bad result
      * if BOTH directions already existed */
-    if(firstExisted && secondExisted)
+    if(firstExisted && secondExisted) {
         *retval = UA_STATUSCODE_BADDUPLICATEREFERENCENOTALLOWED;
+        return;
+    }
+
+    /* Update the subtype closure */
+    if(*retval == UA_STATUSCODE_GOOD &&
+       UA_NodeId_equal(&item->referenceTypeId, &subtypeId)) {
+        if(item->isForward)
+            UA_SubtypeClosure_addSubtype(server, &item->targetNodeId.nodeId,
+                                         &item->sourceNodeId);
+        else
+            UA_SubtypeClosure_addSubtype(server, &item->sourceNodeId,
+                                         &item->targetNodeId.nodeId);
+    }
 }
 
 void Service_AddReferences(UA_Server *server, UA_Session *session,
@@ -1524,18 +1551,22 @@ Operation_deleteReference(UA_Server *server, UA_Session *session, void *context,
     if(*retval != UA_STATUSCODE_GOOD)
         return;
 
-    if(!item->deleteBidirectional || item->targetNodeId.serverIndex != 0)
-        return;
-
-    UA_DeleteReferencesItem secondItem;
-    UA_DeleteReferencesItem_init(&secondItem);
-    secondItem.isForward = !item->isForward;
-    secondItem.sourceNodeId = item->targetNodeId.nodeId;
-    secondItem.targetNodeId.nodeId = item->sourceNodeId;
-    secondItem.referenceTypeId = item->referenceTypeId;
-    *retval = UA_Server_editNode(server, session, &secondItem.sourceNodeId,
-                                 (UA_EditNodeCallback)deleteOneWayReference,
-                                 &secondItem);
+    if(item->deleteBidirectional && item->targetNodeId.serverIndex == 0) {
+        UA_DeleteReferencesItem secondItem;
+        UA_DeleteReferencesItem_init(&secondItem);
+        secondItem.isForward = !item->isForward;
+        secondItem.sourceNodeId = item->targetNodeId.nodeId;
+        secondItem.targetNodeId.nodeId = item->sourceNodeId;
+        secondItem.referenceTypeId = item->referenceTypeId;
+        *retval = UA_Server_editNode(server, session, &secondItem.sourceNodeId,
+                                     (UA_EditNodeCallback)deleteOneWayReference,
+                                     &secondItem);
+    }
+
+    /* Invalidate after the nodes were edited. A parallel rebuild of the subtype
+     * closure might have seen the nodes before the edit. */
+    if(UA_NodeId_equal(&item->referenceTypeId, &subtypeId))
+        UA_SubtypeClosure_invalidate(server->subtypes);
 }
 
 void
@@ -1593,10 +1624,17 @@ UA_StatusCode
 UA_Server_setVariableNode_valueCallback(UA_Server *server,
                                         const UA_NodeId nodeId,
                                         const UA_ValueCallback callback) {
-    return UA_Server_editNode(server, &server->adminSession, &nodeId,
-                              (UA_EditNodeCallback)setValueCallback,
-                              /* cast away const because callback uses const anyway */
-                              (UA_ValueCallback *)(uintptr_t) &callback);
+    UA_StatusCode retval =
+        UA_Server_editNode(server, &server->adminSession, &nodeId,
+                           (UA_EditNodeCallback)setValueCallback,
+                           /* cast away const because callback uses const anyway */
+                           (UA_ValueCallback *)(uintptr_t) &callback);
+#ifdef UA_ENABLE_SUBSCRIPTIONS
+    /* The value is no longer changed only by writes */
+    if(retval == UA_STATUSCODE_GOOD && callback.onRead)
+        UA_MonitoredItem_stopReportByException(server, &nodeId);
+#endif
+    return retval;
 }
 
 /***************************************************/
@@ -1669,10 +1707,17 @@ setDataSource(UA_Server *server, UA_Session *session,
 UA_StatusCode
 UA_Server_setVariableNode_dataSource(UA_Server *server, const UA_NodeId nodeId,
                                      const UA_DataSource dataSource) {
-    return UA_Server_editNode(server, &server->adminSession, &nodeId,
-                              (UA_EditNodeCallback)setDataSource,
-                            /* casting away const because callback casts it back anyway */
-                              (UA_DataSource *) (uintptr_t)&dataSource);
+    UA_StatusCode retval =
+        UA_Server_editNode(server, &server->adminSession, &nodeId,
+                           (UA_EditNodeCallback)setDataSource,
+                           /* casting away const because callback casts it back anyway */
+                           (UA_DataSource *) (uintptr_t)&dataSource);
+#ifdef UA_ENABLE_SUBSCRIPTIONS
+    /* The value is no longer changed only by writes */
+    if(retval == UA_STATUSCODE_GOOD)
+        UA_MonitoredItem_stopReportByException(server, &nodeId);
+#endif
+    return retval;
 }
 
 /************************************/
@@ -347,7 +347,7 @@ Service_ActivateSession(UA_Server *server, UA_SecureChannel *channel,
 
     /* Activate the session */
     session->activated = true;
-    UA_Session_updateLifetime(session);
+    UA_SessionManager_updateLifetime(&server->sessionManager, session);
 
     /* Generate a new session nonce for the next time ActivateSession is called */
     response->responseHeader.serviceResult = UA_Session_generateNonce(session);
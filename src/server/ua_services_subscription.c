@@ -212,6 +212,7 @@ setMonitoredItemSettings(UA_Server *server, UA_MonitoredItem *mon,
 
     /* SamplingInterval */
     UA_Double samplingInterval = params->samplingInterval;
+    UA_Boolean reportByException = false;
     if(mon->attributeId == UA_ATTRIBUTEID_VALUE) {
         mon->monitoredItemType = UA_MONITOREDITEMTYPE_CHANGENOTIFY;
         const UA_VariableNode *vn = (const UA_VariableNode *)
@@ -220,6 +221,12 @@ setMonitoredItemSettings(UA_Server *server, UA_MonitoredItem *mon,
             if(vn->nodeClass == UA_NODECLASS_VARIABLE &&
                samplingInterval < vn->minimumSamplingInterval)
                 samplingInterval = vn->minimumSamplingInterval;
+            /* Only writes can change the value. So there is no need to poll. */
+            reportByException = (server->config.reportByException &&
+                                 samplingInterval == 0.0 &&
+                                 vn->nodeClass == UA_NODECLASS_VARIABLE &&
+                                 vn->valueSource == UA_VALUESOURCE_DATA &&
+                                 !vn->value.data.callback.onRead);
             UA_Nodestore_release(server, (const UA_Node *)vn);
         }
     } else if(mon->attributeId == UA_ATTRIBUTEID_EVENTNOTIFIER) {
@@ -234,12 +241,15 @@ setMonitoredItemSettings(UA_Server *server, UA_MonitoredItem *mon,
                                samplingInterval, mon->samplingInterval);
     if(samplingInterval != samplingInterval) /* Check for nan */
         mon->samplingInterval = server->config.samplingIntervalLimits.min;
+    if(reportByException)
+        mon->samplingInterval = 0.0;
 
     UA_assert(mon->monitoredItemType != 0);
 
     /* QueueSize */
     UA_BOUNDEDVALUE_SETWBOUNDS(server->config.queueSizeLimits,
                                params->queueSize, mon->maxQueueSize);
+    UA_MonitoredItem_trimNotificationCache(mon);
 
     /* DiscardOldest */
     mon->discardOldest = params->discardOldest;
@@ -354,7 +364,12 @@ Operation_CreateMonitoredItem(UA_Server *server, UA_Session *session, struct cre
     /* Add to the subscriptions or the local MonitoredItems */
     if(cmc->sub) {
         newMon->monitoredItemId = ++cmc->sub->lastMonitoredItemId;
-        UA_Subscription_addMonitoredItem(cmc->sub, newMon);
+        retval = UA_Subscription_addMonitoredItem(cmc->sub, newMon);
+        if(retval != UA_STATUSCODE_GOOD) {
+            result->statusCode = retval;
+            UA_MonitoredItem_delete(server, newMon);
+            return;
+        }
 #ifdef UA_ENABLE_SUBSCRIPTIONS_EVENTS
         if(newMon->monitoredItemType == UA_MONITOREDITEMTYPE_EVENTNOTIFY) {
             /* Insert the monitored item into the node's queue */
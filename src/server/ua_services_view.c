@@ -19,21 +19,39 @@
 #include "ua_server_internal.h"
 #include "ua_services.h"
 
+/* Browse and BrowseNext can be processed in parallel worker threads. Access to
+ * the continuation points of the session is serialized. */
+#ifdef UA_ENABLE_MULTITHREADING
+#define BEGIN_CPSECT(SESSION) pthread_mutex_lock(&(SESSION)->continuationPointsMutex)
+#define END_CPSECT(SESSION) pthread_mutex_unlock(&(SESSION)->continuationPointsMutex)
+#else
+#define BEGIN_CPSECT(SESSION)
+#define END_CPSECT(SESSION)
+#endif
+
 /**********/
 /* Browse */
 /**********/
 
-/* Target node on top of the stack */
+/* Attributes of the target node in the ReferenceDescription */
+#define UA_BROWSERESULTMASK_TARGETATTRIBUTES                            \
+    (UA_BROWSERESULTMASK_NODECLASS | UA_BROWSERESULTMASK_BROWSENAME |   \
+     UA_BROWSERESULTMASK_DISPLAYNAME | UA_BROWSERESULTMASK_TYPEDEFINITION)
+
+/* Target node on top of the stack. The target node can be NULL if none of its
+ * attributes are requested. */
 static UA_StatusCode
-fillReferenceDescription(UA_Server *server, const UA_Node *curr,
-                         const UA_NodeReferenceKind *ref,
+fillReferenceDescription(UA_Server *server, const UA_ExpandedNodeId *targetId,
+                         const UA_Node *curr, const UA_NodeReferenceKind *ref,
                          UA_UInt32 mask, UA_ReferenceDescription *descr) {
     UA_ReferenceDescription_init(descr);
-    UA_StatusCode retval = UA_NodeId_copy(&curr->nodeId, &descr->nodeId.nodeId);
+    UA_StatusCode retval = UA_ExpandedNodeId_copy(targetId, &descr->nodeId);
     if(mask & UA_BROWSERESULTMASK_REFERENCETYPEID)
         retval |= UA_NodeId_copy(&ref->referenceTypeId, &descr->referenceTypeId);
     if(mask & UA_BROWSERESULTMASK_ISFORWARD)
         descr->isForward = !ref->isInverse;
+    if(!curr)
+        return retval;
     if(mask & UA_BROWSERESULTMASK_NODECLASS)
         retval |= UA_NodeClass_copy(&curr->nodeClass, &descr->nodeClass);
     if(mask & UA_BROWSERESULTMASK_BROWSENAME)
@@ -68,8 +86,7 @@ relevantReference(UA_Server *server, UA_Boolean includeSubtypes,
     if(!includeSubtypes)
         return UA_NodeId_equal(rootRef, testRef);
 
-    const UA_NodeId hasSubType = UA_NODEID_NUMERIC(0, UA_NS0ID_HASSUBTYPE);
-    return isNodeInTree(&server->config.nodestore, testRef, rootRef, &hasSubType, 1);
+    return isSubtypeOf(server, testRef, rootRef);
 }
 
 static UA_Boolean
@@ -96,6 +113,14 @@ browseReferences(UA_Server *server, const UA_Node *node,
     /* Follow all references? */
     UA_Boolean browseAll = UA_NodeId_isNull(&descr->referenceTypeId);
 
+    /* Look up the target nodes only if they are filtered by the NodeClass or
+     * if their attributes are returned. Otherwise the references are returned
+     * from the node alone. Targets that are not in the nodestore (e.g. on a
+     * remote server) are returned with the fields of the reference only. But
+     * they cannot match a NodeClass filter. */
+    UA_Boolean resolveTargets = (descr->nodeClassMask != UA_NODECLASS_UNSPECIFIED ||
+                                 (descr->resultMask & UA_BROWSERESULTMASK_TARGETATTRIBUTES) != 0);
+
     /* How many references can we return at most? */
     size_t maxrefs = cp->maxReferences;
     if(maxrefs == 0) {
@@ -140,14 +165,19 @@ browseReferences(UA_Server *server, const UA_Node *node,
         /* Loop over the targets */
         for(; targetIndex < rk->targetIdsSize; ++targetIndex) {
             /* Get the node */
-            const UA_Node *target = UA_Nodestore_get(server, &rk->targetIds[targetIndex].nodeId);
-            if(!target)
-                continue;
+            const UA_Node *target = NULL;
+            const UA_ExpandedNodeId *targetId = &rk->targetIds[targetIndex];
+            if(resolveTargets && targetId->serverIndex == 0)
+                target = UA_Nodestore_get(server, &targetId->nodeId);
 
             /* Test if the node class matches */
-            if(!matchClassMask(target, descr->nodeClassMask)) {
-                UA_Nodestore_release(server, target);
-                continue;
+            if(descr->nodeClassMask != UA_NODECLASS_UNSPECIFIED) {
+                if(!target)
+                    continue;
+                if(!matchClassMask(target, descr->nodeClassMask)) {
+                    UA_Nodestore_release(server, target);
+                    continue;
+                }
             }
 
             /* A match! Can we return it? */
@@ -155,7 +185,8 @@ browseReferences(UA_Server *server, const UA_Node *node,
                 /* There are references we could not return */
                 cp->referenceKindIndex = referenceKindIndex;
                 cp->targetIndex = targetIndex;
-                UA_Nodestore_release(server, target);
+                if(target)
+                    UA_Nodestore_release(server, target);
                 return false;
             }
 
@@ -168,7 +199,8 @@ browseReferences(UA_Server *server, const UA_Node *node,
                     UA_realloc(result->references, sizeof(UA_ReferenceDescription) * refs_size);
                 if(!rd) {
                     result->statusCode = UA_STATUSCODE_BADOUTOFMEMORY;
-                    UA_Nodestore_release(server, target);
+                    if(target)
+                        UA_Nodestore_release(server, target);
                     goto error_recovery;
                 }
                 result->references = rd;
@@ -176,10 +208,12 @@ browseReferences(UA_Server *server, const UA_Node *node,
 
             /* Copy the node description. Target is on top of the stack */
             result->statusCode =
-                fillReferenceDescription(server, target, rk, descr->resultMask,
+                fillReferenceDescription(server, targetId, target, rk,
+                                         descr->resultMask,
                                          &result->references[result->referencesSize]);
 
-            UA_Nodestore_release(server, target);
+            if(target)
+                UA_Nodestore_release(server, target);
 
             if(result->statusCode != UA_STATUSCODE_GOOD)
                 goto error_recovery;
@@ -276,6 +310,7 @@ Operation_Browse(UA_Server *server, UA_Session *session, UA_UInt32 *maxrefs,
     /* Persist the new continuation point */
     ContinuationPointEntry *cp2 = NULL;
     UA_StatusCode retval = UA_STATUSCODE_GOOD;
+    BEGIN_CPSECT(session);
     if(session->availableContinuationPoints <= 0 ||
        !(cp2 = (ContinuationPointEntry *)UA_malloc(sizeof(ContinuationPointEntry)))) {
         retval = UA_STATUSCODE_BADNOCONTINUATIONPOINTS;
@@ -307,9 +342,11 @@ Operation_Browse(UA_Server *server, UA_Session *session, UA_UInt32 *maxrefs,
     /* Attach the cp to the session */
     LIST_INSERT_HEAD(&session->continuationPoints, cp2, pointers);
     --session->availableContinuationPoints;
+    END_CPSECT(session);
     return;
 
  cleanup:
+    END_CPSECT(session);
     if(cp2) {
         UA_ByteString_deleteMembers(&cp2->identifier);
         UA_BrowseDescription_deleteMembers(&cp2->browseDescription);
@@ -354,13 +391,16 @@ UA_Server_browse(UA_Server *server, UA_UInt32 maxrefs, const UA_BrowseDescriptio
 static void
 Operation_BrowseNext(UA_Server *server, UA_Session *session, UA_Boolean *releaseContinuationPoints,
                      const UA_ByteString *continuationPoint, UA_BrowseResult *result) {
-    /* Find the continuation point */
+    /* Find the continuation point. The cp is updated during browsing. So the
+     * section is held until the end. */
+    BEGIN_CPSECT(session);
     ContinuationPointEntry *cp;
     LIST_FOREACH(cp, &session->continuationPoints, pointers) {
         if(UA_ByteString_equal(&cp->identifier, continuationPoint))
             break;
     }
     if(!cp) {
+        END_CPSECT(session);
         result->statusCode = UA_STATUSCODE_BADCONTINUATIONPOINTINVALID;
         return;
     }
@@ -368,6 +408,7 @@ Operation_BrowseNext(UA_Server *server, UA_Session *session, UA_Boolean *release
     /* Remove the cp */
     if(*releaseContinuationPoints) {
         removeCp(cp, session);
+        END_CPSECT(session);
         return;
     }
 
@@ -385,6 +426,7 @@ Operation_BrowseNext(UA_Server *server, UA_Session *session, UA_Boolean *release
             result->statusCode = retval;
         }
     }
+    END_CPSECT(session);
 }
 
 void
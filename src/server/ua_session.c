@@ -17,6 +17,9 @@
 void UA_Session_init(UA_Session *session) {
     memset(session, 0, sizeof(UA_Session));
     session->availableContinuationPoints = UA_MAXCONTINUATIONPOINTS;
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_init(&session->continuationPointsMutex, NULL);
+#endif
 #ifdef UA_ENABLE_SUBSCRIPTIONS
     SIMPLEQ_INIT(&session->responseQueue);
 #endif
@@ -36,6 +39,9 @@ void UA_Session_deleteMembersCleanup(UA_Session *session, UA_Server* server) {
         UA_BrowseDescription_deleteMembers(&cp->browseDescription);
         UA_free(cp);
     }
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_destroy(&session->continuationPointsMutex);
+#endif
 }
 
 void UA_Session_attachToSecureChannel(UA_Session *session, UA_SecureChannel *channel) {
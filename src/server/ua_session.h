@@ -11,6 +11,10 @@
 #include "ua_securechannel.h"
 #include "ua_util.h"
 
+#ifdef UA_ENABLE_MULTITHREADING
+#include <pthread.h>
+#endif
+
 _UA_BEGIN_DECLS
 
 #define UA_MAXCONTINUATIONPOINTS 5
@@ -51,6 +55,10 @@ typedef struct {
     UA_ByteString     serverNonce;
     UA_UInt16 availableContinuationPoints;
     LIST_HEAD(ContinuationPointList, ContinuationPointEntry) continuationPoints;
+#ifdef UA_ENABLE_MULTITHREADING
+    /* Browse and BrowseNext of the same session can run in parallel workers */
+    pthread_mutex_t continuationPointsMutex;
+#endif
 #ifdef UA_ENABLE_SUBSCRIPTIONS
     UA_UInt32 lastSubscriptionId;
     UA_UInt32 lastSeenSubscriptionId;
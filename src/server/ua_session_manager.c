@@ -13,9 +13,31 @@
 #include "ua_server_internal.h"
 #include "ua_subscription.h"
 
+/* Sessions can time out at the same time. They are given an absolute order by
+ * the memory address to break ties. */
+static enum ZIP_CMP
+cmpValidTill(const UA_DateTime *a, const UA_DateTime *b) {
+    if(*a < *b)
+        return ZIP_CMP_LESS;
+    if(*a > *b)
+        return ZIP_CMP_MORE;
+    if(a == b)
+        return ZIP_CMP_EQ;
+    if(a < b)
+        return ZIP_CMP_LESS;
+    return ZIP_CMP_MORE;
+}
+
+ZIP_PROTTYPE(UA_SessionExpiryTree, session_list_entry, UA_DateTime)
+ZIP_IMPL(UA_SessionExpiryTree, session_list_entry, expiryEntry,
+         UA_DateTime, session.validTill, cmpValidTill)
+
 UA_StatusCode
 UA_SessionManager_init(UA_SessionManager *sm, UA_Server *server) {
     LIST_INIT(&sm->sessions);
+    ZIP_INIT(&sm->expiryTree);
+    UA_HashIndex_init(&sm->sessionsByToken);
+    UA_HashIndex_init(&sm->sessionsById);
     sm->currentSessionCount = 0;
     sm->server = server;
     return UA_STATUSCODE_GOOD;
@@ -52,6 +74,9 @@ removeSession(UA_SessionManager *sm, session_list_entry *sentry) {
     /* Detach the session from the session manager and make the capacity
      * available */
     LIST_REMOVE(sentry, pointers);
+    ZIP_REMOVE(UA_SessionExpiryTree, &sm->expiryTree, sentry);
+    UA_HashIndex_remove(&sm->sessionsByToken, &sentry->tokenEntry);
+    UA_HashIndex_remove(&sm->sessionsById, &sentry->idEntry);
     UA_atomic_subUInt32(&sm->currentSessionCount, 1);
 
     /* Add a delayed callback to remove the session when the currently
@@ -67,16 +92,18 @@ void UA_SessionManager_deleteMembers(UA_SessionManager *sm) {
     LIST_FOREACH_SAFE(current, &sm->sessions, pointers, temp) {
         removeSession(sm, current);
     }
+    UA_HashIndex_deleteMembers(&sm->sessionsByToken);
+    UA_HashIndex_deleteMembers(&sm->sessionsById);
 }
 
 void
 UA_SessionManager_cleanupTimedOut(UA_SessionManager *sm,
                                   UA_DateTime nowMonotonic) {
-    session_list_entry *sentry, *temp;
-    LIST_FOREACH_SAFE(sentry, &sm->sessions, pointers, temp) {
+    session_list_entry *sentry;
+    while((sentry = ZIP_MIN(UA_SessionExpiryTree, &sm->expiryTree))) {
         /* Session has timed out? */
         if(sentry->session.validTill >= nowMonotonic)
-            continue;
+            break;
         UA_LOG_INFO_SESSION(&sm->server->config.logger, &sentry->session,
                             "Session has timed out");
         sm->server->config.accessControl.closeSession(sm->server,
@@ -87,14 +114,22 @@ UA_SessionManager_cleanupTimedOut(UA_SessionManager *sm,
     }
 }
 
+static session_list_entry *
+findSessionByToken(UA_SessionManager *sm, const UA_NodeId *token) {
+    UA_UInt32 hash = UA_NodeId_hash(token);
+    UA_HashIndexEntry *e = UA_HashIndex_first(&sm->sessionsByToken, hash);
+    for(; e; e = UA_HashIndex_next(e, hash)) {
+        session_list_entry *current = container_of(e, session_list_entry, tokenEntry);
+        if(UA_NodeId_equal(&current->session.header.authenticationToken, token))
+            return current;
+    }
+    return NULL;
+}
+
 UA_Session *
 UA_SessionManager_getSessionByToken(UA_SessionManager *sm, const UA_NodeId *token) {
-    session_list_entry *current = NULL;
-    LIST_FOREACH(current, &sm->sessions, pointers) {
-        /* Token does not match */
-        if(!UA_NodeId_equal(&current->session.header.authenticationToken, token))
-            continue;
-
+    session_list_entry *current = findSessionByToken(sm, token);
+    if(current) {
         /* Session has timed out */
         if(UA_DateTime_nowMonotonic() > current->session.validTill) {
             UA_LOG_INFO_SESSION(&sm->server->config.logger, &current->session,
@@ -119,8 +154,10 @@ UA_SessionManager_getSessionByToken(UA_SessionManager *sm, const UA_NodeId *toke
 UA_Session *
 UA_SessionManager_getSessionById(UA_SessionManager *sm, const UA_NodeId *sessionId) {
     session_list_entry *current = NULL;
-    LIST_FOREACH(current, &sm->sessions, pointers) {
-        /* Token does not match */
+    UA_UInt32 hash = UA_NodeId_hash(sessionId);
+    UA_HashIndexEntry *e = UA_HashIndex_first(&sm->sessionsById, hash);
+    for(; e; e = UA_HashIndex_next(e, hash)) {
+        current = container_of(e, session_list_entry, idEntry);
         if(!UA_NodeId_equal(&current->session.sessionId, sessionId))
             continue;
 
@@ -168,21 +205,46 @@ UA_SessionManager_createSession(UA_SessionManager *sm, UA_SecureChannel *channel
         newentry->session.timeout = sm->server->config.maxSessionTimeout;
 
     UA_Session_updateLifetime(&newentry->session);
+
+    /* Add to the indexes */
+    UA_StatusCode retval =
+        UA_HashIndex_insert(&sm->sessionsByToken, &newentry->tokenEntry,
+                            UA_NodeId_hash(&newentry->session.header.authenticationToken));
+    if(retval == UA_STATUSCODE_GOOD) {
+        retval = UA_HashIndex_insert(&sm->sessionsById, &newentry->idEntry,
+                                     UA_NodeId_hash(&newentry->session.sessionId));
+        if(retval != UA_STATUSCODE_GOOD)
+            UA_HashIndex_remove(&sm->sessionsByToken, &newentry->tokenEntry);
+    }
+    if(retval != UA_STATUSCODE_GOOD) {
+        UA_Session_deleteMembersCleanup(&newentry->session, sm->server);
+        UA_free(newentry);
+        UA_atomic_subUInt32(&sm->currentSessionCount, 1);
+        return retval;
+    }
+
     LIST_INSERT_HEAD(&sm->sessions, newentry, pointers);
+    ZIP_INSERT(UA_SessionExpiryTree, &sm->expiryTree, newentry,
+               ZIP_FFS32(UA_UInt32_random()));
     *session = &newentry->session;
     return UA_STATUSCODE_GOOD;
 }
 
 UA_StatusCode
 UA_SessionManager_removeSession(UA_SessionManager *sm, const UA_NodeId *token) {
-    session_list_entry *current;
-    LIST_FOREACH(current, &sm->sessions, pointers) {
-        if(UA_NodeId_equal(&current->session.header.authenticationToken, token))
-            break;
-    }
+    session_list_entry *current = findSessionByToken(sm, token);
     if(!current)
         return UA_STATUSCODE_BADSESSIONIDINVALID;
 
     removeSession(sm, current);
     return UA_STATUSCODE_GOOD;
 }
+
+void
+UA_SessionManager_updateLifetime(UA_SessionManager *sm, UA_Session *session) {
+    session_list_entry *sentry = container_of(session, session_list_entry, session);
+    ZIP_REMOVE(UA_SessionExpiryTree, &sm->expiryTree, sentry);
+    UA_Session_updateLifetime(session);
+    ZIP_INSERT(UA_SessionExpiryTree, &sm->expiryTree, sentry,
+               ZIP_RANK(sentry, expiryEntry));
+}
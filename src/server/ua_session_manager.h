@@ -17,17 +17,26 @@
 #include "ua_util_internal.h"
 #include "ua_session.h"
 #include "open62541_queue.h"
+#include "ziptree.h"
 
 _UA_BEGIN_DECLS
 
 typedef struct session_list_entry {
     UA_DelayedCallback cleanupCallback;
     LIST_ENTRY(session_list_entry) pointers;
+    UA_HashIndexEntry tokenEntry; /* Hash of the authenticationToken */
+    UA_HashIndexEntry idEntry;    /* Hash of the sessionId */
+    ZIP_ENTRY(session_list_entry) expiryEntry; /* Ordered by session.validTill */
     UA_Session session;
 } session_list_entry;
 
+ZIP_HEAD(UA_SessionExpiryTree, session_list_entry);
+
 typedef struct UA_SessionManager {
     LIST_HEAD(session_list, session_list_entry) sessions; // doubly-linked list of sessions
+    UA_HashIndex sessionsByToken;
+    UA_HashIndex sessionsById;
+    struct UA_SessionExpiryTree expiryTree;
     UA_UInt32 currentSessionCount;
     UA_Server *server;
 } UA_SessionManager;
@@ -40,7 +49,7 @@ void UA_SessionManager_deleteMembers(UA_SessionManager *sm);
 
 /* Deletes all sessions that have timed out. Deletion is implemented via a
  * delayed callback. So all currently scheduled jobs with a pointer to the
- * session can complete. */
+ * session can complete. Only the sessions that have timed out are visited. */
 void UA_SessionManager_cleanupTimedOut(UA_SessionManager *sm,
                                        UA_DateTime nowMonotonic);
 
@@ -57,6 +66,11 @@ UA_SessionManager_getSessionByToken(UA_SessionManager *sm, const UA_NodeId *toke
 UA_Session *
 UA_SessionManager_getSessionById(UA_SessionManager *sm, const UA_NodeId *sessionId);
 
+/* Extend the lifetime of the session after activity. The session must be
+ * managed by the SessionManager. */
+void
+UA_SessionManager_updateLifetime(UA_SessionManager *sm, UA_Session *session);
+
 _UA_END_DECLS
 
 #endif /* UA_SESSION_MANAGER_H_ */
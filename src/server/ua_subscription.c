@@ -18,6 +18,7 @@
 
 #include "ua_server_internal.h"
 #include "ua_subscription.h"
+#include "ua_types_encoding_binary.h"
 
 #ifdef UA_ENABLE_SUBSCRIPTIONS /* conditional compilation */
 
@@ -38,6 +39,7 @@ UA_Subscription_new(UA_Session *session, UA_UInt32 subscriptionId) {
     newSub->nextSequenceNumber = 1;
     TAILQ_INIT(&newSub->retransmissionQueue);
     TAILQ_INIT(&newSub->notificationQueue);
+    UA_HashIndex_init(&newSub->monitoredItemsById);
     return newSub;
 }
 
@@ -56,6 +58,7 @@ UA_Subscription_deleteMembers(UA_Server *server, UA_Subscription *sub) {
         UA_MonitoredItem_delete(server, mon);
     }
     sub->monitoredItemsSize = 0;
+    UA_HashIndex_deleteMembers(&sub->monitoredItemsById);
 
     /* Delete Retransmission Queue */
     UA_NotificationMessageEntry *nme, *nme_tmp;
@@ -75,23 +78,21 @@ UA_Subscription_deleteMembers(UA_Server *server, UA_Subscription *sub) {
 
 UA_MonitoredItem *
 UA_Subscription_getMonitoredItem(UA_Subscription *sub, UA_UInt32 monitoredItemId) {
-    UA_MonitoredItem *mon;
-    LIST_FOREACH(mon, &sub->monitoredItems, listEntry) {
+    UA_UInt32 hash = UA_HashIndex_hashUInt32(monitoredItemId);
+    UA_HashIndexEntry *e = UA_HashIndex_first(&sub->monitoredItemsById, hash);
+    for(; e; e = UA_HashIndex_next(e, hash)) {
+        UA_MonitoredItem *mon = container_of(e, UA_MonitoredItem, idEntry);
         if(mon->monitoredItemId == monitoredItemId)
-            break;
+            return mon;
     }
-    return mon;
+    return NULL;
 }
 
 UA_StatusCode
 UA_Subscription_deleteMonitoredItem(UA_Server *server, UA_Subscription *sub,
                                     UA_UInt32 monitoredItemId) {
     /* Find the MonitoredItem */
-    UA_MonitoredItem *mon;
-    LIST_FOREACH(mon, &sub->monitoredItems, listEntry) {
-        if(mon->monitoredItemId == monitoredItemId)
-            break;
-    }
+    UA_MonitoredItem *mon = UA_Subscription_getMonitoredItem(sub, monitoredItemId);
     if(!mon)
         return UA_STATUSCODE_BADMONITOREDITEMIDINVALID;
 
@@ -102,6 +103,7 @@ UA_Subscription_deleteMonitoredItem(UA_Server *server, UA_Subscription *sub,
 
     /* Remove the MonitoredItem */
     LIST_REMOVE(mon, listEntry);
+    UA_HashIndex_remove(&sub->monitoredItemsById, &mon->idEntry);
     sub->monitoredItemsSize--;
 
     /* Remove content and delayed free */
@@ -110,10 +112,16 @@ UA_Subscription_deleteMonitoredItem(UA_Server *server, UA_Subscription *sub,
     return UA_STATUSCODE_GOOD;
 }
 
-void
+UA_StatusCode
 UA_Subscription_addMonitoredItem(UA_Subscription *sub, UA_MonitoredItem *newMon) {
+    UA_StatusCode retval =
+        UA_HashIndex_insert(&sub->monitoredItemsById, &newMon->idEntry,
+                            UA_HashIndex_hashUInt32(newMon->monitoredItemId));
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
     sub->monitoredItemsSize++;
     LIST_INSERT_HEAD(&sub->monitoredItems, newMon, listEntry);
+    return UA_STATUSCODE_GOOD;
 }
 
 static void
@@ -179,6 +187,91 @@ UA_Subscription_removeRetransmissionMessage(UA_Subscription *sub, UA_UInt32 sequ
     return UA_STATUSCODE_GOOD;
 }
 
+/* Write the DataChangeNotification into the ExtensionObject in its binary
+ * encoding. The shared encodings of the values are copied into the body
+ * without decoding. The monitoredItems of the DataChangeNotification contain
+ * the clientHandle and (where no shared encoding is set) the value. If the
+ * body cannot be created, the shared encodings are decoded into the
+ * DataChangeNotification instead. Releases the shared encodings. */
+static void
+spliceDataChangeNotification(UA_ExtensionObject *eo, UA_EncodedDataValue **encodings) {
+    UA_DataChangeNotification *dcn = (UA_DataChangeNotification*)eo->content.decoded.data;
+    size_t dcnSize = dcn->monitoredItemsSize;
+
+    /* Compute the size of the body: the array of MonitoredItemNotifications
+     * and the empty array of DiagnosticInfos */
+    size_t bodySize = sizeof(UA_Int32) * 2;
+    for(size_t i = 0; i < dcnSize; i++) {
+        bodySize += sizeof(UA_UInt32);
+        if(encodings[i])
+            bodySize += encodings[i]->encoding.length;
+        else
+            bodySize += UA_calcSizeBinary(&dcn->monitoredItems[i].value,
+                                          &UA_TYPES[UA_TYPES_DATAVALUE]);
+    }
+
+    /* Encode the body */
+    UA_ByteString body;
+    UA_StatusCode retval = UA_STATUSCODE_BADENCODINGERROR;
+    if(dcnSize <= UA_INT32_MAX)
+        retval = UA_ByteString_allocBuffer(&body, bodySize);
+    if(retval == UA_STATUSCODE_GOOD) {
+        UA_Byte *bufPos = body.data;
+        const UA_Byte *bufEnd = &body.data[body.length];
+        UA_Int32 arraySize = (UA_Int32)dcnSize;
+        retval = UA_encodeBinary(&arraySize, &UA_TYPES[UA_TYPES_INT32],
+                                 &bufPos, &bufEnd, NULL, NULL);
+        for(size_t i = 0; i < dcnSize && retval == UA_STATUSCODE_GOOD; i++) {
+            UA_MonitoredItemNotification *min = &dcn->monitoredItems[i];
+            retval = UA_encodeBinary(&min->clientHandle, &UA_TYPES[UA_TYPES_UINT32],
+                                     &bufPos, &bufEnd, NULL, NULL);
+            if(retval != UA_STATUSCODE_GOOD)
+                break;
+            if(!encodings[i]) {
+                retval = UA_encodeBinary(&min->value, &UA_TYPES[UA_TYPES_DATAVALUE],
+                                         &bufPos, &bufEnd, NULL, NULL);
+                continue;
+            }
+            memcpy(bufPos, encodings[i]->encoding.data, encodings[i]->encoding.length);
+            bufPos += encodings[i]->encoding.length;
+        }
+        arraySize = -1; /* No DiagnosticInfos */
+        retval |= UA_encodeBinary(&arraySize, &UA_TYPES[UA_TYPES_INT32],
+                                  &bufPos, &bufEnd, NULL, NULL);
+        if(retval != UA_STATUSCODE_GOOD)
+            UA_ByteString_deleteMembers(&body);
+    }
+
+    if(retval == UA_STATUSCODE_GOOD) {
+        /* Replace the decoded content */
+        UA_DataChangeNotification_delete(dcn);
+        eo->encoding = UA_EXTENSIONOBJECT_ENCODED_BYTESTRING;
+        eo->content.encoded.typeId =
+            UA_NODEID_NUMERIC(0, UA_TYPES[UA_TYPES_DATACHANGENOTIFICATION].binaryEncodingId);
+        eo->content.encoded.body = body;
+    } else {
+        /* Fall back to the decoded values */
+        for(size_t i = 0; i < dcnSize; i++) {
+            if(!encodings[i])
+                continue;
+            UA_DataValue *value = &dcn->monitoredItems[i].value;
+            size_t offset = 0;
+            retval = UA_decodeBinary(&encodings[i]->encoding, &offset, value,
+                                     &UA_TYPES[UA_TYPES_DATAVALUE], NULL);
+            if(retval != UA_STATUSCODE_GOOD) {
+                value->hasStatus = true;
+                value->status = retval;
+            }
+        }
+    }
+
+    /* Release the shared encodings */
+    for(size_t i = 0; i < dcnSize; i++) {
+        if(encodings[i])
+            UA_EncodedDataValue_release(encodings[i]);
+    }
+}
+
 static UA_StatusCode
 prepareNotificationMessage(UA_Server *server, UA_Subscription *sub,
                            UA_NotificationMessage *message, size_t notifications) {
@@ -194,6 +287,7 @@ prepareNotificationMessage(UA_Server *server, UA_Subscription *sub,
     /* Pre-allocate DataChangeNotifications */
     size_t notificationDataIdx = 0;
     UA_DataChangeNotification *dcn = NULL;
+    UA_EncodedDataValue **encodings = NULL;
     if(sub->dataChangeNotifications > 0) {
         dcn = UA_DataChangeNotification_new();
         if(!dcn) {
@@ -258,10 +352,17 @@ prepareNotificationMessage(UA_Server *server, UA_Subscription *sub,
     UA_assert(notificationDataIdx > 0);
     message->notificationDataSize = notificationDataIdx;
 
+    /* Collect the shared encodings of the values. Without the array, the
+     * encodings are decoded into the DataChangeNotification. */
+    if(dcn && server->config.shareNotificationEncoding)
+        encodings = (UA_EncodedDataValue**)
+            UA_calloc(dcn->monitoredItemsSize, sizeof(UA_EncodedDataValue*));
+
     /* <-- The point of no return --> */
 
     size_t totalNotifications = 0; /* How many notifications were moved to the response overall? */
     size_t dcnPos = 0; /* How many DataChangeNotifications were put into the list? */
+    UA_Boolean sharedEncodings = false; /* Was a shared encoding moved to encodings? */
 #ifdef UA_ENABLE_SUBSCRIPTIONS_EVENTS
     size_t enlPos = 0; /* How many EventNotifications were moved into the list */
 #endif
@@ -281,6 +382,16 @@ prepareNotificationMessage(UA_Server *server, UA_Subscription *sub,
             /* Move the content to the response */
             UA_MonitoredItemNotification *min = &dcn->monitoredItems[dcnPos];
             min->clientHandle = mon->clientHandle;
+            if(notification->encodedValue) {
+                if(encodings) {
+                    encodings[dcnPos] = notification->encodedValue; /* Move the reference */
+                    notification->encodedValue = NULL;
+                    sharedEncodings = true;
+                } else if(UA_Notification_unshareValue(notification) != UA_STATUSCODE_GOOD) {
+                    notification->data.value.hasStatus = true;
+                    notification->data.value.status = UA_STATUSCODE_BADDECODINGERROR;
+                }
+            }
             min->value = notification->data.value;
             UA_DataValue_init(&notification->data.value); /* Reset after the value has been moved */
             dcnPos++;
@@ -319,6 +430,11 @@ prepareNotificationMessage(UA_Server *server, UA_Subscription *sub,
         }
     }
 
+    /* Encode the DataChangeNotification with the shared encodings */
+    if(sharedEncodings)
+        spliceDataChangeNotification(message->notificationData, encodings);
+    UA_free(encodings);
+
 #ifdef UA_ENABLE_SUBSCRIPTIONS_EVENTS
     if(enl) {
         enl->eventsSize = enlPos;
@@ -348,18 +464,40 @@ publishCallback(UA_Server *server, UA_Subscription *sub) {
     UA_Subscription_publish(server, sub);
 }
 
+/* The network layer could not send everything that was generated for the
+ * connection so far */
+static UA_Boolean
+isCongested(UA_Server *server, UA_Session *session) {
+    if(server->config.maxPendingSendBytes == 0)
+        return false;
+    UA_SecureChannel *channel = session->header.channel;
+    if(!channel || !channel->connection)
+        return false;
+    return (channel->connection->pendingSendBytes > server->config.maxPendingSendBytes);
+}
+
 void
 UA_Subscription_publish(UA_Server *server, UA_Subscription *sub) {
     UA_LOG_DEBUG_SESSION(&server->config.logger, sub->session, "Subscription %u | "
                          "Publish Callback", sub->subscriptionId);
+
+    /* Backpressure: Delay the response until the queued data has been sent.
+     * The counters advance as usual. The congested cycles count against the
+     * lifetime, also with queued publish requests. Otherwise a client that
+     * stops reading from the connection keeps the subscription alive. */
+    UA_Boolean congested = isCongested(server, sub->session);
+
     /* Dequeue a response */
-    UA_PublishResponseEntry *pre = UA_Session_dequeuePublishReq(sub->session);
+    UA_PublishResponseEntry *pre = NULL;
+    if(!congested)
+        pre = UA_Session_dequeuePublishReq(sub->session);
     if(pre) {
         sub->currentLifetimeCount = 0; /* Reset the LifetimeCounter */
     } else {
-        UA_LOG_DEBUG_SESSION(&server->config.logger, sub->session,
-                             "Subscription %u | The publish queue is empty",
-                             sub->subscriptionId);
+        if(!congested)
+            UA_LOG_DEBUG_SESSION(&server->config.logger, sub->session,
+                                 "Subscription %u | The publish queue is empty",
+                                 sub->subscriptionId);
         ++sub->currentLifetimeCount;
 
         if(sub->currentLifetimeCount > sub->lifeTimeCount) {
@@ -400,6 +538,14 @@ UA_Subscription_publish(UA_Server *server, UA_Subscription *sub) {
                              sub->subscriptionId);
     }
 
+    /* The notifications remain in the queue for the next publish cycle */
+    if(congested) {
+        UA_LOG_DEBUG_SESSION(&server->config.logger, sub->session,
+                             "Subscription %u | The connection is congested. "
+                             "Delay the publish response.", sub->subscriptionId);
+        return;
+    }
+
     /* We want to send a response. Is the channel open? */
     UA_SecureChannel *channel = sub->session->header.channel;
     if(!channel || !pre) {
@@ -556,8 +702,9 @@ Subscription_registerPublishCallback(UA_Server *server, UA_Subscription *sub) {
         return UA_STATUSCODE_GOOD;
 
     UA_StatusCode retval =
-        UA_Server_addRepeatedCallback(server, (UA_ServerCallback)publishCallback,
-                                      sub, (UA_UInt32)sub->publishingInterval, &sub->publishCallbackId);
+        UA_Server_addRepeatedCallbackInternal(server, (UA_ServerCallback)publishCallback,
+                                              sub, (UA_UInt32)sub->publishingInterval,
+                                              &sub->publishCallbackId);
     if(retval != UA_STATUSCODE_GOOD)
         return retval;
 
@@ -573,7 +720,7 @@ Subscription_unregisterPublishCallback(UA_Server *server, UA_Subscription *sub)
     if(!sub->publishCallbackIsRegistered)
         return;
 
-    UA_Server_removeRepeatedCallback(server, sub->publishCallbackId);
+    UA_Server_removeRepeatedCallbackInternal(server, sub->publishCallbackId);
     sub->publishCallbackIsRegistered = false;
 }
 
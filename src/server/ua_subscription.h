@@ -18,6 +18,7 @@
 #include "ua_types.h"
 #include "ua_types_generated.h"
 #include "ua_session.h"
+#include "ziptree.h"
 
 _UA_BEGIN_DECLS
 
@@ -56,12 +57,31 @@ typedef struct UA_EventNotification {
 } UA_EventNotification;
 #endif
 
+/* The binary encoding of a sampled DataValue. If the same sample is reported
+ * by several MonitoredItems, their notifications share the encoding (see
+ * shareNotificationEncoding in the server config). The encoding is written
+ * into the PublishResponse as-is. */
+typedef struct {
+    UA_UInt32 refCount;
+    UA_ByteString encoding;
+} UA_EncodedDataValue;
+
+/* Returns the encoding with a reference count of one or NULL */
+UA_EncodedDataValue * UA_EncodedDataValue_new(const UA_DataValue *value);
+
+/* Decrease the reference count. Frees the encoding when it reaches zero. */
+void UA_EncodedDataValue_release(UA_EncodedDataValue *ev);
+
 typedef struct UA_Notification {
     TAILQ_ENTRY(UA_Notification) listEntry; /* Notification list for the MonitoredItem */
     TAILQ_ENTRY(UA_Notification) globalEntry; /* Notification list for the Subscription */
 
     UA_MonitoredItem *mon;
 
+    /* If set, the value of a datachange notification is contained in the
+     * shared encoding and data.value is empty */
+    UA_EncodedDataValue *encodedValue;
+
     /* See the monitoredItemType of the MonitoredItem */
     union {
 #ifdef UA_ENABLE_SUBSCRIPTIONS_EVENTS
@@ -80,14 +100,90 @@ void UA_Notification_enqueue(UA_Server *server, UA_Subscription *sub,
  * global queue. Reduce the respective counters. */
 void UA_Notification_dequeue(UA_Server *server, UA_Notification *n);
 
-/* Delete the notification. Must be dequeued first. */
+/* Decode the shared encoding into data.value and release the reference. The
+ * value is edited before publication (e.g. the overflow infobits). */
+UA_StatusCode UA_Notification_unshareValue(UA_Notification *n);
+
+/* Take a notification from the cache of the MonitoredItem or allocate a new
+ * one. Returns NULL if no memory could be allocated. */
+UA_Notification * UA_Notification_new(UA_MonitoredItem *mon);
+
+/* Delete the notification. Must be dequeued first. The memory is kept in the
+ * cache of the MonitoredItem for reuse if the cache is not full. */
 void UA_Notification_delete(UA_Notification *n);
 
+/* Upper bound of deleted notifications cached per MonitoredItem. Large queues
+ * don't keep their peak memory around. */
+#define UA_NOTIFICATIONCACHE_MAXSIZE 8
+
 typedef TAILQ_HEAD(NotificationQueue, UA_Notification) NotificationQueue;
 
+/* MonitoredItems that sample the same attribute (NodeId, AttributeId,
+ * IndexRange and TimestampsToReturn) with the same interval share the sample.
+ * The attribute is read once and the value is handed to the change detection
+ * of every MonitoredItem. The session-dependent attributes (e.g.
+ * UserAccessLevel) are shared only within the session. For the value
+ * attribute, the access rights are checked for every MonitoredItem. A
+ * DataSource is read in the context of the first MonitoredItem with access
+ * rights. */
+typedef struct {
+    UA_UInt32 nodeIdHash;
+    UA_NodeId nodeId;
+    UA_UInt32 attributeId;
+    UA_String indexRange;
+    UA_TimestampsToReturn timestampsToReturn;
+    const UA_Session *session; /* Only set for the session-dependent attributes */
+} UA_SampleKey;
+
+typedef struct UA_SharedSample {
+    ZIP_ENTRY(UA_SharedSample) zipfields;
+    UA_SampleKey key;
+    size_t index; /* Position in the array of the SamplingGroup */
+    LIST_HEAD(, UA_MonitoredItem) monitoredItems;
+    UA_MonitoredItem *nextMonitoredItem; /* Iteration cursor during sampling */
+    UA_Boolean sampling;
+    LIST_ENTRY(UA_SharedSample) removedEntry;
+} UA_SharedSample;
+
+ZIP_HEAD(UA_SharedSampleTree, UA_SharedSample);
+
+void UA_SharedSample_sample(UA_Server *server, UA_SharedSample *ss);
+
+/* MonitoredItems with a sampling interval of zero report by exception. They
+ * are kept in a SamplingGroup without a repeated callback. Their SharedSamples
+ * are keyed by the NodeId only and are sampled when the value is written. */
+void UA_MonitoredItem_reportWrite(UA_Server *server, const UA_NodeId *nodeId);
+
+/* The value of the node can change without a write (a DataSource or an onRead
+ * callback was set). Its report-by-exception MonitoredItems are moved to a
+ * SamplingGroup with the smallest possible sampling interval. */
+void UA_MonitoredItem_stopReportByException(UA_Server *server, const UA_NodeId *nodeId);
+
+/* DataChange MonitoredItems with the same sampling interval are sampled
+ * together. The SamplingGroup registers a single repeated callback that walks
+ * the array of its SharedSamples. Clients typically create many
+ * MonitoredItems with a handful of different sampling intervals. */
+typedef struct UA_SamplingGroup {
+    UA_DelayedCallback delayedFreePointers;
+    LIST_ENTRY(UA_SamplingGroup) listEntry;
+    UA_Double samplingInterval; /* [ms] */
+    UA_UInt64 sampleCallbackId;
+    struct UA_SharedSampleTree samplesTree; /* Lookup by the UA_SampleKey */
+    UA_SharedSample **samples;
+    size_t samplesSize;
+    size_t samplesCapacity;
+
+    /* SharedSamples removed during sampling are set to NULL in the array and
+     * kept in a list. They are freed and the array is compacted when the
+     * sampling is done. */
+    UA_Boolean sampling;
+    LIST_HEAD(, UA_SharedSample) removedSamples;
+} UA_SamplingGroup;
+
 struct UA_MonitoredItem {
     UA_DelayedCallback delayedFreePointers;
     LIST_ENTRY(UA_MonitoredItem) listEntry;
+    UA_HashIndexEntry idEntry; /* Lookup by the monitoredItemId */
     UA_Subscription *subscription;
     UA_UInt32 monitoredItemId;
     UA_UInt32 clientHandle;
@@ -101,7 +197,7 @@ struct UA_MonitoredItem {
     UA_NodeId monitoredNodeId;
     UA_UInt32 attributeId;
     UA_String indexRange;
-    UA_Double samplingInterval; // [ms]
+    UA_Double samplingInterval; /* [ms] Zero for report-by-exception */
     UA_UInt32 maxQueueSize; /* The max number of enqueued notifications (not
                                counting overflow events) */
     UA_Boolean discardOldest;
@@ -115,13 +211,22 @@ struct UA_MonitoredItem {
     UA_Variant lastValue;
 
     /* Sample Callback */
-    UA_UInt64 sampleCallbackId;
+    UA_SamplingGroup *samplingGroup;
+    UA_SharedSample *sharedSample;
+    LIST_ENTRY(UA_MonitoredItem) sharedSampleEntry;
     UA_ByteString lastSampledValue;
     UA_Boolean sampleCallbackIsRegistered;
 
     /* Notification Queue */
     NotificationQueue queue;
     UA_UInt32 queueSize;
+
+    /* Cache of deleted notifications for reuse. Filled lazily when
+     * notifications are deleted. Holds up to maxQueueSize + 1 entries (the new
+     * notification is enqueued before the queue is trimmed), but no more than
+     * UA_NOTIFICATIONCACHE_MAXSIZE. */
+    NotificationQueue notificationCache;
+    UA_UInt32 notificationCacheSize;
      /* Save the amount of OverflowEvents in a separate counter */
      UA_UInt32 eventOverflows;
 #ifdef UA_ENABLE_SUBSCRIPTIONS_EVENTS
@@ -134,6 +239,9 @@ struct UA_MonitoredItem {
 };
 
 void UA_MonitoredItem_init(UA_MonitoredItem *mon, UA_Subscription *sub);
+
+/* Remove cached notifications if the maxQueueSize was reduced */
+void UA_MonitoredItem_trimNotificationCache(UA_MonitoredItem *mon);
 void UA_MonitoredItem_delete(UA_Server *server, UA_MonitoredItem *mon);
 void UA_MonitoredItem_sampleCallback(UA_Server *server, UA_MonitoredItem *mon);
 UA_StatusCode UA_MonitoredItem_registerSampleCallback(UA_Server *server, UA_MonitoredItem *mon);
@@ -193,6 +301,7 @@ struct UA_Subscription {
     /* MonitoredItems */
     UA_UInt32 lastMonitoredItemId; /* increase the identifiers */
     LIST_HEAD(UA_ListOfUAMonitoredItems, UA_MonitoredItem) monitoredItems;
+    UA_HashIndex monitoredItemsById;
     UA_UInt32 monitoredItemsSize;
 
     /* Global list of notifications from the MonitoredItems */
@@ -217,7 +326,7 @@ UA_Subscription * UA_Subscription_new(UA_Session *session, UA_UInt32 subscriptio
 void UA_Subscription_deleteMembers(UA_Server *server, UA_Subscription *sub);
 UA_StatusCode Subscription_registerPublishCallback(UA_Server *server, UA_Subscription *sub);
 void Subscription_unregisterPublishCallback(UA_Server *server, UA_Subscription *sub);
-void UA_Subscription_addMonitoredItem(UA_Subscription *sub, UA_MonitoredItem *newMon);
+UA_StatusCode UA_Subscription_addMonitoredItem(UA_Subscription *sub, UA_MonitoredItem *newMon);
 UA_MonitoredItem * UA_Subscription_getMonitoredItem(UA_Subscription *sub, UA_UInt32 monitoredItemId);
 
 UA_StatusCode
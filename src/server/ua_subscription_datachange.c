@@ -291,12 +291,63 @@ detectValueChange(UA_Server *server, UA_MonitoredItem *mon,
     return detectValueChangeWithFilter(server, mon, &value, encoding, changed);
 }
 
+UA_EncodedDataValue *
+UA_EncodedDataValue_new(const UA_DataValue *value) {
+    /* Allocate the encoding together with the structure */
+    size_t binsize = UA_calcSizeBinary(value, &UA_TYPES[UA_TYPES_DATAVALUE]);
+    if(binsize == 0)
+        return NULL;
+    UA_EncodedDataValue *ev = (UA_EncodedDataValue*)
+        UA_malloc(sizeof(UA_EncodedDataValue) + binsize);
+    if(!ev)
+        return NULL;
+    ev->refCount = 1;
+    ev->encoding.data = (UA_Byte*)ev + sizeof(UA_EncodedDataValue);
+    ev->encoding.length = binsize;
+
+    /* Encode the value */
+    UA_Byte *bufPos = ev->encoding.data;
+    const UA_Byte *bufEnd = &ev->encoding.data[binsize];
+    UA_StatusCode retval = UA_encodeBinary(value, &UA_TYPES[UA_TYPES_DATAVALUE],
+                                           &bufPos, &bufEnd, NULL, NULL);
+    if(retval != UA_STATUSCODE_GOOD) {
+        UA_free(ev);
+        return NULL;
+    }
+    return ev;
+}
+
+void
+UA_EncodedDataValue_release(UA_EncodedDataValue *ev) {
+    /* The encoding is not changed after creation. Notifications of different
+     * Subscriptions can release concurrently. */
+    if(UA_atomic_subUInt32(&ev->refCount, 1) == 0)
+        UA_free(ev);
+}
+
+UA_StatusCode
+UA_Notification_unshareValue(UA_Notification *n) {
+    UA_EncodedDataValue *ev = n->encodedValue;
+    if(!ev)
+        return UA_STATUSCODE_GOOD;
+    size_t offset = 0;
+    UA_StatusCode retval = UA_decodeBinary(&ev->encoding, &offset, &n->data.value,
+                                           &UA_TYPES[UA_TYPES_DATAVALUE], NULL);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+    n->encodedValue = NULL;
+    UA_EncodedDataValue_release(ev);
+    return UA_STATUSCODE_GOOD;
+}
+
 /* movedValue returns whether the sample was moved to the notification. The
- * default is false. */
+ * default is false. If sharedEncoding is set, the notification references the
+ * (lazily created) encoding of the sample instead of copying the value. */
 static UA_StatusCode
 sampleCallbackWithValue(UA_Server *server, UA_Session *session,
                         UA_Subscription *sub, UA_MonitoredItem *mon,
-                        UA_DataValue *value, UA_Boolean *movedValue) {
+                        UA_DataValue *value, UA_Boolean *movedValue,
+                        UA_EncodedDataValue **sharedEncoding) {
     UA_assert(mon->monitoredItemType == UA_MONITOREDITEMTYPE_CHANGENOTIFY);
 
     /* Contains heap-allocated binary encoding of the value if a change was detected */
@@ -324,20 +375,33 @@ sampleCallbackWithValue(UA_Server *server, UA_Session *session,
      * Prepare a notification and enqueue it. */
     if(sub) {
         /* Allocate a new notification */
-        UA_Notification *newNotification = (UA_Notification *)UA_malloc(sizeof(UA_Notification));
+        UA_Notification *newNotification = UA_Notification_new(mon);
         if(!newNotification) {
             UA_ByteString_deleteMembers(&binValueEncoding);
             return UA_STATUSCODE_BADOUTOFMEMORY;
         }
 
-        if(value->value.storageType == UA_VARIANT_DATA) {
+        /* Reference the shared encoding */
+        if(sharedEncoding) {
+            if(!*sharedEncoding)
+                *sharedEncoding = UA_EncodedDataValue_new(value);
+            if(*sharedEncoding) {
+                UA_atomic_addUInt32(&(*sharedEncoding)->refCount, 1);
+                newNotification->encodedValue = *sharedEncoding;
+                UA_DataValue_init(&newNotification->data.value);
+            }
+        }
+
+        if(newNotification->encodedValue) {
+            /* Nothing to do */
+        } else if(value->value.storageType == UA_VARIANT_DATA) {
             newNotification->data.value = *value; /* Move the value to the notification */
             *movedValue = true;
         } else { /* => (value->value.storageType == UA_VARIANT_DATA_NODELETE) */
             retval = UA_DataValue_copy(value, &newNotification->data.value);
             if(retval != UA_STATUSCODE_GOOD) {
                 UA_ByteString_deleteMembers(&binValueEncoding);
-                UA_free(newNotification);
+                UA_Notification_delete(newNotification);
                 return retval;
             }
         }
@@ -348,7 +412,6 @@ sampleCallbackWithValue(UA_Server *server, UA_Session *session,
                              "MonitoredItem %i | Enqueue a new notification",
                              sub ? sub->subscriptionId : 0, mon->monitoredItemId);
 
-        newNotification->mon = mon;
         UA_Notification_enqueue(server, sub, mon, newNotification);
     }
 
@@ -391,6 +454,41 @@ sampleCallbackWithValue(UA_Server *server, UA_Session *session,
     return UA_STATUSCODE_GOOD;
 }
 
+/* Sample the MonitoredItem with its own settings. The node can be NULL. */
+static void
+sampleWithNode(UA_Server *server, UA_Session *session, UA_Subscription *sub,
+               UA_MonitoredItem *monitoredItem, const UA_Node *node) {
+    /* Sample the value. The sample can still point into the node. */
+    UA_DataValue value;
+    UA_DataValue_init(&value);
+    if(node) {
+        UA_ReadValueId rvid;
+        UA_ReadValueId_init(&rvid);
+        rvid.nodeId = monitoredItem->monitoredNodeId;
+        rvid.attributeId = monitoredItem->attributeId;
+        rvid.indexRange = monitoredItem->indexRange;
+        ReadWithNode(node, server, session, monitoredItem->timestampsToReturn, &rvid, &value);
+    } else {
+        value.hasStatus = true;
+        value.status = UA_STATUSCODE_BADNODEIDUNKNOWN;
+    }
+
+    /* Operate on the sample */
+    UA_Boolean movedValue = false;
+    UA_StatusCode retval = sampleCallbackWithValue(server, session, sub, monitoredItem,
+                                                   &value, &movedValue, NULL);
+    if(retval != UA_STATUSCODE_GOOD) {
+        UA_LOG_WARNING_SESSION(&server->config.logger, session, "Subscription %u | "
+                               "MonitoredItem %i | Sampling returned the statuscode %s",
+                               sub ? sub->subscriptionId : 0, monitoredItem->monitoredItemId,
+                               UA_StatusCode_name(retval));
+    }
+
+    /* Delete the sample if it was not moved to the notification. */
+    if(!movedValue)
+        UA_DataValue_deleteMembers(&value); /* Does nothing for UA_VARIANT_DATA_NODELETE */
+}
+
 void
 UA_MonitoredItem_sampleCallback(UA_Server *server, UA_MonitoredItem *monitoredItem) {
     UA_Subscription *sub = monitoredItem->subscription;
@@ -411,35 +509,94 @@ UA_MonitoredItem_sampleCallback(UA_Server *server, UA_MonitoredItem *monitoredIt
 
     /* Get the node */
     const UA_Node *node = UA_Nodestore_get(server, &monitoredItem->monitoredNodeId);
+    sampleWithNode(server, session, sub, monitoredItem, node);
+    if(node)
+        UA_Nodestore_release(server, node);
+}
 
-    /* Sample the value. The sample can still point into the node. */
+void
+UA_SharedSample_sample(UA_Server *server, UA_SharedSample *ss) {
+    /* Get the node */
+    const UA_Node *node = UA_Nodestore_get(server, &ss->key.nodeId);
+
+    UA_ReadValueId rvid;
+    UA_ReadValueId_init(&rvid);
+    rvid.nodeId = ss->key.nodeId;
+    rvid.attributeId = ss->key.attributeId;
+    rvid.indexRange = ss->key.indexRange;
+
+    /* The value is read once for the first MonitoredItem with access rights */
     UA_DataValue value;
     UA_DataValue_init(&value);
-    if(node) {
-        UA_ReadValueId rvid;
-        UA_ReadValueId_init(&rvid);
-        rvid.nodeId = monitoredItem->monitoredNodeId;
-        rvid.attributeId = monitoredItem->attributeId;
-        rvid.indexRange = monitoredItem->indexRange;
-        ReadWithNode(node, server, session, monitoredItem->timestampsToReturn, &rvid, &value);
-    } else {
+    UA_Boolean sampled = false;
+    UA_EncodedDataValue *encoding = NULL; /* Created with the first notification */
+    if(!node) {
         value.hasStatus = true;
         value.status = UA_STATUSCODE_BADNODEIDUNKNOWN;
+        sampled = true;
     }
 
-    /* Operate on the sample */
-    UA_Boolean movedValue = false;
-    UA_StatusCode retval = sampleCallbackWithValue(server, session, sub, monitoredItem, &value, &movedValue);
-    if(retval != UA_STATUSCODE_GOOD) {
-        UA_LOG_WARNING_SESSION(&server->config.logger, session, "Subscription %u | "
-                               "MonitoredItem %i | Sampling returned the statuscode %s",
-                               sub ? sub->subscriptionId : 0, monitoredItem->monitoredItemId,
-                               UA_StatusCode_name(retval));
+    /* The callback of a local MonitoredItem can remove MonitoredItems. Then the
+     * cursor is moved forward. */
+    ss->sampling = true;
+    UA_MonitoredItem *mon = LIST_FIRST(&ss->monitoredItems);
+    while(mon) {
+        ss->nextMonitoredItem = LIST_NEXT(mon, sharedSampleEntry);
+        UA_Subscription *sub = mon->subscription;
+        UA_Session *session = &server->adminSession;
+        if(sub)
+            session = sub->session;
+
+        /* Report-by-exception reads the written value with the settings of
+         * the MonitoredItem */
+        if(mon->samplingInterval == 0.0) {
+            sampleWithNode(server, session, sub, mon, node);
+            mon = ss->nextMonitoredItem;
+            continue;
+        }
+
+        /* Check the access rights of the session. Then make a shallow copy of
+         * the sample. The notification copies the value if required. */
+        UA_DataValue sample;
+        UA_EncodedDataValue **sharedEncoding = NULL;
+        UA_StatusCode retval = UA_STATUSCODE_GOOD;
+        if(node)
+            retval = checkReadAccess(server, session, node, ss->key.attributeId);
+        if(retval != UA_STATUSCODE_GOOD) {
+            UA_DataValue_init(&sample);
+            sample.hasStatus = true;
+            sample.status = retval;
+        } else {
+            if(server->config.shareNotificationEncoding)
+                sharedEncoding = &encoding;
+            if(!sampled) {
+                ReadWithNode(node, server, session, ss->key.timestampsToReturn,
+                             &rvid, &value);
+                sampled = true;
+            }
+            sample = value;
+            sample.value.storageType = UA_VARIANT_DATA_NODELETE;
+        }
+
+        /* Operate on the sample */
+        UA_Boolean movedValue = false;
+        retval = sampleCallbackWithValue(server, session, sub, mon, &sample,
+                                         &movedValue, sharedEncoding);
+        UA_assert(!movedValue);
+        if(retval != UA_STATUSCODE_GOOD) {
+            UA_LOG_WARNING_SESSION(&server->config.logger, session, "Subscription %u | "
+                                   "MonitoredItem %i | Sampling returned the statuscode %s",
+                                   sub ? sub->subscriptionId : 0, mon->monitoredItemId,
+                                   UA_StatusCode_name(retval));
+        }
+        mon = ss->nextMonitoredItem;
     }
+    ss->nextMonitoredItem = NULL;
+    ss->sampling = false;
 
-    /* Delete the sample if it was not moved to the notification. */
-    if(!movedValue)
-        UA_DataValue_deleteMembers(&value); /* Does nothing for UA_VARIANT_DATA_NODELETE */
+    if(encoding)
+        UA_EncodedDataValue_release(encoding);
+    UA_DataValue_deleteMembers(&value); /* Does nothing for UA_VARIANT_DATA_NODELETE */
     if(node)
         UA_Nodestore_release(server, node);
 }
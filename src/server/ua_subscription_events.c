@@ -77,9 +77,8 @@ UA_Server_createEvent(UA_Server *server, const UA_NodeId eventType, UA_NodeId *o
     }
 
     /* Make sure the eventType is a subtype of BaseEventType */
-    UA_NodeId hasSubtypeId = UA_NODEID_NUMERIC(0, UA_NS0ID_HASSUBTYPE);
     UA_NodeId baseEventTypeId = UA_NODEID_NUMERIC(0, UA_NS0ID_BASEEVENTTYPE);
-    if(!isNodeInTree(&server->config.nodestore, &eventType, &baseEventTypeId, &hasSubtypeId, 1)) {
+    if(!isSubtypeOf(server, &eventType, &baseEventTypeId)) {
         UA_LOG_ERROR(&server->config.logger, UA_LOGCATEGORY_USERLAND,
                      "Event type must be a subtype of BaseEventType!");
         return UA_STATUSCODE_BADINVALIDARGUMENT;
@@ -163,10 +162,8 @@ isValidEvent(UA_Server *server, const UA_NodeId *validEventParent, const UA_Node
      * (ConditionId Clause won't be present in Events, which are not Conditions)
      * Second check for Events which are Conditions or Alarms (Part 9 not supported yet) */
     UA_NodeId conditionTypeId = UA_NODEID_NUMERIC(0, UA_NS0ID_CONDITIONTYPE);
-    UA_NodeId hasSubtypeId = UA_NODEID_NUMERIC(0, UA_NS0ID_HASSUBTYPE);
     if(UA_NodeId_equal(validEventParent, &conditionTypeId) ||
-       isNodeInTree(&server->config.nodestore, tEventType,
-                     &conditionTypeId, &hasSubtypeId, 1)){
+       isSubtypeOf(server, tEventType, &conditionTypeId)){
         UA_LOG_ERROR(&server->config.logger, UA_LOGCATEGORY_USERLAND,
                      "Alarms and Conditions are not supported yet!");
         UA_BrowsePathResult_deleteMembers(&bpr);
@@ -176,8 +173,7 @@ isValidEvent(UA_Server *server, const UA_NodeId *validEventParent, const UA_Node
 
     /* check whether Valid Event other than Conditions */
     UA_NodeId baseEventTypeId = UA_NODEID_NUMERIC(0, UA_NS0ID_BASEEVENTTYPE);
-    UA_Boolean isSubtypeOfBaseEvent = isNodeInTree(&server->config.nodestore, tEventType,
-                                                   &baseEventTypeId, &hasSubtypeId, 1);
+    UA_Boolean isSubtypeOfBaseEvent = isSubtypeOf(server, tEventType, &baseEventTypeId);
 
     UA_BrowsePathResult_deleteMembers(&bpr);
     UA_Variant_deleteMembers(&tOutVariant);
@@ -375,8 +371,7 @@ getParentsNodeIteratorCallback(UA_NodeId parentId, UA_Boolean isInverse,
         return UA_STATUSCODE_GOOD;
 
     /* Is this a hierarchical reference? */
-    if(!isNodeInTree(&handle->server->config.nodestore, &referenceTypeId,
-                     &hierarchicalReferences, &subtypeId, 1))
+    if(!isSubtypeOf(handle->server, &referenceTypeId, &hierarchicalReferences))
         return UA_STATUSCODE_GOOD;
 
     Events_nodeListElement *entry = (Events_nodeListElement *) UA_malloc(sizeof(Events_nodeListElement));
@@ -401,7 +396,7 @@ getParentsNodeIteratorCallback(UA_NodeId parentId, UA_Boolean isInverse,
 static UA_StatusCode
 UA_Event_addEventToMonitoredItem(UA_Server *server, const UA_NodeId *event,
                                  UA_MonitoredItem *mon) {
-    UA_Notification *notification = (UA_Notification *) UA_malloc(sizeof(UA_Notification));
+    UA_Notification *notification = UA_Notification_new(mon);
     if(!notification)
         return UA_STATUSCODE_BADOUTOFMEMORY;
 
@@ -410,16 +405,16 @@ UA_Event_addEventToMonitoredItem(UA_Server *server, const UA_NodeId *event,
     UA_Session *session = sub->session;
 
     /* Apply the filter */
+    UA_EventFieldList_init(&notification->data.event.fields);
     UA_StatusCode retval = UA_Server_filterEvent(server, session, event,
                                                  &mon->filter.eventFilter,
                                                  &notification->data.event);
     if(retval != UA_STATUSCODE_GOOD) {
-        UA_free(notification);
+        UA_Notification_delete(notification);
         return retval;
     }
 
     /* Enqueue the notification */
-    notification->mon = mon;
     UA_Notification_enqueue(server, mon->subscription, mon, notification);
     return UA_STATUSCODE_GOOD;
 }
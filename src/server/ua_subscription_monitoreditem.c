@@ -34,9 +34,8 @@ UA_Notification_isOverflowEvent(UA_Server *server, UA_Notification *n) {
     UA_EventFieldList *efl = &n->data.event.fields;
     if(efl->eventFieldsSize == 1 &&
        efl->eventFields[0].type == &UA_TYPES[UA_TYPES_NODEID] &&
-       isNodeInTree(&server->config.nodestore,
-                    (const UA_NodeId *)efl->eventFields[0].data,
-                    &overflowEventType, &subtypeId, 1)) {
+       isSubtypeOf(server, (const UA_NodeId *)efl->eventFields[0].data,
+                   &overflowEventType)) {
         return true;
     }
 
@@ -45,16 +44,14 @@ UA_Notification_isOverflowEvent(UA_Server *server, UA_Notification *n) {
 
 static UA_Notification *
 createEventOverflowNotification(UA_MonitoredItem *mon) {
-    UA_Notification *overflowNotification = (UA_Notification *) UA_malloc(sizeof(UA_Notification));
+    UA_Notification *overflowNotification = UA_Notification_new(mon);
     if(!overflowNotification)
         return NULL;
 
-    overflowNotification->mon = mon;
     UA_EventFieldList_init(&overflowNotification->data.event.fields);
     overflowNotification->data.event.fields.eventFields = UA_Variant_new();
     if(!overflowNotification->data.event.fields.eventFields) {
-        UA_EventFieldList_deleteMembers(&overflowNotification->data.event.fields);
-        UA_free(overflowNotification);
+        UA_Notification_delete(overflowNotification);
         return NULL;
     }
 
@@ -63,8 +60,7 @@ createEventOverflowNotification(UA_MonitoredItem *mon) {
         UA_Variant_setScalarCopy(overflowNotification->data.event.fields.eventFields,
                                  &simpleOverflowEventType, &UA_TYPES[UA_TYPES_NODEID]);
     if(retval != UA_STATUSCODE_GOOD) {
-        UA_EventFieldList_deleteMembers(&overflowNotification->data.event.fields);
-        UA_free(overflowNotification);
+        UA_Notification_delete(overflowNotification);
         return NULL;
     }
 
@@ -125,12 +121,39 @@ UA_Notification_dequeue(UA_Server *server, UA_Notification *n) {
     --sub->notificationQueueSize;
 }
 
+static UA_UInt32
+notificationCacheCapacity(const UA_MonitoredItem *mon) {
+    if(mon->maxQueueSize < UA_NOTIFICATIONCACHE_MAXSIZE)
+        return mon->maxQueueSize + 1;
+    return UA_NOTIFICATIONCACHE_MAXSIZE;
+}
+
+UA_Notification *
+UA_Notification_new(UA_MonitoredItem *mon) {
+    UA_Notification *n = TAILQ_FIRST(&mon->notificationCache);
+    if(n) {
+        TAILQ_REMOVE(&mon->notificationCache, n, listEntry);
+        --mon->notificationCacheSize;
+    } else {
+        n = (UA_Notification*)UA_malloc(sizeof(UA_Notification));
+        if(!n)
+            return NULL;
+    }
+    n->mon = mon;
+    n->encodedValue = NULL;
+    return n;
+}
+
 void
 UA_Notification_delete(UA_Notification *n) {
     UA_MonitoredItem *mon = n->mon;
 
     if(mon->monitoredItemType == UA_MONITOREDITEMTYPE_CHANGENOTIFY) {
         UA_DataValue_deleteMembers(&n->data.value);
+        if(n->encodedValue) {
+            UA_EncodedDataValue_release(n->encodedValue);
+            n->encodedValue = NULL;
+        }
 #ifdef UA_ENABLE_SUBSCRIPTIONS_EVENTS
     } else if(mon->monitoredItemType == UA_MONITOREDITEMTYPE_EVENTNOTIFY) {
         UA_EventFieldList_deleteMembers(&n->data.event.fields);
@@ -141,6 +164,12 @@ UA_Notification_delete(UA_Notification *n) {
         /* Nothing to do */
     }
 
+    /* Keep the memory for reuse */
+    if(mon->notificationCacheSize < notificationCacheCapacity(mon)) {
+        TAILQ_INSERT_HEAD(&mon->notificationCache, n, listEntry);
+        ++mon->notificationCacheSize;
+        return;
+    }
     UA_free(n);
 }
 
@@ -153,6 +182,18 @@ UA_MonitoredItem_init(UA_MonitoredItem *mon, UA_Subscription *sub) {
     memset(mon, 0, sizeof(UA_MonitoredItem));
     mon->subscription = sub;
     TAILQ_INIT(&mon->queue);
+    TAILQ_INIT(&mon->notificationCache);
+}
+
+void
+UA_MonitoredItem_trimNotificationCache(UA_MonitoredItem *mon) {
+    UA_UInt32 capacity = notificationCacheCapacity(mon);
+    while(mon->notificationCacheSize > capacity) {
+        UA_Notification *n = TAILQ_FIRST(&mon->notificationCache);
+        TAILQ_REMOVE(&mon->notificationCache, n, listEntry);
+        --mon->notificationCacheSize;
+        UA_free(n);
+    }
 }
 
 void
@@ -219,6 +260,14 @@ UA_MonitoredItem_delete(UA_Server *server, UA_MonitoredItem *monitoredItem) {
     UA_Variant_deleteMembers(&monitoredItem->lastValue);
     UA_NodeId_deleteMembers(&monitoredItem->monitoredNodeId);
 
+    /* Free the cached notifications */
+    UA_Notification *n, *n_tmp;
+    TAILQ_FOREACH_SAFE(n, &monitoredItem->notificationCache, listEntry, n_tmp) {
+        TAILQ_REMOVE(&monitoredItem->notificationCache, n, listEntry);
+        UA_free(n);
+    }
+    monitoredItem->notificationCacheSize = 0;
+
     /* No actual callback, just remove the structure */
     monitoredItem->delayedFreePointers.callback = NULL;
     UA_WorkQueue_enqueueDelayed(&server->workQueue, &monitoredItem->delayedFreePointers);
@@ -342,6 +391,13 @@ UA_MonitoredItem_ensureQueueSpace(UA_Server *server, UA_MonitoredItem *mon) {
     if(mon->monitoredItemType == UA_MONITOREDITEMTYPE_CHANGENOTIFY) {
         /* Set the infobits */
         if(mon->maxQueueSize > 1) {
+            /* The infobits are specific to the notification */
+            if(indicator->encodedValue) {
+                UA_StatusCode retval = UA_Notification_unshareValue(indicator);
+                if(retval != UA_STATUSCODE_GOOD)
+                    return retval;
+            }
+
             /* Add the infobits either to the newest or the new last entry */
             indicator->data.value.hasStatus = true;
             indicator->data.value.status |= (UA_STATUSCODE_INFOTYPE_DATAVALUE |
@@ -356,6 +412,365 @@ UA_MonitoredItem_ensureQueueSpace(UA_Server *server, UA_MonitoredItem *mon) {
     return UA_STATUSCODE_GOOD;
 }
 
+/*****************/
+/* SharedSamples */
+/*****************/
+
+static enum ZIP_CMP
+cmpString(const UA_String *a, const UA_String *b) {
+    if(a->length != b->length)
+        return (a->length < b->length) ? ZIP_CMP_LESS : ZIP_CMP_MORE;
+    if(a->length == 0)
+        return ZIP_CMP_EQ;
+    int cmp = memcmp(a->data, b->data, a->length);
+    if(cmp == 0)
+        return ZIP_CMP_EQ;
+    return (cmp < 0) ? ZIP_CMP_LESS : ZIP_CMP_MORE;
+}
+
+static enum ZIP_CMP
+cmpNodeId(const UA_NodeId *a, const UA_NodeId *b) {
+    if(a->namespaceIndex != b->namespaceIndex)
+        return (a->namespaceIndex < b->namespaceIndex) ? ZIP_CMP_LESS : ZIP_CMP_MORE;
+    if(a->identifierType != b->identifierType)
+        return (a->identifierType < b->identifierType) ? ZIP_CMP_LESS : ZIP_CMP_MORE;
+    switch(a->identifierType) {
+    case UA_NODEIDTYPE_NUMERIC:
+        if(a->identifier.numeric == b->identifier.numeric)
+            return ZIP_CMP_EQ;
+        return (a->identifier.numeric < b->identifier.numeric) ?
+            ZIP_CMP_LESS : ZIP_CMP_MORE;
+    case UA_NODEIDTYPE_GUID: {
+        int cmp = memcmp(&a->identifier.guid, &b->identifier.guid, sizeof(UA_Guid));
+        if(cmp == 0)
+            return ZIP_CMP_EQ;
+        return (cmp < 0) ? ZIP_CMP_LESS : ZIP_CMP_MORE; }
+    default: /* String and ByteString */
+        return cmpString(&a->identifier.string, &b->identifier.string);
+    }
+}
+
+/* The keys are unique within the SamplingGroup */
+static enum ZIP_CMP
+cmpSampleKey(const UA_SampleKey *a, const UA_SampleKey *b) {
+    if(a->nodeIdHash != b->nodeIdHash)
+        return (a->nodeIdHash < b->nodeIdHash) ? ZIP_CMP_LESS : ZIP_CMP_MORE;
+    if(a->attributeId != b->attributeId)
+        return (a->attributeId < b->attributeId) ? ZIP_CMP_LESS : ZIP_CMP_MORE;
+    if(a->timestampsToReturn != b->timestampsToReturn)
+        return (a->timestampsToReturn < b->timestampsToReturn) ? ZIP_CMP_LESS : ZIP_CMP_MORE;
+    if(a->session != b->session)
+        return ((uintptr_t)a->session < (uintptr_t)b->session) ? ZIP_CMP_LESS : ZIP_CMP_MORE;
+    enum ZIP_CMP cmp = cmpNodeId(&a->nodeId, &b->nodeId);
+    if(cmp != ZIP_CMP_EQ)
+        return cmp;
+    return cmpString(&a->indexRange, &b->indexRange);
+}
+
+ZIP_PROTTYPE(UA_SharedSampleTree, UA_SharedSample, UA_SampleKey)
+ZIP_IMPL(UA_SharedSampleTree, UA_SharedSample, zipfields, UA_SampleKey, key, cmpSampleKey)
+
+/* The result of reading these attributes depends on the session */
+static UA_Boolean
+isSessionDependentAttribute(UA_UInt32 attributeId) {
+    return (attributeId == UA_ATTRIBUTEID_USERWRITEMASK ||
+            attributeId == UA_ATTRIBUTEID_USERACCESSLEVEL ||
+            attributeId == UA_ATTRIBUTEID_USEREXECUTABLE);
+}
+
+/* The key points into the MonitoredItem. Copy before storing it. */
+static void
+getSampleKey(UA_Server *server, const UA_MonitoredItem *mon, UA_SampleKey *key) {
+    /* Report-by-exception only uses the NodeId of the written value. The
+     * MonitoredItems read with their own settings. */
+    if(mon->samplingInterval == 0.0) {
+        memset(key, 0, sizeof(UA_SampleKey));
+        key->nodeIdHash = UA_NodeId_hash(&mon->monitoredNodeId);
+        key->nodeId = mon->monitoredNodeId;
+        key->attributeId = UA_ATTRIBUTEID_VALUE;
+        return;
+    }
+
+    key->nodeIdHash = UA_NodeId_hash(&mon->monitoredNodeId);
+    key->nodeId = mon->monitoredNodeId;
+    key->attributeId = mon->attributeId;
+    key->indexRange = mon->indexRange;
+    key->timestampsToReturn = mon->timestampsToReturn;
+    key->session = NULL;
+    if(isSessionDependentAttribute(mon->attributeId))
+        key->session = mon->subscription ?
+            mon->subscription->session : &server->adminSession;
+}
+
+static void
+deleteSharedSample(UA_SharedSample *ss) {
+    UA_NodeId_deleteMembers(&ss->key.nodeId);
+    UA_String_deleteMembers(&ss->key.indexRange);
+    UA_free(ss);
+}
+
+/******************/
+/* SamplingGroups */
+/******************/
+
+/* The group is sampled on the internal timer of the server (in the main
+ * thread). It can be deleted from within its own sampling callback. So the
+ * structure is freed with a delayed callback. */
+static void
+deleteSamplingGroup(UA_Server *server, UA_SamplingGroup *sg) {
+    UA_assert(ZIP_EMPTY(&sg->samplesTree));
+    if(sg->samplingInterval > 0.0)
+        UA_Server_removeRepeatedCallbackInternal(server, sg->sampleCallbackId);
+    else
+        server->reportByExceptionGroup = NULL;
+    LIST_REMOVE(sg, listEntry);
+    UA_free(sg->samples);
+    sg->samples = NULL;
+    sg->delayedFreePointers.callback = NULL;
+    UA_WorkQueue_enqueueDelayed(&server->workQueue, &sg->delayedFreePointers);
+}
+
+/* Free the SharedSamples removed during sampling */
+static void
+finishSampling(UA_Server *server, UA_SamplingGroup *sg) {
+    sg->sampling = false;
+    if(LIST_EMPTY(&sg->removedSamples))
+        return;
+
+    /* Free the removed SharedSamples */
+    UA_SharedSample *ss, *ss_tmp;
+    LIST_FOREACH_SAFE(ss, &sg->removedSamples, removedEntry, ss_tmp) {
+        LIST_REMOVE(ss, removedEntry);
+        deleteSharedSample(ss);
+    }
+
+    /* Compact the array */
+    size_t j = 0;
+    for(size_t i = 0; i < sg->samplesSize; i++) {
+        ss = sg->samples[i];
+        if(!ss)
+            continue;
+        ss->index = j;
+        sg->samples[j] = ss;
+        j++;
+    }
+    sg->samplesSize = j;
+
+    if(sg->samplesSize == 0)
+        deleteSamplingGroup(server, sg);
+}
+
+static void
+samplingGroupCallback(UA_Server *server, UA_SamplingGroup *sg) {
+    /* The MonitoredItems can be removed during sampling (e.g. in the callback
+     * of a local MonitoredItem). Newly added SharedSamples are appended and
+     * sampled with the next interval. */
+    sg->sampling = true;
+    size_t samplesSize = sg->samplesSize;
+    for(size_t i = 0; i < samplesSize; i++) {
+        if(sg->samples[i])
+            UA_SharedSample_sample(server, sg->samples[i]);
+    }
+    finishSampling(server, sg);
+}
+
+static UA_SamplingGroup *
+getSamplingGroup(UA_Server *server, UA_Double samplingInterval) {
+    if(samplingInterval == 0.0 && server->reportByExceptionGroup)
+        return server->reportByExceptionGroup;
+
+    UA_SamplingGroup *sg;
+    LIST_FOREACH(sg, &server->samplingGroups, listEntry) {
+        if(sg->samplingInterval == samplingInterval)
+            return sg;
+    }
+
+    sg = (UA_SamplingGroup*)UA_calloc(1, sizeof(UA_SamplingGroup));
+    if(!sg)
+        return NULL;
+    sg->samplingInterval = samplingInterval;
+
+    /* Report-by-exception. Sampled only when the value is written. */
+    if(samplingInterval == 0.0) {
+        LIST_INSERT_HEAD(&server->samplingGroups, sg, listEntry);
+        server->reportByExceptionGroup = sg;
+        return sg;
+    }
+
+    UA_StatusCode retval =
+        UA_Server_addRepeatedCallbackInternal(server, (UA_ServerCallback)samplingGroupCallback,
+                                              sg, samplingInterval, &sg->sampleCallbackId);
+    if(retval != UA_STATUSCODE_GOOD) {
+        UA_free(sg);
+        return NULL;
+    }
+    LIST_INSERT_HEAD(&server->samplingGroups, sg, listEntry);
+    return sg;
+}
+
+static UA_SharedSample *
+addSharedSample(UA_SamplingGroup *sg, const UA_SampleKey *key) {
+    if(sg->samplesSize == sg->samplesCapacity) {
+        size_t newCapacity = sg->samplesCapacity ? sg->samplesCapacity * 2 : 8;
+        UA_SharedSample **newSamples = (UA_SharedSample**)
+            UA_realloc(sg->samples, sizeof(UA_SharedSample*) * newCapacity);
+        if(!newSamples)
+            return NULL;
+        sg->samples = newSamples;
+        sg->samplesCapacity = newCapacity;
+    }
+
+    UA_SharedSample *ss = (UA_SharedSample*)UA_calloc(1, sizeof(UA_SharedSample));
+    if(!ss)
+        return NULL;
+    ss->key = *key;
+    UA_StatusCode retval = UA_NodeId_copy(&key->nodeId, &ss->key.nodeId);
+    retval |= UA_String_copy(&key->indexRange, &ss->key.indexRange);
+    if(retval != UA_STATUSCODE_GOOD) {
+        deleteSharedSample(ss);
+        return NULL;
+    }
+
+    ss->index = sg->samplesSize;
+    sg->samples[sg->samplesSize] = ss;
+    sg->samplesSize++;
+    ZIP_INSERT(UA_SharedSampleTree, &sg->samplesTree, ss, ZIP_FFS32(UA_UInt32_random()));
+    return ss;
+}
+
+static UA_StatusCode
+addToSamplingGroup(UA_Server *server, UA_MonitoredItem *mon) {
+    UA_SamplingGroup *sg = getSamplingGroup(server, mon->samplingInterval);
+    if(!sg)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+
+    /* Find or create the SharedSample */
+    UA_SampleKey key;
+    getSampleKey(server, mon, &key);
+    UA_SharedSample *ss = ZIP_FIND(UA_SharedSampleTree, &sg->samplesTree, &key);
+    if(!ss) {
+        ss = addSharedSample(sg, &key);
+        if(!ss) {
+            /* Don't leave a new and empty group behind */
+            if(sg->samplesSize == 0 && !sg->sampling)
+                deleteSamplingGroup(server, sg);
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+        }
+    }
+
+    mon->samplingGroup = sg;
+    mon->sharedSample = ss;
+    LIST_INSERT_HEAD(&ss->monitoredItems, mon, sharedSampleEntry);
+    return UA_STATUSCODE_GOOD;
+}
+
+static void
+removeFromSamplingGroup(UA_Server *server, UA_MonitoredItem *mon) {
+    UA_SamplingGroup *sg = mon->samplingGroup;
+    UA_SharedSample *ss = mon->sharedSample;
+    mon->samplingGroup = NULL;
+    mon->sharedSample = NULL;
+
+    /* Move the iteration cursor forward if the MonitoredItem is removed while
+     * the SharedSample is sampled */
+    if(ss->nextMonitoredItem == mon)
+        ss->nextMonitoredItem = LIST_NEXT(mon, sharedSampleEntry);
+    LIST_REMOVE(mon, sharedSampleEntry);
+    if(!LIST_EMPTY(&ss->monitoredItems))
+        return;
+
+    /* Remove the SharedSample without MonitoredItems */
+    ZIP_REMOVE(UA_SharedSampleTree, &sg->samplesTree, ss);
+    UA_assert(sg->samples[ss->index] == ss);
+
+    /* Don't move the entries during sampling. The group is cleaned up when the
+     * sampling is done. */
+    if(sg->sampling) {
+        sg->samples[ss->index] = NULL;
+        LIST_INSERT_HEAD(&sg->removedSamples, ss, removedEntry);
+        return;
+    }
+
+    /* Move the last entry into the gap */
+    sg->samplesSize--;
+    if(ss->index < sg->samplesSize) {
+        UA_SharedSample *last = sg->samples[sg->samplesSize];
+        last->index = ss->index;
+        sg->samples[ss->index] = last;
+    }
+    deleteSharedSample(ss);
+
+    /* Remove the empty group */
+    if(sg->samplesSize == 0)
+        deleteSamplingGroup(server, sg);
+}
+
+/* The SharedSample for the report-by-exception of the node */
+static UA_SharedSample *
+findReportByException(UA_Server *server, const UA_NodeId *nodeId) {
+    UA_SamplingGroup *sg = server->reportByExceptionGroup;
+    if(!sg)
+        return NULL;
+    UA_SampleKey key;
+    memset(&key, 0, sizeof(UA_SampleKey));
+    key.nodeIdHash = UA_NodeId_hash(nodeId);
+    key.nodeId = *nodeId;
+    key.attributeId = UA_ATTRIBUTEID_VALUE;
+    return ZIP_FIND(UA_SharedSampleTree, &sg->samplesTree, &key);
+}
+
+void
+UA_MonitoredItem_reportWrite(UA_Server *server, const UA_NodeId *nodeId) {
+    if(!server->config.reportByException || !server->reportByExceptionGroup)
+        return;
+
+    /* Find the SharedSample. Writes from within the sampling of the same
+     * SharedSample (e.g. in the callback of a local MonitoredItem) are not
+     * reported again. */
+    UA_SamplingGroup *sg = server->reportByExceptionGroup;
+    UA_SharedSample *ss = findReportByException(server, nodeId);
+    if(!ss || ss->sampling)
+        return;
+
+    /* Sample. Clean up only after the outermost sampling of the group. */
+    UA_Boolean nested = sg->sampling;
+    sg->sampling = true;
+    UA_SharedSample_sample(server, ss);
+    if(!nested)
+        finishSampling(server, sg);
+}
+
+void
+UA_MonitoredItem_stopReportByException(UA_Server *server, const UA_NodeId *nodeId) {
+    UA_SharedSample *ss = findReportByException(server, nodeId);
+    if(!ss)
+        return;
+
+    /* Revise the sampling interval as for a requested interval of zero */
+    UA_Double samplingInterval = 0.0;
+    const UA_VariableNode *vn = (const UA_VariableNode*)UA_Nodestore_get(server, nodeId);
+    if(vn) {
+        if(vn->nodeClass == UA_NODECLASS_VARIABLE)
+            samplingInterval = vn->minimumSamplingInterval;
+        UA_Nodestore_release(server, (const UA_Node*)vn);
+    }
+    if(samplingInterval < server->config.samplingIntervalLimits.min)
+        samplingInterval = server->config.samplingIntervalLimits.min;
+    if(samplingInterval > server->config.samplingIntervalLimits.max)
+        samplingInterval = server->config.samplingIntervalLimits.max;
+    if(!(samplingInterval > 0.0))
+        return; /* No polling interval allowed by the limits */
+
+    /* Move the MonitoredItems to the SamplingGroup. The SharedSample is
+     * removed with the last MonitoredItem. */
+    do {
+        UA_MonitoredItem *mon = LIST_FIRST(&ss->monitoredItems);
+        UA_MonitoredItem_unregisterSampleCallback(server, mon);
+        mon->samplingInterval = samplingInterval;
+        UA_MonitoredItem_registerSampleCallback(server, mon);
+    } while((ss = findReportByException(server, nodeId)));
+}
+
 UA_StatusCode
 UA_MonitoredItem_registerSampleCallback(UA_Server *server, UA_MonitoredItem *mon) {
     if(mon->sampleCallbackIsRegistered)
@@ -365,9 +780,7 @@ UA_MonitoredItem_registerSampleCallback(UA_Server *server, UA_MonitoredItem *mon
     if(mon->monitoredItemType != UA_MONITOREDITEMTYPE_CHANGENOTIFY)
         return UA_STATUSCODE_GOOD;
 
-    UA_StatusCode retval =
-        UA_Server_addRepeatedCallback(server, (UA_ServerCallback)UA_MonitoredItem_sampleCallback,
-                                      mon, mon->samplingInterval, &mon->sampleCallbackId);
+    UA_StatusCode retval = addToSamplingGroup(server, mon);
     if(retval == UA_STATUSCODE_GOOD)
         mon->sampleCallbackIsRegistered = true;
     return retval;
@@ -377,7 +790,7 @@ void
 UA_MonitoredItem_unregisterSampleCallback(UA_Server *server, UA_MonitoredItem *mon) {
     if(!mon->sampleCallbackIsRegistered)
         return;
-    UA_Server_removeRepeatedCallback(server, mon->sampleCallbackId);
+    removeFromSamplingGroup(server, mon);
     mon->sampleCallbackIsRegistered = false;
 }
 
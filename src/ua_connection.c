@@ -18,8 +18,99 @@
 #include "ua_transport_generated_encoding_binary.h"
 #include "ua_securechannel.h"
 
+/***************/
+/* Buffer Pool */
+/***************/
+
+/* Pooled buffers are prefixed with a header that stores the buffer size. So
+ * buffers of an outdated size can be detected when they are released. The
+ * union keeps the payload aligned. */
+typedef union BufferHeader {
+    struct {
+        size_t bufferSize;
+        union BufferHeader *next;
+    } h;
+    UA_Double align;
+} BufferHeader;
+
+UA_StatusCode
+UA_BufferPool_getBuffer(UA_BufferPool *pool, size_t bufferSize,
+                        size_t length, UA_ByteString *buf) {
+    if(length > bufferSize)
+        return UA_STATUSCODE_BADINTERNALERROR;
+
+    /* The buffer size has changed. Drop the idle buffers. */
+    if(bufferSize != pool->bufferSize) {
+        UA_BufferPool_clear(pool);
+        pool->bufferSize = bufferSize;
+    }
+
+    BufferHeader *header = (BufferHeader*)pool->idle;
+    if(header) {
+        pool->idle = header->h.next;
+        pool->idleSize--;
+        pool->reuses++;
+    } else {
+        header = (BufferHeader*)UA_malloc(sizeof(BufferHeader) + bufferSize);
+        if(!header) {
+            *buf = UA_BYTESTRING_NULL;
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+        }
+        header->h.bufferSize = bufferSize;
+        pool->allocations++;
+    }
+
+    pool->inUse++;
+    if(pool->inUse > pool->inUseHighWaterMark)
+        pool->inUseHighWaterMark = pool->inUse;
+
+    buf->data = (UA_Byte*)&header[1];
+    buf->length = length;
+    return UA_STATUSCODE_GOOD;
+}
+
+void
+UA_BufferPool_releaseBuffer(UA_BufferPool *pool, UA_ByteString *buf) {
+    if(!buf->data)
+        return;
+    BufferHeader *header = &((BufferHeader*)buf->data)[-1];
+    *buf = UA_BYTESTRING_NULL;
+    if(pool->inUse > 0)
+        pool->inUse--;
+
+    size_t maxIdle = (pool->maxIdle > 0) ? pool->maxIdle : UA_BUFFERPOOL_MAXIDLE;
+    if(header->h.bufferSize != pool->bufferSize || pool->idleSize >= maxIdle) {
+        UA_free(header);
+        return;
+    }
+
+    header->h.next = (BufferHeader*)pool->idle;
+    pool->idle = header;
+    pool->idleSize++;
+    if(pool->idleSize > pool->idleHighWaterMark)
+        pool->idleHighWaterMark = pool->idleSize;
+}
+
+void
+UA_BufferPool_clear(UA_BufferPool *pool) {
+    BufferHeader *header = (BufferHeader*)pool->idle;
+    while(header) {
+        BufferHeader *next = header->h.next;
+        UA_free(header);
+        header = next;
+    }
+    pool->idle = NULL;
+    pool->idleSize = 0;
+}
+
+/**************/
+/* Connection */
+/**************/
+
 void UA_Connection_deleteMembers(UA_Connection *connection) {
     UA_ByteString_deleteMembers(&connection->incompleteChunk);
+    UA_BufferPool_clear(&connection->sendBufferPool);
+    UA_BufferPool_clear(&connection->recvBufferPool);
 }
 
 UA_StatusCode
@@ -9,6 +9,9 @@
 #include "ua_util_internal.h"
 #include "ua_timer.h"
 
+/* The timing wheel is implemented in ua_timer_wheel.c */
+#ifndef UA_ENABLE_TIMER_WHEEL
+
 struct UA_TimerEntry {
     ZIP_ENTRY(UA_TimerEntry) zipfields;
     UA_DateTime nextTime;                    /* The next time when the callback
@@ -194,3 +197,5 @@ UA_Timer_deleteMembers(UA_Timer *t) {
     ZIP_ITER(UA_TimerZip, &t->root, freeEntry, NULL);
     ZIP_INIT(&t->root);
 }
+
+#endif /* !UA_ENABLE_TIMER_WHEEL */
@@ -18,6 +18,8 @@ _UA_BEGIN_DECLS
 struct UA_TimerEntry;
 typedef struct UA_TimerEntry UA_TimerEntry;
 
+#ifndef UA_ENABLE_TIMER_WHEEL
+
 ZIP_HEAD(UA_TimerZip, UA_TimerEntry);
 typedef struct UA_TimerZip UA_TimerZip;
 
@@ -31,6 +33,44 @@ typedef struct {
     UA_UInt64 idCounter;
 } UA_Timer;
 
+#else
+
+/* Hierarchical timing wheel after Varghese and Lauck. Every level has
+ * UA_TIMERWHEEL_SLOTS slots. A slot of the lowest level covers one tick. A slot
+ * of the level above covers all slots of the level below. Entries are added to
+ * the lowest level where they fit. The slots of the higher levels are cascaded
+ * down when the current time reaches them. Adding, removing and executing an
+ * entry is O(1). A bitmask per level tracks the slots that are not empty. So
+ * empty slots are skipped when the timer is processed after a pause. */
+#define UA_TIMERWHEEL_LEVELS 5
+#define UA_TIMERWHEEL_SLOTBITS 6
+#define UA_TIMERWHEEL_SLOTS (1 << UA_TIMERWHEEL_SLOTBITS) /* Bits in the mask */
+#define UA_TIMERWHEEL_TICK UA_DATETIME_MSEC
+
+LIST_HEAD(UA_TimerSlot, UA_TimerEntry);
+typedef struct UA_TimerSlot UA_TimerSlot;
+
+/* The callback id contains the index in the id table and a generation counter
+ * that is increased when the index is reused. So the entry is found in O(1). */
+typedef struct {
+    UA_TimerEntry *entry; /* NULL if the index is unused */
+    UA_UInt32 generation;
+    UA_UInt32 nextFree;   /* Index + 1 of the next unused index */
+} UA_TimerId;
+
+/* Only for a single thread. Protect by a mutex if required. */
+typedef struct {
+    UA_TimerSlot slots[UA_TIMERWHEEL_LEVELS][UA_TIMERWHEEL_SLOTS];
+    UA_UInt64 occupied[UA_TIMERWHEEL_LEVELS]; /* Bitmask of the non-empty slots */
+    UA_UInt64 currentTick; /* Slots before the current tick are processed */
+    size_t entriesSize;
+    UA_TimerId *ids;
+    size_t idsSize;
+    UA_UInt32 firstFree; /* Index + 1 of the first unused index */
+} UA_Timer;
+
+#endif
+
 void UA_Timer_init(UA_Timer *t);
 
 UA_StatusCode
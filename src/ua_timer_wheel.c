@@ -0,0 +1,397 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ *    Copyright 2017, 2018 (c) Fraunhofer IOSB (Author: Julius Pfrommer)
+ */
+
+#include "ua_util_internal.h"
+#include "ua_timer.h"
+
+#ifdef UA_ENABLE_TIMER_WHEEL
+
+#define UA_TIMERWHEEL_MASK (UA_TIMERWHEEL_SLOTS - 1)
+#define UA_TIMERWHEEL_NOTICK (~(UA_UInt64)0)
+
+struct UA_TimerEntry {
+    LIST_ENTRY(UA_TimerEntry) pointers;
+    UA_DateTime nextTime;                    /* The next time when the callback
+                                              * is to be executed */
+    UA_UInt64 interval;                      /* Interval in 100ns resolution */
+    UA_Boolean repeated;                     /* Repeated callback? */
+    UA_Byte level;                           /* Position in the wheel */
+    UA_Byte slot;
+
+    UA_ApplicationCallback callback;
+    void *application;
+    void *data;
+
+    UA_UInt64 id;                            /* Id of the entry */
+};
+
+static UA_UInt64
+tickOf(UA_DateTime time) {
+    if(time <= 0)
+        return 0;
+    return (UA_UInt64)time / UA_TIMERWHEEL_TICK;
+}
+
+/* Distance from the start index to the next non-empty slot (circular) */
+static size_t
+firstSlotFrom(UA_UInt64 occupied, size_t start) {
+    if(start > 0)
+        occupied = (occupied >> start) | (occupied << (UA_TIMERWHEEL_SLOTS - start));
+#if defined(__GNUC__) || defined(__clang__)
+    return (size_t)__builtin_ctzll(occupied);
+#else
+    size_t dist = 0;
+    while(!(occupied & 1)) {
+        occupied >>= 1;
+        dist++;
+    }
+    return dist;
+#endif
+}
+
+/************/
+/* Id Table */
+/************/
+
+static UA_StatusCode
+addId(UA_Timer *t, UA_TimerEntry *te) {
+    /* Grow the table */
+    if(t->firstFree == 0) {
+        size_t newSize = (t->idsSize > 0) ? t->idsSize * 2 : 64;
+        if(newSize > UA_UINT32_MAX)
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+        UA_TimerId *ids = (UA_TimerId*)UA_realloc(t->ids, newSize * sizeof(UA_TimerId));
+        if(!ids)
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+        for(size_t i = t->idsSize; i < newSize; i++) {
+            ids[i].entry = NULL;
+            ids[i].generation = 0;
+            ids[i].nextFree = (i + 1 < newSize) ? (UA_UInt32)(i + 2) : 0;
+        }
+        t->firstFree = (UA_UInt32)t->idsSize + 1;
+        t->ids = ids;
+        t->idsSize = newSize;
+    }
+
+    UA_UInt32 index = t->firstFree - 1;
+    UA_TimerId *id = &t->ids[index];
+    t->firstFree = id->nextFree;
+    id->entry = te;
+    te->id = ((UA_UInt64)id->generation << 32) | (UA_UInt64)(index + 1);
+    return UA_STATUSCODE_GOOD;
+}
+
+static UA_TimerEntry *
+findEntry(UA_Timer *t, UA_UInt64 callbackId) {
+    UA_UInt64 index = callbackId & UA_UINT32_MAX;
+    if(index == 0 || index > t->idsSize)
+        return NULL;
+    UA_TimerId *id = &t->ids[index - 1];
+    if(id->generation != (UA_UInt32)(callbackId >> 32))
+        return NULL;
+    return id->entry;
+}
+
+static void
+removeId(UA_Timer *t, UA_TimerEntry *te) {
+    UA_UInt32 index = (UA_UInt32)(te->id & UA_UINT32_MAX);
+    UA_TimerId *id = &t->ids[index - 1];
+    id->entry = NULL;
+    id->generation++; /* Stale ids no longer match */
+    id->nextFree = t->firstFree;
+    t->firstFree = index;
+}
+
+/*********/
+/* Wheel */
+/*********/
+
+/* Add to the lowest level where the entry fits */
+static void
+insertEntry(UA_Timer *t, UA_TimerEntry *te) {
+    /* Overdue entries are executed in the next processing */
+    UA_UInt64 tick = tickOf(te->nextTime);
+    if(tick < t->currentTick)
+        tick = t->currentTick;
+
+    /* Entries beyond the top level are moved down again when the top level is
+     * cascaded. Then their position is computed from nextTime. */
+    UA_UInt64 delta = tick - t->currentTick;
+    UA_UInt64 maxDelta = ((UA_UInt64)1 << (UA_TIMERWHEEL_SLOTBITS * UA_TIMERWHEEL_LEVELS)) - 1;
+    if(delta > maxDelta) {
+        delta = maxDelta;
+        tick = t->currentTick + maxDelta;
+    }
+
+    size_t level = 0;
+    while(level < UA_TIMERWHEEL_LEVELS - 1 &&
+          delta >= ((UA_UInt64)1 << (UA_TIMERWHEEL_SLOTBITS * (level + 1))))
+        level++;
+
+    size_t slot = (size_t)(tick >> (UA_TIMERWHEEL_SLOTBITS * level)) & UA_TIMERWHEEL_MASK;
+    te->level = (UA_Byte)level;
+    te->slot = (UA_Byte)slot;
+    LIST_INSERT_HEAD(&t->slots[level][slot], te, pointers);
+    t->occupied[level] |= (UA_UInt64)1 << slot;
+}
+
+static void
+removeEntry(UA_Timer *t, UA_TimerEntry *te) {
+    LIST_REMOVE(te, pointers);
+    if(LIST_EMPTY(&t->slots[te->level][te->slot]))
+        t->occupied[te->level] &= ~((UA_UInt64)1 << te->slot);
+}
+
+/* Move the entries of a slot to a list outside of the wheel */
+static void
+takeSlot(UA_Timer *t, size_t level, size_t slot, UA_TimerSlot *out) {
+    UA_TimerSlot *s = &t->slots[level][slot];
+    LIST_FIRST(out) = LIST_FIRST(s);
+    if(LIST_FIRST(out))
+        LIST_FIRST(out)->pointers.le_prev = &LIST_FIRST(out);
+    LIST_INIT(s);
+    t->occupied[level] &= ~((UA_UInt64)1 << slot);
+}
+
+/* The current tick reached the slot of a higher level. Move the entries down.
+ * Start with the highest level, as its entries can move to a level below that
+ * is also cascaded now. */
+static void
+cascade(UA_Timer *t) {
+    for(size_t level = UA_TIMERWHEEL_LEVELS - 1; level > 0; level--) {
+        size_t shift = UA_TIMERWHEEL_SLOTBITS * level;
+        if((t->currentTick & (((UA_UInt64)1 << shift) - 1)) != 0)
+            continue;
+        size_t slot = (size_t)(t->currentTick >> shift) & UA_TIMERWHEEL_MASK;
+        if(!(t->occupied[level] & ((UA_UInt64)1 << slot)))
+            continue;
+        UA_TimerSlot list;
+        takeSlot(t, level, slot, &list);
+        UA_TimerEntry *te;
+        while((te = LIST_FIRST(&list))) {
+            LIST_REMOVE(te, pointers);
+            insertEntry(t, te);
+        }
+    }
+}
+
+/* The next tick (from the given tick on) where a slot of the lowest level is
+ * due or a slot of a higher level is cascaded. Returns UA_TIMERWHEEL_NOTICK if
+ * the wheel is empty. The level of the slot is written to outLevel. */
+static UA_UInt64
+nextEventTick(UA_Timer *t, UA_UInt64 from, size_t *outLevel) {
+    UA_UInt64 next = UA_TIMERWHEEL_NOTICK;
+    for(size_t level = 0; level < UA_TIMERWHEEL_LEVELS; level++) {
+        if(!t->occupied[level])
+            continue;
+        size_t shift = UA_TIMERWHEEL_SLOTBITS * level;
+        /* First slot boundary of the level at or after from */
+        UA_UInt64 c = (from + (((UA_UInt64)1 << shift) - 1)) >> shift;
+        size_t dist = firstSlotFrom(t->occupied[level], (size_t)c & UA_TIMERWHEEL_MASK);
+        UA_UInt64 tick = (c + dist) << shift;
+        if(tick < next) {
+            next = tick;
+            *outLevel = level;
+        }
+    }
+    return next;
+}
+
+/* Execute the entries of the lowest-level slot of the current tick */
+static void
+expireSlot(UA_Timer *t, UA_DateTime nowMonotonic,
+           UA_TimerExecutionCallback executionCallback,
+           void *executionApplication) {
+    size_t slot = (size_t)t->currentTick & UA_TIMERWHEEL_MASK;
+    if(!(t->occupied[0] & ((UA_UInt64)1 << slot)))
+        return;
+
+    /* Entries that are re-added for the same tick are not executed again in
+     * this processing. They land in the emptied slot. */
+    UA_TimerSlot list;
+    takeSlot(t, 0, slot, &list);
+
+    UA_TimerEntry *te;
+    while((te = LIST_FIRST(&list))) {
+        LIST_REMOVE(te, pointers);
+
+        /* Later in the current tick */
+        if(te->nextTime > nowMonotonic) {
+            insertEntry(t, te);
+            continue;
+        }
+
+        /* Reinsert / remove first. The callback can interact with the timer
+         * and expects the entry at its new position. */
+        if(!te->repeated) {
+            removeId(t, te);
+            t->entriesSize--;
+            executionCallback(executionApplication, te->callback,
+                              te->application, te->data);
+            UA_free(te);
+            continue;
+        }
+
+        /* Set the time for the next execution. Prevent an infinite loop by
+         * forcing the next processing into the next iteration. */
+        te->nextTime += (UA_Int64)te->interval;
+        if(te->nextTime < nowMonotonic)
+            te->nextTime = nowMonotonic + 1;
+        insertEntry(t, te);
+        executionCallback(executionApplication, te->callback,
+                          te->application, te->data);
+    }
+}
+
+/*************/
+/* Interface */
+/*************/
+
+void
+UA_Timer_init(UA_Timer *t) {
+    memset(t, 0, sizeof(UA_Timer));
+}
+
+static UA_StatusCode
+addCallback(UA_Timer *t, UA_ApplicationCallback callback, void *application, void *data,
+            UA_DateTime nextTime, UA_UInt64 interval, UA_Boolean repeated,
+            UA_UInt64 *callbackId) {
+    /* A callback method needs to be present */
+    if(!callback)
+        return UA_STATUSCODE_BADINTERNALERROR;
+
+    /* Allocate the repeated callback structure */
+    UA_TimerEntry *te = (UA_TimerEntry*)UA_malloc(sizeof(UA_TimerEntry));
+    if(!te)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    UA_StatusCode retval = addId(t, te);
+    if(retval != UA_STATUSCODE_GOOD) {
+        UA_free(te);
+        return retval;
+    }
+
+    /* Set the repeated callback */
+    te->interval = (UA_UInt64)interval;
+    te->callback = callback;
+    te->application = application;
+    te->data = data;
+    te->repeated = repeated;
+    te->nextTime = nextTime;
+
+    /* Set the output identifier */
+    if(callbackId)
+        *callbackId = te->id;
+
+    /* Start the empty wheel at the current time. Otherwise the first
+     * processing has to move over all ticks since the last use. */
+    if(t->entriesSize == 0)
+        t->currentTick = tickOf(UA_DateTime_nowMonotonic());
+    t->entriesSize++;
+    insertEntry(t, te);
+    return UA_STATUSCODE_GOOD;
+}
+
+UA_StatusCode
+UA_Timer_addTimedCallback(UA_Timer *t, UA_ApplicationCallback callback,
+                          void *application, void *data, UA_DateTime date,
+                          UA_UInt64 *callbackId) {
+    return addCallback(t, callback, application, data, date, 0, false, callbackId);
+}
+
+UA_StatusCode
+UA_Timer_addRepeatedCallback(UA_Timer *t, UA_ApplicationCallback callback,
+                             void *application, void *data, UA_Double interval_ms,
+                             UA_UInt64 *callbackId) {
+    /* The interval needs to be positive */
+    if(interval_ms <= 0.0)
+        return UA_STATUSCODE_BADINTERNALERROR;
+
+    UA_UInt64 interval = (UA_UInt64)(interval_ms * UA_DATETIME_MSEC);
+    UA_DateTime nextTime = UA_DateTime_nowMonotonic() + (UA_DateTime)interval;
+    return addCallback(t, callback, application, data, nextTime,
+                       interval, true, callbackId);
+}
+
+UA_StatusCode
+UA_Timer_changeRepeatedCallbackInterval(UA_Timer *t, UA_UInt64 callbackId,
+                                        UA_Double interval_ms) {
+    /* The interval needs to be positive */
+    if(interval_ms <= 0.0)
+        return UA_STATUSCODE_BADINTERNALERROR;
+
+    UA_TimerEntry *te = findEntry(t, callbackId);
+    if(!te)
+        return UA_STATUSCODE_BADNOTFOUND;
+
+    /* Move to the new position in the wheel */
+    removeEntry(t, te);
+    te->interval = (UA_UInt64)(interval_ms * UA_DATETIME_MSEC); /* in 100ns resolution */
+    te->nextTime = UA_DateTime_nowMonotonic() + (UA_DateTime)te->interval;
+    insertEntry(t, te);
+    return UA_STATUSCODE_GOOD;
+}
+
+void
+UA_Timer_removeCallback(UA_Timer *t, UA_UInt64 callbackId) {
+    UA_TimerEntry *te = findEntry(t, callbackId);
+    if(!te)
+        return;
+
+    removeEntry(t, te);
+    removeId(t, te);
+    t->entriesSize--;
+    UA_free(te);
+}
+
+UA_DateTime
+UA_Timer_process(UA_Timer *t, UA_DateTime nowMonotonic,
+                 UA_TimerExecutionCallback executionCallback,
+                 void *executionApplication) {
+    /* Move over the ticks up to now. Jump directly to the next tick where
+     * something is to be done. */
+    UA_UInt64 nowTick = tickOf(nowMonotonic);
+    size_t level = 0;
+    while(t->currentTick <= nowTick) {
+        expireSlot(t, nowMonotonic, executionCallback, executionApplication);
+        if(t->currentTick == nowTick)
+            break;
+        UA_UInt64 next = nextEventTick(t, t->currentTick + 1, &level);
+        if(next > nowTick) {
+            t->currentTick = nowTick;
+            break;
+        }
+        t->currentTick = next;
+        cascade(t);
+    }
+
+    /* Return the timestamp of the earliest next callback. For the lowest
+     * level, the exact time is taken from the entries of the slot. For a
+     * higher level, return when the slot is cascaded. */
+    UA_UInt64 next = nextEventTick(t, t->currentTick, &level);
+    if(next == UA_TIMERWHEEL_NOTICK)
+        return UA_INT64_MAX;
+    if(level > 0)
+        return (UA_DateTime)(next * UA_TIMERWHEEL_TICK);
+    UA_DateTime earliest = UA_INT64_MAX;
+    UA_TimerEntry *te;
+    LIST_FOREACH(te, &t->slots[0][next & UA_TIMERWHEEL_MASK], pointers) {
+        if(te->nextTime < earliest)
+            earliest = te->nextTime;
+    }
+    return earliest;
+}
+
+void
+UA_Timer_deleteMembers(UA_Timer *t) {
+    /* Free all entries and reset the wheel */
+    for(size_t i = 0; i < t->idsSize; i++)
+        UA_free(t->ids[i].entry);
+    UA_free(t->ids);
+    UA_Timer_init(t);
+}
+
+#endif /* UA_ENABLE_TIMER_WHEEL */
@@ -114,7 +114,7 @@ UA_Boolean
 UA_String_equal(const UA_String *s1, const UA_String *s2) {
     if(s1->length != s2->length)
         return false;
-    if(s1->length == 0)
+    if(s1->length == 0 || s1->data == s2->data) /* Shared (e.g. interned) */
         return true;
     i32 is = memcmp((char const*)s1->data,
                     (char const*)s2->data, s1->length);
@@ -326,6 +326,11 @@ fnv32(u32 fnv, const u8 *buf, size_t size) {
     return fnv;
 }
 
+u32
+UA_ByteString_hash(u32 initialHashValue, const u8 *data, size_t size) {
+    return fnv32(initialHashValue, data, size);
+}
+
 u32
 UA_NodeId_hash(const UA_NodeId *n) {
     switch(n->identifierType) {
@@ -290,3 +290,76 @@ UA_NodeId_toString(const UA_NodeId *nodeId, UA_String *nodeIdStr) {
     return UA_STATUSCODE_GOOD;
 }
 
+
+/**************/
+/* Hash Index */
+/**************/
+
+#define UA_HASHINDEX_INITIALBUCKETS 8
+
+void
+UA_HashIndex_init(UA_HashIndex *hi) {
+    memset(hi, 0, sizeof(UA_HashIndex));
+}
+
+void
+UA_HashIndex_deleteMembers(UA_HashIndex *hi) {
+    UA_free(hi->buckets);
+    UA_HashIndex_init(hi);
+}
+
+/* Move the entries to a bucket array of the new size */
+static UA_StatusCode
+HashIndex_resize(UA_HashIndex *hi, size_t newSize) {
+    UA_HashIndexEntry **newBuckets = (UA_HashIndexEntry**)
+        UA_calloc(newSize, sizeof(UA_HashIndexEntry*));
+    if(!newBuckets)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    for(size_t i = 0; i < hi->bucketsSize; i++) {
+        UA_HashIndexEntry *entry = hi->buckets[i];
+        while(entry) {
+            UA_HashIndexEntry *next = entry->next;
+            UA_HashIndexEntry **bucket = &newBuckets[entry->hash & (newSize - 1)];
+            entry->next = *bucket;
+            *bucket = entry;
+            entry = next;
+        }
+    }
+    UA_free(hi->buckets);
+    hi->buckets = newBuckets;
+    hi->bucketsSize = newSize;
+    return UA_STATUSCODE_GOOD;
+}
+
+UA_StatusCode
+UA_HashIndex_insert(UA_HashIndex *hi, UA_HashIndexEntry *entry, UA_UInt32 hash) {
+    if(hi->bucketsSize == 0) {
+        UA_StatusCode retval = HashIndex_resize(hi, UA_HASHINDEX_INITIALBUCKETS);
+        if(retval != UA_STATUSCODE_GOOD)
+            return retval;
+    } else if(hi->entriesSize >= hi->bucketsSize) {
+        HashIndex_resize(hi, hi->bucketsSize * 2); /* Keep the buckets on failure */
+    }
+
+    UA_HashIndexEntry **bucket = &hi->buckets[hash & (hi->bucketsSize - 1)];
+    entry->hash = hash;
+    entry->next = *bucket;
+    *bucket = entry;
+    hi->entriesSize++;
+    return UA_STATUSCODE_GOOD;
+}
+
+void
+UA_HashIndex_remove(UA_HashIndex *hi, UA_HashIndexEntry *entry) {
+    if(hi->bucketsSize == 0)
+        return;
+    UA_HashIndexEntry **pos = &hi->buckets[entry->hash & (hi->bucketsSize - 1)];
+    for(; *pos; pos = &(*pos)->next) {
+        if(*pos != entry)
+            continue;
+        *pos = entry->next;
+        entry->next = NULL;
+        hi->entriesSize--;
+        return;
+    }
+}
@@ -45,6 +45,76 @@ typedef UA_StatusCode status;
 void UA_EXPORT UA_dump_hex_pkg(UA_Byte* buffer, size_t bufferLen);
 #endif
 
+/* container_of */
+#define container_of(ptr, type, member) \
+    (type *)((uintptr_t)ptr - offsetof(type,member))
+
+/* Hash Index
+ * ----------
+ * Intrusive hash table with separate chaining. The UA_HashIndexEntry is
+ * embedded in the indexed structure (one entry per index the structure is part
+ * of). The number of buckets is doubled when it is exceeded by the number of
+ * entries. Lookups iterate over the entries with the hash of the key and
+ * compare the key in the surrounding structure (see container_of).
+ *
+ *   UA_HashIndexEntry *e = UA_HashIndex_first(&index, hash);
+ *   for(; e; e = UA_HashIndex_next(e, hash)) {
+ *       MyStruct *s = container_of(e, MyStruct, indexEntry);
+ *       if(s->key == key)
+ *           return s;
+ *   }
+ */
+
+typedef struct UA_HashIndexEntry {
+    struct UA_HashIndexEntry *next;
+    UA_UInt32 hash;
+} UA_HashIndexEntry;
+
+typedef struct {
+    UA_HashIndexEntry **buckets;
+    size_t bucketsSize; /* Zero or a power of two */
+    size_t entriesSize;
+} UA_HashIndex;
+
+void UA_HashIndex_init(UA_HashIndex *hi);
+
+/* Frees the buckets. The entries are not touched. */
+void UA_HashIndex_deleteMembers(UA_HashIndex *hi);
+
+/* Only fails if the first buckets cannot be allocated. If growing fails, the
+ * buckets become longer. */
+UA_StatusCode
+UA_HashIndex_insert(UA_HashIndex *hi, UA_HashIndexEntry *entry, UA_UInt32 hash);
+
+/* Does nothing if the entry is not in the index */
+void UA_HashIndex_remove(UA_HashIndex *hi, UA_HashIndexEntry *entry);
+
+static UA_INLINE UA_HashIndexEntry *
+UA_HashIndex_next(UA_HashIndexEntry *entry, UA_UInt32 hash) {
+    for(entry = entry->next; entry; entry = entry->next) {
+        if(entry->hash == hash)
+            break;
+    }
+    return entry;
+}
+
+static UA_INLINE UA_HashIndexEntry *
+UA_HashIndex_first(const UA_HashIndex *hi, UA_UInt32 hash) {
+    if(hi->bucketsSize == 0)
+        return NULL;
+    UA_HashIndexEntry *entry = hi->buckets[hash & (hi->bucketsSize - 1)];
+    if(entry && entry->hash != hash)
+        entry = UA_HashIndex_next(entry, hash);
+    return entry;
+}
+
+/* Knuth's multiplicative hashing. Consecutive identifiers are spread over all
+ * buckets. */
+static UA_INLINE UA_UInt32
+UA_HashIndex_hashUInt32(UA_UInt32 id) {
+    return (UA_UInt32)(id * UINT32_C(2654435761));
+}
+
 _UA_END_DECLS
 
 #endif /* UA_UTIL_H_ */
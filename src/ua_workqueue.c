@@ -16,44 +16,253 @@
 
 #include "ua_workqueue.h"
 
+#ifdef UA_ENABLE_MULTITHREADING
+
+/***********************/
+/* Work-Stealing Deque */
+/***********************/
+
+static UA_WorkDequeArray *
+UA_WorkDequeArray_new(UA_Int64 size) {
+    UA_WorkDequeArray *a = (UA_WorkDequeArray*)
+        UA_malloc(sizeof(UA_WorkDequeArray) + (size_t)size * sizeof(UA_DelayedCallback*));
+    if(!a)
+        return NULL;
+    a->retired = NULL;
+    a->size = size;
+    return a;
+}
+
+static UA_StatusCode
+UA_WorkDeque_init(UA_WorkDeque *q) {
+    q->top = 0;
+    q->bottom = 0;
+    q->array = UA_WorkDequeArray_new(UA_WORKDEQUE_INITIALSIZE);
+    if(!q->array)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Must not be accessed concurrently */
+static void
+UA_WorkDeque_deleteMembers(UA_WorkDeque *q) {
+    UA_WorkDequeArray *a = q->array;
+    while(a) {
+        UA_WorkDequeArray *retired = a->retired;
+        UA_free(a);
+        a = retired;
+    }
+    q->array = NULL;
+}
+
+static UA_Boolean
+UA_WorkDeque_isEmpty(UA_WorkDeque *q) {
+    UA_Int64 t = __atomic_load_n(&q->top, __ATOMIC_ACQUIRE);
+    UA_Int64 b = __atomic_load_n(&q->bottom, __ATOMIC_ACQUIRE);
+    return (b <= t);
+}
+
+/* Only called by the owner */
+static UA_StatusCode
+UA_WorkDeque_push(UA_WorkDeque *q, UA_DelayedCallback *dc) {
+    UA_Int64 b = __atomic_load_n(&q->bottom, __ATOMIC_RELAXED);
+    UA_Int64 t = __atomic_load_n(&q->top, __ATOMIC_ACQUIRE);
+    UA_WorkDequeArray *a = __atomic_load_n(&q->array, __ATOMIC_RELAXED);
+
+    /* Full. Grow the array. The old array is retained for concurrent thieves. */
+    if(b - t > a->size - 1) {
+        UA_WorkDequeArray *na = UA_WorkDequeArray_new(a->size * 2);
+        if(!na)
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+        for(UA_Int64 i = t; i < b; i++)
+            na->buffer[i & (na->size - 1)] = a->buffer[i & (a->size - 1)];
+        na->retired = a;
+        __atomic_store_n(&q->array, na, __ATOMIC_RELEASE);
+        a = na;
+    }
+
+    __atomic_store_n(&a->buffer[b & (a->size - 1)], dc, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&q->bottom, b + 1, __ATOMIC_RELAXED);
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Only called by the owner */
+static UA_DelayedCallback *
+UA_WorkDeque_take(UA_WorkDeque *q) {
+    UA_Int64 b = __atomic_load_n(&q->bottom, __ATOMIC_RELAXED) - 1;
+    UA_WorkDequeArray *a = __atomic_load_n(&q->array, __ATOMIC_RELAXED);
+    __atomic_store_n(&q->bottom, b, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    UA_Int64 t = __atomic_load_n(&q->top, __ATOMIC_RELAXED);
+
+    /* Empty */
+    if(t > b) {
+        __atomic_store_n(&q->bottom, b + 1, __ATOMIC_RELAXED);
+        return NULL;
+    }
+
+    UA_DelayedCallback *dc = __atomic_load_n(&a->buffer[b & (a->size - 1)],
+                                             __ATOMIC_RELAXED);
+    if(t == b) {
+        /* The last element. Race against the thieves. */
+        if(!__atomic_compare_exchange_n(&q->top, &t, t + 1, false,
+                                        __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+            dc = NULL;
+        __atomic_store_n(&q->bottom, b + 1, __ATOMIC_RELAXED);
+    }
+    return dc;
+}
+
+/* Can be called from any thread. Returns NULL if the deque is empty or if the
+ * race for the top element was lost. */
+static UA_DelayedCallback *
+UA_WorkDeque_steal(UA_WorkDeque *q) {
+    UA_Int64 t = __atomic_load_n(&q->top, __ATOMIC_ACQUIRE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    UA_Int64 b = __atomic_load_n(&q->bottom, __ATOMIC_ACQUIRE);
+    if(t >= b)
+        return NULL;
+
+    UA_WorkDequeArray *a = __atomic_load_n(&q->array, __ATOMIC_ACQUIRE);
+    UA_DelayedCallback *dc = __atomic_load_n(&a->buffer[t & (a->size - 1)],
+                                             __ATOMIC_RELAXED);
+    if(!__atomic_compare_exchange_n(&q->top, &t, t + 1, false,
+                                    __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+        return NULL;
+    return dc;
+}
+
+/******************/
+/* Dispatch Queue */
+/******************/
+
+static UA_StatusCode
+UA_DispatchQueue_init(UA_DispatchQueue *q, size_t size) {
+    q->cells = (UA_DispatchCell*)UA_malloc(size * sizeof(UA_DispatchCell));
+    if(!q->cells)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    for(size_t i = 0; i < size; i++)
+        q->cells[i].sequence = i;
+    q->mask = size - 1;
+    q->enqueuePos = 0;
+    q->dequeuePos = 0;
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Must not be accessed concurrently */
+static void
+UA_DispatchQueue_deleteMembers(UA_DispatchQueue *q) {
+    UA_free(q->cells);
+    q->cells = NULL;
+}
+
+/* Can be called from any thread. Returns an error if the queue is full. */
+static UA_StatusCode
+UA_DispatchQueue_push(UA_DispatchQueue *q, UA_DelayedCallback *dc) {
+    UA_DispatchCell *cell;
+    size_t pos = __atomic_load_n(&q->enqueuePos, __ATOMIC_RELAXED);
+    while(true) {
+        cell = &q->cells[pos & q->mask];
+        size_t seq = __atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+        if(diff == 0) {
+            /* The cell is free. Try to reserve it. */
+            if(__atomic_compare_exchange_n(&q->enqueuePos, &pos, pos + 1, true,
+                                           __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                break;
+        } else if(diff < 0) {
+            return UA_STATUSCODE_BADOUTOFMEMORY; /* Full */
+        } else {
+            pos = __atomic_load_n(&q->enqueuePos, __ATOMIC_RELAXED);
+        }
+    }
+    cell->dc = dc;
+    __atomic_store_n(&cell->sequence, pos + 1, __ATOMIC_RELEASE);
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Can be called from any thread. Returns NULL if the queue is empty. */
+static UA_DelayedCallback *
+UA_DispatchQueue_pop(UA_DispatchQueue *q) {
+    UA_DispatchCell *cell;
+    size_t pos = __atomic_load_n(&q->dequeuePos, __ATOMIC_RELAXED);
+    while(true) {
+        cell = &q->cells[pos & q->mask];
+        size_t seq = __atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE);
+        intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+        if(diff == 0) {
+            /* The cell is filled. Try to take it out. */
+            if(__atomic_compare_exchange_n(&q->dequeuePos, &pos, pos + 1, true,
+                                           __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                break;
+        } else if(diff < 0) {
+            return NULL; /* Empty */
+        } else {
+            pos = __atomic_load_n(&q->dequeuePos, __ATOMIC_RELAXED);
+        }
+    }
+    UA_DelayedCallback *dc = cell->dc;
+    __atomic_store_n(&cell->sequence, pos + q->mask + 1, __ATOMIC_RELEASE);
+    return dc;
+}
+
+/* A push in progress counts as not empty */
+static UA_Boolean
+UA_DispatchQueue_isEmpty(UA_DispatchQueue *q) {
+    return (__atomic_load_n(&q->enqueuePos, __ATOMIC_ACQUIRE) ==
+            __atomic_load_n(&q->dequeuePos, __ATOMIC_ACQUIRE));
+}
+
+#endif
+
 void UA_WorkQueue_init(UA_WorkQueue *wq) {
     /* Initialized the linked list for delayed callbacks */
     SIMPLEQ_INIT(&wq->delayedCallbacks);
 
 #ifdef UA_ENABLE_MULTITHREADING
-    wq->delayedCallbacks_checkpoint = NULL;
+    wq->workers = NULL;
+    wq->workersSize = 0;
     pthread_mutex_init(&wq->delayedCallbacks_accessMutex,  NULL);
+    wq->epoch = 0;
+    for(size_t i = 0; i < UA_WORKQUEUE_EPOCHS; i++)
+        wq->activeCallbacks[i] = 0;
 
-    /* Initialize the dispatch queue for worker threads */
-    SIMPLEQ_INIT(&wq->dispatchQueue);
-    pthread_mutex_init(&wq->dispatchQueue_accessMutex, NULL);
+    /* Initialize the dispatch queue for worker threads. Without memory for the
+     * dispatch queue, work is executed in the calling thread. */
+    UA_DispatchQueue_init(&wq->dispatchQueue, UA_DISPATCHQUEUE_SIZE);
     pthread_cond_init(&wq->dispatchQueue_condition, NULL);
     pthread_mutex_init(&wq->dispatchQueue_conditionMutex, NULL);
+    wq->idleWorkers = 0;
 #endif
 }
 
 #ifdef UA_ENABLE_MULTITHREADING
 /* Forward declaration */
 static void UA_WorkQueue_manuallyProcessDelayed(UA_WorkQueue *wq);
+
+/* Execute a dispatched callback and mark it as finished for its epoch */
+static void
+executeCallback(UA_WorkQueue *wq, UA_DelayedCallback *dc) {
+    if(dc->callback)
+        dc->callback(dc->application, dc->data);
+    __atomic_sub_fetch(&wq->activeCallbacks[dc->epoch % UA_WORKQUEUE_EPOCHS],
+                       1, __ATOMIC_RELEASE);
+    UA_free(dc);
+}
 #endif
 
 void UA_WorkQueue_cleanup(UA_WorkQueue *wq) {
 #ifdef UA_ENABLE_MULTITHREADING
-    /* Shut down workers */
+    /* Shut down workers. The remaining work of the workers is moved to the
+     * dispatch queue. */
     UA_WorkQueue_stop(wq);
 
     /* Execute remaining work in the dispatch queue */
-    while(true) {
-        pthread_mutex_lock(&wq->dispatchQueue_accessMutex);
-        UA_DelayedCallback *dc = SIMPLEQ_FIRST(&wq->dispatchQueue);
-        if(!dc) {
-            pthread_mutex_unlock(&wq->dispatchQueue_accessMutex);
-            break;
-        }
-        SIMPLEQ_REMOVE_HEAD(&wq->dispatchQueue, next);
-        pthread_mutex_unlock(&wq->dispatchQueue_accessMutex);
-        dc->callback(dc->application, dc->data);
-        UA_free(dc);
+    if(wq->dispatchQueue.cells) {
+        UA_DelayedCallback *dc;
+        while((dc = UA_DispatchQueue_pop(&wq->dispatchQueue)))
+            executeCallback(wq, dc);
     }
 #endif
 
@@ -61,8 +270,7 @@ void UA_WorkQueue_cleanup(UA_WorkQueue *wq) {
     UA_WorkQueue_manuallyProcessDelayed(wq);
 
 #ifdef UA_ENABLE_MULTITHREADING
-    wq->delayedCallbacks_checkpoint = NULL;
-    pthread_mutex_destroy(&wq->dispatchQueue_accessMutex);
+    UA_DispatchQueue_deleteMembers(&wq->dispatchQueue);
     pthread_cond_destroy(&wq->dispatchQueue_condition);
     pthread_mutex_destroy(&wq->dispatchQueue_conditionMutex);
     pthread_mutex_destroy(&wq->delayedCallbacks_accessMutex);
@@ -75,39 +283,82 @@ void UA_WorkQueue_cleanup(UA_WorkQueue *wq) {
 
 #ifdef UA_ENABLE_MULTITHREADING
 
+/* Take from the own deque first. Then take from the dispatch queue and steal
+ * from the other workers. */
+static UA_DelayedCallback *
+findWork(UA_Worker *worker) {
+    UA_WorkQueue *wq = worker->queue;
+    UA_DelayedCallback *dc = UA_WorkDeque_take(&worker->deque);
+    if(dc)
+        return dc;
+    dc = UA_DispatchQueue_pop(&wq->dispatchQueue);
+    if(dc)
+        return dc;
+    for(size_t i = 0; i < wq->workersSize; i++) {
+        size_t victim = worker->nextVictim;
+        worker->nextVictim = (victim + 1) % wq->workersSize;
+        if(victim == worker->index)
+            continue;
+        dc = UA_WorkDeque_steal(&wq->workers[victim].deque);
+        if(dc)
+            return dc;
+    }
+    return NULL;
+}
+
+static UA_Boolean
+workAvailable(UA_WorkQueue *wq) {
+    if(!UA_DispatchQueue_isEmpty(&wq->dispatchQueue))
+        return true;
+    for(size_t i = 0; i < wq->workersSize; i++) {
+        if(!UA_WorkDeque_isEmpty(&wq->workers[i].deque))
+            return true;
+    }
+    return false;
+}
+
+/* Wake up one sleeping worker after new work was pushed */
+static void
+wakeWorker(UA_WorkQueue *wq) {
+    /* Pairs with the fence in the sleeping worker. Either the worker sees the
+     * new work or we see the idle worker. */
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if(__atomic_load_n(&wq->idleWorkers, __ATOMIC_RELAXED) == 0)
+        return;
+    pthread_mutex_lock(&wq->dispatchQueue_conditionMutex);
+    pthread_cond_signal(&wq->dispatchQueue_condition);
+    pthread_mutex_unlock(&wq->dispatchQueue_conditionMutex);
+}
+
 static void *
 workerLoop(UA_Worker *worker) {
     UA_WorkQueue *wq = worker->queue;
-    UA_UInt32 *counter = &worker->counter;
     volatile UA_Boolean *running = &worker->running;
+    pthread_setspecific(wq->workerKey, worker);
 
     /* Initialize the (thread local) random seed with the ram address
      * of the worker. Not for security-critical entropy! */
     UA_random_seed((uintptr_t)worker);
 
     while(*running) {
-        UA_atomic_addUInt32(counter, 1);
+        UA_DelayedCallback *dc = findWork(worker);
 
-        /* Remove a callback from the queue */
-        pthread_mutex_lock(&wq->dispatchQueue_accessMutex);
-        UA_DelayedCallback *dc = SIMPLEQ_FIRST(&wq->dispatchQueue);
-        if(dc)
-            SIMPLEQ_REMOVE_HEAD(&wq->dispatchQueue, next);
-        pthread_mutex_unlock(&wq->dispatchQueue_accessMutex);
-
-        /* Nothing to do. Sleep until a callback is dispatched */
+        /* Nothing to do. Sleep until a callback is dispatched. Check again for
+         * work after announcing to be idle. */
         if(!dc) {
             pthread_mutex_lock(&wq->dispatchQueue_conditionMutex);
-            pthread_cond_wait(&wq->dispatchQueue_condition,
-                              &wq->dispatchQueue_conditionMutex);
+            __atomic_add_fetch(&wq->idleWorkers, 1, __ATOMIC_SEQ_CST);
+            if(*running && !workAvailable(wq))
+                pthread_cond_wait(&wq->dispatchQueue_condition,
+                                  &wq->dispatchQueue_conditionMutex);
+            __atomic_sub_fetch(&wq->idleWorkers, 1, __ATOMIC_SEQ_CST);
             pthread_mutex_unlock(&wq->dispatchQueue_conditionMutex);
             continue;
         }
 
-        /* Execute */
-        if(dc->callback)
-            dc->callback(dc->application, dc->data);
-        UA_free(dc);
+        /* Execute. Callbacks enqueued from here inherit the epoch. */
+        worker->epoch = dc->epoch;
+        executeCallback(wq, dc);
     }
 
     return NULL;
@@ -118,18 +369,36 @@ UA_StatusCode
 UA_WorkQueue_start(UA_WorkQueue *wq, size_t workersCount) {
     if(wq->workersSize > 0 || workersCount == 0)
         return UA_STATUSCODE_BADINTERNALERROR;
-    
+    if(!wq->dispatchQueue.cells &&
+       UA_DispatchQueue_init(&wq->dispatchQueue, UA_DISPATCHQUEUE_SIZE) != UA_STATUSCODE_GOOD)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+
     /* Create the worker array */
     wq->workers = (UA_Worker*)UA_calloc(workersCount, sizeof(UA_Worker));
     if(!wq->workers)
         return UA_STATUSCODE_BADOUTOFMEMORY;
+    for(size_t i = 0; i < workersCount; ++i) {
+        if(UA_WorkDeque_init(&wq->workers[i].deque) != UA_STATUSCODE_GOOD) {
+            for(size_t j = 0; j < i; j++)
+                UA_WorkDeque_deleteMembers(&wq->workers[j].deque);
+            UA_free(wq->workers);
+            wq->workers = NULL;
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+        }
+    }
+    pthread_key_create(&wq->workerKey, NULL);
+
+    /* The workers look into the deques of the others. Set the size before the
+     * first worker is started. */
     wq->workersSize = workersCount;
 
     /* Spin up the workers */
     for(size_t i = 0; i < workersCount; ++i) {
         UA_Worker *w = &wq->workers[i];
         w->queue = wq;
-        w->counter = 0;
+        w->index = i;
+        w->nextVictim = (i + 1) % workersCount;
+        w->epoch = 0;
         w->running = true;
         pthread_create(&w->thread, NULL, (void* (*)(void*))workerLoop, w);
     }
@@ -145,15 +414,87 @@ void UA_WorkQueue_stop(UA_WorkQueue *wq) {
         wq->workers[i].running = false;
 
     /* Wake up all workers */
+    pthread_mutex_lock(&wq->dispatchQueue_conditionMutex);
     pthread_cond_broadcast(&wq->dispatchQueue_condition);
+    pthread_mutex_unlock(&wq->dispatchQueue_conditionMutex);
 
-    /* Wait for the workers to finish, then clean up */
+    /* Wait for the workers to finish */
     for(size_t i = 0; i < wq->workersSize; ++i)
         pthread_join(wq->workers[i].thread, NULL);
 
+    /* Move the remaining work to the dispatch queue (in order) and clean up */
+    for(size_t i = 0; i < wq->workersSize; ++i) {
+        UA_WorkDeque *q = &wq->workers[i].deque;
+        UA_DelayedCallback *dc;
+        while((dc = UA_WorkDeque_steal(q))) {
+            if(UA_DispatchQueue_push(&wq->dispatchQueue, dc) != UA_STATUSCODE_GOOD)
+                executeCallback(wq, dc);
+        }
+        UA_WorkDeque_deleteMembers(q);
+    }
+
     UA_free(wq->workers);
     wq->workers = NULL;
     wq->workersSize = 0;
+    pthread_key_delete(wq->workerKey);
+}
+
+/* Tag the callback with the epoch and count it as active. Outside of the
+ * workers, the epoch can advance concurrently (if the callback is not enqueued
+ * from the main thread). Retry until the counter was increased for the current
+ * epoch. */
+static void
+enterEpoch(UA_WorkQueue *wq, UA_DelayedCallback *dc, UA_Worker *worker) {
+    if(worker) {
+        dc->epoch = worker->epoch;
+        __atomic_add_fetch(&wq->activeCallbacks[dc->epoch % UA_WORKQUEUE_EPOCHS],
+                           1, __ATOMIC_SEQ_CST);
+        return;
+    }
+    do {
+        dc->epoch = __atomic_load_n(&wq->epoch, __ATOMIC_SEQ_CST);
+        __atomic_add_fetch(&wq->activeCallbacks[dc->epoch % UA_WORKQUEUE_EPOCHS],
+                           1, __ATOMIC_SEQ_CST);
+        if(__atomic_load_n(&wq->epoch, __ATOMIC_SEQ_CST) == dc->epoch)
+            return;
+        __atomic_sub_fetch(&wq->activeCallbacks[dc->epoch % UA_WORKQUEUE_EPOCHS],
+                           1, __ATOMIC_SEQ_CST);
+    } while(true);
+}
+
+static UA_Worker *
+currentWorker(UA_WorkQueue *wq) {
+    if(wq->workersSize == 0)
+        return NULL;
+    UA_Worker *worker = (UA_Worker*)pthread_getspecific(wq->workerKey);
+    return (worker && worker->queue == wq) ? worker : NULL;
+}
+
+UA_Boolean
+UA_WorkQueue_isWorker(UA_WorkQueue *wq) {
+    return (currentWorker(wq) != NULL);
+}
+
+/* Push to the deque of the current worker thread or to the dispatch queue */
+static UA_StatusCode
+dispatch(UA_WorkQueue *wq, UA_DelayedCallback *dc) {
+    UA_StatusCode retval;
+    UA_Worker *worker = currentWorker(wq);
+    if(worker) {
+        enterEpoch(wq, dc, worker);
+        retval = UA_WorkDeque_push(&worker->deque, dc);
+        goto finish;
+    }
+    if(!wq->dispatchQueue.cells)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    enterEpoch(wq, dc, NULL);
+    retval = UA_DispatchQueue_push(&wq->dispatchQueue, dc);
+
+ finish:
+    if(retval != UA_STATUSCODE_GOOD)
+        __atomic_sub_fetch(&wq->activeCallbacks[dc->epoch % UA_WORKQUEUE_EPOCHS],
+                           1, __ATOMIC_RELEASE);
+    return retval;
 }
 
 void UA_WorkQueue_enqueue(UA_WorkQueue *wq, UA_ApplicationCallback cb,
@@ -169,12 +510,14 @@ void UA_WorkQueue_enqueue(UA_WorkQueue *wq, UA_ApplicationCallback cb,
     dc->data = data;
 
     /* Enqueue for the worker threads */
-    pthread_mutex_lock(&wq->dispatchQueue_accessMutex);
-    SIMPLEQ_INSERT_TAIL(&wq->dispatchQueue, dc, next);
-    pthread_mutex_unlock(&wq->dispatchQueue_accessMutex);
+    if(dispatch(wq, dc) != UA_STATUSCODE_GOOD) {
+        UA_free(dc);
+        cb(application, data);
+        return;
+    }
 
-    /* Wake up sleeping workers */
-    pthread_cond_broadcast(&wq->dispatchQueue_condition);
+    /* Wake up a sleeping worker */
+    wakeWorker(wq);
 }
 
 #endif
@@ -183,68 +526,59 @@ void UA_WorkQueue_enqueue(UA_WorkQueue *wq, UA_ApplicationCallback cb,
 /* Delayed Callbacks */
 /*********************/
 
+void
+UA_WorkQueue_enqueueDelayed(UA_WorkQueue *wq, UA_DelayedCallback *cb) {
 #ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_lock(&wq->delayedCallbacks_accessMutex);
+    /* The memory was unlinked before. So the epoch is read afterwards. Reading
+     * under the mutex keeps the queue sorted by epoch. */
+    cb->epoch = __atomic_load_n(&wq->epoch, __ATOMIC_SEQ_CST);
+#endif
 
-/* Delayed Callbacks are called only when all callbacks that were dispatched
- * prior are finished. After every UA_MAX_DELAYED_SAMPLE delayed Callbacks that
- * were added to the queue, we sample the counters from the workers. The
- * counters are compared to the last counters that were sampled. If every worker
- * has proceeded the counter, then we know that all delayed callbacks prior to
- * the last sample-point are safe to execute. */
-
-/* Sample the worker counter for every nth delayed callback. This is used to
- * test that all workers have **finished** their current job before the delayed
- * callback is processed. */
-#define UA_MAX_DELAYED_SAMPLE 100
-
-/* Call only with a held mutex for the delayed callbacks */
-static void
-dispatchDelayedCallbacks(UA_WorkQueue *wq, UA_DelayedCallback *cb) {
-    /* Are callbacks before the last checkpoint ready? */
-    for(size_t i = 0; i < wq->workersSize; ++i) {
-        if(wq->workers[i].counter == wq->workers[i].checkpointCounter)
-            return;
-    }
-
-    /* Dispatch all delayed callbacks up to the checkpoint.
-     * TODO: Move over the entire queue up to the checkpoint in one step. */
-    if(wq->delayedCallbacks_checkpoint != NULL) {
-        UA_DelayedCallback *iter, *tmp_iter;
-        SIMPLEQ_FOREACH_SAFE(iter, &wq->delayedCallbacks, next, tmp_iter) {
-            pthread_mutex_lock(&wq->dispatchQueue_accessMutex);
-            SIMPLEQ_INSERT_TAIL(&wq->dispatchQueue, iter, next);
-            pthread_mutex_unlock(&wq->dispatchQueue_accessMutex);
-            if(iter == wq->delayedCallbacks_checkpoint)
-                break;
-        }
-    }
+    SIMPLEQ_INSERT_TAIL(&wq->delayedCallbacks, cb, next);
 
-    /* Create the new sample point */
-    for(size_t i = 0; i < wq->workersSize; ++i)
-        wq->workers[i].checkpointCounter = wq->workers[i].counter;
-    wq->delayedCallbacks_checkpoint = cb;
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_unlock(&wq->delayedCallbacks_accessMutex);
+#endif
 }
 
-#endif
+#ifdef UA_ENABLE_MULTITHREADING
 
 void
-UA_WorkQueue_enqueueDelayed(UA_WorkQueue *wq, UA_DelayedCallback *cb) {
-#ifdef UA_ENABLE_MULTITHREADING
-    pthread_mutex_lock(&wq->dispatchQueue_accessMutex);
-#endif
+UA_WorkQueue_quiescent(UA_WorkQueue *wq) {
+    /* Advance the epoch when all callbacks of the previous epoch are done. The
+     * main thread is quiescent. So we can advance twice in a row. */
+    UA_UInt64 epoch = wq->epoch;
+    for(size_t i = 0; i < 2; i++) {
+        size_t previous = (size_t)((epoch + UA_WORKQUEUE_EPOCHS - 1) % UA_WORKQUEUE_EPOCHS);
+        if(__atomic_load_n(&wq->activeCallbacks[previous], __ATOMIC_SEQ_CST) > 0)
+            break;
+        epoch++;
+        __atomic_store_n(&wq->epoch, epoch, __ATOMIC_SEQ_CST);
+    }
 
-    SIMPLEQ_INSERT_HEAD(&wq->delayedCallbacks, cb, next);
+    /* Take out the delayed callbacks retired at least two epochs ago. They are
+     * at the head of the queue. Execute outside of the mutex, as the callbacks
+     * may enqueue further delayed callbacks. */
+    SIMPLEQ_HEAD(, UA_DelayedCallback) ready = SIMPLEQ_HEAD_INITIALIZER(ready);
+    pthread_mutex_lock(&wq->delayedCallbacks_accessMutex);
+    UA_DelayedCallback *dc;
+    while((dc = SIMPLEQ_FIRST(&wq->delayedCallbacks)) && dc->epoch + 2 <= epoch) {
+        SIMPLEQ_REMOVE_HEAD(&wq->delayedCallbacks, next);
+        SIMPLEQ_INSERT_TAIL(&ready, dc, next);
+    }
+    pthread_mutex_unlock(&wq->delayedCallbacks_accessMutex);
 
-#ifdef UA_ENABLE_MULTITHREADING
-    wq->delayedCallbacks_sinceDispatch++;
-    if(wq->delayedCallbacks_sinceDispatch > UA_MAX_DELAYED_SAMPLE) {
-        dispatchDelayedCallbacks(wq, cb);
-        wq->delayedCallbacks_sinceDispatch = 0;
+    while((dc = SIMPLEQ_FIRST(&ready))) {
+        SIMPLEQ_REMOVE_HEAD(&ready, next);
+        if(dc->callback)
+            dc->callback(dc->application, dc->data);
+        UA_free(dc);
     }
-    pthread_mutex_unlock(&wq->dispatchQueue_accessMutex);
-#endif
 }
 
+#endif
+
 /* Assumes all workers are shut down */
 void UA_WorkQueue_manuallyProcessDelayed(UA_WorkQueue *wq) {
     UA_DelayedCallback *dc, *dc_tmp;
@@ -254,7 +588,4 @@ void UA_WorkQueue_manuallyProcessDelayed(UA_WorkQueue *wq) {
             dc->callback(dc->application, dc->data);
         UA_free(dc);
     }
-#ifdef UA_ENABLE_MULTITHREADING
-    wq->delayedCallbacks_checkpoint = NULL;
-#endif
 }
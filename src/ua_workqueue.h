@@ -38,6 +38,9 @@ typedef struct UA_DelayedCallback {
     UA_ApplicationCallback callback;
     void *application;
     void *data;
+#ifdef UA_ENABLE_MULTITHREADING
+    UA_UInt64 epoch; /* Set internally by the work queue */
+#endif
 } UA_DelayedCallback;
 
 struct UA_WorkQueue;
@@ -45,24 +48,84 @@ typedef struct UA_WorkQueue UA_WorkQueue;
 
 #ifdef UA_ENABLE_MULTITHREADING
 
-/* Workers take out callbacks from the work queue and execute them.
- *
- * Future Plans: Use work-stealing to load-balance between cores.
+/* Work-stealing deque after Chase and Lev. The owner pushes and takes work at
+ * the bottom. Other threads steal from the top. The implementation follows
  * Le, Nhat Minh, et al. "Correct and efficient work-stealing for weak memory
- * models." ACM SIGPLAN Notices. Vol. 48. No. 8. ACM, 2013. */
+ * models." ACM SIGPLAN Notices. Vol. 48. No. 8. ACM, 2013.
+ *
+ * When the deque is full, the owner allocates an array of twice the size.
+ * Thieves may still read from the old array. So it is retired and freed only
+ * when the deque is cleaned up. */
+typedef struct UA_WorkDequeArray {
+    struct UA_WorkDequeArray *retired;
+    UA_Int64 size; /* Always a power of two */
+    UA_DelayedCallback *buffer[];
+} UA_WorkDequeArray;
+
+#define UA_WORKDEQUE_INITIALSIZE 256
+
+typedef struct {
+    volatile UA_Int64 top;
+    char padding[64 - sizeof(UA_Int64)]; /* top and bottom in separate cache lines */
+    volatile UA_Int64 bottom;
+    UA_WorkDequeArray *array;
+} UA_WorkDeque;
+
+/* Bounded multi-producer/multi-consumer queue for the work that is enqueued
+ * from outside the worker threads. Every cell carries a sequence number that
+ * tells producers and consumers whether the cell is free or filled for the
+ * current round. Pushing and popping need a single compare-and-swap and no
+ * lock. The implementation follows the bounded MPMC queue by Dmitry Vyukov. */
+typedef struct {
+    volatile size_t sequence;
+    UA_DelayedCallback *dc;
+} UA_DispatchCell;
+
+#define UA_DISPATCHQUEUE_SIZE 4096 /* Must be a power of two */
+
 typedef struct {
+    UA_DispatchCell *cells;
+    size_t mask;
+    char padding1[64 - sizeof(UA_DispatchCell*) - sizeof(size_t)];
+    volatile size_t enqueuePos;
+    char padding2[64 - sizeof(size_t)]; /* Producers and consumers in
+                                         * separate cache lines */
+    volatile size_t dequeuePos;
+} UA_DispatchQueue;
+
+/* Workers take out callbacks from their own deque and execute them. If the
+ * deque is empty, they take work from the dispatch queue and steal from the
+ * other workers. Callbacks enqueued from within a worker thread are
+ * pushed into the deque of that worker. */
+typedef struct {
+    UA_WorkDeque deque;
     pthread_t thread;
     volatile UA_Boolean running;
     UA_WorkQueue *queue;
-    UA_UInt32 counter;
-    UA_UInt32 checkpointCounter; /* Counter when the last checkpoint was made
-                                  * for the delayed callbacks */
-
-    /* separate cache lines */
-    char padding[64 - sizeof(void*) - sizeof(pthread_t) -
-                 sizeof(UA_UInt32) - sizeof(UA_Boolean)];
+    size_t index;
+    size_t nextVictim; /* Round-robin when stealing */
+    UA_UInt64 epoch; /* Epoch of the callback in execution */
 } UA_Worker;
 
+/* Epoch-based reclamation
+ * -----------------------
+ * Memory that may still be accessed by the workers is retired with a delayed
+ * callback instead of being freed right away. Readers (e.g. of the nodes in
+ * the nodestore) need no locks or atomic reference counts for this.
+ *
+ * Every enqueued callback is tagged with the current global epoch. Callbacks
+ * enqueued from a worker inherit the epoch of the callback in execution, as
+ * they may carry pointers obtained there. The number of unfinished callbacks
+ * is counted per epoch (modulo UA_WORKQUEUE_EPOCHS). Delayed callbacks are
+ * tagged with the epoch in which they were retired.
+ *
+ * Only the main thread advances the epoch, and only at its quiescent points
+ * where it holds no pointers to shared memory. The epoch advances from e to
+ * e+1 when all callbacks of epoch e-1 have finished. So once the epoch is two
+ * ahead of a delayed callback, no worker and not the main thread can access
+ * memory retired before. */
+#define UA_WORKQUEUE_EPOCHS 3
+
 #endif
 
 struct UA_WorkQueue {
@@ -72,11 +135,15 @@ struct UA_WorkQueue {
     UA_Worker *workers;
     size_t workersSize;
 
-    /* Work queue */
-    SIMPLEQ_HEAD(, UA_DelayedCallback) dispatchQueue; /* Dispatch queue for the worker threads */
-    pthread_mutex_t dispatchQueue_accessMutex; /* mutex for access to queue */
-    pthread_cond_t dispatchQueue_condition; /* so the workers don't spin if the queue is empty */
+    /* Work enqueued from outside the worker threads */
+    UA_DispatchQueue dispatchQueue;
+    pthread_key_t workerKey; /* Thread-local pointer to the current UA_Worker.
+                              * Valid while the workers are running. */
+
+    /* Workers sleep on the condition when no work can be found */
+    pthread_cond_t dispatchQueue_condition;
     pthread_mutex_t dispatchQueue_conditionMutex; /* mutex for access to condition variable */
+    volatile UA_UInt32 idleWorkers;
 #endif
 
     /* Delayed callbacks
@@ -84,9 +151,10 @@ struct UA_WorkQueue {
     SIMPLEQ_HEAD(, UA_DelayedCallback) delayedCallbacks;
 #ifdef UA_ENABLE_MULTITHREADING
     pthread_mutex_t delayedCallbacks_accessMutex;
-    UA_DelayedCallback *delayedCallbacks_checkpoint;
-    size_t delayedCallbacks_sinceDispatch; /* How many have been added since we
-                                            * tried to dispatch callbacks? */
+
+    /* Epoch-based reclamation */
+    volatile UA_UInt64 epoch; /* Written only by the main thread */
+    volatile UA_UInt32 activeCallbacks[UA_WORKQUEUE_EPOCHS];
 #endif
 };
 
@@ -96,8 +164,9 @@ void UA_WorkQueue_init(UA_WorkQueue *wq);
  * queue has been finished. The ``cb`` pointer is freed afterwards. ``cb`` can
  * have a NULL callback that is not executed.
  *
- * This method checks internally if existing delayed work can be moved from the
- * delayed queue to the worker dispatch queue. */
+ * With multithreading, the delayed callback retires memory in the current
+ * epoch. It is executed in the main thread by UA_WorkQueue_quiescent once no
+ * worker can hold a pointer to the memory anymore. */
 void UA_WorkQueue_enqueueDelayed(UA_WorkQueue *wq, UA_DelayedCallback *cb);
 
 /* Stop the workers, process all enqueued work in the calling thread, clean up
@@ -118,7 +187,18 @@ UA_StatusCode UA_WorkQueue_start(UA_WorkQueue *wq, size_t workersCount);
 
 void UA_WorkQueue_stop(UA_WorkQueue *wq);
 
-/* Enqueue work for the worker threads */
+/* Is the calling thread one of the workers of the queue? */
+UA_Boolean UA_WorkQueue_isWorker(UA_WorkQueue *wq);
+
+/* Called by the main thread when it holds no pointers to memory that can be
+ * retired with a delayed callback. Advances the epoch if possible and executes
+ * the delayed callbacks whose memory can no longer be accessed. */
+void UA_WorkQueue_quiescent(UA_WorkQueue *wq);
+
+/* Enqueue work for the worker threads. When called from a worker thread, the
+ * work is pushed into the deque of the worker. Otherwise it is added to the
+ * shared dispatch queue. A sleeping worker is woken up only if there is one.
+ * If the dispatch queue is full, the work is executed in the calling thread. */
 void UA_WorkQueue_enqueue(UA_WorkQueue *wq, UA_ApplicationCallback cb,
                           void *application, void *data);
 
@@ -4,19 +4,28 @@
 
 #include "ua_timer.h"
 #include "check.h"
+#include "testing_clock.h"
 
 #include <time.h>
 #include <stdio.h>
 
 #define N_EVENTS 10000
+#define N_MONITOREDITEMS 50000
+#define N_COUNTERS 100
 
 size_t count = 0;
+size_t counters[N_COUNTERS];
 
 static void
 timerCallback(void *application, void *data) {
     count++;
 }
 
+static void
+countingCallback(void *application, void *data) {
+    counters[(uintptr_t)data]++;
+}
+
 static void
 executionCallback(void *executionApplication, UA_ApplicationCallback cb,
                   void *callbackApplication, void *data) {
@@ -57,10 +66,114 @@ START_TEST(benchmarkTimer) {
     UA_Timer_deleteMembers(&timer);
 } END_TEST
 
+/* Every repeated callback is executed once per interval */
+START_TEST(repeatedCallbackIntervals) {
+    UA_Timer timer;
+    UA_Timer_init(&timer);
+    memset(counters, 0, sizeof(counters));
+    for(size_t i = 1; i < N_COUNTERS; i++) {
+        UA_StatusCode retval =
+            UA_Timer_addRepeatedCallback(&timer, countingCallback, NULL, (void*)i,
+                                         (UA_Double)i, NULL);
+        ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+    }
+
+    for(size_t ms = 0; ms < 1000; ms++) {
+        UA_fakeSleep(1);
+        UA_DateTime now = UA_DateTime_nowMonotonic();
+        UA_DateTime next = UA_Timer_process(&timer, now, executionCallback, NULL);
+        ck_assert(next > now);
+        ck_assert(next <= now + UA_DATETIME_MSEC);
+    }
+
+    for(size_t i = 1; i < N_COUNTERS; i++)
+        ck_assert_uint_eq(counters[i], 1000 / i);
+    UA_Timer_deleteMembers(&timer);
+} END_TEST
+
+START_TEST(removeAndChangeInterval) {
+    UA_Timer timer;
+    UA_Timer_init(&timer);
+    memset(counters, 0, sizeof(counters));
+    UA_UInt64 id1, id2, id3;
+    UA_Timer_addRepeatedCallback(&timer, countingCallback, NULL, (void*)1, 10.0, &id1);
+    UA_Timer_addRepeatedCallback(&timer, countingCallback, NULL, (void*)2, 10.0, &id2);
+    UA_Timer_removeCallback(&timer, id1);
+    ck_assert_int_eq(UA_Timer_changeRepeatedCallbackInterval(&timer, id2, 50.0),
+                     UA_STATUSCODE_GOOD);
+    ck_assert_int_eq(UA_Timer_changeRepeatedCallbackInterval(&timer, id1, 50.0),
+                     UA_STATUSCODE_BADNOTFOUND);
+
+    /* A removed id does not match a new callback */
+    UA_Timer_addRepeatedCallback(&timer, countingCallback, NULL, (void*)3, 20.0, &id3);
+    ck_assert_uint_ne(id1, id3);
+    UA_Timer_removeCallback(&timer, id1);
+
+    UA_fakeSleep(99);
+    UA_Timer_process(&timer, UA_DateTime_nowMonotonic(), executionCallback, NULL);
+    ck_assert_uint_eq(counters[1], 0);
+    ck_assert_uint_eq(counters[2], 1); /* Only once, as 99ms passed at once */
+    ck_assert_uint_eq(counters[3], 1);
+    UA_Timer_deleteMembers(&timer);
+} END_TEST
+
+/* A timed callback far in the future is executed once at the given time */
+START_TEST(timedCallbackFarFuture) {
+    UA_Timer timer;
+    UA_Timer_init(&timer);
+    memset(counters, 0, sizeof(counters));
+    UA_DateTime date = UA_DateTime_nowMonotonic() + (UA_DateTime)20 * 24 * 3600 * UA_DATETIME_SEC;
+    UA_Timer_addTimedCallback(&timer, countingCallback, NULL, (void*)1, date, NULL);
+
+    UA_DateTime now = UA_DateTime_nowMonotonic();
+    while(now < date) {
+        UA_DateTime next = UA_Timer_process(&timer, now, executionCallback, NULL);
+        ck_assert(next <= date);
+        ck_assert_uint_eq(counters[1], 0);
+        now += 3600 * UA_DATETIME_SEC;
+        if(now > date)
+            now = date;
+    }
+    UA_DateTime next = UA_Timer_process(&timer, now, executionCallback, NULL);
+    ck_assert_uint_eq(counters[1], 1);
+    ck_assert_int_eq(next, UA_INT64_MAX);
+    UA_Timer_deleteMembers(&timer);
+} END_TEST
+
+/* Many callbacks with the typical sampling intervals of monitored items. The
+ * timer is processed every millisecond. */
+START_TEST(benchmarkMonitoredItems) {
+    const UA_Double intervals[4] = {100.0, 250.0, 500.0, 1000.0};
+    UA_Timer timer;
+    UA_Timer_init(&timer);
+    count = 0;
+    for(size_t i = 0; i < N_MONITOREDITEMS; i++) {
+        /* Spread the first execution */
+        if(i % 100 == 0)
+            UA_fakeSleep(1);
+        UA_Timer_addRepeatedCallback(&timer, timerCallback, NULL, NULL,
+                                     intervals[i % 4], NULL);
+    }
+
+    clock_t begin = clock();
+    for(size_t ms = 0; ms < 10000; ms++) {
+        UA_fakeSleep(1);
+        UA_Timer_process(&timer, UA_DateTime_nowMonotonic(), executionCallback, NULL);
+    }
+    clock_t finish = clock();
+    printf("%u monitored items, 10s sampling: %lu callbacks in %f s\n",
+           N_MONITOREDITEMS, count, (double)(finish - begin) / CLOCKS_PER_SEC);
+    UA_Timer_deleteMembers(&timer);
+} END_TEST
+
 int main(void) {
     Suite *s  = suite_create("Test Event Timer");
     TCase *tc = tcase_create("test cases");
+    tcase_add_test(tc, repeatedCallbackIntervals);
+    tcase_add_test(tc, removeAndChangeInterval);
+    tcase_add_test(tc, timedCallbackFarFuture);
     tcase_add_test(tc, benchmarkTimer);
+    tcase_add_test(tc, benchmarkMonitoredItems);
     suite_add_tcase(s, tc);
 
     SRunner *sr = srunner_create(s);
@@ -8,6 +8,7 @@
 #include "ua_client.h"
 #include "ua_util.h"
 #include "ua_util_internal.h"
+#include "ua_plugin_network.h"
 #include "check.h"
 
 START_TEST(EndpointUrl_split) {
@@ -392,7 +393,158 @@ START_TEST(idToStringByte) {
     UA_String_deleteMembers(&str);
 } END_TEST
 
+START_TEST(BufferPool_recycle) {
+    UA_BufferPool pool;
+    memset(&pool, 0, sizeof(UA_BufferPool));
+
+    UA_ByteString buf1, buf2;
+    UA_StatusCode retval = UA_BufferPool_getBuffer(&pool, 8192, 100, &buf1);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(buf1.length, 100);
+    retval = UA_BufferPool_getBuffer(&pool, 8192, 8192, &buf2);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(pool.inUse, 2);
+    ck_assert_uint_eq(pool.allocations, 2);
+
+    /* The buffers are returned to the pool and handed out again */
+    UA_Byte *data2 = buf2.data;
+    UA_BufferPool_releaseBuffer(&pool, &buf1);
+    UA_BufferPool_releaseBuffer(&pool, &buf2);
+    ck_assert_ptr_eq(buf1.data, NULL);
+    ck_assert_uint_eq(pool.inUse, 0);
+    ck_assert_uint_eq(pool.idleSize, 2);
+    retval = UA_BufferPool_getBuffer(&pool, 8192, 8192, &buf1);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert_ptr_eq(buf1.data, data2);
+    ck_assert_uint_eq(pool.allocations, 2);
+    ck_assert_uint_eq(pool.reuses, 1);
+    ck_assert_uint_eq(pool.inUseHighWaterMark, 2);
+    ck_assert_uint_eq(pool.idleHighWaterMark, 2);
+
+    /* The length must not exceed the buffer size */
+    retval = UA_BufferPool_getBuffer(&pool, 8192, 8193, &buf2);
+    ck_assert_uint_ne(retval, UA_STATUSCODE_GOOD);
+
+    UA_BufferPool_releaseBuffer(&pool, &buf1);
+    UA_BufferPool_clear(&pool);
+    ck_assert_uint_eq(pool.idleSize, 0);
+} END_TEST
+
+START_TEST(BufferPool_limits) {
+    UA_BufferPool pool;
+    memset(&pool, 0, sizeof(UA_BufferPool));
+    pool.maxIdle = 2;
+
+    UA_ByteString bufs[4];
+    for(size_t i = 0; i < 4; i++) {
+        UA_StatusCode retval = UA_BufferPool_getBuffer(&pool, 8192, 8192, &bufs[i]);
+        ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    }
+
+    /* Only maxIdle buffers are kept */
+    for(size_t i = 0; i < 4; i++)
+        UA_BufferPool_releaseBuffer(&pool, &bufs[i]);
+    ck_assert_uint_eq(pool.idleSize, 2);
+
+    /* Buffers of an outdated size are freed when they are released */
+    UA_StatusCode retval = UA_BufferPool_getBuffer(&pool, 8192, 8192, &bufs[0]);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    retval = UA_BufferPool_getBuffer(&pool, 16384, 16384, &bufs[1]);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(pool.bufferSize, 16384);
+    ck_assert_uint_eq(pool.idleSize, 0);
+    UA_BufferPool_releaseBuffer(&pool, &bufs[0]);
+    ck_assert_uint_eq(pool.idleSize, 0);
+    UA_BufferPool_releaseBuffer(&pool, &bufs[1]);
+    ck_assert_uint_eq(pool.idleSize, 1);
+
+    UA_BufferPool_clear(&pool);
+} END_TEST
+
+typedef struct {
+    UA_HashIndexEntry entry;
+    UA_UInt32 id;
+} TestIndexed;
+
+static TestIndexed *
+findIndexed(UA_HashIndex *hi, UA_UInt32 id) {
+    UA_UInt32 hash = UA_HashIndex_hashUInt32(id);
+    UA_HashIndexEntry *e = UA_HashIndex_first(hi, hash);
+    for(; e; e = UA_HashIndex_next(e, hash)) {
+        TestIndexed *t = container_of(e, TestIndexed, entry);
+        if(t->id == id)
+            return t;
+    }
+    return NULL;
+}
 
+START_TEST(HashIndex_insertRemove) {
+    UA_HashIndex hi;
+    UA_HashIndex_init(&hi);
+    ck_assert_ptr_eq(findIndexed(&hi, 1), NULL);
+
+    /* The buckets grow with the entries */
+    TestIndexed items[1000];
+    for(UA_UInt32 i = 0; i < 1000; i++) {
+        items[i].id = i + 1;
+        UA_StatusCode retval =
+            UA_HashIndex_insert(&hi, &items[i].entry, UA_HashIndex_hashUInt32(i + 1));
+        ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    }
+    ck_assert_uint_eq(hi.entriesSize, 1000);
+    ck_assert_uint_ge(hi.bucketsSize, 1000);
+    for(UA_UInt32 i = 0; i < 1000; i++)
+        ck_assert_ptr_eq(findIndexed(&hi, i + 1), &items[i]);
+    ck_assert_ptr_eq(findIndexed(&hi, 1001), NULL);
+
+    /* Remove every second entry */
+    for(UA_UInt32 i = 0; i < 1000; i += 2)
+        UA_HashIndex_remove(&hi, &items[i].entry);
+    ck_assert_uint_eq(hi.entriesSize, 500);
+    for(UA_UInt32 i = 0; i < 1000; i++) {
+        if(i % 2 == 0)
+            ck_assert_ptr_eq(findIndexed(&hi, i + 1), NULL);
+        else
+            ck_assert_ptr_eq(findIndexed(&hi, i + 1), &items[i]);
+    }
+
+    /* Removing an entry twice does nothing */
+    UA_HashIndex_remove(&hi, &items[0].entry);
+    ck_assert_uint_eq(hi.entriesSize, 500);
+
+    UA_HashIndex_deleteMembers(&hi);
+    ck_assert_uint_eq(hi.bucketsSize, 0);
+} END_TEST
+
+START_TEST(HashIndex_collisions) {
+    UA_HashIndex hi;
+    UA_HashIndex_init(&hi);
+
+    /* Entries with the same hash are told apart by the key */
+    TestIndexed items[20];
+    for(UA_UInt32 i = 0; i < 20; i++) {
+        items[i].id = i;
+        UA_StatusCode retval = UA_HashIndex_insert(&hi, &items[i].entry, 42);
+        ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    }
+    UA_UInt32 found = 0;
+    UA_HashIndexEntry *e = UA_HashIndex_first(&hi, 42);
+    for(; e; e = UA_HashIndex_next(e, 42))
+        found++;
+    ck_assert_uint_eq(found, 20);
+    ck_assert_ptr_eq(UA_HashIndex_first(&hi, 43), NULL);
+
+    UA_HashIndex_remove(&hi, &items[10].entry);
+    found = 0;
+    e = UA_HashIndex_first(&hi, 42);
+    for(; e; e = UA_HashIndex_next(e, 42)) {
+        ck_assert_ptr_ne(e, &items[10].entry);
+        found++;
+    }
+    ck_assert_uint_eq(found, 19);
+
+    UA_HashIndex_deleteMembers(&hi);
+} END_TEST
 
 static Suite* testSuite_Utils(void) {
     Suite *s = suite_create("Utils");
@@ -417,6 +569,16 @@ static Suite* testSuite_Utils(void) {
     tcase_add_test(tc1, idToStringByte);
     suite_add_tcase(s, tc1);
 
+    TCase *tc_bufferPool = tcase_create("BufferPool");
+    tcase_add_test(tc_bufferPool, BufferPool_recycle);
+    tcase_add_test(tc_bufferPool, BufferPool_limits);
+    suite_add_tcase(s, tc_bufferPool);
+
+    TCase *tc_hashIndex = tcase_create("HashIndex");
+    tcase_add_test(tc_hashIndex, HashIndex_insertRemove);
+    tcase_add_test(tc_hashIndex, HashIndex_collisions);
+    suite_add_tcase(s, tc_hashIndex);
+
     return s;
 }
 
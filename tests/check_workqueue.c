@@ -0,0 +1,225 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "ua_workqueue.h"
+#include "check.h"
+
+#include <pthread.h>
+#include <unistd.h>
+
+#define N_SPAWN 64  /* Callbacks enqueued from within a worker */
+#define N_SPAWNERS 1000
+#define WORK_ROUNDS 2000
+#define N_PRODUCERS 4 /* Threads that enqueue concurrently */
+#define N_ORDERED 1000 /* Callbacks per producer. All fit in the dispatch queue. */
+
+static volatile UA_UInt32 executed;
+static volatile UA_UInt32 delayedExecuted;
+static volatile UA_UInt32 sink;
+
+/* How often every spawned callback was executed */
+static UA_UInt32 executions[N_SPAWNERS * N_SPAWN];
+
+/* Simulates a callback with some cpu load */
+static void
+busyCallback(void *application, void *data) {
+    UA_UInt32 x = (UA_UInt32)(uintptr_t)data;
+    for(size_t i = 0; i < WORK_ROUNDS; i++)
+        x = x * 1664525u + 1013904223u;
+    sink = x;
+    UA_atomic_addUInt32(&executed, 1);
+}
+
+static void
+countCallback(void *application, void *data) {
+    UA_atomic_addUInt32(&executions[(uintptr_t)data], 1);
+    busyCallback(application, data);
+}
+
+/* Enqueues further callbacks from within the worker. They can be stolen by the
+ * other workers. */
+static void
+spawnCallback(void *application, void *data) {
+    UA_WorkQueue *wq = (UA_WorkQueue*)application;
+    uintptr_t first = (uintptr_t)data * N_SPAWN;
+    for(uintptr_t i = 1; i < N_SPAWN; i++)
+        UA_WorkQueue_enqueue(wq, countCallback, NULL, (void*)(first + i));
+    countCallback(application, (void*)first);
+}
+
+/* The last sequence number executed for every producer. Only accessed from
+ * the single worker. */
+static size_t lastSequence[N_PRODUCERS];
+static size_t orderViolations;
+
+static void
+orderedCallback(void *application, void *data) {
+    size_t producer = (uintptr_t)application;
+    size_t sequence = (uintptr_t)data;
+    if(sequence != lastSequence[producer] + 1)
+        orderViolations++;
+    lastSequence[producer] = sequence;
+    UA_atomic_addUInt32(&executed, 1);
+}
+
+struct Producer {
+    UA_WorkQueue *wq;
+    uintptr_t index;
+};
+
+static void *
+producerLoop(void *arg) {
+    struct Producer *p = (struct Producer*)arg;
+    for(uintptr_t i = 1; i <= N_ORDERED; i++)
+        UA_WorkQueue_enqueue(p->wq, orderedCallback, (void*)p->index, (void*)i);
+    return NULL;
+}
+
+static void
+delayedCallback(void *application, void *data) {
+    UA_atomic_addUInt32(&delayedExecuted, 1);
+}
+
+static void
+waitExecuted(UA_UInt32 count) {
+    while(UA_atomic_addUInt32(&executed, 0) < count)
+        usleep(100);
+}
+
+/* Every callback is executed exactly once. Also when it was enqueued from a
+ * worker and then stolen by another worker. */
+START_TEST(enqueueFromWorkers) {
+    UA_WorkQueue wq;
+    memset(&wq, 0, sizeof(UA_WorkQueue));
+    UA_WorkQueue_init(&wq);
+    ck_assert_uint_eq(UA_WorkQueue_start(&wq, 4), UA_STATUSCODE_GOOD);
+
+    executed = 0;
+    memset(executions, 0, sizeof(executions));
+    for(uintptr_t i = 0; i < N_SPAWNERS; i++) /* Forces the deques to grow */
+        UA_WorkQueue_enqueue(&wq, spawnCallback, &wq, (void*)i);
+    waitExecuted(N_SPAWNERS * N_SPAWN);
+
+    UA_WorkQueue_cleanup(&wq);
+    ck_assert_uint_eq(executed, N_SPAWNERS * N_SPAWN);
+    for(size_t i = 0; i < N_SPAWNERS * N_SPAWN; i++)
+        ck_assert_uint_eq(executions[i], 1);
+} END_TEST
+
+/* Several threads enqueue at the same time. A single worker executes the
+ * callbacks of every producer in the order they were enqueued. */
+START_TEST(dispatchOrder) {
+    UA_WorkQueue wq;
+    memset(&wq, 0, sizeof(UA_WorkQueue));
+    UA_WorkQueue_init(&wq);
+    ck_assert_uint_eq(UA_WorkQueue_start(&wq, 1), UA_STATUSCODE_GOOD);
+
+    executed = 0;
+    orderViolations = 0;
+    memset(lastSequence, 0, sizeof(lastSequence));
+    pthread_t threads[N_PRODUCERS];
+    struct Producer p[N_PRODUCERS];
+    for(size_t i = 0; i < N_PRODUCERS; i++) {
+        p[i].wq = &wq;
+        p[i].index = i;
+        pthread_create(&threads[i], NULL, producerLoop, &p[i]);
+    }
+    for(size_t i = 0; i < N_PRODUCERS; i++)
+        pthread_join(threads[i], NULL);
+    waitExecuted(N_PRODUCERS * N_ORDERED);
+
+    UA_WorkQueue_cleanup(&wq);
+    ck_assert_uint_eq(executed, N_PRODUCERS * N_ORDERED);
+    ck_assert_uint_eq(orderViolations, 0);
+    for(size_t i = 0; i < N_PRODUCERS; i++)
+        ck_assert_uint_eq(lastSequence[i], N_ORDERED);
+} END_TEST
+
+START_TEST(delayedCallbacks) {
+    UA_WorkQueue wq;
+    memset(&wq, 0, sizeof(UA_WorkQueue));
+    UA_WorkQueue_init(&wq);
+    ck_assert_uint_eq(UA_WorkQueue_start(&wq, 2), UA_STATUSCODE_GOOD);
+
+    executed = 0;
+    delayedExecuted = 0;
+    size_t delayed = 1000;
+    for(size_t i = 0; i < delayed; i++) {
+        UA_WorkQueue_enqueue(&wq, busyCallback, NULL, NULL);
+        UA_DelayedCallback *dc = (UA_DelayedCallback*)UA_malloc(sizeof(UA_DelayedCallback));
+        dc->callback = delayedCallback;
+        dc->application = NULL;
+        dc->data = NULL;
+        UA_WorkQueue_enqueueDelayed(&wq, dc);
+    }
+
+    /* Remaining work and delayed callbacks are processed during cleanup */
+    UA_WorkQueue_cleanup(&wq);
+    ck_assert_uint_eq(executed, delayed);
+    ck_assert_uint_eq(delayedExecuted, delayed);
+} END_TEST
+
+static volatile UA_Boolean blocked;
+
+static void
+blockingCallback(void *application, void *data) {
+    while(__atomic_load_n(&blocked, __ATOMIC_SEQ_CST))
+        usleep(100);
+    UA_atomic_addUInt32(&executed, 1);
+}
+
+/* Memory retired in a delayed callback is not reclaimed while a callback that
+ * was dispatched before is still running */
+START_TEST(epochReclamation) {
+    UA_WorkQueue wq;
+    memset(&wq, 0, sizeof(UA_WorkQueue));
+    UA_WorkQueue_init(&wq);
+    ck_assert_uint_eq(UA_WorkQueue_start(&wq, 2), UA_STATUSCODE_GOOD);
+
+    executed = 0;
+    delayedExecuted = 0;
+    blocked = true;
+    UA_WorkQueue_enqueue(&wq, blockingCallback, NULL, NULL);
+    UA_DelayedCallback *dc = (UA_DelayedCallback*)UA_malloc(sizeof(UA_DelayedCallback));
+    dc->callback = delayedCallback;
+    dc->application = NULL;
+    dc->data = NULL;
+    UA_WorkQueue_enqueueDelayed(&wq, dc);
+
+    /* Later callbacks don't hold up the reclamation */
+    for(size_t i = 0; i < 10; i++) {
+        UA_WorkQueue_enqueue(&wq, busyCallback, NULL, NULL);
+        UA_WorkQueue_quiescent(&wq);
+    }
+    ck_assert_uint_eq(delayedExecuted, 0);
+
+    __atomic_store_n(&blocked, false, __ATOMIC_SEQ_CST);
+    waitExecuted(11);
+    for(size_t i = 0; i < 1000 && delayedExecuted == 0; i++) {
+        UA_WorkQueue_quiescent(&wq);
+        usleep(100);
+    }
+    ck_assert_uint_eq(delayedExecuted, 1);
+
+    UA_WorkQueue_cleanup(&wq);
+} END_TEST
+
+int main(void) {
+    Suite *s  = suite_create("Test Work Queue");
+    TCase *tc = tcase_create("test cases");
+    tcase_add_test(tc, enqueueFromWorkers);
+    tcase_add_test(tc, dispatchOrder);
+    tcase_add_test(tc, delayedCallbacks);
+    tcase_add_test(tc, epochReclamation);
+    tcase_set_timeout(tc, 60);
+    suite_add_tcase(s, tc);
+
+    SRunner *sr = srunner_create(s);
+    srunner_set_fork_status(sr, CK_NOFORK);
+    srunner_run_all (sr, CK_NORMAL);
+    int number_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
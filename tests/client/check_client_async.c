@@ -234,6 +234,111 @@ START_TEST(Client_connectivity_check) {
         UA_Client_delete(client);
     }END_TEST
 
+#ifdef UA_ENABLE_MULTITHREADING
+
+static void setup_parallel(void) {
+    running = true;
+    config = UA_ServerConfig_new_default();
+    config->nThreads = 4;
+    server = UA_Server_new(config);
+    UA_Server_run_startup(server);
+    THREAD_CREATE(server_thread, serverloop);
+}
+
+typedef struct {
+    UA_UInt32 lastRequestId;
+    size_t received;
+    size_t outOfOrder;
+} ResponseOrder;
+
+static void asyncOrderCallback(UA_Client *client, void *userdata,
+                               UA_UInt32 requestId, void *response) {
+    ResponseOrder *order = (ResponseOrder*)userdata;
+    if(requestId < order->lastRequestId)
+        order->outOfOrder++;
+    order->lastRequestId = requestId;
+    order->received++;
+    ck_assert_uint_eq(((UA_ResponseHeader*)response)->serviceResult, UA_STATUSCODE_GOOD);
+    UA_fakeSleep(10);
+}
+
+/* Read and Browse are processed by the workers. Write is processed in the
+ * network thread. The responses arrive in the order of the requests. */
+START_TEST(Client_parallel_services_in_order) {
+        UA_Client *client = UA_Client_new();
+        UA_ClientConfig *clientConfig = UA_Client_getConfig(client);
+        UA_ClientConfig_setDefault(clientConfig);
+
+        UA_StatusCode retval = UA_Client_connect(client, "opc.tcp://localhost:4840");
+        ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+
+        UA_ReadRequest rr;
+        UA_ReadRequest_init(&rr);
+        UA_ReadValueId rvid;
+        UA_ReadValueId_init(&rvid);
+        rvid.attributeId = UA_ATTRIBUTEID_VALUE;
+        rvid.nodeId = UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERSTATUS_CURRENTTIME);
+        rr.nodesToRead = &rvid;
+        rr.nodesToReadSize = 1;
+
+        UA_BrowseRequest br;
+        UA_BrowseRequest_init(&br);
+        UA_BrowseDescription bd;
+        UA_BrowseDescription_init(&bd);
+        bd.nodeId = UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER);
+        bd.resultMask = UA_BROWSERESULTMASK_ALL;
+        br.nodesToBrowse = &bd;
+        br.nodesToBrowseSize = 1;
+
+        /* Writing the ServerStatus is not allowed. But the service is
+         * processed and answered. */
+        UA_WriteRequest wr;
+        UA_WriteRequest_init(&wr);
+        UA_WriteValue wv;
+        UA_WriteValue_init(&wv);
+        UA_Int32 value = 42;
+        wv.nodeId = UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERSTATUS_CURRENTTIME);
+        wv.attributeId = UA_ATTRIBUTEID_VALUE;
+        wv.value.hasValue = true;
+        UA_Variant_setScalar(&wv.value.value, &value, &UA_TYPES[UA_TYPES_INT32]);
+        wr.nodesToWrite = &wv;
+        wr.nodesToWriteSize = 1;
+
+        ResponseOrder order;
+        memset(&order, 0, sizeof(ResponseOrder));
+        for(size_t i = 0; i < 300; i++) {
+            switch(i % 3) {
+            case 0:
+                retval = __UA_Client_AsyncService(client, &rr, &UA_TYPES[UA_TYPES_READREQUEST],
+                                                  asyncOrderCallback,
+                                                  &UA_TYPES[UA_TYPES_READRESPONSE], &order, NULL);
+                break;
+            case 1:
+                retval = __UA_Client_AsyncService(client, &br, &UA_TYPES[UA_TYPES_BROWSEREQUEST],
+                                                  asyncOrderCallback,
+                                                  &UA_TYPES[UA_TYPES_BROWSERESPONSE], &order, NULL);
+                break;
+            default:
+                retval = __UA_Client_AsyncService(client, &wr, &UA_TYPES[UA_TYPES_WRITEREQUEST],
+                                                  asyncOrderCallback,
+                                                  &UA_TYPES[UA_TYPES_WRITERESPONSE], &order, NULL);
+                break;
+            }
+            ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+        }
+
+        /* Process async responses during 3s */
+        retval = UA_Client_run_iterate(client, 2999);
+        ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+        ck_assert_uint_eq(order.received, 300);
+        ck_assert_uint_eq(order.outOfOrder, 0);
+
+        UA_Client_disconnect(client);
+        UA_Client_delete(client);
+    }END_TEST
+
+#endif
+
 static Suite* testSuite_Client(void) {
     Suite *s = suite_create("Client");
     TCase *tc_client = tcase_create("Client Basic");
@@ -244,6 +349,13 @@ static Suite* testSuite_Client(void) {
     tcase_add_test(tc_client, Client_highlevel_async_readValue);
 
     suite_add_tcase(s, tc_client);
+
+#ifdef UA_ENABLE_MULTITHREADING
+    TCase *tc_parallel = tcase_create("Client Parallel Services");
+    tcase_add_checked_fixture(tc_parallel, setup_parallel, teardown);
+    tcase_add_test(tc_parallel, Client_parallel_services_in_order);
+    suite_add_tcase(s, tc_parallel);
+#endif
     return s;
 }
 
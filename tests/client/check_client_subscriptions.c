@@ -221,6 +221,98 @@ START_TEST(Client_subscription_createDataChanges) {
 }
 END_TEST
 
+UA_Int32 lastIntValue = 0;
+
+static void
+intValueHandler(UA_Client *client, UA_UInt32 subId, void *subContext,
+                UA_UInt32 monId, void *monContext, UA_DataValue *value) {
+    ck_assert(value->hasValue);
+    ck_assert(UA_Variant_hasScalarType(&value->value, &UA_TYPES[UA_TYPES_INT32]));
+    lastIntValue = *(UA_Int32*)value->value.data;
+    countNotificationReceived++;
+}
+
+START_TEST(Client_subscription_sharedEncoding) {
+    UA_Server_getConfig(server)->shareNotificationEncoding = true;
+
+    UA_Client *client = UA_Client_new();
+    UA_ClientConfig_setDefault(UA_Client_getConfig(client));
+    UA_StatusCode retval = UA_Client_connect(client, "opc.tcp://localhost:4840");
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+
+    UA_Client_recv = client->connection.recv;
+    client->connection.recv = UA_Client_recvTesting;
+
+    /* Add a variable */
+    UA_VariableAttributes attr = UA_VariableAttributes_default;
+    attr.accessLevel = UA_ACCESSLEVELMASK_READ | UA_ACCESSLEVELMASK_WRITE;
+    UA_Int32 intValue = 1;
+    UA_Variant_setScalar(&attr.value, &intValue, &UA_TYPES[UA_TYPES_INT32]);
+    attr.dataType = UA_TYPES[UA_TYPES_INT32].typeId;
+    UA_NodeId nodeId;
+    retval = UA_Client_addVariableNode(client, UA_NODEID_NULL,
+                                       UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                       UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                       UA_QUALIFIEDNAME(1, "SharedEncoding"),
+                                       UA_NODEID_NULL, attr, &nodeId);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+
+    /* Two subscriptions monitor the variable with the same settings. The
+     * sample is encoded once for both notifications. */
+    UA_UInt32 subIds[2];
+    countNotificationReceived = 0;
+    for(size_t i = 0; i < 2; i++) {
+        UA_CreateSubscriptionRequest request = UA_CreateSubscriptionRequest_default();
+        UA_CreateSubscriptionResponse response =
+            UA_Client_Subscriptions_create(client, request, NULL, NULL, NULL);
+        ck_assert_uint_eq(response.responseHeader.serviceResult, UA_STATUSCODE_GOOD);
+        subIds[i] = response.subscriptionId;
+
+        UA_MonitoredItemCreateRequest monRequest = UA_MonitoredItemCreateRequest_default(nodeId);
+        UA_MonitoredItemCreateResult monResponse =
+            UA_Client_MonitoredItems_createDataChange(client, subIds[i],
+                                                      UA_TIMESTAMPSTORETURN_BOTH,
+                                                      monRequest, NULL, intValueHandler, NULL);
+        ck_assert_uint_eq(monResponse.statusCode, UA_STATUSCODE_GOOD);
+    }
+
+    /* Receive the initial values. Notifications can also arrive while the
+     * client waits for other responses. */
+    for(size_t i = 0; i < 4 && countNotificationReceived < 2; i++) {
+        UA_fakeSleep((UA_UInt32)publishingInterval + 1);
+        retval = UA_Client_run_iterate(client, (UA_UInt16)(publishingInterval + 1));
+        ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    }
+    ck_assert_uint_eq(countNotificationReceived, 2);
+    ck_assert_int_eq(lastIntValue, 1);
+
+    /* Change the value. Both subscriptions receive the shared sample. */
+    intValue = 42;
+    UA_Variant value;
+    UA_Variant_setScalar(&value, &intValue, &UA_TYPES[UA_TYPES_INT32]);
+    countNotificationReceived = 0;
+    retval = UA_Client_writeValueAttribute(client, nodeId, &value);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+
+    for(size_t i = 0; i < 4 && countNotificationReceived < 2; i++) {
+        UA_fakeSleep((UA_UInt32)publishingInterval + 1);
+        retval = UA_Client_run_iterate(client, (UA_UInt16)(publishingInterval + 1));
+        ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    }
+    ck_assert_uint_eq(countNotificationReceived, 2);
+    ck_assert_int_eq(lastIntValue, 42);
+
+    for(size_t i = 0; i < 2; i++) {
+        retval = UA_Client_Subscriptions_deleteSingle(client, subIds[i]);
+        ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    }
+
+    UA_Client_disconnect(client);
+    UA_Client_delete(client);
+    UA_Server_getConfig(server)->shareNotificationEncoding = false;
+}
+END_TEST
+
 START_TEST(Client_subscription_keepAlive) {
     UA_Client *client = UA_Client_new();
     UA_ClientConfig_setDefault(UA_Client_getConfig(client));
@@ -559,6 +651,7 @@ static Suite* testSuite_Client(void) {
     tcase_add_test(tc_client, Client_subscription);
     tcase_add_test(tc_client, Client_subscription_connectionClose);
     tcase_add_test(tc_client, Client_subscription_createDataChanges);
+    tcase_add_test(tc_client, Client_subscription_sharedEncoding);
     tcase_add_test(tc_client, Client_subscription_keepAlive);
     tcase_add_test(tc_client, Client_subscription_without_notification);
     tcase_add_test(tc_client, Client_subscription_async_sub);
@@ -7,8 +7,11 @@
 #include <time.h>
 
 #include "ua_types.h"
+#include "ua_server.h"
+#include "ua_config_default.h"
 #include "ua_plugin_nodestore.h"
 #include "ua_nodestore_default.h"
+#include "ua_nodestore_hashmap.h"
 #include "ua_util.h"
 #include "ziptree.h"
 #include "check.h"
@@ -44,12 +47,16 @@ static void checkAllReleased(void *context, const UA_Node* node) {
 
 UA_Nodestore ns;
 
+/* The test suite runs for every nodestore plugin */
+static UA_StatusCode (*newNodestore)(UA_Nodestore *ns);
+
 static void setup(void) {
-    UA_Nodestore_default_new(&ns);
+    newNodestore(&ns);
 }
 
 static void teardown(void) {
-    ns.iterate(ns.context, NULL, checkAllReleased);
+    if(newNodestore == UA_Nodestore_default_new)
+        ns.iterate(ns.context, NULL, checkAllReleased);
     ns.deleteNodestore(ns.context);
 }
 
@@ -190,6 +197,47 @@ START_TEST(iterateOverExpandedNamespaceShallNotVisitEmptyNodes) {
 }
 END_TEST
 
+START_TEST(findNodesInSeveralNamespaces) {
+    /* Small and large identifiers in namespace zero and the same identifiers
+     * in namespace one */
+    for(UA_UInt32 i = 0; i < 200; i++) {
+        ns.insertNode(ns.context, createNode(0,i+1), NULL);
+        ns.insertNode(ns.context, createNode(0,i+100000), NULL);
+        ns.insertNode(ns.context, createNode(1,i+1), NULL);
+    }
+
+    for(UA_UInt32 i = 0; i < 200; i++) {
+        UA_NodeId id = UA_NODEID_NUMERIC(0, i+1);
+        const UA_Node* nr = ns.getNode(ns.context, &id);
+        ck_assert(UA_NodeId_equal(&nr->nodeId, &id));
+        ns.releaseNode(ns.context, nr);
+        id = UA_NODEID_NUMERIC(0, i+100000);
+        nr = ns.getNode(ns.context, &id);
+        ck_assert(UA_NodeId_equal(&nr->nodeId, &id));
+        ns.releaseNode(ns.context, nr);
+        id = UA_NODEID_NUMERIC(1, i+1);
+        nr = ns.getNode(ns.context, &id);
+        ck_assert(UA_NodeId_equal(&nr->nodeId, &id));
+        ns.releaseNode(ns.context, nr);
+    }
+
+    UA_NodeId id = UA_NODEID_NUMERIC(0, 5);
+    ck_assert_int_eq(ns.removeNode(ns.context, &id), UA_STATUSCODE_GOOD);
+    const UA_Node* nr = ns.getNode(ns.context, &id);
+    ck_assert_int_eq((uintptr_t)nr, 0);
+    id = UA_NODEID_NUMERIC(1, 5);
+    nr = ns.getNode(ns.context, &id);
+    ck_assert_int_ne((uintptr_t)nr, 0);
+    ns.releaseNode(ns.context, nr);
+
+    zeroCnt = 0;
+    visitCnt = 0;
+    ns.iterate(ns.context, NULL, checkZeroVisitor);
+    ck_assert_int_eq(zeroCnt, 0);
+    ck_assert_int_eq(visitCnt, 599);
+}
+END_TEST
+
 START_TEST(failToFindNonExistentNodeInUA_NodeStoreWithSeveralEntries) {
     UA_Node* n1 = createNode(0,2253);
     ns.insertNode(ns.context, n1, NULL);
@@ -208,6 +256,50 @@ START_TEST(failToFindNonExistentNodeInUA_NodeStoreWithSeveralEntries) {
 }
 END_TEST
 
+START_TEST(removeNodesAndReinsert) {
+    for(UA_UInt32 i = 0; i < 200; i++) {
+        UA_Node* n = createNode(0,i+1);
+        ns.insertNode(ns.context, n, NULL);
+    }
+
+    /* Remove every second node */
+    for(UA_UInt32 i = 0; i < 200; i += 2) {
+        UA_NodeId id = UA_NODEID_NUMERIC(0, i+1);
+        UA_StatusCode retval = ns.removeNode(ns.context, &id);
+        ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+    }
+    UA_NodeId removed = UA_NODEID_NUMERIC(0, 1);
+    ck_assert_int_eq(ns.removeNode(ns.context, &removed), UA_STATUSCODE_BADNODEIDUNKNOWN);
+
+    /* The remaining nodes are still found */
+    for(UA_UInt32 i = 0; i < 200; i++) {
+        UA_NodeId id = UA_NODEID_NUMERIC(0, i+1);
+        const UA_Node* nr = ns.getNode(ns.context, &id);
+        if(i % 2 == 0) {
+            ck_assert_int_eq((uintptr_t)nr, 0);
+        } else {
+            ck_assert_int_ne((uintptr_t)nr, 0);
+            ns.releaseNode(ns.context, nr);
+        }
+    }
+
+    /* Reinsert the removed nodes */
+    for(UA_UInt32 i = 0; i < 200; i += 2) {
+        UA_Node* n = createNode(0,i+1);
+        UA_StatusCode retval = ns.insertNode(ns.context, n, NULL);
+        ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+    }
+    UA_Node* dup = createNode(0,1);
+    ck_assert_int_eq(ns.insertNode(ns.context, dup, NULL), UA_STATUSCODE_BADNODEIDEXISTS);
+
+    zeroCnt = 0;
+    visitCnt = 0;
+    ns.iterate(ns.context, NULL, checkZeroVisitor);
+    ck_assert_int_eq(zeroCnt, 0);
+    ck_assert_int_eq(visitCnt, 200);
+}
+END_TEST
+
 /************************************/
 /* Performance Profiling Test Cases */
 /************************************/
@@ -235,6 +327,328 @@ static void *profileGetThread(void *arg) {
 }
 #endif
 
+/* Without a retire callback, removed and replaced nodes stay valid until they
+ * are released */
+START_TEST(readRemovedNode) {
+    ns.insertNode(ns.context, createNode(0, 2253), NULL);
+    ns.insertNode(ns.context, createNode(1, 2253), NULL);
+    UA_NodeId in1 = UA_NODEID_NUMERIC(0, 2253);
+    UA_NodeId in2 = UA_NODEID_NUMERIC(1, 2253);
+    const UA_Node *n1 = ns.getNode(ns.context, &in1);
+    const UA_Node *n2 = ns.getNode(ns.context, &in2);
+    ck_assert_ptr_ne(n1, NULL);
+    ck_assert_ptr_ne(n2, NULL);
+
+    UA_StatusCode retval = ns.removeNode(ns.context, &in1);
+    ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+    UA_Node *copy;
+    retval = ns.getNodeCopy(ns.context, &in2, &copy);
+    ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+    copy->writeMask = 1;
+    retval = ns.replaceNode(ns.context, copy);
+    ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+
+    ck_assert(UA_NodeId_equal(&n1->nodeId, &in1));
+    ck_assert(UA_NodeId_equal(&n2->nodeId, &in2));
+    ck_assert_uint_eq(n2->writeMask, 0);
+    ns.releaseNode(ns.context, n1);
+    ns.releaseNode(ns.context, n2);
+    ck_assert_ptr_eq(ns.getNode(ns.context, &in1), NULL);
+}
+END_TEST
+
+/* The string members of nodes are interned and shared between nodes. They are
+ * edited in a node copy by replacing them via the interned methods. */
+START_TEST(editInternedStrings) {
+    UA_VariableAttributes attr = UA_VariableAttributes_default;
+    attr.displayName = UA_LOCALIZEDTEXT("en-US", "shared name");
+    UA_QualifiedName bn = UA_QUALIFIEDNAME(1, "shared name");
+    UA_Node *n1 = createNode(0, 2253);
+    UA_Node *n2 = createNode(0, 2255);
+    UA_StatusCode retval = UA_Node_setAttributes(n1, &attr, &UA_TYPES[UA_TYPES_VARIABLEATTRIBUTES]);
+    retval |= UA_Node_setAttributes(n2, &attr, &UA_TYPES[UA_TYPES_VARIABLEATTRIBUTES]);
+    retval |= UA_QualifiedName_copyInterned(&bn, &n1->browseName);
+    retval |= UA_QualifiedName_copyInterned(&bn, &n2->browseName);
+    ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert_ptr_eq(n1->displayName.text.data, n2->displayName.text.data);
+    ck_assert_ptr_eq(n1->browseName.name.data, n2->browseName.name.data);
+    ns.insertNode(ns.context, n1, NULL);
+    ns.insertNode(ns.context, n2, NULL);
+
+    /* The copy still shares the strings */
+    UA_NodeId in1 = UA_NODEID_NUMERIC(0, 2253);
+    UA_NodeId in2 = UA_NODEID_NUMERIC(0, 2255);
+    UA_Node *copy;
+    retval = ns.getNodeCopy(ns.context, &in1, &copy);
+    ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+
+    /* Replace with a plain heap copy and with a new interned string */
+    UA_LocalizedText dn = UA_LOCALIZEDTEXT("en-US", "new name");
+    UA_LocalizedText_deleteInterned(&copy->displayName);
+    retval = UA_LocalizedText_copy(&dn, &copy->displayName);
+    ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+    UA_QualifiedName newBn = UA_QUALIFIEDNAME(1, "new name");
+    UA_QualifiedName_deleteInterned(&copy->browseName);
+    retval = UA_QualifiedName_copyInterned(&newBn, &copy->browseName);
+    ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+    retval = ns.replaceNode(ns.context, copy);
+    ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+
+    const UA_Node *e1 = ns.getNode(ns.context, &in1);
+    const UA_Node *e2 = ns.getNode(ns.context, &in2);
+    ck_assert(UA_String_equal(&e1->displayName.text, &dn.text));
+    ck_assert(UA_QualifiedName_equal(&e1->browseName, &newBn));
+    ck_assert(UA_String_equal(&e2->displayName.text, &attr.displayName.text));
+    ck_assert(UA_QualifiedName_equal(&e2->browseName, &bn));
+    ns.releaseNode(ns.context, e1);
+    ns.releaseNode(ns.context, e2);
+}
+END_TEST
+
+START_TEST(nodeStatistics) {
+    UA_NodestoreStatistics stats;
+    UA_StatusCode retval = UA_Nodestore_default_getStatistics(&ns, &stats);
+    if(newNodestore != UA_Nodestore_default_new) {
+        ck_assert_int_eq(retval, UA_STATUSCODE_BADNOTSUPPORTED);
+        return;
+    }
+    ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+
+    for(UA_UInt32 i = 0; i < 100; i++)
+        ns.insertNode(ns.context, createNode(1, (UA_Int32)i + 1), NULL);
+    UA_Node *n = ns.newNode(ns.context, UA_NODECLASS_OBJECT);
+    n->nodeId = UA_NODEID_STRING_ALLOC(1, "Object");
+    ns.insertNode(ns.context, n, NULL);
+
+    retval = UA_Nodestore_default_getStatistics(&ns, &stats);
+    ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+    for(size_t i = 0; i < UA_NODESTORE_NODECLASSES; i++) {
+        UA_NodestoreClassStatistics *cs = &stats.classes[i];
+        ck_assert_uint_ge(cs->slabBytes, cs->nodes * cs->slotSize);
+        if(cs->nodeClass == UA_NODECLASS_VARIABLE) {
+            ck_assert_uint_eq(cs->nodes, 100);
+            ck_assert_uint_eq(cs->memberBytes, 0);
+        } else if(cs->nodeClass == UA_NODECLASS_OBJECT) {
+            ck_assert_uint_eq(cs->nodes, 1);
+            ck_assert_uint_eq(cs->memberBytes, strlen("Object"));
+        } else {
+            ck_assert_uint_eq(cs->nodes, 0);
+            ck_assert_uint_eq(cs->slabBytes, 0);
+        }
+    }
+
+    /* The slot of a removed node is reused */
+    UA_NodeId id = UA_NODEID_NUMERIC(1, 1);
+    const UA_Node *removed = ns.getNode(ns.context, &id);
+    ns.releaseNode(ns.context, removed);
+    ns.removeNode(ns.context, &id);
+    UA_Node *reused = createNode(1, 1);
+    ck_assert_ptr_eq(reused, removed);
+    ns.insertNode(ns.context, reused, NULL);
+}
+END_TEST
+
+static size_t
+variableSlabBytes(void) {
+    UA_NodestoreStatistics stats;
+    UA_Nodestore_default_getStatistics(&ns, &stats);
+    for(size_t i = 0; i < UA_NODESTORE_NODECLASSES; i++) {
+        if(stats.classes[i].nodeClass == UA_NODECLASS_VARIABLE)
+            return stats.classes[i].slabBytes;
+    }
+    return 0;
+}
+
+START_TEST(releaseSlabs) {
+    if(newNodestore != UA_Nodestore_default_new)
+        return;
+
+    ns.insertNode(ns.context, createNode(1, 1), NULL);
+    size_t slabBytes = variableSlabBytes();
+    ck_assert_uint_gt(slabBytes, 0);
+
+    /* Fill several slabs */
+    for(UA_Int32 i = 2; i <= 1000; i++)
+        ns.insertNode(ns.context, createNode(1, i), NULL);
+    ck_assert_uint_gt(variableSlabBytes(), 2 * slabBytes);
+
+    /* The unused slabs are freed. One slab with free slots is kept. */
+    for(UA_Int32 i = 1; i <= 1000; i++) {
+        UA_NodeId id = UA_NODEID_NUMERIC(1, (UA_UInt32)i);
+        ck_assert_int_eq(ns.removeNode(ns.context, &id), UA_STATUSCODE_GOOD);
+    }
+    ck_assert_uint_eq(variableSlabBytes(), slabBytes);
+
+    /* The slabs are allocated again */
+    for(UA_Int32 i = 1; i <= 1000; i++)
+        ns.insertNode(ns.context, createNode(1, i), NULL);
+    ck_assert_uint_gt(variableSlabBytes(), 2 * slabBytes);
+}
+END_TEST
+
+#ifdef UA_ENABLE_MULTITHREADING
+#define READERS 4
+#define READ_NODES 1000
+
+/* Retired nodes are deleted after the readers have finished */
+static UA_Node **retired = NULL;
+static size_t retiredSize = 0;
+
+static void retireNode(void *context, UA_Node *node) {
+    retired = (UA_Node**)UA_realloc(retired, sizeof(UA_Node*) * (retiredSize + 1));
+    retired[retiredSize] = node;
+    retiredSize++;
+}
+
+struct UA_NodeStoreReader {
+    volatile UA_Boolean *running;
+    size_t lookups;
+    size_t errors;
+};
+
+static void *readerThread(void *arg) {
+    struct UA_NodeStoreReader *r = (struct UA_NodeStoreReader*)arg;
+    UA_NodeId id = UA_NODEID_NUMERIC(0, 0);
+    while(*r->running) {
+        for(UA_UInt32 i = 0; i < READ_NODES; i++) {
+            id.identifier.numeric = i + 1;
+            const UA_Node *node = ns.getNode(ns.context, &id);
+            if(!node || !UA_NodeId_equal(&node->nodeId, &id))
+                r->errors++;
+            ns.releaseNode(ns.context, node);
+            r->lookups++;
+        }
+    }
+    return NULL;
+}
+
+/* Readers always find the nodes while the nodes are replaced and the nodestore
+ * grows */
+START_TEST(readWhileWriting) {
+    ns.setRetireCallback(ns.context, NULL, retireNode);
+    for(UA_UInt32 i = 0; i < READ_NODES; i++)
+        ns.insertNode(ns.context, createNode(0, (UA_Int32)i + 1), NULL);
+
+    volatile UA_Boolean running = true;
+    pthread_t t[READERS];
+    struct UA_NodeStoreReader r[READERS];
+    for(size_t i = 0; i < READERS; i++) {
+        r[i] = (struct UA_NodeStoreReader){&running, 0, 0};
+        pthread_create(&t[i], NULL, readerThread, &r[i]);
+    }
+
+    for(UA_UInt32 round = 0; round < 10; round++) {
+        UA_NodeId id = UA_NODEID_NUMERIC(0, 0);
+        for(UA_UInt32 i = 0; i < READ_NODES; i++) {
+            id.identifier.numeric = i + 1;
+            UA_Node *copy;
+            UA_StatusCode retval = ns.getNodeCopy(ns.context, &id, &copy);
+            ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+            copy->writeMask = round;
+            retval = ns.replaceNode(ns.context, copy);
+            ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+        }
+        /* Additional nodes in another namespace */
+        for(UA_UInt32 i = 0; i < READ_NODES; i++) {
+            UA_StatusCode retval =
+                ns.insertNode(ns.context, createNode(1, (UA_Int32)(round * READ_NODES + i + 1)), NULL);
+            ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+        }
+    }
+
+    running = false;
+    for(size_t i = 0; i < READERS; i++) {
+        pthread_join(t[i], NULL);
+        ck_assert_uint_gt(r[i].lookups, 0);
+        ck_assert_uint_eq(r[i].errors, 0);
+    }
+
+    for(size_t i = 0; i < retiredSize; i++)
+        ns.deleteNode(ns.context, retired[i]);
+    UA_free(retired);
+    retired = NULL;
+    retiredSize = 0;
+}
+END_TEST
+#endif
+
+static void
+collectNodeId(void *context, const UA_Node *node) {
+    UA_NodeId **ids = (UA_NodeId**)context;
+    UA_NodeId_copy(&node->nodeId, *ids);
+    (*ids)++;
+}
+
+static void
+countNodes(void *context, const UA_Node *node) {
+    (*(size_t*)context)++;
+}
+
+/* Every node of namespace zero is found with its NodeId */
+START_TEST(lookupNs0) {
+    UA_ServerConfig *config = UA_ServerConfig_new_default();
+    config->nodestore.deleteNodestore(config->nodestore.context);
+    UA_StatusCode retval = newNodestore(&config->nodestore);
+    ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+    UA_Server *server = UA_Server_new(config);
+    UA_Nodestore *ns0 = &config->nodestore;
+
+    size_t count = 0;
+    ns0->iterate(ns0->context, &count, countNodes);
+    ck_assert_uint_gt(count, 0);
+    UA_NodeId *ids = (UA_NodeId*)UA_Array_new(count, &UA_TYPES[UA_TYPES_NODEID]);
+    UA_NodeId *pos = ids;
+    ns0->iterate(ns0->context, &pos, collectNodeId);
+    ck_assert_uint_eq((size_t)(pos - ids), count);
+
+    for(size_t i = 0; i < count; i++) {
+        const UA_Node *node = ns0->getNode(ns0->context, &ids[i]);
+        ck_assert_ptr_ne(node, NULL);
+        ck_assert(UA_NodeId_equal(&node->nodeId, &ids[i]));
+        ns0->releaseNode(ns0->context, node);
+    }
+
+    UA_Array_delete(ids, count, &UA_TYPES[UA_TYPES_NODEID]);
+    UA_Server_delete(server);
+    UA_ServerConfig_delete(config);
+}
+END_TEST
+
+#define LOOKUP_NODES 10000 /* Half numeric, half string NodeIds */
+
+static UA_NodeId
+lookupNodeId(size_t i) {
+    if(i % 2 == 0)
+        return UA_NODEID_NUMERIC(1, (UA_UInt32)i + 1);
+    char buf[64];
+    snprintf(buf, sizeof(buf), "Plant.Line%lu.Sensor%lu",
+             (unsigned long)(i / 1000), (unsigned long)(i % 1000));
+    return UA_NODEID_STRING_ALLOC(1, buf);
+}
+
+/* Many string NodeIds with a common prefix are stored side by side with
+ * numeric NodeIds */
+START_TEST(lookupStringNodeIds) {
+    for(size_t i = 0; i < LOOKUP_NODES; i++) {
+        UA_Node *node = ns.newNode(ns.context, UA_NODECLASS_OBJECT);
+        node->nodeId = lookupNodeId(i);
+        ck_assert_int_eq(ns.insertNode(ns.context, node, NULL), UA_STATUSCODE_GOOD);
+    }
+
+    for(size_t i = 0; i < LOOKUP_NODES; i++) {
+        UA_NodeId id = lookupNodeId(i);
+        const UA_Node *node = ns.getNode(ns.context, &id);
+        ck_assert_ptr_ne(node, NULL);
+        ck_assert(UA_NodeId_equal(&node->nodeId, &id));
+        ns.releaseNode(ns.context, node);
+        UA_NodeId_deleteMembers(&id);
+    }
+
+    UA_NodeId missing = UA_NODEID_STRING(1, "Plant.Line0.Sensor1000");
+    ck_assert_ptr_eq(ns.getNode(ns.context, &missing), NULL);
+}
+END_TEST
+
 #define N 1000 /* make bigger to test */
 
 START_TEST(profileGetDelete) {
@@ -272,8 +686,8 @@ START_TEST(profileGetDelete) {
 }
 END_TEST
 
-static Suite * namespace_suite (void) {
-    Suite *s = suite_create ("UA_NodeStore");
+static Suite * namespace_suite (const char *name) {
+    Suite *s = suite_create (name);
 
     TCase* tc_find = tcase_create ("Find");
     tcase_add_checked_fixture(tc_find, setup, teardown);
@@ -282,14 +696,37 @@ static Suite * namespace_suite (void) {
     tcase_add_test (tc_find, findNodeInExpandedNamespace);
     tcase_add_test (tc_find, failToFindNonExistentNodeInUA_NodeStoreWithSeveralEntries);
     tcase_add_test (tc_find, failToFindNodeInOtherUA_NodeStore);
+    tcase_add_test (tc_find, findNodesInSeveralNamespaces);
     suite_add_tcase (s, tc_find);
 
+    TCase *tc_lookup = tcase_create("Lookup");
+    tcase_add_checked_fixture(tc_lookup, setup, teardown);
+    tcase_add_test (tc_lookup, lookupNs0);
+    tcase_add_test (tc_lookup, lookupStringNodeIds);
+    suite_add_tcase (s, tc_lookup);
+
     TCase *tc_replace = tcase_create("Replace");
     tcase_add_checked_fixture(tc_replace, setup, teardown);
     tcase_add_test (tc_replace, replaceExistingNode);
     tcase_add_test (tc_replace, replaceOldNode);
+    tcase_add_test (tc_replace, editInternedStrings);
+#ifdef UA_ENABLE_MULTITHREADING
+    tcase_add_test (tc_replace, readWhileWriting);
+#endif
     suite_add_tcase (s, tc_replace);
 
+    TCase *tc_remove = tcase_create("Remove");
+    tcase_add_checked_fixture(tc_remove, setup, teardown);
+    tcase_add_test (tc_remove, removeNodesAndReinsert);
+    tcase_add_test (tc_remove, readRemovedNode);
+    suite_add_tcase (s, tc_remove);
+
+    TCase *tc_statistics = tcase_create("Statistics");
+    tcase_add_checked_fixture(tc_statistics, setup, teardown);
+    tcase_add_test (tc_statistics, nodeStatistics);
+    tcase_add_test (tc_statistics, releaseSlabs);
+    suite_add_tcase (s, tc_statistics);
+
     TCase* tc_iterate = tcase_create ("Iterate");
     tcase_add_checked_fixture(tc_iterate, setup, teardown);
     tcase_add_test (tc_iterate, iterateOverUA_NodeStoreShallNotVisitEmptyNodes);
@@ -307,11 +744,21 @@ static Suite * namespace_suite (void) {
 
 int main (void) {
     int number_failed = 0;
-    Suite *s = namespace_suite();
+
+    newNodestore = UA_Nodestore_default_new;
+    Suite *s = namespace_suite("UA_NodeStore");
     SRunner *sr = srunner_create(s);
     srunner_set_fork_status(sr,CK_NOFORK);
     srunner_run_all(sr, CK_NORMAL);
     number_failed += srunner_ntests_failed (sr);
     srunner_free(sr);
+
+    newNodestore = UA_Nodestore_hashMap_new;
+    s = namespace_suite("UA_NodeStore_HashMap");
+    sr = srunner_create(s);
+    srunner_set_fork_status(sr,CK_NOFORK);
+    srunner_run_all(sr, CK_NORMAL);
+    number_failed += srunner_ntests_failed (sr);
+    srunner_free(sr);
     return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
 }
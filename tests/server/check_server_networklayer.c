@@ -0,0 +1,229 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ua_types.h"
+#include "ua_server.h"
+#include "ua_client.h"
+#include "ua_client_highlevel_async.h"
+#include "ua_config_default.h"
+#include "ua_network_tcp.h"
+#include "server/ua_server_internal.h"
+#include "client/ua_client_internal.h"
+#include "check.h"
+#include "testing_clock.h"
+#include "thread_wrapper.h"
+
+/* The responses are much larger than the socket buffers */
+#define VALUESIZE (256 * 1024)
+#define SOCKETBUFFERSIZE (32 * 1024)
+#define REQUESTS 4
+#define MAXITERATIONS 100000
+
+static UA_Server *server;
+static UA_ServerConfig *config;
+static UA_Client *client;
+static UA_ByteString value;
+static size_t responses;
+static UA_Boolean running;
+static THREAD_HANDLE server_thread;
+
+/* The test suite runs for every TCP server network layer */
+static UA_ServerNetworkLayer
+(*newNetworkLayer)(UA_ConnectionConfig conf, UA_UInt16 port, UA_Logger *logger);
+static UA_Boolean sendCoalescing;
+
+THREAD_CALLBACK(serverloop) {
+    while(running)
+        UA_Server_run_iterate(server, true);
+    return 0;
+}
+
+/* After the connection is established, server and client take turns in the
+ * same thread. So the test decides when the client reads from its socket. */
+static void iterate(void) {
+    UA_Server_run_iterate(server, false);
+    UA_Client_run_iterate(client, 0);
+}
+
+static void setup(void) {
+    config = UA_ServerConfig_new_default();
+    UA_ServerNetworkLayer *nl = &config->networkLayers[0];
+    UA_ConnectionConfig connectionConfig = nl->localConnectionConfig;
+    nl->deleteMembers(nl);
+    *nl = newNetworkLayer(connectionConfig, 4840, &config->logger);
+    ck_assert_ptr_ne(nl->handle, NULL);
+    UA_ServerNetworkLayerTCP_setSendCoalescing(nl, sendCoalescing);
+    server = UA_Server_new(config);
+
+    UA_StatusCode retval = UA_ByteString_allocBuffer(&value, VALUESIZE);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    for(size_t i = 0; i < VALUESIZE; i++)
+        value.data[i] = (UA_Byte)(i % 251);
+    UA_VariableAttributes attr = UA_VariableAttributes_default;
+    UA_Variant_setScalar(&attr.value, &value, &UA_TYPES[UA_TYPES_BYTESTRING]);
+    retval = UA_Server_addVariableNode(server, UA_NODEID_STRING(1, "large"),
+                                       UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                       UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                       UA_QUALIFIEDNAME(1, "large"),
+                                       UA_NODEID_NUMERIC(0, UA_NS0ID_BASEDATAVARIABLETYPE),
+                                       attr, NULL, NULL);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+
+    retval = UA_Server_run_startup(server);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+
+    running = true;
+    THREAD_CREATE(server_thread, serverloop);
+    client = UA_Client_new();
+    UA_ClientConfig_setDefault(UA_Client_getConfig(client));
+    retval = UA_Client_connect(client, "opc.tcp://localhost:4840");
+    running = false;
+    THREAD_JOIN(server_thread);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    responses = 0;
+}
+
+static void teardown(void) {
+    /* Close the client socket first. Otherwise the client waits for the
+     * response to CloseSession while the server does not iterate. */
+    client->connection.close(&client->connection);
+    UA_Client_delete(client);
+    UA_Server_run_shutdown(server);
+    UA_Server_delete(server);
+    UA_ServerConfig_delete(config);
+    UA_ByteString_deleteMembers(&value);
+}
+
+/* The server side of the client connection */
+static UA_Connection *
+serverConnection(void) {
+    channel_entry *entry = TAILQ_FIRST(&server->secureChannelManager.channels);
+    if(!entry)
+        return NULL;
+    return entry->channel.connection;
+}
+
+static void
+readCallback(UA_Client *c, void *userdata, UA_UInt32 requestId,
+             UA_ReadResponse *rr) {
+    /* Pending requests are cancelled when the client is deleted */
+    if(rr->responseHeader.serviceResult != UA_STATUSCODE_GOOD)
+        return;
+    ck_assert_uint_eq(rr->resultsSize, 1);
+    ck_assert(UA_Variant_hasScalarType(&rr->results[0].value,
+                                       &UA_TYPES[UA_TYPES_BYTESTRING]));
+    ck_assert(UA_ByteString_equal((UA_ByteString*)rr->results[0].value.data, &value));
+    responses++;
+}
+
+/* Send the requests. The server queues the responses that do not fit into the
+ * socket buffers. */
+static UA_Connection *
+queueResponses(void) {
+    UA_Connection *connection = serverConnection();
+    ck_assert_ptr_ne(connection, NULL);
+    int size = SOCKETBUFFERSIZE;
+    UA_setsockopt(connection->sockfd, SOL_SOCKET, SO_SNDBUF,
+                  (const char*)&size, sizeof(size));
+    UA_setsockopt(client->connection.sockfd, SOL_SOCKET, SO_RCVBUF,
+                  (const char*)&size, sizeof(size));
+
+    UA_ReadValueId rvi;
+    UA_ReadValueId_init(&rvi);
+    rvi.nodeId = UA_NODEID_STRING(1, "large");
+    rvi.attributeId = UA_ATTRIBUTEID_VALUE;
+    UA_ReadRequest request;
+    UA_ReadRequest_init(&request);
+    request.nodesToRead = &rvi;
+    request.nodesToReadSize = 1;
+    for(size_t i = 0; i < REQUESTS; i++) {
+        UA_UInt32 requestId;
+        UA_StatusCode retval =
+            UA_Client_sendAsyncReadRequest(client, &request, readCallback, NULL, &requestId);
+        ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    }
+
+    /* The client does not read. The server must not block on the full
+     * socket. (With multithreading, the responses are generated by the
+     * workers.) */
+    for(size_t i = 0; i < MAXITERATIONS && connection->pendingSendBytes == 0; i++)
+        UA_Server_run_iterate(server, false);
+    ck_assert_uint_gt(connection->pendingSendBytes, 0);
+    return connection;
+}
+
+/* The queue is written in partial sends as the client reads. The responses
+ * arrive in full and in order. */
+START_TEST(sendWithBackpressure) {
+    UA_Connection *connection = queueResponses();
+    for(size_t i = 0; i < MAXITERATIONS && responses < REQUESTS; i++)
+        iterate();
+    ck_assert_uint_eq(responses, REQUESTS);
+    ck_assert_uint_eq(connection->pendingSendBytes, 0);
+    ck_assert_ptr_eq(serverConnection(), connection);
+} END_TEST
+
+/* The peer goes away while chunks are queued. The connection is removed and
+ * the queued chunks are freed. */
+START_TEST(peerCloseWithQueuedChunks) {
+    queueResponses();
+    client->connection.close(&client->connection);
+    for(size_t i = 0; i < MAXITERATIONS && serverConnection(); i++)
+        UA_Server_run_iterate(server, false);
+    ck_assert_ptr_eq(serverConnection(), NULL);
+    ck_assert_uint_eq(responses, 0);
+} END_TEST
+
+static Suite *
+networklayer_suite(const char *name) {
+    Suite *s = suite_create(name);
+    TCase *tc_send = tcase_create("Send");
+    tcase_add_checked_fixture(tc_send, setup, teardown);
+    tcase_add_test(tc_send, sendWithBackpressure);
+    tcase_add_test(tc_send, peerCloseWithQueuedChunks);
+    suite_add_tcase(s, tc_send);
+    return s;
+}
+
+static int
+runSuite(const char *name) {
+    Suite *s = networklayer_suite(name);
+    SRunner *sr = srunner_create(s);
+    srunner_set_fork_status(sr, CK_NOFORK);
+    srunner_run_all(sr, CK_NORMAL);
+    int number_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return number_failed;
+}
+
+int main(void) {
+    int number_failed = 0;
+
+    newNetworkLayer = UA_ServerNetworkLayerTCP;
+    sendCoalescing = true;
+    number_failed += runSuite("Server NetworkLayer TCP");
+    sendCoalescing = false;
+    number_failed += runSuite("Server NetworkLayer TCP (no coalescing)");
+
+#ifdef UA_ENABLE_EPOLL
+    newNetworkLayer = UA_ServerNetworkLayerTCPEpoll;
+    sendCoalescing = true;
+    number_failed += runSuite("Server NetworkLayer epoll");
+    sendCoalescing = false;
+    number_failed += runSuite("Server NetworkLayer epoll (no coalescing)");
+#endif
+
+#ifdef UA_ENABLE_IO_URING
+    newNetworkLayer = UA_ServerNetworkLayerTCPUring;
+    sendCoalescing = true;
+    number_failed += runSuite("Server NetworkLayer io_uring");
+    sendCoalescing = false;
+    number_failed += runSuite("Server NetworkLayer io_uring (no coalescing)");
+#endif
+
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -206,6 +206,204 @@ START_TEST(AddNodeTwiceGivesError) {
     ck_assert_int_eq(res, UA_STATUSCODE_BADNODEIDEXISTS);
 } END_TEST
 
+START_TEST(AddNodesShareInternedStrings) {
+    UA_ObjectAttributes attr = UA_ObjectAttributes_default;
+    attr.displayName = UA_LOCALIZEDTEXT("en-US", "Sensor");
+    UA_NodeId ids[2] = {UA_NODEID_STRING(1, "Line1.Sensor"),
+                        UA_NODEID_STRING(1, "Line2.Sensor")};
+    for(size_t i = 0; i < 2; i++) {
+        UA_StatusCode res =
+            UA_Server_addObjectNode(server, ids[i], UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                    UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                    UA_QUALIFIEDNAME(1, "Sensor"),
+                                    UA_NODEID_NUMERIC(0, UA_NS0ID_BASEOBJECTTYPE),
+                                    attr, NULL, NULL);
+        ck_assert_int_eq(res, UA_STATUSCODE_GOOD);
+    }
+
+    /* The equal attributes point to the same memory */
+    const UA_Node *n1 = UA_Nodestore_get(server, &ids[0]);
+    const UA_Node *n2 = UA_Nodestore_get(server, &ids[1]);
+    ck_assert_ptr_eq(n1->browseName.name.data, n2->browseName.name.data);
+    ck_assert_ptr_eq(n1->displayName.text.data, n2->displayName.text.data);
+    ck_assert_ptr_eq(n1->displayName.locale.data, n2->displayName.locale.data);
+    UA_Nodestore_release(server, n1);
+    UA_Nodestore_release(server, n2);
+
+    /* Writing to one node does not change the other */
+    UA_LocalizedText newName = UA_LOCALIZEDTEXT("en-US", "Sensor 2");
+    UA_StatusCode res = UA_Server_writeDisplayName(server, ids[1], newName);
+    ck_assert_int_eq(res, UA_STATUSCODE_GOOD);
+    UA_LocalizedText out;
+    res = UA_Server_readDisplayName(server, ids[0], &out);
+    ck_assert_int_eq(res, UA_STATUSCODE_GOOD);
+    ck_assert(UA_String_equal(&out.text, &attr.displayName.text));
+    UA_LocalizedText_deleteMembers(&out);
+
+    /* The shared strings survive the deletion of one node */
+    res = UA_Server_deleteNode(server, ids[1], true);
+    ck_assert_int_eq(res, UA_STATUSCODE_GOOD);
+    UA_QualifiedName outName;
+    res = UA_Server_readBrowseName(server, ids[0], &outName);
+    ck_assert_int_eq(res, UA_STATUSCODE_GOOD);
+    UA_String expected = UA_STRING("Sensor");
+    ck_assert(UA_String_equal(&outName.name, &expected));
+    UA_QualifiedName_deleteMembers(&outName);
+} END_TEST
+
+#define WIDE_FOLDER_CHILDREN 1000
+
+/* Returns the forward Organizes references of the node */
+static const UA_NodeReferenceKind *
+getOrganizes(const UA_Node *node) {
+    const UA_NodeId organizes = UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES);
+    for(size_t i = 0; i < node->referencesSize; i++) {
+        if(!node->references[i].isInverse &&
+           UA_NodeId_equal(&node->references[i].referenceTypeId, &organizes))
+            return &node->references[i];
+    }
+    return NULL;
+}
+
+START_TEST(AddAndDeleteInWideFolder) {
+    UA_NodeId folderId = UA_NODEID_NUMERIC(1, 10000);
+    UA_ObjectAttributes attr = UA_ObjectAttributes_default;
+    UA_StatusCode res =
+        UA_Server_addObjectNode(server, folderId, UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                UA_QUALIFIEDNAME(1, "Tags"),
+                                UA_NODEID_NUMERIC(0, UA_NS0ID_FOLDERTYPE),
+                                attr, NULL, NULL);
+    ck_assert_int_eq(res, UA_STATUSCODE_GOOD);
+    for(UA_UInt32 i = 0; i < WIDE_FOLDER_CHILDREN; i++) {
+        res = UA_Server_addObjectNode(server, UA_NODEID_NUMERIC(1, 20000 + i), folderId,
+                                      UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                      UA_QUALIFIEDNAME(1, "Tag"),
+                                      UA_NODEID_NUMERIC(0, UA_NS0ID_BASEOBJECTTYPE),
+                                      attr, NULL, NULL);
+        ck_assert_int_eq(res, UA_STATUSCODE_GOOD);
+    }
+
+    /* Duplicates are detected with the target index */
+    res = UA_Server_addReference(server, folderId, UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                 UA_EXPANDEDNODEID_NUMERIC(1, 20000 + 500), true);
+    ck_assert_int_eq(res, UA_STATUSCODE_BADDUPLICATEREFERENCENOTALLOWED);
+
+    /* Delete every second child */
+    for(UA_UInt32 i = 0; i < WIDE_FOLDER_CHILDREN; i += 2) {
+        res = UA_Server_deleteNode(server, UA_NODEID_NUMERIC(1, 20000 + i), true);
+        ck_assert_int_eq(res, UA_STATUSCODE_GOOD);
+    }
+
+    /* The remaining children are found in the index. A copy of the node has
+     * the same index. */
+    const UA_Node *folder = UA_Nodestore_get(server, &folderId);
+    UA_Node *copy = UA_Node_copy_alloc(folder);
+    ck_assert_ptr_ne(copy, NULL);
+    UA_Nodestore_release(server, folder);
+    const UA_NodeReferenceKind *rk = getOrganizes(copy);
+    ck_assert_ptr_ne(rk, NULL);
+    ck_assert_uint_eq(rk->targetIdsSize, WIDE_FOLDER_CHILDREN / 2);
+    ck_assert_ptr_ne(rk->targetIndex, NULL);
+    for(UA_UInt32 i = 1; i < WIDE_FOLDER_CHILDREN; i += 2) {
+        UA_AddReferencesItem item;
+        UA_AddReferencesItem_init(&item);
+        item.isForward = true;
+        item.referenceTypeId = UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES);
+        item.targetNodeId = UA_EXPANDEDNODEID_NUMERIC(1, 20000 + i);
+        ck_assert_int_eq(UA_Node_addReference(copy, &item),
+                         UA_STATUSCODE_BADDUPLICATEREFERENCENOTALLOWED);
+    }
+    UA_Node_deleteMembers(copy);
+    UA_free(copy);
+
+    /* Delete the remaining children except one. The index is removed. */
+    for(UA_UInt32 i = 1; i < WIDE_FOLDER_CHILDREN - 1; i += 2) {
+        res = UA_Server_deleteNode(server, UA_NODEID_NUMERIC(1, 20000 + i), true);
+        ck_assert_int_eq(res, UA_STATUSCODE_GOOD);
+    }
+    folder = UA_Nodestore_get(server, &folderId);
+    rk = getOrganizes(folder);
+    ck_assert_ptr_ne(rk, NULL);
+    ck_assert_uint_eq(rk->targetIdsSize, 1);
+    ck_assert_ptr_eq(rk->targetIndex, NULL);
+    UA_NodeId last = UA_NODEID_NUMERIC(1, 20000 + WIDE_FOLDER_CHILDREN - 1);
+    ck_assert(UA_NodeId_equal(&rk->targetIds[0].nodeId, &last));
+    UA_Nodestore_release(server, folder);
+} END_TEST
+
+START_TEST(RetireNodesBeforeRun) {
+    /* Adding a child replaces the parent node. Without a main loop, the old
+     * versions are deleted right away. */
+    UA_ObjectAttributes attr = UA_ObjectAttributes_default;
+    for(UA_UInt32 i = 0; i < 10; i++) {
+        UA_StatusCode res =
+            UA_Server_addObjectNode(server, UA_NODEID_NUMERIC(1, 30000 + i),
+                                    UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                    UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                    UA_QUALIFIEDNAME(1, "Object"),
+                                    UA_NODEID_NUMERIC(0, UA_NS0ID_BASEOBJECTTYPE),
+                                    attr, NULL, NULL);
+        ck_assert_int_eq(res, UA_STATUSCODE_GOOD);
+    }
+    ck_assert_uint_eq(server->nodesInUse, 0);
+    ck_assert(SIMPLEQ_EMPTY(&server->retiredNodes));
+    ck_assert(SIMPLEQ_EMPTY(&server->workQueue.delayedCallbacks));
+
+#ifdef UA_ENABLE_IMMUTABLE_NODES
+    /* A node is held. The replaced nodes are retired until the release. */
+    UA_NodeId objectsId = UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER);
+    const UA_Node *objects = UA_Nodestore_get(server, &objectsId);
+    ck_assert_ptr_ne(objects, NULL);
+    UA_StatusCode res =
+        UA_Server_writeDisplayName(server, objectsId, UA_LOCALIZEDTEXT("en-US", "Objs"));
+    ck_assert_int_eq(res, UA_STATUSCODE_GOOD);
+    ck_assert(!SIMPLEQ_EMPTY(&server->retiredNodes));
+    UA_String oldName = UA_STRING("Objects");
+    ck_assert(UA_String_equal(&objects->displayName.text, &oldName));
+    UA_Nodestore_release(server, objects);
+    ck_assert_uint_eq(server->nodesInUse, 0);
+    ck_assert(SIMPLEQ_EMPTY(&server->retiredNodes));
+#endif
+} END_TEST
+
+#ifdef UA_ENABLE_IMMUTABLE_NODES
+START_TEST(RetireNodesAcrossRun) {
+    /* A node is held across the start and the stop of the server. The count of
+     * the held nodes stays correct and the retired nodes are kept meanwhile. */
+    UA_NodeId objectsId = UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER);
+    const UA_Node *objects = UA_Nodestore_get(server, &objectsId);
+    ck_assert_ptr_ne(objects, NULL);
+    UA_StatusCode res =
+        UA_Server_writeDisplayName(server, objectsId, UA_LOCALIZEDTEXT("en-US", "Objs"));
+    ck_assert_int_eq(res, UA_STATUSCODE_GOOD);
+    ck_assert(!SIMPLEQ_EMPTY(&server->retiredNodes));
+
+    UA_Server_run_startup(server);
+#ifdef UA_ENABLE_MULTITHREADING
+    /* Handed to the work queue when the workers start */
+    ck_assert(SIMPLEQ_EMPTY(&server->retiredNodes));
+#endif
+    UA_Server_run_iterate(server, false);
+    UA_Nodestore_release(server, objects);
+    ck_assert_uint_eq(server->nodesInUse, 0);
+
+    /* Held across the stop of the workers */
+    objects = UA_Nodestore_get(server, &objectsId);
+    ck_assert_ptr_ne(objects, NULL);
+    res = UA_Server_writeDisplayName(server, objectsId, UA_LOCALIZEDTEXT("en-US", "Objects"));
+    ck_assert_int_eq(res, UA_STATUSCODE_GOOD);
+    UA_Server_run_shutdown(server);
+    ck_assert_uint_eq(server->nodesInUse, 1);
+    ck_assert(!SIMPLEQ_EMPTY(&server->retiredNodes));
+    UA_String name = UA_STRING("Objs");
+    ck_assert(UA_String_equal(&objects->displayName.text, &name));
+    UA_Nodestore_release(server, objects);
+    ck_assert_uint_eq(server->nodesInUse, 0);
+    ck_assert(SIMPLEQ_EMPTY(&server->retiredNodes));
+} END_TEST
+#endif
+
 static UA_Boolean constructorCalled = false;
 
 static UA_StatusCode
@@ -459,6 +657,88 @@ START_TEST(InstantiateObjectType) {
     ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
 } END_TEST
 
+typedef struct {
+    UA_NodeId ids[1024];
+    size_t idsSize;
+} TypeCollection;
+
+static void
+collectTypes(void *context, const UA_Node *node) {
+    TypeCollection *c = (TypeCollection*)context;
+    if(node->nodeClass != UA_NODECLASS_REFERENCETYPE &&
+       node->nodeClass != UA_NODECLASS_DATATYPE &&
+       node->nodeClass != UA_NODECLASS_OBJECTTYPE &&
+       node->nodeClass != UA_NODECLASS_VARIABLETYPE)
+        return;
+    ck_assert_uint_lt(c->idsSize, 1024);
+    UA_NodeId_copy(&node->nodeId, &c->ids[c->idsSize]);
+    c->idsSize++;
+}
+
+START_TEST(SubtypeClosureMatchesTree) {
+    TypeCollection *c = (TypeCollection*)UA_calloc(1, sizeof(TypeCollection));
+    config->nodestore.iterate(config->nodestore.context, c, collectTypes);
+    ck_assert_uint_gt(c->idsSize, 0);
+    for(size_t i = 0; i < c->idsSize; i++) {
+        for(size_t j = 0; j < c->idsSize; j++) {
+            UA_Boolean expected = isNodeInTree(&config->nodestore, &c->ids[i],
+                                               &c->ids[j], &subtypeId, 1);
+            ck_assert_int_eq(isSubtypeOf(server, &c->ids[i], &c->ids[j]), expected);
+        }
+    }
+    for(size_t i = 0; i < c->idsSize; i++)
+        UA_NodeId_deleteMembers(&c->ids[i]);
+    UA_free(c);
+} END_TEST
+
+START_TEST(SubtypeClosureUpdates) {
+    const UA_NodeId references = UA_NODEID_NUMERIC(0, UA_NS0ID_REFERENCES);
+    const UA_NodeId organizes = UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES);
+    ck_assert(isSubtypeOf(server, &organizes, &hierarchicalReferences));
+
+    /* Add a new leaf type */
+    UA_ReferenceTypeAttributes attr = UA_ReferenceTypeAttributes_default;
+    attr.displayName = UA_LOCALIZEDTEXT("", "MyRef");
+    UA_NodeId myRef = UA_NODEID_NUMERIC(1, 5000);
+    UA_StatusCode retval =
+        UA_Server_addReferenceTypeNode(server, myRef, hierarchicalReferences,
+                                       subtypeId, UA_QUALIFIEDNAME(1, "MyRef"),
+                                       attr, NULL, NULL);
+    ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert(isSubtypeOf(server, &myRef, &hierarchicalReferences));
+    ck_assert(isSubtypeOf(server, &myRef, &references));
+    ck_assert(!isSubtypeOf(server, &myRef, &organizes));
+    ck_assert(!isSubtypeOf(server, &hierarchicalReferences, &myRef));
+
+    /* And a subtype of the new type */
+    attr.displayName = UA_LOCALIZEDTEXT("", "MySubRef");
+    UA_NodeId mySubRef = UA_NODEID_NUMERIC(1, 5001);
+    retval = UA_Server_addReferenceTypeNode(server, mySubRef, myRef, subtypeId,
+                                            UA_QUALIFIEDNAME(1, "MySubRef"),
+                                            attr, NULL, NULL);
+    ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert(isSubtypeOf(server, &mySubRef, &myRef));
+    ck_assert(isSubtypeOf(server, &mySubRef, &references));
+
+    /* Remove the subtype */
+    retval = UA_Server_deleteNode(server, mySubRef, true);
+    ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert(!isSubtypeOf(server, &mySubRef, &myRef));
+    ck_assert(isSubtypeOf(server, &myRef, &references));
+
+    /* Move the type below Organizes */
+    retval = UA_Server_deleteReference(server, myRef, subtypeId, false,
+                                       UA_EXPANDEDNODEID_NUMERIC(0, UA_NS0ID_HIERARCHICALREFERENCES),
+                                       true);
+    ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert(!isSubtypeOf(server, &myRef, &references));
+    retval = UA_Server_addReference(server, myRef, subtypeId,
+                                    UA_EXPANDEDNODEID_NUMERIC(0, UA_NS0ID_ORGANIZES), false);
+    ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert(isSubtypeOf(server, &myRef, &organizes));
+    ck_assert(isSubtypeOf(server, &myRef, &references));
+} END_TEST
+
 int main(void) {
     Suite *s = suite_create("services_nodemanagement");
 
@@ -470,6 +750,11 @@ int main(void) {
     tcase_add_test(tc_addnodes, InstantiateVariableTypeNodeLessDims);
     tcase_add_test(tc_addnodes, AddComplexTypeWithInheritance);
     tcase_add_test(tc_addnodes, AddNodeTwiceGivesError);
+    tcase_add_test(tc_addnodes, AddNodesShareInternedStrings);
+    tcase_add_test(tc_addnodes, RetireNodesBeforeRun);
+#ifdef UA_ENABLE_IMMUTABLE_NODES
+    tcase_add_test(tc_addnodes, RetireNodesAcrossRun);
+#endif
     tcase_add_test(tc_addnodes, AddObjectWithConstructor);
     tcase_add_test(tc_addnodes, InstantiateObjectType);
     suite_add_tcase(s, tc_addnodes);
@@ -478,8 +763,15 @@ int main(void) {
     tcase_add_checked_fixture(tc_deletenodes, setup, teardown);
     tcase_add_test(tc_deletenodes, DeleteObjectWithDestructor);
     tcase_add_test(tc_deletenodes, DeleteObjectAndReferences);
+    tcase_add_test(tc_deletenodes, AddAndDeleteInWideFolder);
     suite_add_tcase(s, tc_deletenodes);
 
+    TCase *tc_subtypes = tcase_create("subtypes");
+    tcase_add_checked_fixture(tc_subtypes, setup, teardown);
+    tcase_add_test(tc_subtypes, SubtypeClosureMatchesTree);
+    tcase_add_test(tc_subtypes, SubtypeClosureUpdates);
+    suite_add_tcase(s, tc_subtypes);
+
     SRunner *sr = srunner_create(s);
     srunner_set_fork_status(sr, CK_NOFORK);
     srunner_run_all(sr, CK_NORMAL);
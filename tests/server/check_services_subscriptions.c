@@ -76,7 +76,7 @@ createSubscription(void) {
 }
 
 static void
-createMonitoredItem(void) {
+createMonitoredItemWithNode(UA_NodeId nodeId, UA_UInt32 attributeId) {
     UA_CreateMonitoredItemsRequest request;
     UA_CreateMonitoredItemsRequest_init(&request);
     request.subscriptionId = subscriptionId;
@@ -85,8 +85,8 @@ createMonitoredItem(void) {
     UA_MonitoredItemCreateRequest_init(&item);
     UA_ReadValueId rvi;
     UA_ReadValueId_init(&rvi);
-    rvi.nodeId = UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER);
-    rvi.attributeId = UA_ATTRIBUTEID_BROWSENAME;
+    UA_NodeId_copy(&nodeId, &rvi.nodeId);
+    rvi.attributeId = attributeId;
     rvi.indexRange = UA_STRING_NULL;
     item.itemToMonitor = rvi;
     item.monitoringMode = UA_MONITORINGMODE_REPORTING;
@@ -111,6 +111,12 @@ createMonitoredItem(void) {
     UA_CreateMonitoredItemsResponse_deleteMembers(&response);
 }
 
+static void
+createMonitoredItem(void) {
+    createMonitoredItemWithNode(UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER),
+                                UA_ATTRIBUTEID_BROWSENAME);
+}
+
 START_TEST(Server_createSubscription) {
     /* Create a subscription */
     UA_CreateSubscriptionRequest request;
@@ -288,6 +294,59 @@ START_TEST(Server_publishCallback) {
 }
 END_TEST
 
+START_TEST(Server_publishBackpressure) {
+    createSubscription();
+    UA_Subscription *sub = UA_Session_getSubscriptionById(session, subscriptionId);
+    ck_assert_ptr_ne(sub, NULL);
+    ck_assert_uint_eq(sub->currentKeepAliveCount, sub->maxKeepAliveCount);
+
+    /* Attach the session to a channel with a congested connection */
+    UA_Connection connection;
+    memset(&connection, 0, sizeof(UA_Connection));
+    connection.pendingSendBytes = config->maxPendingSendBytes + 1;
+    UA_SecureChannel channel;
+    memset(&channel, 0, sizeof(UA_SecureChannel));
+    LIST_INIT(&channel.sessions);
+    channel.connection = &connection;
+    UA_Session_attachToSecureChannel(session, &channel);
+
+    /* The response is delayed. But the counters advance. (The publish cycle
+     * is called directly. With multithreading, the repeated callback runs in a
+     * worker thread.) */
+    UA_UInt32 lifetimeCount = sub->currentLifetimeCount;
+    UA_Subscription_publish(server, sub);
+    ck_assert_uint_eq(sub->currentKeepAliveCount, sub->maxKeepAliveCount + 1);
+    ck_assert_uint_eq(sub->currentLifetimeCount, lifetimeCount + 1);
+    ck_assert_int_ne(sub->state, UA_SUBSCRIPTIONSTATE_LATE);
+
+    /* The queued data was sent. Without a publish request, the subscription
+     * is late. */
+    connection.pendingSendBytes = 0;
+    UA_Subscription_publish(server, sub);
+    ck_assert_uint_eq(sub->currentKeepAliveCount, sub->maxKeepAliveCount + 2);
+    ck_assert_int_eq(sub->state, UA_SUBSCRIPTIONSTATE_LATE);
+
+    /* A client that stops reading does not keep the subscription alive. Also
+     * not with a queued publish request. */
+    UA_PublishResponseEntry *pre = (UA_PublishResponseEntry*)
+        UA_malloc(sizeof(UA_PublishResponseEntry));
+    ck_assert_ptr_ne(pre, NULL);
+    pre->requestId = 1;
+    UA_PublishResponse_init(&pre->response);
+    UA_Session_queuePublishReq(session, pre, false);
+    connection.pendingSendBytes = config->maxPendingSendBytes + 1;
+    while(sub->currentLifetimeCount < sub->lifeTimeCount) {
+        UA_Subscription_publish(server, sub);
+        ck_assert_uint_gt(sub->currentLifetimeCount, 0);
+    }
+    ck_assert_uint_eq(session->numPublishReq, 1);
+    UA_Subscription_publish(server, sub);
+    ck_assert_ptr_eq(UA_Session_getSubscriptionById(session, subscriptionId), NULL);
+
+    UA_Session_detachFromSecureChannel(session);
+}
+END_TEST
+
 START_TEST(Server_createMonitoredItems) {
     createSubscription();
     createMonitoredItem();
@@ -579,6 +638,228 @@ START_TEST(Server_deleteMonitoredItems) {
 }
 END_TEST
 
+START_TEST(Server_samplingGroups) {
+    createSubscription();
+
+    /* MonitoredItems with the same sampling interval share a SamplingGroup */
+    UA_UInt32 ids[3];
+    for(size_t i = 0; i < 2; i++) {
+        createMonitoredItem();
+        ids[i] = monitoredItemId;
+    }
+    createMonitoredItemWithNode(UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER),
+                                UA_ATTRIBUTEID_DISPLAYNAME);
+    ids[2] = monitoredItemId;
+
+    UA_SamplingGroup *sg = LIST_FIRST(&server->samplingGroups);
+    ck_assert_ptr_ne(sg, NULL);
+    ck_assert_ptr_eq(LIST_NEXT(sg, listEntry), NULL);
+    ck_assert_uint_eq(sg->samplesSize, 2);
+
+    /* Remove the MonitoredItem of the first SharedSample. The last entry
+     * moves into the gap. */
+    UA_DeleteMonitoredItemsRequest request;
+    UA_DeleteMonitoredItemsRequest_init(&request);
+    request.subscriptionId = subscriptionId;
+    request.monitoredItemIdsSize = 1;
+    request.monitoredItemIds = &ids[2];
+
+    UA_DeleteMonitoredItemsResponse response;
+    UA_DeleteMonitoredItemsResponse_init(&response);
+    Service_DeleteMonitoredItems(server, session, &request, &response);
+    ck_assert_uint_eq(response.results[0], UA_STATUSCODE_GOOD);
+    UA_DeleteMonitoredItemsResponse_deleteMembers(&response);
+
+    ck_assert_uint_eq(sg->samplesSize, 1);
+    UA_SharedSample *ss = sg->samples[0];
+    ck_assert_uint_eq(ss->index, 0);
+    ck_assert_uint_eq(ss->key.attributeId, UA_ATTRIBUTEID_BROWSENAME);
+    UA_MonitoredItem *mon;
+    size_t monSize = 0;
+    LIST_FOREACH(mon, &ss->monitoredItems, sharedSampleEntry) {
+        ck_assert_ptr_eq(mon->sharedSample, ss);
+        monSize++;
+    }
+    ck_assert_uint_eq(monSize, 2);
+
+    /* Sample the group */
+    UA_fakeSleep((UA_UInt32)sg->samplingInterval + 1);
+    UA_Server_run_iterate(server, false);
+
+    /* The group is removed with the last MonitoredItem */
+    request.monitoredItemIdsSize = 2;
+    request.monitoredItemIds = ids;
+    UA_DeleteMonitoredItemsResponse_init(&response);
+    Service_DeleteMonitoredItems(server, session, &request, &response);
+    ck_assert_uint_eq(response.results[0], UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(response.results[1], UA_STATUSCODE_GOOD);
+    UA_DeleteMonitoredItemsResponse_deleteMembers(&response);
+    ck_assert_ptr_eq(LIST_FIRST(&server->samplingGroups), NULL);
+}
+END_TEST
+
+static UA_UInt32 dataSourceReads = 0;
+
+static UA_StatusCode
+countingRead(UA_Server *s, const UA_NodeId *sessionId, void *sessionContext,
+             const UA_NodeId *nodeId, void *nodeContext, UA_Boolean includeSourceTimeStamp,
+             const UA_NumericRange *range, UA_DataValue *value) {
+    dataSourceReads++;
+    UA_Variant_setScalarCopy(&value->value, &dataSourceReads, &UA_TYPES[UA_TYPES_UINT32]);
+    value->hasValue = true;
+    return UA_STATUSCODE_GOOD;
+}
+
+START_TEST(Server_sharedSample) {
+    UA_VariableAttributes attr = UA_VariableAttributes_default;
+    UA_DataSource dataSource;
+    dataSource.read = countingRead;
+    dataSource.write = NULL;
+    UA_NodeId nodeId = UA_NODEID_STRING(1, "counter");
+    UA_StatusCode retval =
+        UA_Server_addDataSourceVariableNode(server, nodeId,
+                                            UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                            UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                            UA_QUALIFIEDNAME(1, "counter"),
+                                            UA_NODEID_NUMERIC(0, UA_NS0ID_BASEDATAVARIABLETYPE),
+                                            attr, dataSource, NULL, NULL);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+
+    /* Five MonitoredItems on the same value */
+    createSubscription();
+    for(size_t i = 0; i < 5; i++)
+        createMonitoredItemWithNode(nodeId, UA_ATTRIBUTEID_VALUE);
+
+    UA_SamplingGroup *sg = LIST_FIRST(&server->samplingGroups);
+    ck_assert_ptr_ne(sg, NULL);
+    ck_assert_uint_eq(sg->samplesSize, 1);
+
+    /* The DataSource is read once per interval. Every MonitoredItem gets the
+     * new value. */
+    UA_UInt32 reads = dataSourceReads;
+    UA_fakeSleep((UA_UInt32)sg->samplingInterval + 1);
+    UA_Server_run_iterate(server, false);
+    ck_assert_uint_eq(dataSourceReads, reads + 1);
+    UA_MonitoredItem *mon;
+    size_t monSize = 0;
+    LIST_FOREACH(mon, &sg->samples[0]->monitoredItems, sharedSampleEntry) {
+        UA_Notification *n = TAILQ_LAST(&mon->queue, NotificationQueue);
+        ck_assert_ptr_ne(n, NULL);
+        ck_assert_uint_eq(*(UA_UInt32*)n->data.value.value.data, dataSourceReads);
+        monSize++;
+    }
+    ck_assert_uint_eq(monSize, 5);
+}
+END_TEST
+
+START_TEST(Server_reportByException) {
+    server->config.reportByException = true;
+
+    UA_VariableAttributes attr = UA_VariableAttributes_default;
+    UA_Int32 value = 0;
+    UA_Variant_setScalar(&attr.value, &value, &UA_TYPES[UA_TYPES_INT32]);
+    UA_NodeId nodeId = UA_NODEID_STRING(1, "value");
+    UA_StatusCode retval =
+        UA_Server_addVariableNode(server, nodeId, UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                  UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                  UA_QUALIFIEDNAME(1, "value"),
+                                  UA_NODEID_NUMERIC(0, UA_NS0ID_BASEDATAVARIABLETYPE),
+                                  attr, NULL, NULL);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+
+    /* Requesting a sampling interval of zero */
+    createSubscription();
+    createMonitoredItemWithNode(nodeId, UA_ATTRIBUTEID_VALUE);
+    UA_Subscription *sub = UA_Session_getSubscriptionById(session, subscriptionId);
+    ck_assert_ptr_ne(sub, NULL);
+    UA_MonitoredItem *mon = UA_Subscription_getMonitoredItem(sub, monitoredItemId);
+    ck_assert_ptr_ne(mon, NULL);
+    ck_assert(mon->samplingInterval == 0.0);
+    ck_assert(mon->samplingGroup->samplingInterval == 0.0);
+
+    /* Other attributes are still sampled periodically */
+    createMonitoredItem();
+    UA_MonitoredItem *polled = UA_Subscription_getMonitoredItem(sub, monitoredItemId);
+    ck_assert(polled->samplingInterval > 0.0);
+
+    /* The write is reported without sampling */
+    value = 42;
+    UA_Variant var;
+    UA_Variant_setScalar(&var, &value, &UA_TYPES[UA_TYPES_INT32]);
+    retval = UA_Server_writeValue(server, nodeId, var);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    UA_Notification *n = TAILQ_LAST(&mon->queue, NotificationQueue);
+    ck_assert_ptr_ne(n, NULL);
+    ck_assert_int_eq(*(UA_Int32*)n->data.value.value.data, 42);
+    ck_assert_ptr_eq(server->reportByExceptionGroup, mon->samplingGroup);
+
+    /* With a DataSource, the value is sampled periodically again */
+    UA_DataSource dataSource;
+    dataSource.read = countingRead;
+    dataSource.write = NULL;
+    retval = UA_Server_setVariableNode_dataSource(server, nodeId, dataSource);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert(mon->samplingInterval > 0.0);
+    ck_assert_ptr_ne(mon->samplingGroup, NULL);
+    ck_assert(mon->samplingGroup->samplingInterval > 0.0);
+    ck_assert_ptr_eq(server->reportByExceptionGroup, NULL);
+    UA_UInt32 reads = dataSourceReads;
+    UA_fakeSleep((UA_UInt32)mon->samplingInterval + 1);
+    UA_Server_run_iterate(server, false);
+    ck_assert_uint_gt(dataSourceReads, reads);
+}
+END_TEST
+
+START_TEST(Server_notificationCache) {
+    server->config.reportByException = true;
+
+    UA_VariableAttributes attr = UA_VariableAttributes_default;
+    UA_Int32 value = 0;
+    UA_Variant_setScalar(&attr.value, &value, &UA_TYPES[UA_TYPES_INT32]);
+    UA_NodeId nodeId = UA_NODEID_STRING(1, "value");
+    UA_StatusCode retval =
+        UA_Server_addVariableNode(server, nodeId, UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                  UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                  UA_QUALIFIEDNAME(1, "value"),
+                                  UA_NODEID_NUMERIC(0, UA_NS0ID_BASEDATAVARIABLETYPE),
+                                  attr, NULL, NULL);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+
+    createSubscription();
+    createMonitoredItemWithNode(nodeId, UA_ATTRIBUTEID_VALUE);
+    UA_Subscription *sub = UA_Session_getSubscriptionById(session, subscriptionId);
+    UA_MonitoredItem *mon = UA_Subscription_getMonitoredItem(sub, monitoredItemId);
+    ck_assert_ptr_ne(mon, NULL);
+    ck_assert_uint_eq(mon->maxQueueSize, 1);
+    ck_assert_uint_eq(mon->queueSize, 1);
+    ck_assert_uint_eq(mon->notificationCacheSize, 0);
+
+    /* The cache is filled when the first notification is discarded */
+    UA_Notification *used[2] = {TAILQ_FIRST(&mon->queue), NULL};
+    value = 1;
+    UA_Variant var;
+    UA_Variant_setScalar(&var, &value, &UA_TYPES[UA_TYPES_INT32]);
+    retval = UA_Server_writeValue(server, nodeId, var);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(mon->queueSize, 1);
+    ck_assert_uint_eq(mon->notificationCacheSize, 1);
+    ck_assert_ptr_eq(TAILQ_FIRST(&mon->notificationCache), used[0]);
+    used[1] = TAILQ_FIRST(&mon->queue);
+
+    /* The discarded notifications are reused */
+    for(value = 2; value < 10; value++) {
+        UA_Variant_setScalar(&var, &value, &UA_TYPES[UA_TYPES_INT32]);
+        retval = UA_Server_writeValue(server, nodeId, var);
+        ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+        ck_assert_uint_eq(mon->queueSize, 1);
+        ck_assert_uint_eq(mon->notificationCacheSize, 1);
+        UA_Notification *n = TAILQ_FIRST(&mon->queue);
+        ck_assert(n == used[0] || n == used[1]);
+        ck_assert_int_eq(*(UA_Int32*)n->data.value.value.data, value);
+    }
+}
+END_TEST
+
 START_TEST(Server_lifeTimeCount) {
     /* Create a subscription */
     UA_CreateSubscriptionRequest request;
@@ -809,10 +1090,15 @@ static Suite* testSuite_Client(void) {
     tcase_add_test(tc_server, Server_overflow);
     tcase_add_test(tc_server, Server_setMonitoringMode);
     tcase_add_test(tc_server, Server_deleteMonitoredItems);
+    tcase_add_test(tc_server, Server_samplingGroups);
+    tcase_add_test(tc_server, Server_reportByException);
+    tcase_add_test(tc_server, Server_notificationCache);
+    tcase_add_test(tc_server, Server_sharedSample);
     tcase_add_test(tc_server, Server_republish);
     tcase_add_test(tc_server, Server_republish_invalid);
     tcase_add_test(tc_server, Server_deleteSubscription);
     tcase_add_test(tc_server, Server_publishCallback);
+    tcase_add_test(tc_server, Server_publishBackpressure);
     tcase_add_test(tc_server, Server_lifeTimeCount);
     tcase_add_test(tc_server, Server_invalidPublishingInterval);
 #endif /* UA_ENABLE_SUBSCRIPTIONS */
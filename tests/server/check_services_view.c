@@ -125,6 +125,126 @@ START_TEST(Service_Browse_WithBrowseName) {
 }
 END_TEST
 
+START_TEST(Service_Browse_WithoutTargetAttributes) {
+    UA_ServerConfig *config = UA_ServerConfig_new_default();
+    UA_Server *server = UA_Server_new(config);
+
+    UA_BrowseDescription bd;
+    UA_BrowseDescription_init(&bd);
+    bd.resultMask = UA_BROWSERESULTMASK_ALL;
+    bd.nodeId = UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER);
+    bd.browseDirection = UA_BROWSEDIRECTION_BOTH;
+    UA_BrowseResult full = UA_Server_browse(server, 0, &bd);
+    ck_assert_int_eq(full.statusCode, UA_STATUSCODE_GOOD);
+    ck_assert(full.referencesSize > 0);
+
+    /* The same references are returned without looking up the targets */
+    bd.resultMask = UA_BROWSERESULTMASK_REFERENCETYPEID | UA_BROWSERESULTMASK_ISFORWARD;
+    UA_BrowseResult br = UA_Server_browse(server, 0, &bd);
+    ck_assert_int_eq(br.statusCode, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(br.referencesSize, full.referencesSize);
+    for(size_t i = 0; i < br.referencesSize; i++) {
+        ck_assert(UA_ExpandedNodeId_equal(&br.references[i].nodeId,
+                                          &full.references[i].nodeId));
+        ck_assert(UA_NodeId_equal(&br.references[i].referenceTypeId,
+                                  &full.references[i].referenceTypeId));
+        ck_assert_int_eq(br.references[i].isForward, full.references[i].isForward);
+        ck_assert_int_eq(br.references[i].nodeClass, UA_NODECLASS_UNSPECIFIED);
+        ck_assert(UA_String_equal(&br.references[i].browseName.name, &UA_STRING_NULL));
+    }
+
+    UA_BrowseResult_deleteMembers(&br);
+    UA_BrowseResult_deleteMembers(&full);
+    UA_Server_delete(server);
+    UA_ServerConfig_delete(config);
+}
+END_TEST
+
+static UA_StatusCode
+addTargetReference(UA_Server *server, UA_Session *session,
+                   UA_Node *node, const UA_ExpandedNodeId *target) {
+    UA_AddReferencesItem item;
+    UA_AddReferencesItem_init(&item);
+    item.isForward = true;
+    item.referenceTypeId = UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES);
+    item.targetNodeId = *target;
+    return UA_Node_addReference(node, &item);
+}
+
+/* References to a node on a remote server and to a missing node */
+START_TEST(Service_Browse_UnresolvableTargets) {
+    UA_ServerConfig *config = UA_ServerConfig_new_default();
+    UA_Server *server = UA_Server_new(config);
+
+    UA_NodeId folderId = UA_NODEID_NUMERIC(1, 5000);
+    UA_StatusCode res =
+        UA_Server_addObjectNode(server, folderId, UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                UA_QUALIFIEDNAME(1, "Folder"),
+                                UA_NODEID_NUMERIC(0, UA_NS0ID_FOLDERTYPE),
+                                UA_ObjectAttributes_default, NULL, NULL);
+    ck_assert_int_eq(res, UA_STATUSCODE_GOOD);
+
+    /* The remote NodeId also exists locally. It must not be resolved. */
+    UA_ExpandedNodeId remote = UA_EXPANDEDNODEID_NUMERIC(0, UA_NS0ID_SERVER);
+    remote.serverIndex = 1;
+    UA_ExpandedNodeId missing = UA_EXPANDEDNODEID_NUMERIC(1, 5001);
+    res = UA_Server_editNode(server, &server->adminSession, &folderId,
+                             (UA_EditNodeCallback)addTargetReference, &remote);
+    ck_assert_int_eq(res, UA_STATUSCODE_GOOD);
+    res = UA_Server_editNode(server, &server->adminSession, &folderId,
+                             (UA_EditNodeCallback)addTargetReference, &missing);
+    ck_assert_int_eq(res, UA_STATUSCODE_GOOD);
+
+    /* Both targets are returned with and without the target attributes. With
+     * only one reference per call, the continuation points match as well. */
+    UA_UInt32 masks[2] = {UA_BROWSERESULTMASK_ALL,
+                          UA_BROWSERESULTMASK_REFERENCETYPEID |
+                          UA_BROWSERESULTMASK_ISFORWARD};
+    for(size_t m = 0; m < 2; m++) {
+        UA_BrowseDescription bd;
+        UA_BrowseDescription_init(&bd);
+        bd.nodeId = folderId;
+        bd.browseDirection = UA_BROWSEDIRECTION_FORWARD;
+        bd.referenceTypeId = UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES);
+        bd.resultMask = masks[m];
+        UA_BrowseResult br = UA_Server_browse(server, 1, &bd);
+        ck_assert_int_eq(br.statusCode, UA_STATUSCODE_GOOD);
+        ck_assert_uint_eq(br.referencesSize, 1);
+        ck_assert(UA_ExpandedNodeId_equal(&br.references[0].nodeId, &remote));
+        ck_assert_int_eq(br.references[0].nodeClass, UA_NODECLASS_UNSPECIFIED);
+        ck_assert(UA_String_equal(&br.references[0].browseName.name, &UA_STRING_NULL));
+        ck_assert(br.references[0].isForward);
+        ck_assert_uint_gt(br.continuationPoint.length, 0);
+
+        UA_BrowseResult next = UA_Server_browseNext(server, false, &br.continuationPoint);
+        ck_assert_int_eq(next.statusCode, UA_STATUSCODE_GOOD);
+        ck_assert_uint_eq(next.referencesSize, 1);
+        ck_assert(UA_ExpandedNodeId_equal(&next.references[0].nodeId, &missing));
+        ck_assert_int_eq(next.references[0].nodeClass, UA_NODECLASS_UNSPECIFIED);
+        ck_assert_uint_eq(next.continuationPoint.length, 0);
+        UA_BrowseResult_deleteMembers(&next);
+        UA_BrowseResult_deleteMembers(&br);
+    }
+
+    /* Unresolvable targets don't match a NodeClass filter */
+    UA_BrowseDescription bd;
+    UA_BrowseDescription_init(&bd);
+    bd.nodeId = folderId;
+    bd.browseDirection = UA_BROWSEDIRECTION_FORWARD;
+    bd.referenceTypeId = UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES);
+    bd.nodeClassMask = UA_NODECLASS_OBJECT;
+    bd.resultMask = UA_BROWSERESULTMASK_ALL;
+    UA_BrowseResult br = UA_Server_browse(server, 0, &bd);
+    ck_assert_int_eq(br.statusCode, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(br.referencesSize, 0);
+    UA_BrowseResult_deleteMembers(&br);
+
+    UA_Server_delete(server);
+    UA_ServerConfig_delete(config);
+}
+END_TEST
+
 START_TEST(Service_TranslateBrowsePathsToNodeIds) {
     UA_Client *client = UA_Client_new();
     UA_ClientConfig_setDefault(UA_Client_getConfig(client));
@@ -192,6 +312,8 @@ static Suite *testSuite_Service_TranslateBrowsePathsToNodeIds(void) {
     TCase *tc_browse = tcase_create("Browse Service");
     tcase_add_test(tc_browse, Service_Browse_WithBrowseName);
     tcase_add_test(tc_browse, Service_Browse_WithMaxResults);
+    tcase_add_test(tc_browse, Service_Browse_WithoutTargetAttributes);
+    tcase_add_test(tc_browse, Service_Browse_UnresolvableTargets);
     suite_add_tcase(s, tc_browse);
 
     TCase *tc_translate = tcase_create("TranslateBrowsePathsToNodeIds");
@@ -6,8 +6,11 @@
 #include <stdlib.h>
 
 #include "ua_types.h"
+#include "ua_config_default.h"
 #include "server/ua_services.h"
+#include "server/ua_server_internal.h"
 #include "check.h"
+#include "testing_clock.h"
 
 START_TEST(Session_init_ShallWork) {
     UA_Session session;
@@ -45,11 +48,56 @@ START_TEST(Session_updateLifetime_ShallWork) {
 }
 END_TEST
 
+static UA_Session *
+createSession(UA_Server *server, UA_Double timeout) {
+    UA_CreateSessionRequest request;
+    UA_CreateSessionRequest_init(&request);
+    request.requestedSessionTimeout = timeout;
+    UA_Session *session = NULL;
+    UA_StatusCode retval =
+        UA_SessionManager_createSession(&server->sessionManager, NULL, &request, &session);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    return session;
+}
+
+START_TEST(SessionManager_cleanupTimedOut_ShallRemoveExpired) {
+    UA_ServerConfig *config = UA_ServerConfig_new_default();
+    UA_Server *server = UA_Server_new(config);
+    UA_SessionManager *sm = &server->sessionManager;
+
+    createSession(server, 1000.0);
+    UA_Session *s2 = createSession(server, 2000.0);
+    createSession(server, 3000.0);
+    ck_assert_uint_eq(sm->currentSessionCount, 3);
+
+    /* Only the first session has timed out */
+    UA_fakeSleep(1500);
+    UA_SessionManager_cleanupTimedOut(sm, UA_DateTime_nowMonotonic());
+    ck_assert_uint_eq(sm->currentSessionCount, 2);
+    ck_assert_ptr_eq(UA_SessionManager_getSessionByToken(sm, &s2->header.authenticationToken), s2);
+
+    /* Activity extends the lifetime of the second session beyond the third */
+    UA_SessionManager_updateLifetime(sm, s2);
+    UA_fakeSleep(1600);
+    UA_SessionManager_cleanupTimedOut(sm, UA_DateTime_nowMonotonic());
+    ck_assert_uint_eq(sm->currentSessionCount, 1);
+    ck_assert_ptr_eq(UA_SessionManager_getSessionById(sm, &s2->sessionId), s2);
+
+    UA_fakeSleep(2000);
+    UA_SessionManager_cleanupTimedOut(sm, UA_DateTime_nowMonotonic());
+    ck_assert_uint_eq(sm->currentSessionCount, 0);
+
+    UA_Server_delete(server);
+    UA_ServerConfig_delete(config);
+}
+END_TEST
+
 static Suite* testSuite_Session(void) {
     Suite *s = suite_create("Session");
     TCase *tc_core = tcase_create("Core");
     tcase_add_test(tc_core, Session_init_ShallWork);
     tcase_add_test(tc_core, Session_updateLifetime_ShallWork);
+    tcase_add_test(tc_core, SessionManager_cleanupTimedOut_ShallRemoveExpired);
 
     suite_add_tcase(s,tc_core);
     return s;
@@ -3,6 +3,7 @@
  * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
 
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 #include "testing_networklayers.h"
 #include "testing_clock.h"
@@ -55,6 +56,7 @@ UA_Connection createDummyConnection(size_t sendBufferSize,
     UA_ByteString_allocBuffer(&sendBuffer, sendBufferSize);
 
     UA_Connection c;
+    memset(&c, 0, sizeof(UA_Connection));
     c.state = UA_CONNECTION_ESTABLISHED;
     c.config = UA_ConnectionConfig_default;
     c.channel = NULL;